@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		async_task.h
+//!
+//! @brief		Minimal C++20 coroutine task. A Task starts when it is
+//!				awaited, resumes its awaiter when it finishes and hands back
+//!				the co_returned value or rethrows what escaped the body.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <coroutine>					// Coroutine handles and awaiters
+#include <exception>					// Exception propagation
+#include <optional>						// Result storage
+#include <stdexcept>					// Awaiting an empty task
+#include <utility>						// std::move, std::exchange
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_ASYNC_TASK				// Define the async task types.
+#define     CPP_ASYNC_TASK
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		template <typename T>
+		class Task;
+
+		/// @brief State shared by every task promise, the awaiting coroutine and a
+		///			captured exception.
+		class TaskPromiseBase
+		{
+		public:
+			/// @brief Symmetric transfer back to the awaiter, so long chains of tasks
+			///			finishing synchronously do not grow the stack.
+			struct FinalAwaiter
+			{
+				bool await_ready() const noexcept { return false; }
+
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().mContinuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept {}
+			};
+
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			FinalAwaiter final_suspend() const noexcept { return {}; }
+			void unhandled_exception() noexcept { mException = std::current_exception(); }
+
+			std::coroutine_handle<>	mContinuation;
+			std::exception_ptr		mException;
+		};
+
+		template <typename T>
+		class TaskPromise : public TaskPromiseBase
+		{
+		public:
+			Task<T> get_return_object() noexcept;
+
+			template <typename Value>
+			void return_value(Value&& value)
+			{
+				mValue.emplace(std::forward<Value>(value));
+			}
+
+			T TakeResult()
+			{
+				if (mException)
+				{
+					std::rethrow_exception(mException);
+				}
+				return std::move(*mValue);
+			}
+
+			std::optional<T> mValue;
+		};
+
+		template <>
+		class TaskPromise<void> : public TaskPromiseBase
+		{
+		public:
+			Task<void> get_return_object() noexcept;
+
+			void return_void() const noexcept {}
+
+			void TakeResult()
+			{
+				if (mException)
+				{
+					std::rethrow_exception(mException);
+				}
+			}
+		};
+
+		template <typename T = void>
+		class Task
+		{
+		public:
+			using promise_type = TaskPromise<T>;
+
+			Task() : mHandle(nullptr) {}
+			explicit Task(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+			Task(const Task&) = delete;
+			Task& operator=(const Task&) = delete;
+			Task(Task&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+			Task& operator=(Task&& other) noexcept
+			{
+				if (this != &other)
+				{
+					if (mHandle)
+					{
+						mHandle.destroy();
+					}
+					mHandle = std::exchange(other.mHandle, nullptr);
+				}
+				return *this;
+			}
+
+			~Task()
+			{
+				if (mHandle)
+				{
+					mHandle.destroy();
+				}
+			}
+
+			bool IsValid() const
+			{
+				return static_cast<bool>(mHandle);
+			}
+
+			// An empty task is ready so await_resume can report it, there is nothing to resume
+			bool await_ready() const noexcept
+			{
+				return !mHandle || mHandle.done();
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+			{
+				mHandle.promise().mContinuation = awaiter;
+				return mHandle;
+			}
+
+			T await_resume()
+			{
+				// Default constructed or moved from, there is no promise to take a result from
+				if (!mHandle)
+				{
+					throw std::logic_error("awaited a task without a coroutine");
+				}
+				return mHandle.promise().TakeResult();
+			}
+		protected:
+		private:
+			std::coroutine_handle<promise_type> mHandle;
+		};
+
+		template <typename T>
+		inline Task<T> TaskPromise<T>::get_return_object() noexcept
+		{
+			return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+		}
+
+		inline Task<void> TaskPromise<void>::get_return_object() noexcept
+		{
+			return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+		}
+
+		/// @brief Fire-and-forget coroutine that frees itself when it finishes. Used
+		///			to start a Task from plain code, its body must not throw.
+		struct DetachedTask
+		{
+			struct promise_type
+			{
+				DetachedTask get_return_object() const noexcept { return {}; }
+				std::suspend_never initial_suspend() const noexcept { return {}; }
+				std::suspend_never final_suspend() const noexcept { return {}; }
+				void return_void() const noexcept {}
+				void unhandled_exception() const noexcept { std::terminate(); }
+			};
+		};
+	}
+}
+#endif
@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		bounded_queue.h
+//!
+//! @brief		Fixed capacity lock-free multi producer / multi consumer queue
+//!				of trivially copyable values. A full queue drops its oldest
+//!				value to make room, a slow consumer only loses history.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Cell sequences and positions
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <memory>						// Cell storage
+#include <type_traits>					// is_trivially_copyable
+#include "seqlock.h"					// SpinPause
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_BOUNDED_QUEUE			// Define the bounded queue class.
+#define     CPP_BOUNDED_QUEUE
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Array based queue where every cell carries a sequence number telling
+		///			producers and consumers whose turn it is, so claiming a cell is one
+		///			compare-exchange on the shared position and no thread takes a lock.
+		///			Capacity is rounded up to a power of two.
+		template <typename T>
+		class BoundedQueue
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "BoundedQueue values must be trivially copyable");
+
+		public:
+			explicit BoundedQueue(size_t capacity)
+			{
+				size_t rounded = 2;
+				while (rounded < capacity)
+				{
+					rounded <<= 1;
+				}
+
+				mMask = rounded - 1;
+				mCells = std::make_unique<Cell[]>(rounded);
+				for (size_t i = 0; i < rounded; i++)
+				{
+					mCells[i].sequence.store(i, std::memory_order_relaxed);
+				}
+				mEnqueuePosition.store(0, std::memory_order_relaxed);
+				mDequeuePosition.store(0, std::memory_order_relaxed);
+				mDropped.store(0, std::memory_order_relaxed);
+			}
+
+			BoundedQueue(const BoundedQueue&) = delete;
+			BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+			/// @brief Append a value unless the queue is full.
+			/// @param value - value to append
+			/// @return true if the value was queued
+			bool TryPush(const T& value)
+			{
+				size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+				Cell* cell = nullptr;
+
+				while (true)
+				{
+					cell = &mCells[position & mMask];
+					const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+					const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+					if (difference == 0)
+					{
+						if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						{
+							break;
+						}
+					}
+					else if (difference < 0)
+					{
+						return false;
+					}
+					else
+					{
+						position = mEnqueuePosition.load(std::memory_order_relaxed);
+					}
+				}
+
+				cell->value = value;
+				cell->sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+
+			/// @brief Append a value, dropping the oldest queued values while it is full.
+			/// @param value - value to append
+			void Push(const T& value)
+			{
+				while (!TryPush(value))
+				{
+					// A consumer may be halfway through the oldest cell, then there is
+					// nothing to drop yet and the push retries once it is released.
+					T discarded;
+					if (TryPop(discarded))
+					{
+						mDropped.fetch_add(1, std::memory_order_relaxed);
+					}
+					else
+					{
+						SpinPause();
+					}
+				}
+			}
+
+			/// @brief Take the oldest value.
+			/// @param value - [out] the value taken
+			/// @return true if a value was taken, false if the queue is empty
+			bool TryPop(T& value)
+			{
+				size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+				Cell* cell = nullptr;
+
+				while (true)
+				{
+					cell = &mCells[position & mMask];
+					const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+					const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+					if (difference == 0)
+					{
+						if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						{
+							break;
+						}
+					}
+					else if (difference < 0)
+					{
+						return false;
+					}
+					else
+					{
+						position = mDequeuePosition.load(std::memory_order_relaxed);
+					}
+				}
+
+				value = cell->value;
+				cell->sequence.store(position + mMask + 1, std::memory_order_release);
+				return true;
+			}
+
+			/// @brief Approximate number of queued values, exact when no other thread is active.
+			size_t GetSize() const
+			{
+				const size_t enqueued = mEnqueuePosition.load(std::memory_order_acquire);
+				const size_t dequeued = mDequeuePosition.load(std::memory_order_acquire);
+				return enqueued > dequeued ? enqueued - dequeued : 0;
+			}
+
+			size_t GetCapacity() const
+			{
+				return mMask + 1;
+			}
+
+			/// @brief Values discarded by Push to make room.
+			uint64_t GetDroppedCount() const
+			{
+				return mDropped.load(std::memory_order_relaxed);
+			}
+
+		protected:
+		private:
+			struct Cell
+			{
+				std::atomic<size_t>	sequence;
+				T					value;
+			};
+
+			std::unique_ptr<Cell[]>				mCells;
+			size_t								mMask;
+			alignas(64) std::atomic<size_t>		mEnqueuePosition;
+			alignas(64) std::atomic<size_t>		mDequeuePosition;
+			alignas(64) std::atomic<uint64_t>	mDropped;
+		};
+	}
+}
+#endif
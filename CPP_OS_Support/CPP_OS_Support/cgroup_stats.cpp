@@ -0,0 +1,328 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cgroup_stats.cpp
+//!
+//! @brief		Implementation of the cgroup stats class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"cgroup_stats.h"			// Cgroup Stats Class
+#include	<algorithm>					// std::min
+#include	<chrono>					// Sample timestamps
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		CgroupStats::CgroupStats()
+		{
+			mDirectoryFd = -1;
+			mPreviousTimestampNs = 0;
+			mPreviousUsageUsec = 0;
+			mPreviousUserUsec = 0;
+			mPreviousSystemUsec = 0;
+			mPreviousPeriods = 0;
+			mPreviousThrottledPeriods = 0;
+		}
+
+		CgroupStats::~CgroupStats()
+		{
+			Close();
+		}
+
+		int CgroupStats::Open(MountTable& table)
+		{
+#ifdef __linux__
+			// The unified hierarchy is the "0::" line, v1 controllers have their own lines
+			ProcfsFile selfCgroup("/proc/self/cgroup");
+			std::string_view text = selfCgroup.Read();
+			std::string_view path;
+			while (!text.empty())
+			{
+				std::string_view line = Procfs::NextLine(text);
+				if (line.substr(0, 3) == "0::")
+				{
+					path = line.substr(3);
+					break;
+				}
+			}
+
+			if (path.empty())
+			{
+				return -1;
+			}
+
+			// A mount's root is the part of the hierarchy it exposes, inside a cgroup
+			// namespace both are usually "/". Prefer the mount exposing the most of the path.
+			const MountEntry* best = nullptr;
+			for (const MountEntry& mount : table.GetMounts())
+			{
+				if (mount.fsType != "cgroup2" || path.compare(0, mount.root.size(), mount.root) != 0)
+				{
+					continue;
+				}
+
+				if (best == nullptr || mount.root.size() > best->root.size())
+				{
+					best = &mount;
+				}
+			}
+
+			if (best == nullptr)
+			{
+				return -1;
+			}
+
+			std::string relative(path.substr(best->root == "/" ? 0 : best->root.size()));
+			std::string directory = best->mountPoint;
+			if (!relative.empty() && relative != "/")
+			{
+				if (directory.back() == '/')
+				{
+					directory.pop_back();
+				}
+				directory += relative;
+			}
+
+			return Open(table, directory);
+#else
+			(void)table;
+			return -1;
+#endif
+		}
+
+		int CgroupStats::Open(MountTable& table, const std::string& directory)
+		{
+			Close();
+
+#ifdef __linux__
+			mDirectoryFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (mDirectoryFd < 0)
+			{
+				return -1;
+			}
+			mDirectory = directory;
+
+			// Files of controllers that are not enabled are simply absent
+			mMemoryCurrentFile.OpenAt(mDirectoryFd, "memory.current", 64);
+			mMemoryStatFile.OpenAt(mDirectoryFd, "memory.stat", 4096);
+			mCpuStatFile.OpenAt(mDirectoryFd, "cpu.stat", 512);
+
+			// A parent's limit bounds every child, so keep a handle on each level up to the mount
+			const MountEntry* mount = table.FindMountForPath(directory);
+			std::string level = directory;
+			while (true)
+			{
+				ProcfsFile memoryMax;
+				if (memoryMax.Open((level + "/memory.max").c_str(), 64) == 0)
+				{
+					mMemoryMaxFiles.push_back(std::move(memoryMax));
+				}
+
+				ProcfsFile cpuMax;
+				if (cpuMax.Open((level + "/cpu.max").c_str(), 64) == 0)
+				{
+					mCpuMaxFiles.push_back(std::move(cpuMax));
+				}
+
+				size_t slash = level.find_last_of('/');
+				if (mount == nullptr || level == mount->mountPoint || slash == std::string::npos || slash == 0)
+				{
+					break;
+				}
+				level.resize(slash);
+			}
+
+			return 0;
+#else
+			(void)table;
+			(void)directory;
+			return -1;
+#endif
+		}
+
+		void CgroupStats::Close()
+		{
+#ifdef __linux__
+			if (mDirectoryFd >= 0)
+			{
+				close(mDirectoryFd);
+				mDirectoryFd = -1;
+			}
+#endif
+
+			mDirectory.clear();
+			mMemoryCurrentFile.Close();
+			mMemoryStatFile.Close();
+			mCpuStatFile.Close();
+			mMemoryMaxFiles.clear();
+			mCpuMaxFiles.clear();
+			mPreviousTimestampNs = 0;
+		}
+
+		bool CgroupStats::IsOpen() const
+		{
+			return mDirectoryFd >= 0;
+		}
+
+		const std::string& CgroupStats::GetDirectory() const
+		{
+			return mDirectory;
+		}
+
+		int CgroupStats::Sample(CgroupSample& sample)
+		{
+			const int memory = ReadMemory(sample);
+			const int cpu = ReadCpu(sample);
+
+			return memory == 0 || cpu == 0 ? 0 : -1;
+		}
+
+		int CgroupStats::ReadMemory(CgroupSample& sample)
+		{
+			sample.hasMemory = false;
+			sample.hasMemoryLimit = false;
+			if (!mMemoryCurrentFile.IsOpen())
+			{
+				return -1;
+			}
+
+			uint64_t current = 0;
+			if (!ParseLimit(mMemoryCurrentFile.Read(), current))
+			{
+				return -1;
+			}
+
+			sample.hasMemory = true;
+			sample.memoryCurrentBytes = current;
+
+			for (ProcfsFile& file : mMemoryMaxFiles)
+			{
+				uint64_t limit = 0;
+				if (ParseLimit(file.Read(), limit))
+				{
+					sample.memoryLimitBytes = sample.hasMemoryLimit ? std::min(sample.memoryLimitBytes, limit) : limit;
+					sample.hasMemoryLimit = true;
+				}
+			}
+
+			std::string_view stat = mMemoryStatFile.Read();
+			Procfs::FindValue(stat, "anon", sample.memoryAnonBytes);
+			Procfs::FindValue(stat, "file", sample.memoryFileBytes);
+			Procfs::FindValue(stat, "inactive_file", sample.memoryInactiveFileBytes);
+
+			sample.memoryWorkingSetBytes = current > sample.memoryInactiveFileBytes ? current - sample.memoryInactiveFileBytes : 0;
+			return 0;
+		}
+
+		int CgroupStats::ReadCpu(CgroupSample& sample)
+		{
+			sample.hasCpu = false;
+			sample.cpuIntervalNs = 0;
+			if (!mCpuStatFile.IsOpen())
+			{
+				return -1;
+			}
+
+			// usage/user/system are always present, the throttling keys only with the cpu controller
+			std::string_view stat = mCpuStatFile.Read();
+			if (!Procfs::FindValue(stat, "usage_usec", sample.cpuUsageUsec))
+			{
+				return -1;
+			}
+			Procfs::FindValue(stat, "user_usec", sample.cpuUserUsec);
+			Procfs::FindValue(stat, "system_usec", sample.cpuSystemUsec);
+			Procfs::FindValue(stat, "nr_periods", sample.cpuPeriods);
+			Procfs::FindValue(stat, "nr_throttled", sample.cpuThrottledPeriods);
+			Procfs::FindValue(stat, "throttled_usec", sample.cpuThrottledUsec);
+			sample.hasCpu = true;
+
+			// cpu.max is "max 100000" or "<quota> <period>"
+			sample.hasCpuLimit = false;
+			sample.cpuLimitCores = static_cast<double>(CountAllowedCpus());
+			for (ProcfsFile& file : mCpuMaxFiles)
+			{
+				std::string_view text = file.Read();
+				std::string_view quotaToken = Procfs::NextToken(text);
+				std::string_view periodToken = Procfs::NextToken(text);
+
+				uint64_t quota = 0;
+				uint64_t period = 0;
+				if (Procfs::ToUnsigned(quotaToken, quota) && Procfs::ToUnsigned(periodToken, period) && period > 0)
+				{
+					const double cores = static_cast<double>(quota) / static_cast<double>(period);
+					if (cores < sample.cpuLimitCores)
+					{
+						sample.cpuLimitCores = cores;
+						sample.hasCpuLimit = true;
+					}
+				}
+			}
+
+			sample.timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+
+			// Interval figures against the previous CPU read
+			if (mPreviousTimestampNs != 0 && sample.timestampNs > mPreviousTimestampNs && sample.cpuLimitCores > 0.0)
+			{
+				const double capacityUsec = static_cast<double>(sample.timestampNs - mPreviousTimestampNs) / 1000.0 * sample.cpuLimitCores;
+				auto percent = [capacityUsec](uint64_t before, uint64_t after) -> double
+				{
+					return after >= before ? static_cast<double>(after - before) / capacityUsec * 100.0 : 0.0;
+				};
+
+				sample.cpuUsagePercent = percent(mPreviousUsageUsec, sample.cpuUsageUsec);
+				sample.cpuUserPercent = percent(mPreviousUserUsec, sample.cpuUserUsec);
+				sample.cpuSystemPercent = percent(mPreviousSystemUsec, sample.cpuSystemUsec);
+
+				const uint64_t periods = sample.cpuPeriods - mPreviousPeriods;
+				sample.cpuThrottledPercent = periods > 0 ?
+					static_cast<double>(sample.cpuThrottledPeriods - mPreviousThrottledPeriods) / static_cast<double>(periods) * 100.0 : 0.0;
+				sample.cpuIntervalNs = sample.timestampNs - mPreviousTimestampNs;
+			}
+
+			mPreviousTimestampNs = sample.timestampNs;
+			mPreviousUsageUsec = sample.cpuUsageUsec;
+			mPreviousUserUsec = sample.cpuUserUsec;
+			mPreviousSystemUsec = sample.cpuSystemUsec;
+			mPreviousPeriods = sample.cpuPeriods;
+			mPreviousThrottledPeriods = sample.cpuThrottledPeriods;
+
+			return 0;
+		}
+
+		bool CgroupStats::ParseLimit(std::string_view text, uint64_t& value)
+		{
+			// "max" means unlimited and is reported as no limit
+			std::string_view token = Procfs::NextToken(text);
+			return Procfs::ToUnsigned(token, value);
+		}
+
+		int CgroupStats::CountAllowedCpus()
+		{
+#ifdef __linux__
+			// cpuset restrictions show up in the affinity mask
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			if (sched_getaffinity(0, sizeof(set), &set) == 0)
+			{
+				return CPU_COUNT(&set);
+			}
+
+			long online = sysconf(_SC_NPROCESSORS_ONLN);
+			return online > 0 ? static_cast<int>(online) : 1;
+#else
+			return 1;
+#endif
+		}
+	}
+}
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cgroup_stats.h
+//!
+//! @brief		cgroup v2 memory and CPU accounting for the cgroup this
+//!				process runs in, so containerised callers see their own
+//!				limits and usage rather than the host's.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Fixed width types
+#include <string>						// cgroup path
+#include <string_view>					// Parsing
+#include <vector>						// Ancestor limit files
+#include "procfs_reader.h"				// Persistent interface file handles
+#include "mount_table.h"				// Locating the cgroup2 mount
+//
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_CGROUP_STATS			// Define the cgroup stats class.
+#define     CPP_CGROUP_STATS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Memory and CPU figures of one cgroup. Limits are the effective
+		///			ones, the tightest of the cgroup and all of its ancestors.
+		struct CgroupSample
+		{
+			uint64_t	timestampNs = 0;
+
+			bool		hasMemory = false;				// memory controller enabled for the cgroup
+			bool		hasMemoryLimit = false;
+			uint64_t	memoryLimitBytes = 0;
+			uint64_t	memoryCurrentBytes = 0;			// Includes page cache
+			uint64_t	memoryAnonBytes = 0;
+			uint64_t	memoryFileBytes = 0;
+			uint64_t	memoryInactiveFileBytes = 0;
+			uint64_t	memoryWorkingSetBytes = 0;		// current - inactive_file, what the OOM killer weighs
+
+			bool		hasCpu = false;
+			bool		hasCpuLimit = false;
+			double		cpuLimitCores = 0.0;			// quota / period, or the allowed CPU count without a quota
+			uint64_t	cpuUsageUsec = 0;
+			uint64_t	cpuUserUsec = 0;
+			uint64_t	cpuSystemUsec = 0;
+			uint64_t	cpuPeriods = 0;
+			uint64_t	cpuThrottledPeriods = 0;
+			uint64_t	cpuThrottledUsec = 0;
+
+			double		cpuUsagePercent = 0.0;			// Of cpuLimitCores over the interval
+			double		cpuUserPercent = 0.0;
+			double		cpuSystemPercent = 0.0;
+			double		cpuThrottledPercent = 0.0;		// Share of enforcement periods that were throttled
+			uint64_t	cpuIntervalNs = 0;				// 0 until two CPU reads have been made
+		};
+
+		class CgroupStats
+		{
+		public:
+			CgroupStats();
+			~CgroupStats();
+			CgroupStats(const CgroupStats&) = delete;
+			CgroupStats& operator=(const CgroupStats&) = delete;
+			int			Open(MountTable& table);
+			int			Open(MountTable& table, const std::string& directory);
+			void		Close();
+			bool		IsOpen() const;
+			const std::string& GetDirectory() const;
+			int			Sample(CgroupSample& sample);
+			int			ReadMemory(CgroupSample& sample);
+			int			ReadCpu(CgroupSample& sample);
+		protected:
+		private:
+			static bool	ParseLimit(std::string_view text, uint64_t& value);
+			static int	CountAllowedCpus();
+
+			std::string					mDirectory;
+			int							mDirectoryFd;
+			ProcfsFile					mMemoryCurrentFile;
+			ProcfsFile					mMemoryStatFile;
+			ProcfsFile					mCpuStatFile;
+			std::vector<ProcfsFile>		mMemoryMaxFiles;		// The cgroup first, then each ancestor
+			std::vector<ProcfsFile>		mCpuMaxFiles;
+			uint64_t					mPreviousTimestampNs;
+			uint64_t					mPreviousUsageUsec;
+			uint64_t					mPreviousUserUsec;
+			uint64_t					mPreviousSystemUsec;
+			uint64_t					mPreviousPeriods;
+			uint64_t					mPreviousThrottledPeriods;
+		};
+	}
+}
+#endif
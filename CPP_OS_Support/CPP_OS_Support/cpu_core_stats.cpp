@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cpu_core_stats.cpp
+//!
+//! @brief		Implementation of the cpu core stats class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"cpu_core_stats.h"			// CPU Core Stats Class
+#include	<algorithm>					// std::max
+//
+#if defined(_MSC_VER)
+#define OS_SUPPORT_RESTRICT __restrict
+#else
+#define OS_SUPPORT_RESTRICT __restrict__
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		// Vector kernels. Each runs over contiguous per-core columns with no
+		// aliasing so the compiler emits packed SIMD for the whole loop.
+
+		static void DeltaKernel(const double* OS_SUPPORT_RESTRICT current, const double* OS_SUPPORT_RESTRICT previous,
+			double* OS_SUPPORT_RESTRICT delta, double* OS_SUPPORT_RESTRICT total, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				// Counters can step backwards across CPU hotplug, clamp those to zero.
+				const double d = std::max(current[i] - previous[i], 0.0);
+				delta[i] = d;
+				total[i] += d;
+			}
+		}
+
+		static void ReciprocalKernel(double* OS_SUPPORT_RESTRICT total, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				// A non-empty interval has at least one jiffy; a zero total means every delta is zero.
+				total[i] = 100.0 / std::max(total[i], 1.0);
+			}
+		}
+
+		static void ScaleKernel(double* OS_SUPPORT_RESTRICT values, const double* OS_SUPPORT_RESTRICT scale, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				values[i] *= scale[i];
+			}
+		}
+
+		static void AccumulateKernel(const double* OS_SUPPORT_RESTRICT values, double* OS_SUPPORT_RESTRICT sum, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				sum[i] += values[i];
+			}
+		}
+
+		CpuCoreStats::CpuCoreStats() : mStatFile("/proc/stat", 64 * 1024)
+		{
+			mSampleCount = 0;
+		}
+
+		CpuCoreStats::~CpuCoreStats()
+		{
+
+		}
+
+		int CpuCoreStats::Sample()
+		{
+			int result = -1;
+
+#ifdef __linux__
+			// Linux implementation
+			std::string_view stat = mStatFile.Read();
+			if (!stat.empty())
+			{
+				result = Update(stat);
+			}
+
+#endif
+
+			return result;
+		}
+
+		int CpuCoreStats::Update(std::string_view statText)
+		{
+			for (size_t field = 0; field < FIELD_COUNT; field++)
+			{
+				mPrevious[field].swap(mCurrent[field]);
+			}
+
+			const size_t previousCount = mCoreIds.size();
+			bool topologyChanged = false;
+			size_t count = 0;
+
+			const char* cursor = statText.data();
+			const char* end = cursor + statText.size();
+
+			while (cursor < end)
+			{
+				const char* lineEnd = cursor;
+				while (lineEnd < end && *lineEnd != '\n')
+				{
+					lineEnd++;
+				}
+
+				const size_t lineLength = static_cast<size_t>(lineEnd - cursor);
+				if (lineLength < 4 || cursor[0] != 'c' || cursor[1] != 'p' || cursor[2] != 'u')
+				{
+					// The cpu lines are contiguous at the top of the file
+					break;
+				}
+
+				if (cursor[3] >= '0' && cursor[3] <= '9')
+				{
+					uint64_t id = 0;
+					const char* field = Procfs::ParseUnsigned(cursor + 3, lineEnd, id);
+
+					if (count >= mCoreIds.size())
+					{
+						Resize(count + 1);
+						topologyChanged = true;
+					}
+					else if (mCoreIds[count] != static_cast<int>(id))
+					{
+						topologyChanged = true;
+					}
+
+					mCoreIds[count] = static_cast<int>(id);
+					for (size_t column = 0; column < FIELD_COUNT; column++)
+					{
+						uint64_t value = 0;
+						field = Procfs::ParseUnsigned(field, lineEnd, value);
+						mCurrent[column][count] = static_cast<double>(value);
+					}
+
+					count++;
+				}
+
+				cursor = lineEnd + 1;
+			}
+
+			if (count == 0)
+			{
+				// Nothing was parsed, put the last good sample back as the baseline
+				for (size_t field = 0; field < FIELD_COUNT; field++)
+				{
+					mPrevious[field].swap(mCurrent[field]);
+				}
+				return -1;
+			}
+
+			if (count != previousCount)
+			{
+				Resize(count);
+				topologyChanged = true;
+			}
+
+			if (topologyChanged)
+			{
+				// No usable previous sample, report since boot for this one
+				for (size_t field = 0; field < FIELD_COUNT; field++)
+				{
+					std::fill(mPrevious[field].begin(), mPrevious[field].end(), 0.0);
+				}
+				mSampleCount = 0;
+			}
+
+			ComputeIntervals();
+			mSampleCount++;
+
+			return 0;
+		}
+
+		void CpuCoreStats::Resize(size_t coreCount)
+		{
+			mCoreIds.resize(coreCount, -1);
+			for (size_t field = 0; field < FIELD_COUNT; field++)
+			{
+				mCurrent[field].resize(coreCount, 0.0);
+				mPrevious[field].resize(coreCount, 0.0);
+				mPercent[field].resize(coreCount, 0.0);
+			}
+			mTotal.resize(coreCount, 0.0);
+			mUsage.resize(coreCount, 0.0);
+		}
+
+		void CpuCoreStats::ComputeIntervals()
+		{
+			const size_t count = mCoreIds.size();
+
+			std::fill(mTotal.begin(), mTotal.end(), 0.0);
+			for (size_t field = 0; field < FIELD_COUNT; field++)
+			{
+				DeltaKernel(mCurrent[field].data(), mPrevious[field].data(), mPercent[field].data(), mTotal.data(), count);
+			}
+
+			ReciprocalKernel(mTotal.data(), count);
+			for (size_t field = 0; field < FIELD_COUNT; field++)
+			{
+				ScaleKernel(mPercent[field].data(), mTotal.data(), count);
+			}
+
+			// Busy is everything except idle and iowait
+			std::fill(mUsage.begin(), mUsage.end(), 0.0);
+			for (Field field : { USER, NICE, SYSTEM, IRQ, SOFTIRQ, STEAL })
+			{
+				AccumulateKernel(mPercent[field].data(), mUsage.data(), count);
+			}
+		}
+
+		size_t CpuCoreStats::GetCoreCount() const
+		{
+			return mCoreIds.size();
+		}
+
+		bool CpuCoreStats::HasInterval() const
+		{
+			return mSampleCount > 1;
+		}
+
+		int CpuCoreStats::GetCoreUsage(std::vector<CoreCpuUsage>& cores) const
+		{
+			const size_t count = mCoreIds.size();
+			if (count == 0)
+			{
+				return -1;
+			}
+
+			cores.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				CoreCpuUsage& core = cores[i];
+				core.core		= mCoreIds[i];
+				core.usage		= mUsage[i];
+				core.user		= mPercent[USER][i];
+				core.nice		= mPercent[NICE][i];
+				core.system		= mPercent[SYSTEM][i];
+				core.idle		= mPercent[IDLE][i];
+				core.iowait		= mPercent[IOWAIT][i];
+				core.irq		= mPercent[IRQ][i];
+				core.softirq	= mPercent[SOFTIRQ][i];
+				core.steal		= mPercent[STEAL][i];
+			}
+
+			return 0;
+		}
+
+		const double* CpuCoreStats::GetPercentColumn(Field field) const
+		{
+			return field < FIELD_COUNT ? mPercent[field].data() : nullptr;
+		}
+
+		const double* CpuCoreStats::GetUsageColumn() const
+		{
+			return mUsage.data();
+		}
+
+		const int* CpuCoreStats::GetCoreIds() const
+		{
+			return mCoreIds.data();
+		}
+	}
+}
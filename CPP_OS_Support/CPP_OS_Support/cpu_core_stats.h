@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cpu_core_stats.h
+//!
+//! @brief		Per-core CPU utilisation computed from the cpuN lines of
+//!				/proc/stat. Counters are kept as a structure of arrays so
+//!				the per-interval math runs as vectorised loops over all cores.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string_view>					// Parsing input
+#include <vector>						// Per-core arrays
+#include "procfs_reader.h"				// Persistent /proc/stat handle
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_CPU_CORE_STATS			// Define the cpu core stats class.
+#define     CPP_CPU_CORE_STATS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Utilisation of one core over the last interval, in percent of that core.
+		struct CoreCpuUsage
+		{
+			int		core = -1;
+			double	usage = 0.0;			// Everything except idle and iowait
+			double	user = 0.0;
+			double	nice = 0.0;
+			double	system = 0.0;
+			double	idle = 0.0;
+			double	iowait = 0.0;
+			double	irq = 0.0;
+			double	softirq = 0.0;
+			double	steal = 0.0;
+		};
+
+		class CpuCoreStats
+		{
+		public:
+			/// @brief Counter columns, in /proc/stat order.
+			enum Field : uint8_t
+			{
+				USER,
+				NICE,
+				SYSTEM,
+				IDLE,
+				IOWAIT,
+				IRQ,
+				SOFTIRQ,
+				STEAL,
+				FIELD_COUNT,
+			};
+
+			CpuCoreStats();
+			~CpuCoreStats();
+			int			Sample();
+			int			Update(std::string_view statText);
+			size_t		GetCoreCount() const;
+			bool		HasInterval() const;
+			int			GetCoreUsage(std::vector<CoreCpuUsage>& cores) const;
+			const double* GetPercentColumn(Field field) const;
+			const double* GetUsageColumn() const;
+			const int*	GetCoreIds() const;
+		protected:
+		private:
+			void		Resize(size_t coreCount);
+			void		ComputeIntervals();
+
+			std::vector<int>	mCoreIds;
+			std::vector<double>	mCurrent[FIELD_COUNT];	// Cumulative counters of the latest sample
+			std::vector<double>	mPrevious[FIELD_COUNT];	// Cumulative counters of the sample before
+			std::vector<double>	mPercent[FIELD_COUNT];	// Interval percentages
+			std::vector<double>	mTotal;					// Scratch, interval jiffies per core
+			std::vector<double>	mUsage;					// Interval busy percentage per core
+			ProcfsFile			mStatFile;
+			size_t				mSampleCount;
+		};
+	}
+}
+#endif
@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cpu_sampler.cpp
+//!
+//! @brief		Implementation of the cpu sampler class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"cpu_sampler.h"				// CPU Sampler Class
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		static uint64_t SteadyNowNs()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		CpuSampler::CpuSampler() : mStatFile("/proc/stat")
+		{
+			mStopRequested = false;
+			mRunning = false;
+			mPeriod = std::chrono::milliseconds(1000);
+		}
+
+		CpuSampler::~CpuSampler()
+		{
+			Stop();
+		}
+
+		int CpuSampler::Start(std::chrono::milliseconds period)
+		{
+			if (mRunning)
+			{
+				return 0;
+			}
+
+			CpuTimes baseline;
+			if (ReadCpuTimes(mStatFile, baseline) != 0)
+			{
+				return -1;
+			}
+
+			// Seed with the since-boot average so readers have a sensible value
+			// until the first full interval completes.
+			CpuSample seed;
+			ComputeSample(CpuTimes(), baseline, seed);
+			seed.timestampNs = SteadyNowNs();
+			seed.intervalNs = 0;
+			mLatest.Store(seed);
+
+			mPeriod = period.count() > 0 ? period : std::chrono::milliseconds(1);
+			{
+				std::lock_guard<std::mutex> lock(mWakeMutex);
+				mStopRequested = false;
+			}
+			mRunning = true;
+			mThread = std::thread(&CpuSampler::Run, this, baseline);
+
+			return 0;
+		}
+
+		void CpuSampler::Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mWakeMutex);
+				mStopRequested = true;
+			}
+			mWakeCondition.notify_all();
+
+			if (mThread.joinable())
+			{
+				mThread.join();
+			}
+
+			mRunning = false;
+		}
+
+		bool CpuSampler::IsRunning() const
+		{
+			return mRunning;
+		}
+
+		CpuSample CpuSampler::GetLatestSample() const
+		{
+			return mLatest.Load();
+		}
+
+		double CpuSampler::GetUsagePercent() const
+		{
+			return mLatest.Load().usage;
+		}
+
+		void CpuSampler::Run(CpuTimes previous)
+		{
+			uint64_t previousNs = SteadyNowNs();
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mWakeMutex);
+					if (mWakeCondition.wait_for(lock, mPeriod, [this] { return mStopRequested; }))
+					{
+						break;
+					}
+				}
+
+				CpuTimes current;
+				if (ReadCpuTimes(mStatFile, current) != 0)
+				{
+					continue;
+				}
+
+				CpuSample sample;
+				ComputeSample(previous, current, sample);
+				sample.timestampNs = SteadyNowNs();
+				sample.intervalNs = sample.timestampNs - previousNs;
+				mLatest.Store(sample);
+
+				previous = current;
+				previousNs = sample.timestampNs;
+			}
+		}
+
+		void CpuSampler::ComputeSample(const CpuTimes& previous, const CpuTimes& current, CpuSample& sample)
+		{
+			// Counters can step backwards across CPU hotplug, clamp those to zero.
+			auto delta = [](uint64_t before, uint64_t after) -> double
+			{
+				return after > before ? static_cast<double>(after - before) : 0.0;
+			};
+
+			const double user		= delta(previous.user, current.user);
+			const double nice		= delta(previous.nice, current.nice);
+			const double system		= delta(previous.system, current.system);
+			const double idle		= delta(previous.idle, current.idle);
+			const double iowait		= delta(previous.iowait, current.iowait);
+			const double irq		= delta(previous.irq, current.irq);
+			const double softirq	= delta(previous.softirq, current.softirq);
+			const double steal		= delta(previous.steal, current.steal);
+			const double total		= user + nice + system + idle + iowait + irq + softirq + steal;
+
+			if (total <= 0.0)
+			{
+				return;
+			}
+
+			const double scale = 100.0 / total;
+			sample.user		= user * scale;
+			sample.nice		= nice * scale;
+			sample.system	= system * scale;
+			sample.idle		= idle * scale;
+			sample.iowait	= iowait * scale;
+			sample.irq		= irq * scale;
+			sample.softirq	= softirq * scale;
+			sample.steal	= steal * scale;
+			sample.usage	= (total - idle - iowait) * scale;
+		}
+
+		int CpuSampler::ReadCpuTimes(ProcfsFile& statFile, CpuTimes& times)
+		{
+			(void)statFile;
+			int result = -1;
+
+#ifdef _WIN32
+			// Windows implementation
+			FILETIME idleTime, kernelTime, userTime;
+			if (GetSystemTimes(&idleTime, &kernelTime, &userTime))
+			{
+				auto toU64 = [](const FILETIME& ft) -> uint64_t
+				{
+					return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+				};
+
+				// Kernel time includes idle time on Windows
+				times = CpuTimes();
+				times.idle = toU64(idleTime);
+				times.system = toU64(kernelTime) - times.idle;
+				times.user = toU64(userTime);
+				result = 0;
+			}
+
+#elif __linux__
+			// Linux implementation
+			result = ParseCpuTimes(statFile.Read(), times);
+
+#elif __APPLE__
+			// macOS implementation
+			host_cpu_load_info_data_t loadInfo;
+			mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+			if (host_statistics(mach_host_self(), HOST_CPU_LOAD_INFO, reinterpret_cast<host_info_t>(&loadInfo), &count) == KERN_SUCCESS)
+			{
+				times = CpuTimes();
+				times.user = loadInfo.cpu_ticks[CPU_STATE_USER];
+				times.nice = loadInfo.cpu_ticks[CPU_STATE_NICE];
+				times.system = loadInfo.cpu_ticks[CPU_STATE_SYSTEM];
+				times.idle = loadInfo.cpu_ticks[CPU_STATE_IDLE];
+				result = 0;
+			}
+
+#endif
+
+			return result;
+		}
+
+		int CpuSampler::ParseCpuTimes(std::string_view stat, CpuTimes& times)
+		{
+			// The aggregate "cpu" line always leads /proc/stat
+			if (stat.size() < 4 || stat.compare(0, 4, "cpu ") != 0)
+			{
+				return -1;
+			}
+
+			std::string_view line = Procfs::NextLine(stat);
+			const char* cursor = line.data() + 4;
+			const char* end = line.data() + line.size();
+
+			uint64_t* fields[] = { &times.user, &times.nice, &times.system, &times.idle,
+				&times.iowait, &times.irq, &times.softirq, &times.steal };
+			for (uint64_t* field : fields)
+			{
+				cursor = Procfs::ParseUnsigned(cursor, end, *field);
+			}
+
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cpu_sampler.h
+//!
+//! @brief		Background sampler that turns the cumulative CPU time counters
+//!				into interval utilisation and publishes the latest result.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Running flag
+#include <chrono>						// Sample period
+#include <condition_variable>			// Prompt shutdown of the sampler
+#include <cstdint>						// Fixed width types
+#include <mutex>						// Condition variable guard
+#include <string_view>					// Parsing /proc/stat
+#include <thread>						// Sampler thread
+#include "seqlock.h"					// Publishing the latest sample
+#include "procfs_reader.h"				// Persistent /proc/stat handle
+//
+#ifdef _WIN32
+#include <Windows.h>
+#elif __APPLE__
+#include <mach/mach.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_CPU_SAMPLER				// Define the cpu sampler class.
+#define     CPP_CPU_SAMPLER
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Cumulative CPU time counters as reported by the OS (jiffies on Linux,
+		///			100ns units on Windows, ticks on macOS).
+		struct CpuTimes
+		{
+			uint64_t user = 0;
+			uint64_t nice = 0;
+			uint64_t system = 0;
+			uint64_t idle = 0;
+			uint64_t iowait = 0;
+			uint64_t irq = 0;
+			uint64_t softirq = 0;
+			uint64_t steal = 0;
+
+			uint64_t Total() const
+			{
+				return user + nice + system + idle + iowait + irq + softirq + steal;
+			}
+		};
+
+		/// @brief CPU utilisation over one sampling interval, in percent of all CPUs.
+		struct CpuSample
+		{
+			double		usage = 0.0;			// Everything except idle and iowait
+			double		user = 0.0;
+			double		nice = 0.0;
+			double		system = 0.0;
+			double		idle = 0.0;
+			double		iowait = 0.0;
+			double		irq = 0.0;
+			double		softirq = 0.0;
+			double		steal = 0.0;
+			uint64_t	timestampNs = 0;		// Steady clock time the interval ended
+			uint64_t	intervalNs = 0;			// Interval length, 0 for the since-boot seed sample
+		};
+
+		class CpuSampler
+		{
+		public:
+			CpuSampler();
+			~CpuSampler();
+			CpuSampler(const CpuSampler&) = delete;
+			CpuSampler& operator=(const CpuSampler&) = delete;
+			int			Start(std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+			void		Stop();
+			bool		IsRunning() const;
+			CpuSample	GetLatestSample() const;
+			double		GetUsagePercent() const;
+			static int	ReadCpuTimes(ProcfsFile& statFile, CpuTimes& times);
+			static int	ParseCpuTimes(std::string_view stat, CpuTimes& times);
+			static void ComputeSample(const CpuTimes& previous, const CpuTimes& current, CpuSample& sample);
+		protected:
+		private:
+			void		Run(CpuTimes previous);
+
+			std::thread					mThread;
+			std::mutex					mWakeMutex;
+			std::condition_variable		mWakeCondition;
+			bool						mStopRequested;
+			std::atomic<bool>			mRunning;
+			std::chrono::milliseconds	mPeriod;
+			SeqLock<CpuSample>			mLatest;
+			ProcfsFile					mStatFile;		// Only touched by the sampler thread once started
+		};
+	}
+}
+#endif
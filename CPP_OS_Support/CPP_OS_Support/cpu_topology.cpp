@@ -0,0 +1,925 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cpu_topology.cpp
+//!
+//! @brief		Implementation of the cpu topology, numa memory and affinity
+//!				helpers
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"cpu_topology.h"			// Cpu Topology Class
+#include	<bit>						// Bit scans over set words
+#include	<cerrno>					// errno values
+//
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Contents of a small sysfs file without the trailing newline, empty if it cannot be read
+		static std::string_view ReadAttribute(ProcfsFile& scratch, const std::string& path)
+		{
+			if (scratch.Open(path.c_str(), 256) != 0)
+			{
+				return std::string_view();
+			}
+
+			std::string_view text = scratch.Read();
+			while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+			{
+				text.remove_suffix(1);
+			}
+
+			return text;
+		}
+
+		/// @brief Signed attribute, physical_package_id is -1 on some platforms
+		static int ReadInteger(ProcfsFile& scratch, const std::string& path, int fallback)
+		{
+			std::string_view text = ReadAttribute(scratch, path);
+			const bool negative = !text.empty() && text.front() == '-';
+			if (negative)
+			{
+				text.remove_prefix(1);
+			}
+
+			uint64_t value = 0;
+			if (!Procfs::ToUnsigned(text, value))
+			{
+				return fallback;
+			}
+
+			return negative ? -static_cast<int>(value) : static_cast<int>(value);
+		}
+
+		/// @brief Cache sizes are printed as "48K", "2048K" or "32M"
+		static uint64_t ParseSize(std::string_view text)
+		{
+			uint64_t value = 0;
+			const char* end = text.data() + text.size();
+			const char* cursor = Procfs::ParseUnsigned(text.data(), end, value);
+			if (cursor < end)
+			{
+				switch (*cursor)
+				{
+				case 'K': return value * 1024;
+				case 'M': return value * 1024 * 1024;
+				case 'G': return value * 1024 * 1024 * 1024;
+				default: break;
+				}
+			}
+
+			return value;
+		}
+
+		CpuSet::CpuSet()
+		{
+
+		}
+
+		CpuSet CpuSet::FromList(std::string_view list)
+		{
+			// Kernel cpulist format, "0-3,8,10-11"
+			CpuSet set;
+			const char* cursor = list.data();
+			const char* end = list.data() + list.size();
+			while (cursor < end)
+			{
+				uint64_t first = 0;
+				const char* next = Procfs::ParseUnsigned(cursor, end, first);
+				if (next == cursor)
+				{
+					break;
+				}
+
+				uint64_t last = first;
+				if (next < end && *next == '-')
+				{
+					next = Procfs::ParseUnsigned(next + 1, end, last);
+				}
+
+				for (uint64_t cpu = first; cpu <= last; cpu++)
+				{
+					set.Set(static_cast<int>(cpu));
+				}
+
+				cursor = next < end && *next == ',' ? next + 1 : end;
+			}
+
+			return set;
+		}
+
+		void CpuSet::Set(int cpu)
+		{
+			if (cpu < 0)
+			{
+				return;
+			}
+
+			const size_t word = static_cast<size_t>(cpu) / 64;
+			if (word >= mWords.size())
+			{
+				mWords.resize(word + 1, 0);
+			}
+			mWords[word] |= uint64_t(1) << (cpu % 64);
+		}
+
+		bool CpuSet::Test(int cpu) const
+		{
+			const size_t word = static_cast<size_t>(cpu) / 64;
+			return cpu >= 0 && word < mWords.size() && (mWords[word] >> (cpu % 64)) & 1;
+		}
+
+		size_t CpuSet::Count() const
+		{
+			size_t count = 0;
+			for (uint64_t word : mWords)
+			{
+				count += static_cast<size_t>(std::popcount(word));
+			}
+
+			return count;
+		}
+
+		bool CpuSet::IsEmpty() const
+		{
+			return mWords.empty();
+		}
+
+		int CpuSet::First() const
+		{
+			return Next(-1);
+		}
+
+		int CpuSet::Next(int cpu) const
+		{
+			// Lowest member above cpu, -1 past the last
+			const int start = cpu + 1;
+			size_t word = static_cast<size_t>(start) / 64;
+			if (word >= mWords.size())
+			{
+				return -1;
+			}
+
+			uint64_t bits = mWords[word] & (~uint64_t(0) << (start % 64));
+			while (bits == 0)
+			{
+				if (++word >= mWords.size())
+				{
+					return -1;
+				}
+				bits = mWords[word];
+			}
+
+			return static_cast<int>(word * 64) + std::countr_zero(bits);
+		}
+
+		int CpuSet::Highest() const
+		{
+			if (mWords.empty())
+			{
+				return -1;
+			}
+
+			return static_cast<int>(mWords.size() * 64) - 1 - std::countl_zero(mWords.back());
+		}
+
+		bool CpuSet::Intersects(const CpuSet& other) const
+		{
+			const size_t words = mWords.size() < other.mWords.size() ? mWords.size() : other.mWords.size();
+			for (size_t i = 0; i < words; i++)
+			{
+				if (mWords[i] & other.mWords[i])
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		CpuSet& CpuSet::operator|=(const CpuSet& other)
+		{
+			if (other.mWords.size() > mWords.size())
+			{
+				mWords.resize(other.mWords.size(), 0);
+			}
+
+			for (size_t i = 0; i < other.mWords.size(); i++)
+			{
+				mWords[i] |= other.mWords[i];
+			}
+
+			return *this;
+		}
+
+		bool CpuSet::operator==(const CpuSet& other) const
+		{
+			return mWords == other.mWords;
+		}
+
+		bool CpuSet::operator!=(const CpuSet& other) const
+		{
+			return mWords != other.mWords;
+		}
+
+		const std::vector<uint64_t>& CpuSet::GetWords() const
+		{
+			return mWords;
+		}
+
+		CpuTopology::CpuTopology()
+		{
+			mDiscovered = false;
+		}
+
+		CpuTopology::~CpuTopology()
+		{
+
+		}
+
+		const CpuTopology& CpuTopology::Get()
+		{
+			// Read on first use, the layout only changes with CPU hotplug
+			static const CpuTopology topology = []
+			{
+				CpuTopology discovered;
+				discovered.Discover();
+				return discovered;
+			}();
+
+			return topology;
+		}
+
+		int CpuTopology::Discover(const std::string& root)
+		{
+			mCpus.clear();
+			mCores.clear();
+			mPackages.clear();
+			mCaches.clear();
+			mNodes.clear();
+			mOnline = CpuSet();
+			mIsolated = CpuSet();
+			mDiscovered = false;
+
+#ifdef __linux__
+			// Linux implementation, a few thousand small reads on large hosts, done once
+			ProcfsFile scratch;
+			if (DiscoverCpus(root + "/cpu", scratch) != 0)
+			{
+				return -1;
+			}
+
+			DiscoverCaches(root + "/cpu", scratch);
+			DiscoverNodes(root + "/node", scratch);
+			mDiscovered = true;
+			return 0;
+#else
+			(void)root;
+			return -1;
+#endif
+		}
+
+		bool CpuTopology::IsDiscovered() const
+		{
+			return mDiscovered;
+		}
+
+		const std::vector<LogicalCpu>& CpuTopology::GetCpus() const
+		{
+			return mCpus;
+		}
+
+		const std::vector<PhysicalCore>& CpuTopology::GetCores() const
+		{
+			return mCores;
+		}
+
+		const std::vector<CpuPackage>& CpuTopology::GetPackages() const
+		{
+			return mPackages;
+		}
+
+		const std::vector<CpuCache>& CpuTopology::GetCaches() const
+		{
+			return mCaches;
+		}
+
+		const std::vector<NumaNode>& CpuTopology::GetNodes() const
+		{
+			return mNodes;
+		}
+
+		const CpuSet& CpuTopology::GetOnline() const
+		{
+			return mOnline;
+		}
+
+		const CpuSet& CpuTopology::GetIsolated() const
+		{
+			return mIsolated;
+		}
+
+		const LogicalCpu* CpuTopology::FindCpu(int cpu) const
+		{
+			if (cpu < 0 || static_cast<size_t>(cpu) >= mCpus.size())
+			{
+				return nullptr;
+			}
+
+			return &mCpus[static_cast<size_t>(cpu)];
+		}
+
+		const NumaNode* CpuTopology::FindNode(int node) const
+		{
+			for (const NumaNode& entry : mNodes)
+			{
+				if (entry.id == node)
+				{
+					return &entry;
+				}
+			}
+
+			return nullptr;
+		}
+
+		const CpuCache* CpuTopology::FindCache(int cpu, uint8_t level, CacheType type) const
+		{
+			// A unified cache answers for both data and instruction lookups
+			for (const CpuCache& cache : mCaches)
+			{
+				if (cache.level == level && (cache.type == type || cache.type == CacheType::UNIFIED) && cache.cpus.Test(cpu))
+				{
+					return &cache;
+				}
+			}
+
+			return nullptr;
+		}
+
+		int CpuTopology::GetNodeOfCpu(int cpu) const
+		{
+			const LogicalCpu* entry = FindCpu(cpu);
+			return entry != nullptr ? entry->node : -1;
+		}
+
+		int CpuTopology::DiscoverCpus(const std::string& cpuRoot, ProcfsFile& scratch)
+		{
+			CpuSet possible = CpuSet::FromList(ReadAttribute(scratch, cpuRoot + "/possible"));
+			if (possible.IsEmpty())
+			{
+				possible = CpuSet::FromList(ReadAttribute(scratch, cpuRoot + "/present"));
+			}
+
+			if (possible.IsEmpty())
+			{
+				return -1;
+			}
+
+			// Kernels without the online list have no hotplug, everything possible is online
+			mOnline = CpuSet::FromList(ReadAttribute(scratch, cpuRoot + "/online"));
+			if (mOnline.IsEmpty())
+			{
+				mOnline = possible;
+			}
+			mIsolated = CpuSet::FromList(ReadAttribute(scratch, cpuRoot + "/isolated"));
+
+			mCpus.resize(static_cast<size_t>(possible.Highest()) + 1);
+			for (size_t i = 0; i < mCpus.size(); i++)
+			{
+				mCpus[i].cpu = static_cast<int>(i);
+				mCpus[i].online = mOnline.Test(static_cast<int>(i));
+				mCpus[i].isolated = mIsolated.Test(static_cast<int>(i));
+			}
+
+			// Offline CPUs have no topology directory
+			for (int cpu = mOnline.First(); cpu >= 0; cpu = mOnline.Next(cpu))
+			{
+				if (static_cast<size_t>(cpu) >= mCpus.size())
+				{
+					break;
+				}
+
+				const std::string directory = cpuRoot + "/cpu" + std::to_string(cpu) + "/topology/";
+				LogicalCpu& entry = mCpus[static_cast<size_t>(cpu)];
+				entry.package = ReadInteger(scratch, directory + "physical_package_id", -1);
+				entry.die = ReadInteger(scratch, directory + "die_id", 0);
+				const int coreId = ReadInteger(scratch, directory + "core_id", cpu);
+
+				// core_cpus_list is the 5.x name, thread_siblings_list the older one
+				CpuSet siblings = CpuSet::FromList(ReadAttribute(scratch, directory + "core_cpus_list"));
+				if (siblings.IsEmpty())
+				{
+					siblings = CpuSet::FromList(ReadAttribute(scratch, directory + "thread_siblings_list"));
+				}
+				siblings.Set(cpu);
+
+				for (size_t i = 0; i < mCores.size() && entry.core < 0; i++)
+				{
+					if (mCores[i].package == entry.package && mCores[i].threads == siblings)
+					{
+						entry.core = static_cast<int>(i);
+					}
+				}
+
+				if (entry.core < 0)
+				{
+					PhysicalCore core;
+					core.package = entry.package;
+					core.die = entry.die;
+					core.coreId = coreId;
+					core.threads = siblings;
+					entry.core = static_cast<int>(mCores.size());
+					mCores.push_back(core);
+				}
+
+				CpuPackage* package = nullptr;
+				for (CpuPackage& candidate : mPackages)
+				{
+					package = candidate.id == entry.package ? &candidate : package;
+				}
+
+				if (package == nullptr)
+				{
+					mPackages.emplace_back();
+					package = &mPackages.back();
+					package->id = entry.package;
+				}
+				package->cpus.Set(cpu);
+			}
+
+			for (CpuPackage& package : mPackages)
+			{
+				for (const PhysicalCore& core : mCores)
+				{
+					package.coreCount += core.package == package.id ? 1 : 0;
+				}
+			}
+
+			return 0;
+		}
+
+		int CpuTopology::DiscoverCaches(const std::string& cpuRoot, ProcfsFile& scratch)
+		{
+			for (int cpu = mOnline.First(); cpu >= 0; cpu = mOnline.Next(cpu))
+			{
+				const std::string directory = cpuRoot + "/cpu" + std::to_string(cpu) + "/cache/index";
+				for (int index = 0; ; index++)
+				{
+					const std::string prefix = directory + std::to_string(index) + "/";
+					const int level = ReadInteger(scratch, prefix + "level", -1);
+					if (level < 0)
+					{
+						break;
+					}
+
+					CpuCache cache;
+					cache.level = static_cast<uint8_t>(level);
+					const std::string_view type = ReadAttribute(scratch, prefix + "type");
+					cache.type = type == "Data" ? CacheType::DATA :
+						type == "Instruction" ? CacheType::INSTRUCTION : CacheType::UNIFIED;
+					cache.cpus = CpuSet::FromList(ReadAttribute(scratch, prefix + "shared_cpu_list"));
+					cache.cpus.Set(cpu);
+
+					// Each sharer lists the same instance, only the first one reads the details
+					bool known = false;
+					for (const CpuCache& existing : mCaches)
+					{
+						known = known || (existing.level == cache.level && existing.type == cache.type && existing.cpus == cache.cpus);
+					}
+
+					if (known)
+					{
+						continue;
+					}
+
+					cache.id = ReadInteger(scratch, prefix + "id", -1);
+					cache.sizeBytes = ParseSize(ReadAttribute(scratch, prefix + "size"));
+					cache.lineSizeBytes = static_cast<uint32_t>(ReadInteger(scratch, prefix + "coherency_line_size", 0));
+					cache.ways = static_cast<uint32_t>(ReadInteger(scratch, prefix + "ways_of_associativity", 0));
+					mCaches.push_back(cache);
+				}
+			}
+
+			return mCaches.empty() ? -1 : 0;
+		}
+
+		int CpuTopology::DiscoverNodes(const std::string& nodeRoot, ProcfsFile& scratch)
+		{
+			const CpuSet online = CpuSet::FromList(ReadAttribute(scratch, nodeRoot + "/online"));
+			for (int id = online.First(); id >= 0; id = online.Next(id))
+			{
+				const std::string directory = nodeRoot + "/node" + std::to_string(id) + "/";
+				NumaNode node;
+				node.id = id;
+				node.cpus = CpuSet::FromList(ReadAttribute(scratch, directory + "cpulist"));
+
+				NumaNodeMemory memory;
+				if (scratch.Open((directory + "meminfo").c_str(), 4096) == 0 &&
+					NumaMemoryStats::ParseNodeMeminfo(scratch.Read(), memory) == 0)
+				{
+					node.totalBytes = memory.totalBytes;
+				}
+
+				std::string_view distances = ReadAttribute(scratch, directory + "distance");
+				while (!distances.empty())
+				{
+					uint64_t distance = 0;
+					if (Procfs::ToUnsigned(Procfs::NextToken(distances), distance))
+					{
+						node.distances.push_back(static_cast<uint32_t>(distance));
+					}
+				}
+
+				mNodes.push_back(node);
+			}
+
+			// Without CONFIG_NUMA everything is node 0
+			if (mNodes.empty())
+			{
+				NumaNode node;
+				node.id = 0;
+				node.cpus = mOnline;
+				node.distances.push_back(10);
+
+				uint64_t total = 0;
+				if (scratch.Open("/proc/meminfo", 4096) == 0 && Procfs::FindValue(scratch.Read(), "MemTotal", total))
+				{
+					node.totalBytes = total * 1024;
+				}
+				mNodes.push_back(node);
+			}
+
+			for (const NumaNode& node : mNodes)
+			{
+				for (int cpu = node.cpus.First(); cpu >= 0; cpu = node.cpus.Next(cpu))
+				{
+					if (static_cast<size_t>(cpu) < mCpus.size())
+					{
+						mCpus[static_cast<size_t>(cpu)].node = node.id;
+					}
+				}
+			}
+
+			for (PhysicalCore& core : mCores)
+			{
+				core.node = GetNodeOfCpu(core.threads.First());
+			}
+
+			return 0;
+		}
+
+		NumaMemoryStats::NumaMemoryStats()
+		{
+
+		}
+
+		NumaMemoryStats::~NumaMemoryStats()
+		{
+
+		}
+
+		int NumaMemoryStats::Open(const CpuTopology& topology, const std::string& root)
+		{
+			mNodeIds.clear();
+			mMeminfoFiles.clear();
+
+			for (const NumaNode& node : topology.GetNodes())
+			{
+				ProcfsFile meminfo;
+				if (meminfo.Open((root + "/node/node" + std::to_string(node.id) + "/meminfo").c_str(), 4096) == 0)
+				{
+					mNodeIds.push_back(node.id);
+					mMeminfoFiles.push_back(std::move(meminfo));
+				}
+			}
+
+			// Non-NUMA kernels, the system figures are node 0's
+			if (mMeminfoFiles.empty())
+			{
+				ProcfsFile meminfo;
+				if (meminfo.Open("/proc/meminfo", 4096) != 0)
+				{
+					return -1;
+				}
+
+				mNodeIds.push_back(0);
+				mMeminfoFiles.push_back(std::move(meminfo));
+			}
+
+			return 0;
+		}
+
+		bool NumaMemoryStats::IsOpen() const
+		{
+			return !mMeminfoFiles.empty();
+		}
+
+		int NumaMemoryStats::Sample(std::vector<NumaNodeMemory>& nodes)
+		{
+			nodes.resize(mMeminfoFiles.size());
+
+			int result = mMeminfoFiles.empty() ? -1 : 0;
+			for (size_t i = 0; i < mMeminfoFiles.size(); i++)
+			{
+				nodes[i] = NumaNodeMemory();
+				if (ParseNodeMeminfo(mMeminfoFiles[i].Read(), nodes[i]) != 0)
+				{
+					result = -1;
+				}
+				nodes[i].node = mNodeIds[i];
+			}
+
+			return result;
+		}
+
+		int NumaMemoryStats::ParseNodeMeminfo(std::string_view meminfo, NumaNodeMemory& node)
+		{
+			// "Node 0 MemTotal:  16318856 kB", /proc/meminfo lines lack the "Node N" prefix
+			bool hasTotal = false;
+			while (!meminfo.empty())
+			{
+				std::string_view line = Procfs::NextLine(meminfo);
+				std::string_view key = Procfs::NextToken(line);
+				if (key == "Node")
+				{
+					Procfs::NextToken(line);
+					key = Procfs::NextToken(line);
+				}
+
+				uint64_t* field = key == "MemTotal:" ? &node.totalBytes :
+					key == "MemFree:" ? &node.freeBytes :
+					key == "FilePages:" ? &node.filePagesBytes : nullptr;
+				if (field == nullptr)
+				{
+					continue;
+				}
+
+				uint64_t value = 0;
+				Procfs::ParseUnsigned(line.data(), line.data() + line.size(), value);
+				*field = value * 1024;
+				hasTotal = hasTotal || field == &node.totalBytes;
+			}
+
+			return hasTotal ? 0 : -1;
+		}
+
+		namespace Affinity
+		{
+#ifdef __linux__
+			/// @brief Kernel cpu_set_t sized for the highest CPU in the set, release with CPU_FREE
+			static cpu_set_t* ToKernelSet(const CpuSet& cpus, size_t& size)
+			{
+				const int count = cpus.Highest() + 1;
+				cpu_set_t* set = CPU_ALLOC(count);
+				if (set == nullptr)
+				{
+					return nullptr;
+				}
+
+				size = CPU_ALLOC_SIZE(count);
+				CPU_ZERO_S(size, set);
+				for (int cpu = cpus.First(); cpu >= 0; cpu = cpus.Next(cpu))
+				{
+					CPU_SET_S(cpu, size, set);
+				}
+
+				return set;
+			}
+
+			static int ToKernelMode(NumaPolicyMode mode)
+			{
+				switch (mode)
+				{
+				case NumaPolicyMode::PREFERRED: return MPOL_PREFERRED;
+				case NumaPolicyMode::BIND: return MPOL_BIND;
+				case NumaPolicyMode::INTERLEAVE: return MPOL_INTERLEAVE;
+				case NumaPolicyMode::LOCAL: return MPOL_LOCAL;
+				default: return MPOL_DEFAULT;
+				}
+			}
+#endif
+
+			int PinThread(const CpuSet& cpus)
+			{
+#ifdef __linux__
+				if (cpus.IsEmpty())
+				{
+					errno = EINVAL;
+					return -1;
+				}
+
+				size_t size = 0;
+				cpu_set_t* set = ToKernelSet(cpus, size);
+				if (set == nullptr)
+				{
+					return -1;
+				}
+
+				// Pid 0 is the calling thread, not the whole process
+				const int result = sched_setaffinity(0, size, set);
+				CPU_FREE(set);
+				return result == 0 ? 0 : -1;
+#else
+				(void)cpus;
+				return -1;
+#endif
+			}
+
+			int PinThread(std::thread& thread, const CpuSet& cpus)
+			{
+#ifdef __linux__
+				if (cpus.IsEmpty() || !thread.joinable())
+				{
+					errno = EINVAL;
+					return -1;
+				}
+
+				size_t size = 0;
+				cpu_set_t* set = ToKernelSet(cpus, size);
+				if (set == nullptr)
+				{
+					return -1;
+				}
+
+				const int error = pthread_setaffinity_np(thread.native_handle(), size, set);
+				CPU_FREE(set);
+				if (error != 0)
+				{
+					errno = error;
+					return -1;
+				}
+
+				return 0;
+#else
+				(void)thread;
+				(void)cpus;
+				return -1;
+#endif
+			}
+
+			int PinThreadToCpu(int cpu)
+			{
+				CpuSet cpus;
+				cpus.Set(cpu);
+				return PinThread(cpus);
+			}
+
+			int PinThreadToCore(const CpuTopology& topology, size_t core)
+			{
+				if (core >= topology.GetCores().size())
+				{
+					errno = EINVAL;
+					return -1;
+				}
+
+				return PinThread(topology.GetCores()[core].threads);
+			}
+
+			int PinThreadToNode(const CpuTopology& topology, int node)
+			{
+				// Memory-only nodes have no CPUs, PinThread rejects the empty set
+				const NumaNode* entry = topology.FindNode(node);
+				if (entry == nullptr)
+				{
+					errno = EINVAL;
+					return -1;
+				}
+
+				return PinThread(entry->cpus);
+			}
+
+			int PinThreadToCache(const CpuTopology& topology, int cpu, uint8_t level)
+			{
+				const CpuCache* cache = topology.FindCache(cpu, level);
+				if (cache == nullptr)
+				{
+					errno = EINVAL;
+					return -1;
+				}
+
+				return PinThread(cache->cpus);
+			}
+
+			int GetThreadAffinity(CpuSet& cpus)
+			{
+				cpus = CpuSet();
+
+#ifdef __linux__
+				// The kernel rejects a mask smaller than its nr_cpu_ids, grow until it fits
+				for (int count = 1024; count <= 65536; count *= 2)
+				{
+					cpu_set_t* set = CPU_ALLOC(count);
+					if (set == nullptr)
+					{
+						return -1;
+					}
+
+					const size_t size = CPU_ALLOC_SIZE(count);
+					if (sched_getaffinity(0, size, set) == 0)
+					{
+						for (int cpu = 0; cpu < count; cpu++)
+						{
+							if (CPU_ISSET_S(cpu, size, set))
+							{
+								cpus.Set(cpu);
+							}
+						}
+
+						CPU_FREE(set);
+						return 0;
+					}
+
+					CPU_FREE(set);
+					if (errno != EINVAL)
+					{
+						return -1;
+					}
+				}
+#endif
+
+				return -1;
+			}
+
+			int GetCurrentCpu()
+			{
+#ifdef __linux__
+				// vDSO, no syscall on x86-64 and arm64
+				return sched_getcpu();
+#else
+				return -1;
+#endif
+			}
+
+			NumaPolicy GetLocalPolicy(const CpuTopology& topology, bool strict)
+			{
+				// The node of the CPU running now, the thread should be pinned for this to last
+				const int node = topology.GetNodeOfCpu(GetCurrentCpu());
+				if (node < 0)
+				{
+					NumaPolicy policy;
+					policy.mode = NumaPolicyMode::LOCAL;
+					return policy;
+				}
+
+				return GetNodePolicy(node, strict);
+			}
+
+			NumaPolicy GetNodePolicy(int node, bool strict)
+			{
+				NumaPolicy policy;
+				policy.mode = strict ? NumaPolicyMode::BIND : NumaPolicyMode::PREFERRED;
+				policy.nodes.Set(node);
+				return policy;
+			}
+
+			int ApplyPolicy(const NumaPolicy& policy)
+			{
+#ifdef __linux__
+				// Default and local take no node mask
+				const bool hasNodes = policy.mode != NumaPolicyMode::DEFAULT && policy.mode != NumaPolicyMode::LOCAL;
+				const std::vector<uint64_t>& words = policy.nodes.GetWords();
+				const unsigned long* mask = hasNodes ? reinterpret_cast<const unsigned long*>(words.data()) : nullptr;
+				const unsigned long maxNode = hasNodes ? static_cast<unsigned long>(words.size() * 64 + 1) : 0;
+				return syscall(SYS_set_mempolicy, ToKernelMode(policy.mode), mask, maxNode) == 0 ? 0 : -1;
+#else
+				(void)policy;
+				return -1;
+#endif
+			}
+
+			int BindMemory(void* address, size_t length, const NumaPolicy& policy)
+			{
+#ifdef __linux__
+				// address must be page aligned, pages already faulted in stay where they are
+				const bool hasNodes = policy.mode != NumaPolicyMode::DEFAULT && policy.mode != NumaPolicyMode::LOCAL;
+				const std::vector<uint64_t>& words = policy.nodes.GetWords();
+				const unsigned long* mask = hasNodes ? reinterpret_cast<const unsigned long*>(words.data()) : nullptr;
+				const unsigned long maxNode = hasNodes ? static_cast<unsigned long>(words.size() * 64 + 1) : 0;
+				return syscall(SYS_mbind, address, length, ToKernelMode(policy.mode), mask, maxNode, 0u) == 0 ? 0 : -1;
+#else
+				(void)address;
+				(void)length;
+				(void)policy;
+				return -1;
+#endif
+			}
+		}
+	}
+}
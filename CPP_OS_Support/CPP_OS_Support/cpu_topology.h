@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		cpu_topology.h
+//!
+//! @brief		CPU topology, cache hierarchy and NUMA layout read once from
+//!				/sys/devices/system/cpu and /sys/devices/system/node, with
+//!				helpers that pin threads to a core, node or cache domain and
+//!				that bind allocations to the local node.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string>						// Sysfs root
+#include <string_view>					// Parsing
+#include <thread>						// Pinning other threads
+#include <vector>						// Topology tables
+#include "procfs_reader.h"				// Sysfs reads and node meminfo handles
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_CPU_TOPOLOGY			// Define the cpu topology class.
+#define     CPP_CPU_TOPOLOGY
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Set of CPU (or node) numbers, one bit each, sized to the highest number set.
+		class CpuSet
+		{
+		public:
+			CpuSet();
+			static CpuSet FromList(std::string_view list);
+			void		Set(int cpu);
+			bool		Test(int cpu) const;
+			size_t		Count() const;
+			bool		IsEmpty() const;
+			int			First() const;
+			int			Next(int cpu) const;
+			int			Highest() const;
+			bool		Intersects(const CpuSet& other) const;
+			CpuSet&		operator|=(const CpuSet& other);
+			bool		operator==(const CpuSet& other) const;
+			bool		operator!=(const CpuSet& other) const;
+			const std::vector<uint64_t>& GetWords() const;
+		protected:
+		private:
+			std::vector<uint64_t>	mWords;			// Trailing zero words are never kept
+		};
+
+		/// @brief Cache type as sysfs names it
+		enum class CacheType : uint8_t
+		{
+			UNIFIED,
+			DATA,
+			INSTRUCTION,
+		};
+
+		/// @brief One cache instance and the CPUs sharing it
+		struct CpuCache
+		{
+			uint8_t		level = 0;
+			CacheType	type = CacheType::UNIFIED;
+			int			id = -1;					// Instance id within the level, -1 before 5.x kernels
+			uint64_t	sizeBytes = 0;
+			uint32_t	lineSizeBytes = 0;
+			uint32_t	ways = 0;					// 0 for fully associative
+			CpuSet		cpus;
+		};
+
+		/// @brief One logical CPU, numbers are as the kernel reports them
+		struct LogicalCpu
+		{
+			int			cpu = -1;
+			int			package = -1;				// Socket
+			int			die = -1;
+			int			core = -1;					// Index into GetCores(), -1 while offline
+			int			node = -1;
+			bool		online = false;
+			bool		isolated = false;			// isolcpus=, kept away from the scheduler
+		};
+
+		/// @brief One physical core and its SMT siblings
+		struct PhysicalCore
+		{
+			int			package = -1;
+			int			die = -1;
+			int			coreId = -1;				// Not unique across packages
+			int			node = -1;
+			CpuSet		threads;
+		};
+
+		/// @brief One socket
+		struct CpuPackage
+		{
+			int			id = -1;
+			uint32_t	coreCount = 0;
+			CpuSet		cpus;
+		};
+
+		/// @brief One NUMA node. Free memory changes, see NumaMemoryStats.
+		struct NumaNode
+		{
+			int			id = -1;
+			uint64_t	totalBytes = 0;
+			CpuSet		cpus;						// Empty for memory-only nodes
+			std::vector<uint32_t> distances;		// SLIT distance to each node in GetNodes() order, 10 is local
+		};
+
+		/// @brief Memory of one node at sample time
+		struct NumaNodeMemory
+		{
+			int			node = -1;
+			uint64_t	totalBytes = 0;
+			uint64_t	freeBytes = 0;
+			uint64_t	filePagesBytes = 0;			// Page cache on the node
+		};
+
+		class CpuTopology
+		{
+		public:
+			CpuTopology();
+			~CpuTopology();
+			static const CpuTopology& Get();
+			int			Discover(const std::string& root = "/sys/devices/system");
+			bool		IsDiscovered() const;
+			const std::vector<LogicalCpu>&		GetCpus() const;
+			const std::vector<PhysicalCore>&	GetCores() const;
+			const std::vector<CpuPackage>&		GetPackages() const;
+			const std::vector<CpuCache>&		GetCaches() const;
+			const std::vector<NumaNode>&		GetNodes() const;
+			const CpuSet&	GetOnline() const;
+			const CpuSet&	GetIsolated() const;
+			const LogicalCpu* FindCpu(int cpu) const;
+			const NumaNode*	FindNode(int node) const;
+			const CpuCache*	FindCache(int cpu, uint8_t level, CacheType type = CacheType::DATA) const;
+			int			GetNodeOfCpu(int cpu) const;
+		protected:
+		private:
+			int			DiscoverCpus(const std::string& cpuRoot, ProcfsFile& scratch);
+			int			DiscoverCaches(const std::string& cpuRoot, ProcfsFile& scratch);
+			int			DiscoverNodes(const std::string& nodeRoot, ProcfsFile& scratch);
+
+			std::vector<LogicalCpu>		mCpus;			// Indexed by CPU number
+			std::vector<PhysicalCore>	mCores;
+			std::vector<CpuPackage>		mPackages;
+			std::vector<CpuCache>		mCaches;		// One entry per instance, shared caches once
+			std::vector<NumaNode>		mNodes;
+			CpuSet						mOnline;
+			CpuSet						mIsolated;
+			bool						mDiscovered;
+		};
+
+		/// @brief Per-node total and free memory from nodeN/meminfo, handles kept open
+		class NumaMemoryStats
+		{
+		public:
+			NumaMemoryStats();
+			~NumaMemoryStats();
+			int			Open(const CpuTopology& topology, const std::string& root = "/sys/devices/system");
+			bool		IsOpen() const;
+			int			Sample(std::vector<NumaNodeMemory>& nodes);
+			static int	ParseNodeMeminfo(std::string_view meminfo, NumaNodeMemory& node);
+		protected:
+		private:
+			std::vector<int>		mNodeIds;
+			std::vector<ProcfsFile>	mMeminfoFiles;
+		};
+
+		/// @brief Memory policy modes, see set_mempolicy(2)
+		enum class NumaPolicyMode : uint8_t
+		{
+			DEFAULT,						// Back to the process policy
+			PREFERRED,						// First node of the set, others when it is full
+			BIND,							// Only the set, reclaim or OOM when it is full
+			INTERLEAVE,						// Round robin page by page over the set
+			LOCAL,							// Node of the CPU doing the allocation
+		};
+
+		/// @brief A memory policy ready to apply to the calling thread or a range
+		struct NumaPolicy
+		{
+			NumaPolicyMode	mode = NumaPolicyMode::DEFAULT;
+			CpuSet			nodes;
+		};
+
+		/// @brief Thread placement and memory policy helpers. All return 0 on success
+		///			and -1 with errno set, and -1 on platforms without the calls.
+		namespace Affinity
+		{
+			int			PinThread(const CpuSet& cpus);
+			int			PinThread(std::thread& thread, const CpuSet& cpus);
+			int			PinThreadToCpu(int cpu);
+			int			PinThreadToCore(const CpuTopology& topology, size_t core);
+			int			PinThreadToNode(const CpuTopology& topology, int node);
+			int			PinThreadToCache(const CpuTopology& topology, int cpu, uint8_t level);
+			int			GetThreadAffinity(CpuSet& cpus);
+			int			GetCurrentCpu();
+			NumaPolicy	GetLocalPolicy(const CpuTopology& topology, bool strict = false);
+			NumaPolicy	GetNodePolicy(int node, bool strict = false);
+			int			ApplyPolicy(const NumaPolicy& policy);
+			int			BindMemory(void* address, size_t length, const NumaPolicy& policy);
+		}
+	}
+}
+#endif
@@ -0,0 +1,324 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		disk_io_stats.cpp
+//!
+//! @brief		Implementation of the disk io stats class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"disk_io_stats.h"			// Disk Io Stats Class
+#include	<algorithm>					// std::remove_if, std::min, std::rotate
+#include	<chrono>					// Sample timestamps
+#include	<cstring>					// memcpy, strncmp
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		DiskIoStats::DiskIoStats() : mDiskstatsFile("/proc/diskstats", 64 * 1024)
+		{
+			mSampleNumber = 0;
+			mLastTimestampNs = 0;
+		}
+
+		DiskIoStats::~DiskIoStats()
+		{
+
+		}
+
+		void DiskIoStats::SetFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude)
+		{
+			mInclude = include;
+			mExclude = exclude;
+
+			// The filter result is cached per slot, re-evaluate the existing ones. An excluded
+			// slot's counters went stale, so one that comes back starts a new baseline.
+			for (BlockDeviceStats& stats : mDevices)
+			{
+				const bool included = Matches(stats.name);
+				if (included != stats.included)
+				{
+					stats.lastSeen = 0;
+					stats.hasRates = false;
+				}
+				stats.included = included;
+			}
+		}
+
+		int DiskIoStats::Sample()
+		{
+			int result = -1;
+
+#ifdef __linux__
+			// Linux implementation, one read of /proc/diskstats covers every device where
+			// /sys/block/*/stat would take an open and a read per device. Past a page the
+			// read takes a pread per page, ProcfsFile keeps going to the end of the file.
+			std::string_view diskstats = mDiskstatsFile.Read();
+			if (!diskstats.empty())
+			{
+				const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+				result = Update(diskstats, now);
+			}
+
+#endif
+
+			return result;
+		}
+
+		int DiskIoStats::Update(std::string_view diskstats, uint64_t timestampNs)
+		{
+			mSampleNumber++;
+			const double seconds = mLastTimestampNs != 0 && timestampNs > mLastTimestampNs ?
+				static_cast<double>(timestampNs - mLastTimestampNs) / 1e9 : 0.0;
+			size_t position = 0;
+
+			while (!diskstats.empty())
+			{
+				std::string_view line = Procfs::NextLine(diskstats);
+
+				// major minor name, then up to 17 counters depending on the kernel
+				uint64_t major = 0;
+				uint64_t minor = 0;
+				const char* cursor = line.data();
+				const char* end = line.data() + line.size();
+				cursor = Procfs::ParseUnsigned(cursor, end, major);
+				cursor = Procfs::ParseUnsigned(cursor, end, minor);
+
+				std::string_view rest(cursor, static_cast<size_t>(end - cursor));
+				std::string_view name = Procfs::NextToken(rest);
+				if (name.empty() || name.size() >= BLOCK_DEVICE_NAME_LENGTH)
+				{
+					continue;
+				}
+
+				BlockDeviceStats* stats = Slot(static_cast<uint32_t>(major), static_cast<uint32_t>(minor), name, position++);
+				if (!stats->included)
+				{
+					stats->lastSeen = mSampleNumber;
+					continue;
+				}
+
+				uint64_t fields[17] = {};
+				cursor = rest.data();
+				end = rest.data() + rest.size();
+				for (uint64_t& field : fields)
+				{
+					cursor = Procfs::ParseUnsigned(cursor, end, field);
+				}
+
+				DiskIoCounters current;
+				current.reads = fields[0];
+				current.readsMerged = fields[1];
+				current.sectorsRead = fields[2];
+				current.readTimeMs = fields[3];
+				current.writes = fields[4];
+				current.writesMerged = fields[5];
+				current.sectorsWritten = fields[6];
+				current.writeTimeMs = fields[7];
+				current.inFlight = fields[8];
+				current.ioTimeMs = fields[9];
+				current.weightedIoTimeMs = fields[10];
+				current.discards = fields[11];
+				current.discardsMerged = fields[12];
+				current.sectorsDiscarded = fields[13];
+				current.discardTimeMs = fields[14];
+				current.flushes = fields[15];
+				current.flushTimeMs = fields[16];
+
+				const bool continuous = stats->lastSeen == mSampleNumber - 1 && seconds > 0.0;
+				if (continuous)
+				{
+					// A counter that went backwards wrapped at 32 bits or the device was replaced
+					auto delta = [](uint64_t before, uint64_t after) -> double
+					{
+						return after >= before ? static_cast<double>(after - before) : 0.0;
+					};
+
+					const DiskIoCounters& previous = stats->counters;
+					const double reads = delta(previous.reads, current.reads);
+					const double writes = delta(previous.writes, current.writes);
+					const double discards = delta(previous.discards, current.discards);
+					const double requests = reads + writes + discards;
+					const double busyMs = delta(previous.ioTimeMs, current.ioTimeMs);
+					const double intervalMs = seconds * 1000.0;
+
+					stats->readBytesPerSecond = delta(previous.sectorsRead, current.sectorsRead) * DISKSTATS_SECTOR_BYTES / seconds;
+					stats->writeBytesPerSecond = delta(previous.sectorsWritten, current.sectorsWritten) * DISKSTATS_SECTOR_BYTES / seconds;
+					stats->discardBytesPerSecond = delta(previous.sectorsDiscarded, current.sectorsDiscarded) * DISKSTATS_SECTOR_BYTES / seconds;
+					stats->readsPerSecond = reads / seconds;
+					stats->writesPerSecond = writes / seconds;
+					stats->discardsPerSecond = discards / seconds;
+					stats->iops = requests / seconds;
+					stats->readAwaitMs = reads > 0.0 ? delta(previous.readTimeMs, current.readTimeMs) / reads : 0.0;
+					stats->writeAwaitMs = writes > 0.0 ? delta(previous.writeTimeMs, current.writeTimeMs) / writes : 0.0;
+					stats->serviceTimeMs = requests > 0.0 ? busyMs / requests : 0.0;
+					stats->queueDepth = delta(previous.weightedIoTimeMs, current.weightedIoTimeMs) / intervalMs;
+
+					// io_ticks is sampled by the kernel and can run slightly ahead of the wall clock
+					stats->utilisationPercent = std::min(100.0, busyMs * 100.0 / intervalMs);
+				}
+
+				stats->hasRates = continuous;
+				stats->counters = current;
+				stats->lastSeen = mSampleNumber;
+			}
+
+			// Drop devices that went away, this only moves slots and never allocates
+			const uint64_t sampleNumber = mSampleNumber;
+			mDevices.erase(std::remove_if(mDevices.begin(), mDevices.end(),
+				[sampleNumber](const BlockDeviceStats& stats) { return stats.lastSeen != sampleNumber; }), mDevices.end());
+
+			mLastTimestampNs = timestampNs;
+			return 0;
+		}
+
+		BlockDeviceStats* DiskIoStats::Slot(uint32_t major, uint32_t minor, std::string_view name, size_t position)
+		{
+			// diskstats lists devices in a stable order, so the slot at the same position
+			// is almost always the right one and the lookup is a single compare. Device
+			// numbers are matched as well, a replaced disk can come back under its name.
+			auto sameDevice = [major, minor, name](const BlockDeviceStats& stats)
+			{
+				return stats.major == major && stats.minor == minor &&
+					std::strncmp(stats.name, name.data(), name.size()) == 0 && stats.name[name.size()] == '\0';
+			};
+
+			if (position < mDevices.size() && sameDevice(mDevices[position]))
+			{
+				return &mDevices[position];
+			}
+
+			// Slots before position hold this sample's earlier lines in file order, so a
+			// miss is either further down or new. Either way the slot is moved to or
+			// created at position, later devices line up again and only the sample that
+			// sees a hotplug pays for the scan. Appending instead would leave every device
+			// after a new partition off by one and scanning on every sample.
+			const size_t start = std::min(position, mDevices.size());
+			for (size_t index = start; index < mDevices.size(); index++)
+			{
+				if (sameDevice(mDevices[index]))
+				{
+					std::rotate(mDevices.begin() + start, mDevices.begin() + index, mDevices.begin() + index + 1);
+					return &mDevices[start];
+				}
+			}
+
+			// New device, the only path that can allocate
+			BlockDeviceStats& stats = *mDevices.emplace(mDevices.begin() + start);
+			std::memcpy(stats.name, name.data(), name.size());
+			stats.name[name.size()] = '\0';
+			stats.major = major;
+			stats.minor = minor;
+			stats.included = Matches(name);
+			stats.lastSeen = 0;
+			return &stats;
+		}
+
+		bool DiskIoStats::Matches(std::string_view name) const
+		{
+#ifndef _WIN32
+			char buffer[BLOCK_DEVICE_NAME_LENGTH] = {};
+			std::memcpy(buffer, name.data(), std::min(name.size(), BLOCK_DEVICE_NAME_LENGTH - 1));
+
+			bool included = mInclude.empty();
+			for (const std::string& pattern : mInclude)
+			{
+				if (fnmatch(pattern.c_str(), buffer, 0) == 0)
+				{
+					included = true;
+					break;
+				}
+			}
+
+			for (const std::string& pattern : mExclude)
+			{
+				if (fnmatch(pattern.c_str(), buffer, 0) == 0)
+				{
+					included = false;
+					break;
+				}
+			}
+
+			return included;
+#else
+			(void)name;
+			return true;
+#endif
+		}
+
+		size_t DiskIoStats::GetDeviceCount() const
+		{
+			return mDevices.size();
+		}
+
+		const BlockDeviceStats* DiskIoStats::GetDevice(size_t index) const
+		{
+			return index < mDevices.size() ? &mDevices[index] : nullptr;
+		}
+
+		const BlockDeviceStats* DiskIoStats::FindDevice(std::string_view name) const
+		{
+			for (const BlockDeviceStats& stats : mDevices)
+			{
+				if (stats.included && name == stats.name)
+				{
+					return &stats;
+				}
+			}
+
+			return nullptr;
+		}
+
+		const BlockDeviceStats* DiskIoStats::FindDevice(uint32_t major, uint32_t minor) const
+		{
+			for (const BlockDeviceStats& stats : mDevices)
+			{
+				if (stats.included && stats.major == major && stats.minor == minor)
+				{
+					return &stats;
+				}
+			}
+
+			return nullptr;
+		}
+
+		const BlockDeviceStats* DiskIoStats::FindDeviceForPath(MountTable& mounts, const std::string& path) const
+		{
+			// mountinfo carries the st_dev of the filesystem, which is the partition or
+			// mapper device it lives on. Filesystems without one (tmpfs, overlay, btrfs
+			// subvolumes) report major 0 and have no diskstats line.
+			const MountEntry* mount = mounts.FindMountForPath(path);
+			if (mount == nullptr || mount->major == 0)
+			{
+				return nullptr;
+			}
+
+			return FindDevice(mount->major, mount->minor);
+		}
+
+		int DiskIoStats::GetDevices(std::vector<BlockDeviceStats>& devices) const
+		{
+			// Reuses the caller's capacity, excluded devices are skipped
+			devices.clear();
+			for (const BlockDeviceStats& stats : mDevices)
+			{
+				if (stats.included)
+				{
+					devices.push_back(stats);
+				}
+			}
+
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		disk_io_stats.h
+//!
+//! @brief		Per-block-device throughput, IOPS, latency, queue depth and
+//!				utilisation computed from the deltas between /proc/diskstats
+//!				samples. Device slots are reused between samples, so steady
+//!				state sampling does not allocate however many disks,
+//!				partitions and NVMe namespaces the host has.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string>						// Filter patterns
+#include <string_view>					// Parsing
+#include <vector>						// Device slots
+#include "procfs_reader.h"				// Persistent /proc/diskstats handle
+#include "mount_table.h"				// Mount point to device numbers
+//
+#ifndef _WIN32
+#include <fnmatch.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_DISK_IO_STATS			// Define the disk io stats class.
+#define     CPP_DISK_IO_STATS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Block device names are at most DISK_NAME_LEN (32) including the terminator
+		constexpr size_t BLOCK_DEVICE_NAME_LENGTH = 32;
+
+		/// @brief diskstats counts sectors of 512 bytes whatever the device's block size
+		constexpr uint64_t DISKSTATS_SECTOR_BYTES = 512;
+
+		/// @brief Cumulative counters from one /proc/diskstats line. Discard fields need
+		///			kernel 4.18 and flush fields 5.5, they stay zero on older kernels.
+		struct DiskIoCounters
+		{
+			uint64_t	reads = 0;
+			uint64_t	readsMerged = 0;
+			uint64_t	sectorsRead = 0;
+			uint64_t	readTimeMs = 0;
+			uint64_t	writes = 0;
+			uint64_t	writesMerged = 0;
+			uint64_t	sectorsWritten = 0;
+			uint64_t	writeTimeMs = 0;
+			uint64_t	inFlight = 0;				// Requests issued and not yet completed
+			uint64_t	ioTimeMs = 0;				// Time with at least one request in flight
+			uint64_t	weightedIoTimeMs = 0;		// Request time summed over all requests in flight
+			uint64_t	discards = 0;
+			uint64_t	discardsMerged = 0;
+			uint64_t	sectorsDiscarded = 0;
+			uint64_t	discardTimeMs = 0;
+			uint64_t	flushes = 0;
+			uint64_t	flushTimeMs = 0;
+		};
+
+		/// @brief Counters and rates of one block device over the last interval, the
+		///			same figures iostat -x reports.
+		struct BlockDeviceStats
+		{
+			char			name[BLOCK_DEVICE_NAME_LENGTH] = {};
+			uint32_t		major = 0;
+			uint32_t		minor = 0;
+			DiskIoCounters	counters;
+			double			readBytesPerSecond = 0.0;
+			double			writeBytesPerSecond = 0.0;
+			double			discardBytesPerSecond = 0.0;
+			double			readsPerSecond = 0.0;
+			double			writesPerSecond = 0.0;
+			double			discardsPerSecond = 0.0;
+			double			iops = 0.0;					// Reads, writes and discards completed per second
+			double			readAwaitMs = 0.0;			// Mean time per read, queueing included
+			double			writeAwaitMs = 0.0;			// Mean time per write, queueing included
+			double			serviceTimeMs = 0.0;		// Busy time per completed request
+			double			queueDepth = 0.0;			// Mean requests in flight
+			double			utilisationPercent = 0.0;	// Share of the interval the device was busy
+			bool			hasRates = false;			// False until the device was seen twice
+			bool			included = true;			// Result of the include/exclude filter
+			uint64_t		lastSeen = 0;				// Sample number the device was last listed in
+		};
+
+		class DiskIoStats
+		{
+		public:
+			DiskIoStats();
+			~DiskIoStats();
+			void		SetFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude);
+			int			Sample();
+			int			Update(std::string_view diskstats, uint64_t timestampNs);
+			size_t		GetDeviceCount() const;
+			const BlockDeviceStats* GetDevice(size_t index) const;
+			const BlockDeviceStats* FindDevice(std::string_view name) const;
+			const BlockDeviceStats* FindDevice(uint32_t major, uint32_t minor) const;
+			const BlockDeviceStats* FindDeviceForPath(MountTable& mounts, const std::string& path) const;
+			int			GetDevices(std::vector<BlockDeviceStats>& devices) const;
+		protected:
+		private:
+			bool		Matches(std::string_view name) const;
+			BlockDeviceStats* Slot(uint32_t major, uint32_t minor, std::string_view name, size_t position);
+
+			ProcfsFile						mDiskstatsFile;
+			std::vector<BlockDeviceStats>	mDevices;
+			std::vector<std::string>		mInclude;			// Globs, empty includes everything
+			std::vector<std::string>		mExclude;			// Globs
+			uint64_t						mSampleNumber;
+			uint64_t						mLastTimestampNs;
+		};
+	}
+}
+#endif
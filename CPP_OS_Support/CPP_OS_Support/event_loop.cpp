@@ -0,0 +1,404 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		event_loop.cpp
+//!
+//! @brief		Implementation of the event loop, executor adapter and the
+//!				helper pool for blocking calls
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"event_loop.h"				// Event Loop Classes
+#include	<cerrno>					// errno values
+#include	<condition_variable>		// Parked helper threads
+#include	<deque>						// Helper job queue
+//
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Helper threads park here between jobs. Deliberately leaked with
+		///			detached threads, a mount stuck in the kernel must not hold up exit.
+		struct BlockingPool
+		{
+			static constexpr size_t MAX_THREADS = 4;
+
+			std::mutex					mutex;
+			std::condition_variable		condition;
+			std::deque<std::function<void()>> jobs;
+			size_t						threads = 0;
+			size_t						idle = 0;
+		};
+
+		static BlockingPool* gBlockingPool = nullptr;
+		static std::once_flag gBlockingPoolOnce;
+
+		static BlockingPool& GetBlockingPool()
+		{
+			std::call_once(gBlockingPoolOnce, []
+			{
+				gBlockingPool = new BlockingPool();
+#ifndef _WIN32
+				// A forked child has none of the parent's helper threads, and the condition
+				// variable still counts their waits, so the child starts a fresh pool.
+				pthread_atfork(
+					[] { gBlockingPool->mutex.lock(); },
+					[] { gBlockingPool->mutex.unlock(); },
+					[] { gBlockingPool = new BlockingPool(); });
+#endif
+			});
+			return *gBlockingPool;
+		}
+
+		static void BlockingWorker(BlockingPool& pool)
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			while (true)
+			{
+				pool.idle++;
+				pool.condition.wait(lock, [&pool] { return !pool.jobs.empty(); });
+				pool.idle--;
+
+				std::function<void()> job = std::move(pool.jobs.front());
+				pool.jobs.pop_front();
+
+				lock.unlock();
+				job();
+				lock.lock();
+			}
+		}
+
+		void RunBlocking(std::function<void()> job)
+		{
+			BlockingPool& pool = GetBlockingPool();
+			std::lock_guard<std::mutex> lock(pool.mutex);
+
+			pool.jobs.push_back(std::move(job));
+			if (pool.idle < pool.jobs.size() && pool.threads < BlockingPool::MAX_THREADS)
+			{
+				pool.threads++;
+				std::thread(BlockingWorker, std::ref(pool)).detach();
+			}
+			pool.condition.notify_one();
+		}
+
+		EventLoop::EventLoop()
+		{
+			mEpollFd = -1;
+			mWakeFd = -1;
+			mTimerFd = -1;
+			mTimerOrder = 0;
+			mWakePending = false;
+			mStopRequested = false;
+		}
+
+		EventLoop::~EventLoop()
+		{
+			Close();
+		}
+
+		int EventLoop::Open()
+		{
+			if (IsOpen())
+			{
+				return 0;
+			}
+
+#ifdef __linux__
+			mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+			mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+			if (mEpollFd < 0 || mWakeFd < 0 || mTimerFd < 0)
+			{
+				Close();
+				return -1;
+			}
+
+			struct epoll_event event {};
+			event.events = EPOLLIN;
+			event.data.fd = mWakeFd;
+			if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event) != 0)
+			{
+				Close();
+				return -1;
+			}
+
+			event.data.fd = mTimerFd;
+			if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &event) != 0)
+			{
+				Close();
+				return -1;
+			}
+
+			mArmedDeadline = std::chrono::steady_clock::time_point::max();
+			mStopRequested = false;
+			return 0;
+#else
+			return -1;
+#endif
+		}
+
+		void EventLoop::Close()
+		{
+#ifdef __linux__
+			for (int* fd : { &mEpollFd, &mWakeFd, &mTimerFd })
+			{
+				if (*fd >= 0)
+				{
+					close(*fd);
+					*fd = -1;
+				}
+			}
+#endif
+		}
+
+		bool EventLoop::IsOpen() const
+		{
+			return mEpollFd >= 0;
+		}
+
+		void EventLoop::Post(std::coroutine_handle<> handle)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mReady.push_back(handle);
+			}
+			Wake();
+		}
+
+		void EventLoop::PostAfter(std::chrono::nanoseconds delay, std::coroutine_handle<> handle)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + delay;
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mTimers.push(Timer{ deadline, mTimerOrder++, handle });
+			ArmTimer();
+		}
+
+		int EventLoop::Run()
+		{
+			if (!IsOpen())
+			{
+				return -1;
+			}
+
+			while (!mStopRequested.load())
+			{
+				if (RunOnce(-1) < 0)
+				{
+					return -1;
+				}
+			}
+
+			mStopRequested = false;
+			return 0;
+		}
+
+		int EventLoop::RunOnce(int timeoutMs)
+		{
+#ifdef __linux__
+			if (!IsOpen())
+			{
+				return -1;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (!mReady.empty())
+				{
+					timeoutMs = 0;
+				}
+			}
+
+			struct epoll_event events[4];
+			int count = epoll_wait(mEpollFd, events, 4, timeoutMs);
+			if (count < 0 && errno != EINTR)
+			{
+				return -1;
+			}
+
+			for (int i = 0; i < count; i++)
+			{
+				// Both are drained, the timer heap is the source of truth for expiries
+				uint64_t value = 0;
+				if (read(events[i].data.fd, &value, sizeof(value)) < 0)
+				{
+					continue;
+				}
+
+				if (events[i].data.fd == mWakeFd)
+				{
+					mWakePending = false;
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mRunning.swap(mReady);
+
+				const auto now = std::chrono::steady_clock::now();
+				while (!mTimers.empty() && mTimers.top().deadline <= now)
+				{
+					mRunning.push_back(mTimers.top().handle);
+					mTimers.pop();
+				}
+
+				if (mArmedDeadline <= now)
+				{
+					mArmedDeadline = std::chrono::steady_clock::time_point::max();
+				}
+				ArmTimer();
+			}
+
+			// Resumed outside the lock, the coroutines post and sleep again freely
+			const int resumed = static_cast<int>(mRunning.size());
+			for (std::coroutine_handle<> handle : mRunning)
+			{
+				handle.resume();
+			}
+			mRunning.clear();
+
+			return resumed;
+#else
+			(void)timeoutMs;
+			return -1;
+#endif
+		}
+
+		void EventLoop::Stop()
+		{
+			mStopRequested = true;
+			Wake();
+		}
+
+		int EventLoop::GetDescriptor() const
+		{
+			return mEpollFd;
+		}
+
+		void EventLoop::Wake()
+		{
+#ifdef __linux__
+			// One pending eventfd write is enough however many posts pile up behind it
+			if (mWakeFd >= 0 && !mWakePending.exchange(true))
+			{
+				uint64_t one = 1;
+				if (write(mWakeFd, &one, sizeof(one)) < 0)
+				{
+					mWakePending = false;
+				}
+			}
+#endif
+		}
+
+		void EventLoop::ArmTimer()
+		{
+#ifdef __linux__
+			// Only rearmed when the earliest deadline moves, called with the mutex held
+			if (mTimerFd < 0)
+			{
+				return;
+			}
+
+			const auto next = mTimers.empty() ? std::chrono::steady_clock::time_point::max() : mTimers.top().deadline;
+			if (next == mArmedDeadline)
+			{
+				return;
+			}
+
+			struct itimerspec spec {};
+			if (!mTimers.empty())
+			{
+				const auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(next.time_since_epoch()).count();
+
+				// A zero value disarms, a deadline already passed still has to fire
+				spec.it_value.tv_sec = static_cast<time_t>(sinceEpoch / 1000000000);
+				spec.it_value.tv_nsec = static_cast<long>(sinceEpoch % 1000000000);
+				if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+				{
+					spec.it_value.tv_nsec = 1;
+				}
+			}
+
+			if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0)
+			{
+				mArmedDeadline = next;
+			}
+#endif
+		}
+
+		ExecutorAdapter::ExecutorAdapter(PostFunction post, PostAfterFunction postAfter)
+		{
+			mPost = std::move(post);
+			mPostAfter = std::move(postAfter);
+		}
+
+		ExecutorAdapter::~ExecutorAdapter()
+		{
+			if (mTimerThread.joinable())
+			{
+				mTimerLoop->Stop();
+				mTimerThread.join();
+			}
+		}
+
+		void ExecutorAdapter::Post(std::coroutine_handle<> handle)
+		{
+			mPost([handle] { handle.resume(); });
+		}
+
+		void ExecutorAdapter::PostAfter(std::chrono::nanoseconds delay, std::coroutine_handle<> handle)
+		{
+			if (mPostAfter)
+			{
+				mPostAfter(delay, [handle] { handle.resume(); });
+				return;
+			}
+
+			// The timer loop resumes a relay coroutine whose only job is to post the
+			// real one to the application's executor.
+			{
+				std::lock_guard<std::mutex> lock(mTimerMutex);
+				if (!mTimerLoop)
+				{
+					mTimerLoop = std::make_unique<EventLoop>();
+					if (mTimerLoop->Open() != 0)
+					{
+						mTimerLoop.reset();
+					}
+					else
+					{
+						mTimerThread = std::thread([loop = mTimerLoop.get()] { loop->Run(); });
+					}
+				}
+			}
+
+			if (!mTimerLoop)
+			{
+				// No timers on this platform, resume now rather than never
+				Post(handle);
+				return;
+			}
+
+			auto relay = [](EventLoop& loop, std::chrono::nanoseconds wait, ExecutorAdapter& adapter,
+				std::coroutine_handle<> target) -> DetachedTask
+			{
+				co_await SleepFor(loop, wait);
+				adapter.Post(target);
+			};
+			relay(*mTimerLoop, delay, *this, handle);
+		}
+	}
+}
@@ -0,0 +1,307 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		event_loop.h
+//!
+//! @brief		Executors for the coroutine API. EventLoop is a single thread
+//!				epoll loop with an eventfd for wakeups and one timerfd for
+//!				every pending timer. ExecutorAdapter forwards resumptions to
+//!				an executor the application already runs. Blocking system
+//!				calls go to a small helper pool and resume on the executor.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Stop and wake flags
+#include <chrono>						// Timer deadlines
+#include <coroutine>					// Coroutine handles
+#include <cstdint>						// Fixed width types
+#include <exception>					// Offloaded exceptions
+#include <functional>					// Adapter callbacks, helper jobs
+#include <memory>						// Adapter timer loop
+#include <mutex>						// Ready queue and timers
+#include <optional>						// Offloaded results
+#include <queue>						// Timer heap
+#include <stdexcept>					// Loop that cannot open
+#include <thread>						// Adapter timer thread
+#include <type_traits>					// Offloaded result type
+#include <vector>						// Ready queue
+#include "async_task.h"					// Task and DetachedTask
+#include "support_error.h"				// Last error carried back from the helper pool
+//
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_EVENT_LOOP				// Define the event loop classes.
+#define     CPP_EVENT_LOOP
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Where coroutines of the async API are resumed. Post may be called
+		///			from any thread.
+		class Executor
+		{
+		public:
+			virtual ~Executor() = default;
+			virtual void Post(std::coroutine_handle<> handle) = 0;
+			virtual void PostAfter(std::chrono::nanoseconds delay, std::coroutine_handle<> handle) = 0;
+		};
+
+		class EventLoop : public Executor
+		{
+		public:
+			EventLoop();
+			~EventLoop() override;
+			EventLoop(const EventLoop&) = delete;
+			EventLoop& operator=(const EventLoop&) = delete;
+			int			Open();
+			void		Close();
+			bool		IsOpen() const;
+			void		Post(std::coroutine_handle<> handle) override;
+			void		PostAfter(std::chrono::nanoseconds delay, std::coroutine_handle<> handle) override;
+			int			Run();
+			int			RunOnce(int timeoutMs);
+			void		Stop();
+			int			GetDescriptor() const;
+
+			template <typename T>
+			T			RunUntilComplete(Task<T> task);
+		protected:
+		private:
+			struct Timer
+			{
+				std::chrono::steady_clock::time_point	deadline;
+				uint64_t								order;		// Keeps equal deadlines first in, first out
+				std::coroutine_handle<>					handle;
+
+				bool operator>(const Timer& other) const
+				{
+					return deadline != other.deadline ? deadline > other.deadline : order > other.order;
+				}
+			};
+
+			void		Wake();
+			void		ArmTimer();
+
+			int			mEpollFd;
+			int			mWakeFd;
+			int			mTimerFd;
+			std::mutex	mMutex;
+			std::vector<std::coroutine_handle<>> mReady;
+			std::vector<std::coroutine_handle<>> mRunning;
+			std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> mTimers;
+			std::chrono::steady_clock::time_point mArmedDeadline;
+			uint64_t	mTimerOrder;
+			std::atomic<bool> mWakePending;
+			std::atomic<bool> mStopRequested;
+		};
+
+		/// @brief Runs coroutines on an executor the application already has. The
+		///			post function must run the job it is given on that executor, e.g.
+		///			[&io](auto job) { asio::post(io, std::move(job)); }. Without a
+		///			delayed post function timers run on an internal EventLoop thread
+		///			that only hands each expiry over to the post function.
+		class ExecutorAdapter : public Executor
+		{
+		public:
+			using Job = std::function<void()>;
+			using PostFunction = std::function<void(Job)>;
+			using PostAfterFunction = std::function<void(std::chrono::nanoseconds, Job)>;
+
+			explicit ExecutorAdapter(PostFunction post, PostAfterFunction postAfter = nullptr);
+			~ExecutorAdapter() override;
+			void		Post(std::coroutine_handle<> handle) override;
+			void		PostAfter(std::chrono::nanoseconds delay, std::coroutine_handle<> handle) override;
+		protected:
+		private:
+			PostFunction		mPost;
+			PostAfterFunction	mPostAfter;
+			std::mutex			mTimerMutex;
+			std::unique_ptr<EventLoop>	mTimerLoop;
+			std::thread			mTimerThread;
+		};
+
+		/// @brief Runs a job on the shared helper pool. The pool grows to a few threads
+		///			while jobs wait and its threads stay parked for reuse.
+		void RunBlocking(std::function<void()> job);
+
+		/// @brief Awaiting it runs the function on the helper pool and resumes the
+		///			awaiting coroutine on the executor with the function's result. An
+		///			error the function records is recorded again on the resuming thread,
+		///			so LastError reads the same as after the blocking call.
+		template <typename Function>
+		class OffloadAwaitable
+		{
+		public:
+			using Result = std::invoke_result_t<Function&>;
+			static_assert(!std::is_void_v<Result>, "offloaded work must return a value");
+
+			OffloadAwaitable(Executor& executor, Function function) :
+				mExecutor(executor), mFunction(std::move(function))
+			{
+			}
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				RunBlocking([this, handle]
+				{
+					try
+					{
+						LastError::Clear();
+						mResult.emplace(mFunction());
+						mError = LastError::Get();
+					}
+					catch (...)
+					{
+						mException = std::current_exception();
+					}
+
+					// Nothing of this awaitable may be touched after the handoff
+					mExecutor.Post(handle);
+				});
+			}
+
+			Result await_resume()
+			{
+				if (mException)
+				{
+					std::rethrow_exception(mException);
+				}
+
+				if (!mError.Ok())
+				{
+					LastError::Set(mError.code, mError.source, mError.errorNumber);
+				}
+				return std::move(*mResult);
+			}
+		protected:
+		private:
+			Executor&				mExecutor;
+			Function				mFunction;
+			std::optional<Result>	mResult;
+			std::exception_ptr		mException;
+			ErrorInfo				mError;
+		};
+
+		template <typename Function>
+		OffloadAwaitable<Function> Offload(Executor& executor, Function function)
+		{
+			return OffloadAwaitable<Function>(executor, std::move(function));
+		}
+
+		/// @brief co_await Schedule(executor) continues the coroutine on that executor
+		struct ScheduleAwaitable
+		{
+			Executor& executor;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) const { executor.Post(handle); }
+			void await_resume() const noexcept {}
+		};
+
+		inline ScheduleAwaitable Schedule(Executor& executor)
+		{
+			return ScheduleAwaitable{ executor };
+		}
+
+		/// @brief co_await SleepFor(executor, delay) suspends without holding a thread
+		struct SleepAwaitable
+		{
+			Executor&					executor;
+			std::chrono::nanoseconds	delay;
+
+			bool await_ready() const noexcept { return delay.count() <= 0; }
+			void await_suspend(std::coroutine_handle<> handle) const { executor.PostAfter(delay, handle); }
+			void await_resume() const noexcept {}
+		};
+
+		template <typename Rep, typename Period>
+		SleepAwaitable SleepFor(Executor& executor, std::chrono::duration<Rep, Period> delay)
+		{
+			return SleepAwaitable{ executor, std::chrono::duration_cast<std::chrono::nanoseconds>(delay) };
+		}
+
+		/// @brief Starts the task on the executor and lets it run to completion on its
+		///			own. Exceptions escaping the task terminate, as with std::thread.
+		inline DetachedTask Spawn(Executor& executor, Task<void> task)
+		{
+			co_await Schedule(executor);
+			co_await task;
+		}
+
+		template <typename T>
+		T EventLoop::RunUntilComplete(Task<T> task)
+		{
+			// Task<void> has no value to keep, a flag stands in for it
+			using Value = std::conditional_t<std::is_void_v<T>, bool, T>;
+			std::optional<Value> result;
+			std::exception_ptr exception;
+			bool finished = false;
+
+			auto run = [](Task<T> inner, std::optional<Value>& value, std::exception_ptr& error, bool& done) -> DetachedTask
+			{
+				try
+				{
+					if constexpr (std::is_void_v<T>)
+					{
+						co_await inner;
+						value.emplace(true);
+					}
+					else
+					{
+						value.emplace(co_await inner);
+					}
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				done = true;
+			};
+
+			// A task started on a loop that cannot run would never finish
+			if (!IsOpen() && Open() != 0)
+			{
+				throw std::runtime_error("event loop could not be opened");
+			}
+
+			run(std::move(task), result, exception, finished);
+			while (!finished)
+			{
+				RunOnce(-1);
+			}
+
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+
+			if constexpr (!std::is_void_v<T>)
+			{
+				return std::move(*result);
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		instrumentation.cpp
+//!
+//! @brief		Implementation of the per-thread probe shards and merging
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"instrumentation.h"			// Instrumentation Types
+#include	<bit>						// std::countl_zero
+#include	<memory>					// Shard ownership
+#include	<mutex>						// Shard registry
+#include	<vector>					// Shard registry
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief One thread's counters for one probe. Only the owning thread writes,
+		///			so updates are plain relaxed load/store pairs without a locked
+		///			instruction, and Collect may read them at any time.
+		struct ProbeShard
+		{
+			std::atomic<uint64_t>	calls{ 0 };
+			std::atomic<uint64_t>	errors{ 0 };
+			std::atomic<uint64_t>	totalNs{ 0 };
+			std::atomic<uint64_t>	maxNs{ 0 };
+			std::atomic<uint64_t>	buckets[HISTOGRAM_BUCKETS]{};
+		};
+
+		/// @brief Every probe for one thread, on its own cache lines
+		struct alignas(64) ThreadShard
+		{
+			ProbeShard	probes[static_cast<size_t>(Probe::PROBE_COUNT)];
+			bool		inUse = false;		// Guarded by the registry mutex
+		};
+
+		/// @brief Shards are never freed, an exiting thread hands its shard to the next
+		///			new thread so the totals survive and memory stays bounded by the
+		///			peak number of instrumented threads.
+		struct ShardRegistry
+		{
+			std::mutex									mutex;
+			std::vector<std::unique_ptr<ThreadShard>>	shards;
+		};
+
+		static ShardRegistry& GetRegistry()
+		{
+			// Leaked on purpose, threads may still record during static destruction
+			static ShardRegistry* registry = new ShardRegistry();
+			return *registry;
+		}
+
+		/// @brief Claims a shard on the first probe of a thread, releases it at thread exit
+		class ShardLease
+		{
+		public:
+			ShardLease()
+			{
+				ShardRegistry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+
+				mShard = nullptr;
+				for (std::unique_ptr<ThreadShard>& shard : registry.shards)
+				{
+					if (!shard->inUse)
+					{
+						mShard = shard.get();
+						break;
+					}
+				}
+
+				if (mShard == nullptr)
+				{
+					registry.shards.push_back(std::make_unique<ThreadShard>());
+					mShard = registry.shards.back().get();
+				}
+				mShard->inUse = true;
+			}
+
+			~ShardLease()
+			{
+				ShardRegistry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				mShard->inUse = false;
+			}
+
+			ThreadShard& Get()
+			{
+				return *mShard;
+			}
+		protected:
+		private:
+			ThreadShard* mShard;
+		};
+
+		static inline void Increment(std::atomic<uint64_t>& counter, uint64_t amount)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		const char* GetProbeName(Probe probe)
+		{
+			switch (probe)
+			{
+			case Probe::PROCFS_READ:	return "procfs_read";
+			case Probe::SYSINFO:		return "sysinfo";
+			case Probe::STATVFS:		return "statvfs";
+			case Probe::MOUNT:			return "mount";
+			case Probe::UNMOUNT:		return "unmount";
+			default:					return "unknown";
+			}
+		}
+
+		double ProbeStats::GetMeanNs() const
+		{
+			return calls > 0 ? static_cast<double>(totalNs) / static_cast<double>(calls) : 0.0;
+		}
+
+		uint64_t ProbeStats::GetPercentileNs(double percentile) const
+		{
+			if (calls == 0)
+			{
+				return 0;
+			}
+
+			// Rank of the requested sample, 1 based, then the bucket that holds it
+			uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(calls) + 0.5);
+			rank = rank == 0 ? 1 : rank;
+
+			uint64_t seen = 0;
+			for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+			{
+				seen += buckets[i];
+				if (seen >= rank)
+				{
+					const uint64_t bound = Instrumentation::GetBucketUpperBound(i);
+					return bound < maxNs ? bound : maxNs;
+				}
+			}
+
+			return maxNs;
+		}
+
+		namespace Instrumentation
+		{
+			size_t GetBucketIndex(uint64_t valueNs)
+			{
+				if (valueNs < HISTOGRAM_SUB_BUCKETS)
+				{
+					return static_cast<size_t>(valueNs);
+				}
+
+				// Magnitude picks the group, the next four bits the bucket inside it
+				const int magnitude = 63 - std::countl_zero(valueNs);
+				if (magnitude >= HISTOGRAM_MAX_MAGNITUDE)
+				{
+					return HISTOGRAM_BUCKETS - 1;
+				}
+
+				const size_t group = static_cast<size_t>(magnitude - 3);
+				const size_t sub = static_cast<size_t>((valueNs >> (magnitude - 4)) & (HISTOGRAM_SUB_BUCKETS - 1));
+				return group * HISTOGRAM_SUB_BUCKETS + sub;
+			}
+
+			uint64_t GetBucketUpperBound(size_t index)
+			{
+				if (index < HISTOGRAM_SUB_BUCKETS)
+				{
+					return index;
+				}
+
+				const size_t group = index / HISTOGRAM_SUB_BUCKETS;
+				const uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+				return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+			}
+
+			void Record(Probe probe, uint64_t elapsedNs, bool failed)
+			{
+				static thread_local ShardLease lease;
+				ProbeShard& shard = lease.Get().probes[static_cast<size_t>(probe)];
+
+				Increment(shard.calls, 1);
+				if (failed)
+				{
+					Increment(shard.errors, 1);
+				}
+				Increment(shard.totalNs, elapsedNs);
+				if (elapsedNs > shard.maxNs.load(std::memory_order_relaxed))
+				{
+					shard.maxNs.store(elapsedNs, std::memory_order_relaxed);
+				}
+				Increment(shard.buckets[GetBucketIndex(elapsedNs)], 1);
+			}
+
+			int Collect(Probe probe, ProbeStats& stats)
+			{
+				stats = ProbeStats();
+
+				if (!INSTRUMENTATION_ENABLED || probe >= Probe::PROBE_COUNT)
+				{
+					return -1;
+				}
+
+				// Shards are read while their threads keep recording, so the merged
+				// figures can be a few calls apart from each other but never torn.
+				ShardRegistry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+
+				for (const std::unique_ptr<ThreadShard>& thread : registry.shards)
+				{
+					const ProbeShard& shard = thread->probes[static_cast<size_t>(probe)];
+					stats.calls += shard.calls.load(std::memory_order_relaxed);
+					stats.errors += shard.errors.load(std::memory_order_relaxed);
+					stats.totalNs += shard.totalNs.load(std::memory_order_relaxed);
+
+					const uint64_t maxNs = shard.maxNs.load(std::memory_order_relaxed);
+					stats.maxNs = maxNs > stats.maxNs ? maxNs : stats.maxNs;
+
+					for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+					{
+						stats.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+					}
+				}
+
+				return 0;
+			}
+		}
+	}
+}
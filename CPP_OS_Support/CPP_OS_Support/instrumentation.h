@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		instrumentation.h
+//!
+//! @brief		Self-instrumentation of the collection paths. Every probe
+//!				records into a per-thread shard of log-linear latency
+//!				histograms and call/error counters, shards are merged only
+//!				when the figures are asked for. Compiled out entirely unless
+//!				OS_SUPPORT_INSTRUMENTATION is defined to 1.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <array>						// Merged histogram
+#include <atomic>						// Shard counters
+#include <chrono>						// Probe timing
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_INSTRUMENTATION			// Define the instrumentation types.
+#define     CPP_INSTRUMENTATION
+//
+#ifndef		OS_SUPPORT_INSTRUMENTATION	// Set by the OS_SUPPORT_ENABLE_INSTRUMENTATION CMake option
+#define		OS_SUPPORT_INSTRUMENTATION 0
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief True when the probes are compiled in
+		inline constexpr bool INSTRUMENTATION_ENABLED = OS_SUPPORT_INSTRUMENTATION != 0;
+
+		/// @brief Instrumented kernel interaction
+		enum class Probe : uint8_t
+		{
+			PROCFS_READ,		// pread of a procfs/sysfs/cgroupfs file
+			SYSINFO,
+			STATVFS,			// statvfs, statfs or GetDiskFreeSpaceEx
+			MOUNT,				// mount(2) or the diskutil shell-out
+			UNMOUNT,
+			PROBE_COUNT,
+		};
+
+		/// @brief Printable probe name
+		const char* GetProbeName(Probe probe);
+
+		/// @brief Histogram layout: values below 16 ns get a bucket each, above that
+		///			every power of two is split into 16 buckets, so any recorded value
+		///			is within 6.25% of its bucket. Values past 2^40 ns (18 minutes)
+		///			share the last bucket.
+		inline constexpr int	HISTOGRAM_SUB_BUCKETS = 16;
+		inline constexpr int	HISTOGRAM_MAX_MAGNITUDE = 40;
+		inline constexpr size_t	HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_MAGNITUDE - 3) * HISTOGRAM_SUB_BUCKETS;
+
+		/// @brief Merged figures for one probe across every thread.
+		struct ProbeStats
+		{
+			uint64_t	calls = 0;
+			uint64_t	errors = 0;
+			uint64_t	totalNs = 0;
+			uint64_t	maxNs = 0;
+			std::array<uint64_t, HISTOGRAM_BUCKETS> buckets{};
+
+			double		GetMeanNs() const;
+			uint64_t	GetPercentileNs(double percentile) const;
+		};
+
+		namespace Instrumentation
+		{
+			size_t		GetBucketIndex(uint64_t valueNs);
+			uint64_t	GetBucketUpperBound(size_t index);
+			void		Record(Probe probe, uint64_t elapsedNs, bool failed);
+			int			Collect(Probe probe, ProbeStats& stats);
+		}
+
+		/// @brief Times one probe from construction to Finish. The disabled
+		///			specialisation is empty so the probes vanish from the build.
+		template <bool Enabled>
+		class BasicProbeTimer
+		{
+		public:
+			explicit BasicProbeTimer(Probe probe)
+			{
+				mProbe = probe;
+				mStart = std::chrono::steady_clock::now();
+			}
+
+			void Finish(bool succeeded)
+			{
+				Instrumentation::Record(mProbe, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - mStart).count()), !succeeded);
+			}
+		protected:
+		private:
+			Probe									mProbe;
+			std::chrono::steady_clock::time_point	mStart;
+		};
+
+		template <>
+		class BasicProbeTimer<false>
+		{
+		public:
+			explicit BasicProbeTimer(Probe) {}
+			void Finish(bool) {}
+		};
+
+		using ProbeTimer = BasicProbeTimer<INSTRUMENTATION_ENABLED>;
+	}
+}
+#endif
@@ -0,0 +1,617 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		link_monitor.cpp
+//!
+//! @brief		Implementation of the link monitor class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"link_monitor.h"			// Link Monitor Class
+#include	<cerrno>					// errno values
+#include	<cstring>					// memcpy, strnlen
+#include	"procfs_reader.h"			// sysfs speed attribute
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		bool LinkInfo::IsUp() const
+		{
+#ifdef __linux__
+			// Drivers that do not implement operstate report UNKNOWN, loopback among them
+			return (flags & IFF_UP) != 0 && (operState == IF_OPER_UP ||
+				(operState == IF_OPER_UNKNOWN && (flags & IFF_RUNNING) != 0));
+#else
+			return false;
+#endif
+		}
+
+		LinkMonitor::LinkMonitor()
+		{
+			mSocket = -1;
+			mWakeFd = -1;
+			mSequence = 0;
+			mDumpNumber = 0;
+			mDumpPending = false;
+			mResyncNeeded = false;
+			mStopRequested = false;
+			mRunning = false;
+		}
+
+		LinkMonitor::~LinkMonitor()
+		{
+			Close();
+		}
+
+		int LinkMonitor::Open()
+		{
+			if (mSocket >= 0)
+			{
+				return 0;
+			}
+
+#ifdef __linux__
+			mSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+			if (mSocket < 0)
+			{
+				return -1;
+			}
+
+			// Subscribe before dumping so no change can fall between the two
+			struct sockaddr_nl address {};
+			address.nl_family = AF_NETLINK;
+			address.nl_groups = RTMGRP_LINK;
+			if (bind(mSocket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0)
+			{
+				Close();
+				return -1;
+			}
+
+			// A burst of events on a busy container host overflows the default buffer
+			int receiveBuffer = 1024 * 1024;
+			setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+			// Large enough for any single message, IFLA_STATS64 and IFLA_LINKINFO included
+			mBuffer.resize(64 * 1024);
+
+			mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+			return Refresh();
+#else
+			return -1;
+#endif
+		}
+
+		void LinkMonitor::Close()
+		{
+			Stop();
+
+#ifdef __linux__
+			if (mSocket >= 0)
+			{
+				close(mSocket);
+				mSocket = -1;
+			}
+
+			if (mWakeFd >= 0)
+			{
+				close(mWakeFd);
+				mWakeFd = -1;
+			}
+#endif
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mLinks.clear();
+			mDumpPending = false;
+			mResyncNeeded = false;
+		}
+
+		void LinkMonitor::SetCallback(Callback callback)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCallback = std::move(callback);
+		}
+
+		int LinkMonitor::Refresh()
+		{
+			// Events only arrive for state changes, a dump also brings the counters up to date
+			if (RequestDump() != 0)
+			{
+				return -1;
+			}
+
+			// With the event thread running it receives the reply itself
+			if (mRunning)
+			{
+				return 0;
+			}
+
+			return Receive(true);
+		}
+
+		int LinkMonitor::ProcessEvents(int timeoutMs)
+		{
+#ifdef __linux__
+			if (mSocket < 0)
+			{
+				return -1;
+			}
+
+			struct pollfd descriptor {};
+			descriptor.fd = mSocket;
+			descriptor.events = POLLIN;
+
+			int ready = poll(&descriptor, 1, timeoutMs);
+			if (ready < 0)
+			{
+				return errno == EINTR ? 0 : -1;
+			}
+			if (ready == 0)
+			{
+				return 0;
+			}
+
+			return Receive(false);
+#else
+			(void)timeoutMs;
+			return -1;
+#endif
+		}
+
+		int LinkMonitor::Start()
+		{
+			if (mRunning)
+			{
+				return 0;
+			}
+
+			if (Open() != 0)
+			{
+				return -1;
+			}
+
+			mStopRequested = false;
+			mRunning = true;
+			mThread = std::thread(&LinkMonitor::Run, this);
+			return 0;
+		}
+
+		void LinkMonitor::Stop()
+		{
+			if (mThread.joinable())
+			{
+				mStopRequested = true;
+#ifdef __linux__
+				uint64_t one = 1;
+				if (write(mWakeFd, &one, sizeof(one)) < 0)
+				{
+					// The thread still notices the flag within its poll timeout
+				}
+#endif
+				mThread.join();
+			}
+
+			mRunning = false;
+		}
+
+		bool LinkMonitor::IsRunning() const
+		{
+			return mRunning;
+		}
+
+		int LinkMonitor::GetLinks(std::vector<LinkInfo>& links)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			links.clear();
+			for (const auto& entry : mLinks)
+			{
+				links.push_back(entry.second.info);
+			}
+
+			return mSocket >= 0 ? 0 : -1;
+		}
+
+		bool LinkMonitor::FindLink(const std::string& name, LinkInfo& link)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			for (const auto& entry : mLinks)
+			{
+				if (entry.second.info.name == name)
+				{
+					link = entry.second.info;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		int LinkMonitor::GetDescriptor() const
+		{
+			return mSocket;
+		}
+
+		int LinkMonitor::RequestDump()
+		{
+#ifdef __linux__
+			if (mSocket < 0)
+			{
+				return -1;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (mDumpPending)
+				{
+					// The running dump already covers this request
+					return 0;
+				}
+				mDumpPending = true;
+				mResyncNeeded = false;
+				mDumpNumber++;
+				mSequence++;
+			}
+
+			struct
+			{
+				struct nlmsghdr		header;
+				struct ifinfomsg	info;
+			} request {};
+
+			request.header.nlmsg_len = NLMSG_LENGTH(sizeof(request.info));
+			request.header.nlmsg_type = RTM_GETLINK;
+			request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+			request.header.nlmsg_seq = mSequence;
+			request.info.ifi_family = AF_UNSPEC;
+
+			struct sockaddr_nl kernel {};
+			kernel.nl_family = AF_NETLINK;
+
+			if (sendto(mSocket, &request, request.header.nlmsg_len, 0,
+				reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mDumpPending = false;
+				return -1;
+			}
+
+			return 0;
+#else
+			return -1;
+#endif
+		}
+
+		int LinkMonitor::Receive(bool untilDone)
+		{
+#ifdef __linux__
+			while (true)
+			{
+				ssize_t length = recv(mSocket, mBuffer.data(), mBuffer.size(), untilDone ? 0 : MSG_DONTWAIT);
+				if (length < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					if (errno == ENOBUFS)
+					{
+						// The kernel dropped events, only a full dump can recover the table
+						{
+							std::lock_guard<std::mutex> lock(mMutex);
+							mResyncNeeded = true;
+						}
+						if (untilDone)
+						{
+							continue;
+						}
+						break;
+					}
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						break;
+					}
+					return -1;
+				}
+
+				bool done = false;
+				const struct nlmsghdr* header = reinterpret_cast<const struct nlmsghdr*>(mBuffer.data());
+				for (size_t remaining = static_cast<size_t>(length); NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining))
+				{
+					if (header->nlmsg_type == NLMSG_DONE)
+					{
+						FinishDump(true);
+						done = true;
+						continue;
+					}
+
+					if (header->nlmsg_type == NLMSG_ERROR)
+					{
+						// Only a dump that could not run (EBUSY, ENOMEM) is answered with an error
+						FinishDump(false);
+						done = true;
+						continue;
+					}
+
+					HandleMessage(header);
+				}
+
+				if (untilDone && done)
+				{
+					break;
+				}
+			}
+
+			bool resync = false;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				resync = mResyncNeeded && !mDumpPending;
+			}
+
+			if (resync)
+			{
+				return Refresh();
+			}
+
+			return 0;
+#else
+			(void)untilDone;
+			return -1;
+#endif
+		}
+
+		void LinkMonitor::HandleMessage(const struct nlmsghdr* header)
+		{
+#ifdef __linux__
+			if ((header->nlmsg_type != RTM_NEWLINK && header->nlmsg_type != RTM_DELLINK) ||
+				header->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg)))
+			{
+				return;
+			}
+
+			// Bridge port notifications share the group but describe the port, not the link
+			const struct ifinfomsg* message = static_cast<const struct ifinfomsg*>(NLMSG_DATA(header));
+			if (message->ifi_family == AF_BRIDGE)
+			{
+				return;
+			}
+
+			LinkInfo link;
+			link.index = message->ifi_index;
+			link.type = message->ifi_type;
+			link.flags = message->ifi_flags;
+
+			int attributeLength = static_cast<int>(IFLA_PAYLOAD(header));
+			for (const struct rtattr* attribute = IFLA_RTA(message); RTA_OK(attribute, attributeLength);
+				attribute = RTA_NEXT(attribute, attributeLength))
+			{
+				const char* data = static_cast<const char*>(RTA_DATA(attribute));
+				const size_t size = RTA_PAYLOAD(attribute);
+
+				switch (attribute->rta_type)
+				{
+				case IFLA_IFNAME:
+					link.name.assign(data, strnlen(data, size));
+					break;
+				case IFLA_MTU:
+					if (size >= sizeof(uint32_t))
+					{
+						std::memcpy(&link.mtu, data, sizeof(uint32_t));
+					}
+					break;
+				case IFLA_OPERSTATE:
+					if (size >= sizeof(uint8_t))
+					{
+						link.operState = static_cast<uint8_t>(data[0]);
+					}
+					break;
+				case IFLA_MASTER:
+					if (size >= sizeof(int))
+					{
+						std::memcpy(&link.master, data, sizeof(int));
+					}
+					break;
+				case IFLA_STATS64:
+					if (size >= sizeof(struct rtnl_link_stats64))
+					{
+						struct rtnl_link_stats64 stats;
+						std::memcpy(&stats, data, sizeof(stats));
+						link.counters.rxBytes = stats.rx_bytes;
+						link.counters.rxPackets = stats.rx_packets;
+						link.counters.rxErrors = stats.rx_errors;
+						link.counters.rxDrops = stats.rx_dropped;
+						link.counters.txBytes = stats.tx_bytes;
+						link.counters.txPackets = stats.tx_packets;
+						link.counters.txErrors = stats.tx_errors;
+						link.counters.txDrops = stats.tx_dropped;
+					}
+					break;
+				case IFLA_LINKINFO:
+				{
+					int nestedLength = static_cast<int>(size);
+					for (const struct rtattr* nested = static_cast<const struct rtattr*>(RTA_DATA(attribute));
+						RTA_OK(nested, nestedLength); nested = RTA_NEXT(nested, nestedLength))
+					{
+						if (nested->rta_type == IFLA_INFO_KIND)
+						{
+							const char* kind = static_cast<const char*>(RTA_DATA(nested));
+							link.kind.assign(kind, strnlen(kind, RTA_PAYLOAD(nested)));
+						}
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+
+			LinkEvent event = LinkEvent::CHANGED;
+			bool notify = true;
+			bool readSpeed = false;
+			Callback callback;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				callback = mCallback;
+
+				auto found = mLinks.find(link.index);
+				if (header->nlmsg_type == RTM_DELLINK)
+				{
+					if (found == mLinks.end())
+					{
+						return;
+					}
+
+					link = found->second.info;
+					mLinks.erase(found);
+					event = LinkEvent::REMOVED;
+				}
+				else if (found == mLinks.end())
+				{
+					readSpeed = true;
+					event = LinkEvent::ADDED;
+				}
+				else
+				{
+					const LinkInfo& previous = found->second.info;
+					if (previous.IsUp() != link.IsUp())
+					{
+						readSpeed = true;
+						event = link.IsUp() ? LinkEvent::UP : LinkEvent::DOWN;
+					}
+					else
+					{
+						// Speed only changes with carrier
+						link.speedMbps = previous.speedMbps;
+						notify = previous.name != link.name || previous.mtu != link.mtu ||
+							previous.flags != link.flags || previous.operState != link.operState ||
+							previous.master != link.master;
+
+						found->second.info = link;
+						found->second.dumpNumber = mDumpNumber;
+					}
+				}
+			}
+
+			// The speed file goes through the driver's ethtool handler, which can take a
+			// while, so it is read without holding up GetLinks and Find. Only the thread
+			// processing events writes mLinks, the entry is published once the speed is known.
+			if (readSpeed)
+			{
+				link.speedMbps = ReadSpeed(link.name);
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				Entry& entry = mLinks[link.index];
+				entry.info = link;
+				entry.dumpNumber = mDumpNumber;
+			}
+
+			if (notify && callback)
+			{
+				callback(event, link);
+			}
+#else
+			(void)header;
+#endif
+		}
+
+		void LinkMonitor::FinishDump(bool complete)
+		{
+			std::vector<LinkInfo> removed;
+			Callback callback;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (!mDumpPending)
+				{
+					return;
+				}
+				mDumpPending = false;
+				callback = mCallback;
+
+				if (!complete)
+				{
+					mResyncNeeded = true;
+					return;
+				}
+
+				// Links missing from a complete dump went away while events were being lost
+				for (auto entry = mLinks.begin(); entry != mLinks.end();)
+				{
+					if (entry->second.dumpNumber != mDumpNumber)
+					{
+						removed.push_back(entry->second.info);
+						entry = mLinks.erase(entry);
+					}
+					else
+					{
+						++entry;
+					}
+				}
+			}
+
+			if (callback)
+			{
+				for (const LinkInfo& link : removed)
+				{
+					callback(LinkEvent::REMOVED, link);
+				}
+			}
+		}
+
+		int64_t LinkMonitor::ReadSpeed(const std::string& name)
+		{
+			// Virtual and carrier-less devices fail the read with EINVAL or report -1
+			std::string path = "/sys/class/net/" + name + "/speed";
+			ProcfsFile file(path.c_str(), 64);
+			std::string_view text = file.Read();
+
+			uint64_t speed = 0;
+			while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+			{
+				text.remove_suffix(1);
+			}
+
+			if (text.empty() || !Procfs::ToUnsigned(text, speed))
+			{
+				return -1;
+			}
+
+			return static_cast<int64_t>(speed);
+		}
+
+		void LinkMonitor::Run()
+		{
+#ifdef __linux__
+			struct pollfd descriptors[2] {};
+			descriptors[0].fd = mSocket;
+			descriptors[0].events = POLLIN;
+			descriptors[1].fd = mWakeFd;
+			descriptors[1].events = POLLIN;
+
+			while (!mStopRequested)
+			{
+				int ready = poll(descriptors, 2, 1000);
+				if (ready > 0 && (descriptors[0].revents & POLLIN) != 0)
+				{
+					Receive(false);
+				}
+			}
+
+			uint64_t value = 0;
+			if (read(mWakeFd, &value, sizeof(value)) < 0)
+			{
+				// Nothing was written when the thread stopped on its own timeout
+			}
+#endif
+		}
+	}
+}
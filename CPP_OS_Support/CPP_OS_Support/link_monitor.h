@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		link_monitor.h
+//!
+//! @brief		rtnetlink interface table. One RTM_GETLINK dump builds the
+//!				table and an RTNLGRP_LINK subscription keeps it current, with
+//!				callbacks on link add/remove and up/down instead of polling.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Running flag
+#include <cstdint>						// Fixed width types
+#include <functional>					// Event callbacks
+#include <map>							// Interface table keyed by index
+#include <mutex>						// Table guard
+#include <string>						// Names
+#include <thread>						// Event thread
+#include <vector>						// Receive buffer, table copies
+//
+#ifdef __linux__
+#include <linux/if.h>
+#include <linux/if_arp.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_LINK_MONITOR			// Define the link monitor class.
+#define     CPP_LINK_MONITOR
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Counters from IFLA_STATS64 as of the last message about the link.
+		struct LinkCounters
+		{
+			uint64_t	rxBytes = 0;
+			uint64_t	rxPackets = 0;
+			uint64_t	rxErrors = 0;
+			uint64_t	rxDrops = 0;
+			uint64_t	txBytes = 0;
+			uint64_t	txPackets = 0;
+			uint64_t	txErrors = 0;
+			uint64_t	txDrops = 0;
+		};
+
+		/// @brief One entry of the interface table.
+		struct LinkInfo
+		{
+			int				index = 0;
+			std::string		name;
+			std::string		kind;				// IFLA_INFO_KIND: "veth", "bond", "vlan", "dummy"..., empty for physical devices
+			uint16_t		type = 0;			// ARPHRD_* hardware type
+			uint32_t		flags = 0;			// IFF_* flags
+			uint8_t			operState = 0;		// IF_OPER_* (RFC 2863)
+			uint32_t		mtu = 0;
+			int64_t			speedMbps = -1;		// -1 when the driver does not report one
+			int				master = 0;			// Index of the bond/bridge this link is enslaved to
+			LinkCounters	counters;
+
+			/// @brief Administratively up and carrying traffic
+			bool IsUp() const;
+		};
+
+		/// @brief What happened to a link.
+		enum class LinkEvent : uint8_t
+		{
+			ADDED,
+			REMOVED,
+			UP,
+			DOWN,
+			CHANGED,			// MTU, name, flags other than the up/down state
+		};
+
+		class LinkMonitor
+		{
+		public:
+			using Callback = std::function<void(LinkEvent event, const LinkInfo& link)>;
+
+			LinkMonitor();
+			~LinkMonitor();
+			LinkMonitor(const LinkMonitor&) = delete;
+			LinkMonitor& operator=(const LinkMonitor&) = delete;
+			int			Open();
+			void		Close();
+			void		SetCallback(Callback callback);
+			int			Refresh();
+			int			ProcessEvents(int timeoutMs);
+			int			Start();
+			void		Stop();
+			bool		IsRunning() const;
+			int			GetLinks(std::vector<LinkInfo>& links);
+			bool		FindLink(const std::string& name, LinkInfo& link);
+			int			GetDescriptor() const;
+		protected:
+		private:
+			int			RequestDump();
+			int			Receive(bool untilDone);
+			void		HandleMessage(const struct nlmsghdr* header);
+			void		FinishDump(bool complete);
+			static int64_t ReadSpeed(const std::string& name);
+			void		Run();
+
+			/// @brief Table entry plus the dump it was last listed in
+			struct Entry
+			{
+				LinkInfo	info;
+				uint64_t	dumpNumber = 0;
+			};
+
+			int							mSocket;
+			int							mWakeFd;			// Wakes the event thread for Stop
+			uint32_t					mSequence;
+			std::vector<char>			mBuffer;
+			std::mutex					mMutex;
+			std::map<int, Entry>		mLinks;
+			uint64_t					mDumpNumber;
+			bool						mDumpPending;		// A dump was requested and has not finished
+			bool						mResyncNeeded;		// Events were lost, the table must be re-dumped
+			Callback					mCallback;
+			std::thread					mThread;
+			std::atomic<bool>			mStopRequested;
+			std::atomic<bool>			mRunning;
+		};
+	}
+}
+#endif
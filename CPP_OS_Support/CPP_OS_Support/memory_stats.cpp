@@ -0,0 +1,292 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		memory_stats.cpp
+//!
+//! @brief		Implementation of the memory stats class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"memory_stats.h"			// Memory Stats Class
+#include	<chrono>					// Sample timestamps
+#include	<cstddef>					// size_t
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief A meminfo key and the sample field it fills, values are KiB unless the scale says otherwise
+		struct MeminfoField
+		{
+			std::string_view		key;
+			uint64_t MemorySample::* field;
+			uint64_t				scale;
+		};
+
+		/// @brief A vmstat key and the counter it adds to, several keys may add to one counter
+		struct VmstatField
+		{
+			std::string_view				key;
+			uint64_t MemoryEventCounters::*	field;
+		};
+
+		// Both tables are in the order the kernel prints the keys, see MatchField
+		static constexpr MeminfoField MEMINFO_FIELDS[] =
+		{
+			{ "MemTotal", &MemorySample::totalBytes, 1024 },
+			{ "MemFree", &MemorySample::freeBytes, 1024 },
+			{ "MemAvailable", &MemorySample::availableBytes, 1024 },
+			{ "Buffers", &MemorySample::buffersBytes, 1024 },
+			{ "Cached", &MemorySample::cachedBytes, 1024 },
+			{ "SwapCached", &MemorySample::swapCachedBytes, 1024 },
+			{ "Active", &MemorySample::activeBytes, 1024 },
+			{ "Inactive", &MemorySample::inactiveBytes, 1024 },
+			{ "Active(file)", &MemorySample::activeFileBytes, 1024 },
+			{ "Inactive(file)", &MemorySample::inactiveFileBytes, 1024 },
+			{ "SwapTotal", &MemorySample::swapTotalBytes, 1024 },
+			{ "SwapFree", &MemorySample::swapFreeBytes, 1024 },
+			{ "Dirty", &MemorySample::dirtyBytes, 1024 },
+			{ "Writeback", &MemorySample::writebackBytes, 1024 },
+			{ "AnonPages", &MemorySample::anonBytes, 1024 },
+			{ "Mapped", &MemorySample::mappedBytes, 1024 },
+			{ "Shmem", &MemorySample::shmemBytes, 1024 },
+			{ "Slab", &MemorySample::slabBytes, 1024 },
+			{ "SReclaimable", &MemorySample::slabReclaimableBytes, 1024 },
+			{ "SUnreclaim", &MemorySample::slabUnreclaimableBytes, 1024 },
+			{ "KernelStack", &MemorySample::kernelStackBytes, 1024 },
+			{ "PageTables", &MemorySample::pageTablesBytes, 1024 },
+			{ "CommitLimit", &MemorySample::commitLimitBytes, 1024 },
+			{ "Committed_AS", &MemorySample::committedBytes, 1024 },
+			{ "AnonHugePages", &MemorySample::anonHugePagesBytes, 1024 },
+			{ "HugePages_Total", &MemorySample::hugePagesTotal, 1 },
+			{ "HugePages_Free", &MemorySample::hugePagesFree, 1 },
+			{ "HugePages_Rsvd", &MemorySample::hugePagesReserved, 1 },
+			{ "HugePages_Surp", &MemorySample::hugePagesSurplus, 1 },
+			{ "Hugepagesize", &MemorySample::hugePageSizeBytes, 1024 },
+		};
+
+		static constexpr VmstatField VMSTAT_FIELDS[] =
+		{
+			{ "workingset_refault", &MemoryEventCounters::refaults },			// Before 5.9
+			{ "workingset_refault_anon", &MemoryEventCounters::refaults },
+			{ "workingset_refault_file", &MemoryEventCounters::refaults },
+			{ "pgpgin", &MemoryEventCounters::pagedInKilobytes },
+			{ "pgpgout", &MemoryEventCounters::pagedOutKilobytes },
+			{ "pswpin", &MemoryEventCounters::swapIns },
+			{ "pswpout", &MemoryEventCounters::swapOuts },
+			{ "pgfault", &MemoryEventCounters::pageFaults },
+			{ "pgmajfault", &MemoryEventCounters::majorFaults },
+			{ "pgsteal_kswapd", &MemoryEventCounters::stolenKswapd },
+			{ "pgsteal_direct", &MemoryEventCounters::stolenDirect },
+			{ "pgscan_kswapd", &MemoryEventCounters::scannedKswapd },
+			{ "pgscan_direct", &MemoryEventCounters::scannedDirect },
+			{ "oom_kill", &MemoryEventCounters::oomKills },
+		};
+
+		/// @brief Table entry for a key. The kernel prints keys in a fixed order, so
+		///			the entry after the previous match is tried first and a full
+		///			pass costs about one compare per wanted line.
+		template <typename Field, size_t N>
+		static const Field* MatchField(const Field (&fields)[N], std::string_view key, size_t& next)
+		{
+			if (next < N && fields[next].key == key)
+			{
+				return &fields[next++];
+			}
+
+			for (size_t i = 0; i < N; i++)
+			{
+				if (fields[i].key == key)
+				{
+					next = i + 1;
+					return &fields[i];
+				}
+			}
+
+			return nullptr;
+		}
+
+		MemoryStats::MemoryStats() :
+			mMeminfoFile("/proc/meminfo", 8 * 1024),
+			mVmstatFile("/proc/vmstat", 16 * 1024)
+		{
+
+		}
+
+		MemoryStats::~MemoryStats()
+		{
+
+		}
+
+		int MemoryStats::Sample()
+		{
+			int result = -1;
+
+#ifdef __linux__
+			// Linux implementation, one read of each file
+			std::string_view meminfo = mMeminfoFile.Read();
+			std::string_view vmstat = mVmstatFile.Read();
+			if (!meminfo.empty())
+			{
+				const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+				result = Update(meminfo, vmstat, now);
+			}
+
+#endif
+
+			return result;
+		}
+
+		int MemoryStats::Update(std::string_view meminfo, std::string_view vmstat, uint64_t timestampNs)
+		{
+			MemorySample sample;
+			if (ParseMeminfo(meminfo, sample) != 0)
+			{
+				return -1;
+			}
+
+			// Without vmstat (restricted /proc) the breakdown is still reported, without rates
+			const bool hasCounters = ParseVmstat(vmstat, sample.counters) == 0;
+			sample.timestampNs = timestampNs;
+
+			if (hasCounters && mLatest.timestampNs != 0 && timestampNs > mLatest.timestampNs)
+			{
+				const double seconds = static_cast<double>(timestampNs - mLatest.timestampNs) / 1e9;
+
+				// A counter that went backwards was reset, it reports no rate for this interval
+				auto delta = [](uint64_t before, uint64_t after) -> double
+				{
+					return after >= before ? static_cast<double>(after - before) : 0.0;
+				};
+
+				const MemoryEventCounters& previous = mLatest.counters;
+				const MemoryEventCounters& current = sample.counters;
+				const double scanned = delta(previous.scannedKswapd, current.scannedKswapd) +
+					delta(previous.scannedDirect, current.scannedDirect);
+				const double stolen = delta(previous.stolenKswapd, current.stolenKswapd) +
+					delta(previous.stolenDirect, current.stolenDirect);
+
+				sample.pageFaultsPerSecond = delta(previous.pageFaults, current.pageFaults) / seconds;
+				sample.majorFaultsPerSecond = delta(previous.majorFaults, current.majorFaults) / seconds;
+				sample.pagedInKilobytesPerSecond = delta(previous.pagedInKilobytes, current.pagedInKilobytes) / seconds;
+				sample.pagedOutKilobytesPerSecond = delta(previous.pagedOutKilobytes, current.pagedOutKilobytes) / seconds;
+				sample.swapInsPerSecond = delta(previous.swapIns, current.swapIns) / seconds;
+				sample.swapOutsPerSecond = delta(previous.swapOuts, current.swapOuts) / seconds;
+				sample.scannedKswapdPerSecond = delta(previous.scannedKswapd, current.scannedKswapd) / seconds;
+				sample.scannedDirectPerSecond = delta(previous.scannedDirect, current.scannedDirect) / seconds;
+				sample.stolenPerSecond = stolen / seconds;
+				sample.allocationStallsPerSecond = delta(previous.allocationStalls, current.allocationStalls) / seconds;
+				sample.refaultsPerSecond = delta(previous.refaults, current.refaults) / seconds;
+				sample.oomKillsPerSecond = delta(previous.oomKills, current.oomKills) / seconds;
+				sample.reclaimEfficiency = scanned > 0.0 ? stolen / scanned : 0.0;
+				sample.intervalNs = timestampNs - mLatest.timestampNs;
+				sample.hasRates = true;
+			}
+
+			mLatest = sample;
+			return 0;
+		}
+
+		const MemorySample& MemoryStats::GetLatest() const
+		{
+			return mLatest;
+		}
+
+		int MemoryStats::ParseMeminfo(std::string_view meminfo, MemorySample& sample)
+		{
+			bool hasTotal = false;
+			bool hasAvailable = false;
+			size_t next = 0;
+
+			while (!meminfo.empty())
+			{
+				std::string_view line = Procfs::NextLine(meminfo);
+				const size_t colon = line.find(':');
+				if (colon == std::string_view::npos)
+				{
+					continue;
+				}
+
+				const MeminfoField* field = MatchField(MEMINFO_FIELDS, line.substr(0, colon), next);
+				if (field == nullptr)
+				{
+					continue;
+				}
+
+				uint64_t value = 0;
+				Procfs::ParseUnsigned(line.data() + colon + 1, line.data() + line.size(), value);
+				sample.*(field->field) = value * field->scale;
+				hasTotal = hasTotal || field->field == &MemorySample::totalBytes;
+				hasAvailable = hasAvailable || field->field == &MemorySample::availableBytes;
+			}
+
+			if (!hasTotal)
+			{
+				return -1;
+			}
+
+			// MemAvailable needs 3.14, older kernels get the usual estimate
+			if (!hasAvailable)
+			{
+				sample.availableBytes = sample.freeBytes + sample.buffersBytes + sample.cachedBytes + sample.slabReclaimableBytes;
+			}
+
+			sample.availableBytes = sample.availableBytes < sample.totalBytes ? sample.availableBytes : sample.totalBytes;
+			sample.usedBytes = sample.totalBytes - sample.availableBytes;
+			sample.swapUsedBytes = sample.swapTotalBytes > sample.swapFreeBytes ? sample.swapTotalBytes - sample.swapFreeBytes : 0;
+			return 0;
+		}
+
+		int MemoryStats::ParseVmstat(std::string_view vmstat, MemoryEventCounters& counters)
+		{
+			if (vmstat.empty())
+			{
+				return -1;
+			}
+
+			counters = MemoryEventCounters();
+			size_t next = 0;
+
+			while (!vmstat.empty())
+			{
+				std::string_view line = Procfs::NextLine(vmstat);
+				const size_t space = line.find(' ');
+				if (space == std::string_view::npos)
+				{
+					continue;
+				}
+
+				const std::string_view key = line.substr(0, space);
+				uint64_t value = 0;
+
+				// One line per zone (allocstall_dma32, allocstall_normal...), summed
+				if (key.substr(0, 11) == "allocstall_")
+				{
+					Procfs::ParseUnsigned(line.data() + space, line.data() + line.size(), value);
+					counters.allocationStalls += value;
+					continue;
+				}
+
+				const VmstatField* field = MatchField(VMSTAT_FIELDS, key, next);
+				if (field == nullptr)
+				{
+					continue;
+				}
+
+				Procfs::ParseUnsigned(line.data() + space, line.data() + line.size(), value);
+				counters.*(field->field) += value;
+			}
+
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		memory_stats.h
+//!
+//! @brief		Memory breakdown from one pass over /proc/meminfo and paging
+//!				and reclaim rates from the deltas between /proc/vmstat
+//!				samples. The figures that show memory pressure building up
+//!				before latency does: available memory, dirty and writeback
+//!				pages, swap traffic, reclaim scans and allocation stalls.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Fixed width types
+#include <string_view>					// Parsing
+#include "procfs_reader.h"				// Persistent proc file handles
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_MEMORY_STATS			// Define the memory stats class.
+#define     CPP_MEMORY_STATS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Cumulative event counters from /proc/vmstat, in pages unless noted.
+		struct MemoryEventCounters
+		{
+			uint64_t	pageFaults = 0;				// Minor and major
+			uint64_t	majorFaults = 0;			// Faults that waited for I/O
+			uint64_t	pagedInKilobytes = 0;		// Block I/O reads
+			uint64_t	pagedOutKilobytes = 0;		// Block I/O writes
+			uint64_t	swapIns = 0;
+			uint64_t	swapOuts = 0;
+			uint64_t	scannedKswapd = 0;			// Background reclaim
+			uint64_t	scannedDirect = 0;			// Reclaim done by the allocating task itself
+			uint64_t	stolenKswapd = 0;
+			uint64_t	stolenDirect = 0;
+			uint64_t	allocationStalls = 0;		// Allocations that entered direct reclaim, all zones
+			uint64_t	refaults = 0;				// Evicted pages faulted back in, thrashing
+			uint64_t	oomKills = 0;
+		};
+
+		/// @brief Memory breakdown in bytes, huge page counts excepted, and event rates
+		///			per second over the interval since the previous sample.
+		struct MemorySample
+		{
+			uint64_t	totalBytes = 0;
+			uint64_t	freeBytes = 0;				// Unused, page cache not counted
+			uint64_t	availableBytes = 0;			// Allocatable without swapping, cache included
+			uint64_t	usedBytes = 0;				// totalBytes - availableBytes
+			uint64_t	buffersBytes = 0;
+			uint64_t	cachedBytes = 0;			// Page cache, shmem included
+			uint64_t	swapCachedBytes = 0;
+			uint64_t	activeBytes = 0;
+			uint64_t	inactiveBytes = 0;
+			uint64_t	activeFileBytes = 0;
+			uint64_t	inactiveFileBytes = 0;
+			uint64_t	anonBytes = 0;
+			uint64_t	mappedBytes = 0;
+			uint64_t	shmemBytes = 0;
+			uint64_t	dirtyBytes = 0;				// Waiting to be written back
+			uint64_t	writebackBytes = 0;			// Being written back now
+			uint64_t	slabBytes = 0;
+			uint64_t	slabReclaimableBytes = 0;
+			uint64_t	slabUnreclaimableBytes = 0;
+			uint64_t	kernelStackBytes = 0;
+			uint64_t	pageTablesBytes = 0;
+			uint64_t	swapTotalBytes = 0;
+			uint64_t	swapFreeBytes = 0;
+			uint64_t	swapUsedBytes = 0;
+			uint64_t	commitLimitBytes = 0;
+			uint64_t	committedBytes = 0;			// Committed_AS
+			uint64_t	anonHugePagesBytes = 0;		// Transparent huge pages
+			uint64_t	hugePagesTotal = 0;			// hugetlbfs pool, in pages
+			uint64_t	hugePagesFree = 0;
+			uint64_t	hugePagesReserved = 0;
+			uint64_t	hugePagesSurplus = 0;
+			uint64_t	hugePageSizeBytes = 0;
+
+			MemoryEventCounters	counters;
+			double		pageFaultsPerSecond = 0.0;
+			double		majorFaultsPerSecond = 0.0;
+			double		pagedInKilobytesPerSecond = 0.0;
+			double		pagedOutKilobytesPerSecond = 0.0;
+			double		swapInsPerSecond = 0.0;
+			double		swapOutsPerSecond = 0.0;
+			double		scannedKswapdPerSecond = 0.0;
+			double		scannedDirectPerSecond = 0.0;
+			double		stolenPerSecond = 0.0;		// Pages reclaimed, both paths
+			double		allocationStallsPerSecond = 0.0;
+			double		refaultsPerSecond = 0.0;
+			double		oomKillsPerSecond = 0.0;
+			double		reclaimEfficiency = 0.0;	// Stolen per scanned over the interval, 0 without scans
+			uint64_t	timestampNs = 0;			// Steady clock time of the sample
+			uint64_t	intervalNs = 0;				// Interval the rates cover, 0 for the first sample
+			bool		hasRates = false;
+		};
+
+		class MemoryStats
+		{
+		public:
+			MemoryStats();
+			~MemoryStats();
+			int			Sample();
+			int			Update(std::string_view meminfo, std::string_view vmstat, uint64_t timestampNs);
+			const MemorySample& GetLatest() const;
+			static int	ParseMeminfo(std::string_view meminfo, MemorySample& sample);
+			static int	ParseVmstat(std::string_view vmstat, MemoryEventCounters& counters);
+		protected:
+		private:
+			ProcfsFile		mMeminfoFile;
+			ProcfsFile		mVmstatFile;
+			MemorySample	mLatest;
+		};
+	}
+}
+#endif
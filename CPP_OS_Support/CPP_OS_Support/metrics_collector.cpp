@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		metrics_collector.cpp
+//!
+//! @brief		Implementation of the metrics collector class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"metrics_collector.h"		// Metrics Collector Class
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		MetricsCollector::MetricsCollector()
+		{
+			mStopRequested = false;
+			mRunning = false;
+			mPeriod = std::chrono::milliseconds(1000);
+			mRecordSize = 0;
+		}
+
+		MetricsCollector::~MetricsCollector()
+		{
+			Stop();
+		}
+
+		int MetricsCollector::SetMounts(const std::vector<std::string>& mounts)
+		{
+			if (mRunning)
+			{
+				return -1;
+			}
+
+			return mSupport.SetSnapshotMounts(mounts);
+		}
+
+		int MetricsCollector::EnableSharedMemory(const std::string& name)
+		{
+			if (mRunning || name.empty())
+			{
+				return -1;
+			}
+
+			mSharedName = name;
+			return 0;
+		}
+
+		int MetricsCollector::EnableRecording(const std::string& path, uint64_t fileSizeBytes)
+		{
+			if (mRunning || path.empty())
+			{
+				return -1;
+			}
+
+			mRecordPath = path;
+			mRecordSize = fileSizeBytes;
+			return 0;
+		}
+
+		int MetricsCollector::Start(std::chrono::milliseconds period)
+		{
+			if (mRunning)
+			{
+				return 0;
+			}
+
+			mPeriod = period.count() > 0 ? period : std::chrono::milliseconds(1);
+
+			if (!mSharedName.empty() &&
+				mPublisher.Open(mSharedName, static_cast<uint64_t>(std::chrono::nanoseconds(mPeriod).count())) != 0)
+			{
+				return -1;
+			}
+
+			if (!mRecordPath.empty() && mRecorder.OpenForSnapshots(mRecordPath, mRecordSize) != 0)
+			{
+				mPublisher.Close();
+				return -1;
+			}
+
+			// Publish one snapshot before returning so readers never see an empty one
+			SystemSnapshot snapshot;
+			if (mSupport.Capture(snapshot) != 0)
+			{
+				mPublisher.Close();
+				mRecorder.Close();
+				return -1;
+			}
+			mLatest.Store(snapshot);
+			mPublisher.Publish(snapshot);
+
+			{
+				std::lock_guard<std::mutex> lock(mWakeMutex);
+				mStopRequested = false;
+			}
+			mRunning = true;
+			mThread = std::thread(&MetricsCollector::Run, this);
+
+			return 0;
+		}
+
+		void MetricsCollector::Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mWakeMutex);
+				mStopRequested = true;
+			}
+			mWakeCondition.notify_all();
+
+			if (mThread.joinable())
+			{
+				mThread.join();
+			}
+
+			mPublisher.Close();
+			mRecorder.Close();
+			mRunning = false;
+		}
+
+		bool MetricsCollector::IsRunning() const
+		{
+			return mRunning;
+		}
+
+		SystemSnapshot MetricsCollector::GetSnapshot() const
+		{
+			return mLatest.Load();
+		}
+
+		bool MetricsCollector::TryGetSnapshot(SystemSnapshot& snapshot) const
+		{
+			return mLatest.TryLoad(snapshot);
+		}
+
+		uint64_t MetricsCollector::GetVersion() const
+		{
+			return mLatest.GetVersion();
+		}
+
+		void MetricsCollector::Run()
+		{
+			SystemSnapshot snapshot;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mWakeMutex);
+					if (mWakeCondition.wait_for(lock, mPeriod, [this] { return mStopRequested; }))
+					{
+						break;
+					}
+				}
+
+				// A partial capture is still published, its failed fields are zeroed
+				mSupport.Capture(snapshot);
+				mLatest.Store(snapshot);
+				mPublisher.Publish(snapshot);
+
+				// The seed capture in Start holds since-boot CPU figures and is not recorded
+				if (mRecorder.IsOpen())
+				{
+					mRecorder.Record(snapshot);
+				}
+			}
+		}
+	}
+}
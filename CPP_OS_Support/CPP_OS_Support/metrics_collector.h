@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		metrics_collector.h
+//!
+//! @brief		Single background collector that captures a SystemSnapshot
+//!				at a fixed period and publishes it through a seqlock, so any
+//!				number of threads can read the latest snapshot without a mutex.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Running flag
+#include <chrono>						// Collection period
+#include <condition_variable>			// Prompt shutdown of the collector
+#include <cstdint>						// Fixed width types
+#include <mutex>						// Condition variable guard
+#include <string>						// Mount paths
+#include <thread>						// Collector thread
+#include <vector>						// Mount paths
+#include "os_support.h"					// Capture
+#include "seqlock.h"					// Publishing the latest snapshot
+#include "shared_metrics.h"				// Optional cross-process publishing
+#include "metrics_recorder.h"			// Optional on-disk history
+#include "system_snapshot.h"			// Published type
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_METRICS_COLLECTOR		// Define the metrics collector class.
+#define     CPP_METRICS_COLLECTOR
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief OS_Support instances are single threaded. Share one MetricsCollector between
+		///			threads instead: it owns the only OS_Support doing kernel work and readers
+		///			copy the published snapshot wait-free with respect to each other.
+		class MetricsCollector
+		{
+		public:
+			MetricsCollector();
+			~MetricsCollector();
+			MetricsCollector(const MetricsCollector&) = delete;
+			MetricsCollector& operator=(const MetricsCollector&) = delete;
+			int			SetMounts(const std::vector<std::string>& mounts);
+			int			EnableSharedMemory(const std::string& name = SHARED_METRICS_DEFAULT_NAME);
+			int			EnableRecording(const std::string& path, uint64_t fileSizeBytes);
+			int			Start(std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+			void		Stop();
+			bool		IsRunning() const;
+			SystemSnapshot GetSnapshot() const;
+			bool		TryGetSnapshot(SystemSnapshot& snapshot) const;
+			uint64_t	GetVersion() const;
+		protected:
+		private:
+			void		Run();
+
+			OS_Support					mSupport;		// Only touched by the collector thread once started
+			std::thread					mThread;
+			std::mutex					mWakeMutex;
+			std::condition_variable		mWakeCondition;
+			bool						mStopRequested;
+			std::atomic<bool>			mRunning;
+			std::chrono::milliseconds	mPeriod;
+			SeqLock<SystemSnapshot>		mLatest;
+			SharedMetricsPublisher		mPublisher;
+			std::string					mSharedName;	// Empty when shared memory is disabled
+			MetricsRecorder				mRecorder;
+			std::string					mRecordPath;	// Empty when recording is disabled
+			uint64_t					mRecordSize;
+		};
+	}
+}
+#endif
@@ -0,0 +1,737 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		metrics_recorder.cpp
+//!
+//! @brief		Implementation of the metrics recorder classes
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"metrics_recorder.h"		// Metrics Recorder Classes
+#include	<algorithm>					// std::min, std::sort
+#include	<bit>						// std::countl_zero, std::countr_zero, std::bit_cast
+#include	<chrono>					// Default record time
+#include	<cmath>						// std::llround
+#include	<cstdio>					// snprintf
+#include	<cstring>					// memset, strncmp
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Header rounded up to a page so blocks stay page aligned
+		static constexpr uint32_t RECORDER_HEADER_SIZE = 4096;
+
+		/// @brief Marks a series that has no leading/trailing zero window yet
+		static constexpr uint8_t RECORDER_NO_WINDOW = 0xFF;
+
+		static_assert(sizeof(RecorderFileHeader) <= RECORDER_HEADER_SIZE, "recorder header must fit its page");
+		static_assert(sizeof(RecorderBlockHeader) == 32, "recorder block header layout changed");
+
+		/// @brief Columns recorded from a SystemSnapshot and the precision kept for each
+		static constexpr size_t RECORDER_SNAPSHOT_BASE_SERIES = 6;
+
+		/// @brief MSB-first reader over a block's bit stream
+		class BitReader
+		{
+		public:
+			BitReader(const uint8_t* data, uint64_t bitCount) : mData(data), mBitCount(bitCount), mPosition(0) {}
+
+			bool Read(unsigned int bits, uint64_t& value)
+			{
+				if (mPosition + bits > mBitCount)
+				{
+					return false;
+				}
+
+				value = 0;
+				while (bits > 0)
+				{
+					const unsigned int offset = static_cast<unsigned int>(mPosition & 7);
+					const unsigned int take = std::min(8u - offset, bits);
+					const uint8_t byte = mData[mPosition >> 3];
+					value = (value << take) | ((byte >> (8u - offset - take)) & ((1u << take) - 1u));
+					bits -= take;
+					mPosition += take;
+				}
+
+				return true;
+			}
+
+		private:
+			const uint8_t*	mData;
+			uint64_t		mBitCount;
+			uint64_t		mPosition;
+		};
+
+		/// @brief Bits needed to encode one sample in the worst case
+		static uint64_t WorstCaseBits(size_t seriesCount)
+		{
+			return 4 + 64 + seriesCount * (2 + 5 + 6 + 64);
+		}
+
+		MetricsRecorder::MetricsRecorder()
+		{
+			mFd = -1;
+			mMapping = nullptr;
+			mMappingSize = 0;
+			mHeader = nullptr;
+			mBlock = nullptr;
+			mPayload = nullptr;
+			mBitPosition = 0;
+			mPayloadBits = 0;
+			mSampleCount = 0;
+			mPreviousTimeMs = 0;
+			mPreviousDelta = 0;
+			mBitsWritten = 0;
+			mSamplesWritten = 0;
+		}
+
+		MetricsRecorder::~MetricsRecorder()
+		{
+			Close();
+		}
+
+		int MetricsRecorder::Open(const std::string& path, const std::vector<RecorderSeries>& series, uint64_t fileSizeBytes)
+		{
+			Close();
+
+#ifndef _WIN32
+			if (series.empty() || series.size() > RECORDER_MAX_SERIES ||
+				fileSizeBytes < RECORDER_HEADER_SIZE + 2ull * RECORDER_BLOCK_SIZE)
+			{
+				return -1;
+			}
+
+			const uint32_t blockCount = static_cast<uint32_t>((fileSizeBytes - RECORDER_HEADER_SIZE) / RECORDER_BLOCK_SIZE);
+			const size_t size = RECORDER_HEADER_SIZE + static_cast<size_t>(blockCount) * RECORDER_BLOCK_SIZE;
+
+			int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+			if (fd < 0)
+			{
+				return -1;
+			}
+
+			// One writer per file, a second recorder would interleave blocks
+			if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+			{
+				close(fd);
+				return -1;
+			}
+
+			struct stat info {};
+			const bool sameSize = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) == size;
+			if (!sameSize && (ftruncate(fd, 0) != 0 || ftruncate(fd, static_cast<off_t>(size)) != 0))
+			{
+				close(fd);
+				return -1;
+			}
+
+			void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mapping == MAP_FAILED)
+			{
+				close(fd);
+				return -1;
+			}
+
+			mFd = fd;
+			mMapping = static_cast<uint8_t*>(mapping);
+			mMappingSize = size;
+			mHeader = reinterpret_cast<RecorderFileHeader*>(mMapping);
+
+			// An existing file with the same layout keeps its history, anything else starts over
+			bool compatible = sameSize && mHeader->magic.load(std::memory_order_acquire) == RECORDER_MAGIC &&
+				mHeader->version == RECORDER_LAYOUT_VERSION && mHeader->headerSize == RECORDER_HEADER_SIZE &&
+				mHeader->blockSize == RECORDER_BLOCK_SIZE && mHeader->blockCount == blockCount &&
+				mHeader->seriesCount == series.size();
+			for (size_t i = 0; compatible && i < series.size(); i++)
+			{
+				compatible = std::strncmp(mHeader->series[i].name, series[i].name, RECORDER_SERIES_NAME_LENGTH) == 0 &&
+					mHeader->series[i].scale == series[i].scale;
+			}
+
+			if (!compatible)
+			{
+				std::memset(mMapping, 0, size);
+				mHeader->version = RECORDER_LAYOUT_VERSION;
+				mHeader->headerSize = RECORDER_HEADER_SIZE;
+				mHeader->blockSize = RECORDER_BLOCK_SIZE;
+				mHeader->blockCount = blockCount;
+				mHeader->seriesCount = static_cast<uint32_t>(series.size());
+				mHeader->nextSequence.store(1, std::memory_order_relaxed);
+				for (size_t i = 0; i < series.size(); i++)
+				{
+					mHeader->series[i] = series[i];
+					mHeader->series[i].name[RECORDER_SERIES_NAME_LENGTH - 1] = '\0';
+				}
+				mHeader->magic.store(RECORDER_MAGIC, std::memory_order_release);
+			}
+
+			// A reopened file continues in a fresh block, the encoder state of the last one is gone
+			mBlock = nullptr;
+			return 0;
+#else
+			(void)path;
+			(void)series;
+			(void)fileSizeBytes;
+			return -1;
+#endif
+		}
+
+		int MetricsRecorder::OpenForSnapshots(const std::string& path, uint64_t fileSizeBytes)
+		{
+			std::vector<RecorderSeries> series;
+			GetSnapshotSeries(series);
+			return Open(path, series, fileSizeBytes);
+		}
+
+		void MetricsRecorder::Close()
+		{
+#ifndef _WIN32
+			if (mMapping != nullptr)
+			{
+				munmap(mMapping, mMappingSize);
+			}
+
+			if (mFd >= 0)
+			{
+				close(mFd);
+			}
+#endif
+
+			mFd = -1;
+			mMapping = nullptr;
+			mMappingSize = 0;
+			mHeader = nullptr;
+			mBlock = nullptr;
+			mPayload = nullptr;
+		}
+
+		bool MetricsRecorder::IsOpen() const
+		{
+			return mHeader != nullptr;
+		}
+
+		int MetricsRecorder::Append(uint64_t timeMs, const double* values, size_t count)
+		{
+			if (mHeader == nullptr || count != mHeader->seriesCount)
+			{
+				return -1;
+			}
+
+			if (mBlock == nullptr || mBitPosition + WorstCaseBits(count) > mPayloadBits)
+			{
+				StartBlock();
+			}
+
+			const uint64_t startPosition = mBitPosition;
+
+			if (mSampleCount == 0)
+			{
+				// The first sample of a block is stored raw so every block decodes on its own
+				WriteBits(timeMs, 64);
+				mPreviousDelta = 0;
+				mBlock->firstTimeMs = timeMs;
+			}
+			else
+			{
+				// Delta-of-delta in the Gorilla buckets, regular sampling costs one bit
+				const int64_t delta = static_cast<int64_t>(timeMs - mPreviousTimeMs);
+				const int64_t deltaOfDelta = delta - mPreviousDelta;
+				mPreviousDelta = delta;
+
+				if (deltaOfDelta == 0)
+				{
+					WriteBits(0, 1);
+				}
+				else if (deltaOfDelta >= -64 && deltaOfDelta <= 63)
+				{
+					WriteBits(0b10, 2);
+					WriteBits(static_cast<uint64_t>(deltaOfDelta), 7);
+				}
+				else if (deltaOfDelta >= -256 && deltaOfDelta <= 255)
+				{
+					WriteBits(0b110, 3);
+					WriteBits(static_cast<uint64_t>(deltaOfDelta), 9);
+				}
+				else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047)
+				{
+					WriteBits(0b1110, 4);
+					WriteBits(static_cast<uint64_t>(deltaOfDelta), 12);
+				}
+				else
+				{
+					WriteBits(0b1111, 4);
+					WriteBits(static_cast<uint64_t>(deltaOfDelta), 64);
+				}
+			}
+			mPreviousTimeMs = timeMs;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const double quantised = static_cast<double>(std::llround(values[i] * mHeader->series[i].scale));
+				const uint64_t bits = std::bit_cast<uint64_t>(quantised);
+
+				if (mSampleCount == 0)
+				{
+					WriteBits(bits, 64);
+					mPreviousValues[i] = bits;
+					mPreviousLeading[i] = RECORDER_NO_WINDOW;
+					mPreviousTrailing[i] = 0;
+					continue;
+				}
+
+				const uint64_t xorValue = bits ^ mPreviousValues[i];
+				mPreviousValues[i] = bits;
+
+				if (xorValue == 0)
+				{
+					WriteBits(0, 1);
+					continue;
+				}
+
+				uint8_t leading = static_cast<uint8_t>(std::min(std::countl_zero(xorValue), 31));
+				uint8_t trailing = static_cast<uint8_t>(std::countr_zero(xorValue));
+
+				// Reuse the previous window when the meaningful bits fit inside it
+				if (mPreviousLeading[i] != RECORDER_NO_WINDOW && leading >= mPreviousLeading[i] && trailing >= mPreviousTrailing[i])
+				{
+					const unsigned int length = 64u - mPreviousLeading[i] - mPreviousTrailing[i];
+					WriteBits(0b10, 2);
+					WriteBits(xorValue >> mPreviousTrailing[i], length);
+				}
+				else
+				{
+					const unsigned int length = 64u - leading - trailing;
+					WriteBits(0b11, 2);
+					WriteBits(leading, 5);
+					WriteBits(length - 1, 6);
+					WriteBits(xorValue >> trailing, length);
+					mPreviousLeading[i] = leading;
+					mPreviousTrailing[i] = trailing;
+				}
+			}
+
+			// Publish after the bits, a concurrent reader only decodes complete samples
+			mSampleCount++;
+			mBlock->lastTimeMs.store(timeMs, std::memory_order_relaxed);
+			mBlock->sampleCount.store(mSampleCount, std::memory_order_release);
+
+			mBitsWritten += mBitPosition - startPosition;
+			mSamplesWritten++;
+			return 0;
+		}
+
+		int MetricsRecorder::Record(const SystemSnapshot& snapshot, uint64_t timeMs)
+		{
+			if (timeMs == 0)
+			{
+				timeMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count());
+			}
+
+			double values[RECORDER_SNAPSHOT_BASE_SERIES + SNAPSHOT_MAX_MOUNTS] = {};
+			values[0] = snapshot.cpu.usage;
+			values[1] = snapshot.cpu.user;
+			values[2] = snapshot.cpu.system;
+			values[3] = snapshot.cpu.iowait;
+			values[4] = static_cast<double>(snapshot.usedRamBytes);
+			values[5] = static_cast<double>(snapshot.freeRamBytes);
+			for (size_t i = 0; i < snapshot.diskCount && i < SNAPSHOT_MAX_MOUNTS; i++)
+			{
+				values[RECORDER_SNAPSHOT_BASE_SERIES + i] = snapshot.disks[i].valid ? static_cast<double>(snapshot.disks[i].freeBytes) : 0.0;
+			}
+
+			return Append(timeMs, values, RECORDER_SNAPSHOT_BASE_SERIES + SNAPSHOT_MAX_MOUNTS);
+		}
+
+		int MetricsRecorder::Flush()
+		{
+#ifndef _WIN32
+			if (mMapping == nullptr)
+			{
+				return -1;
+			}
+
+			return msync(mMapping, mMappingSize, MS_ASYNC);
+#else
+			return -1;
+#endif
+		}
+
+		uint64_t MetricsRecorder::GetBitsWritten() const
+		{
+			return mBitsWritten;
+		}
+
+		uint64_t MetricsRecorder::GetSamplesWritten() const
+		{
+			return mSamplesWritten;
+		}
+
+		void MetricsRecorder::GetSnapshotSeries(std::vector<RecorderSeries>& series)
+		{
+			// Percentages kept to 0.01, memory to KiB and disk space to MiB
+			static const struct
+			{
+				const char*	name;
+				double		scale;
+			} baseSeries[RECORDER_SNAPSHOT_BASE_SERIES] =
+			{
+				{ "cpu.usage", 100.0 },
+				{ "cpu.user", 100.0 },
+				{ "cpu.system", 100.0 },
+				{ "cpu.iowait", 100.0 },
+				{ "ram.used", 1.0 / 1024.0 },
+				{ "ram.free", 1.0 / 1024.0 },
+			};
+
+			series.clear();
+			for (const auto& base : baseSeries)
+			{
+				series.emplace_back();
+				std::snprintf(series.back().name, RECORDER_SERIES_NAME_LENGTH, "%s", base.name);
+				series.back().scale = base.scale;
+			}
+
+			for (size_t i = 0; i < SNAPSHOT_MAX_MOUNTS; i++)
+			{
+				series.emplace_back();
+				std::snprintf(series.back().name, RECORDER_SERIES_NAME_LENGTH, "disk%zu.free", i);
+				series.back().scale = 1.0 / (1024.0 * 1024.0);
+			}
+		}
+
+		int MetricsRecorder::StartBlock()
+		{
+			// Sequences start at 1 so that 0 can mark an empty block
+			const uint64_t sequence = mHeader->nextSequence.fetch_add(1, std::memory_order_relaxed);
+			const size_t index = static_cast<size_t>((sequence - 1) % mHeader->blockCount);
+
+			mBlock = reinterpret_cast<RecorderBlockHeader*>(mMapping + RECORDER_HEADER_SIZE + index * RECORDER_BLOCK_SIZE);
+			mPayload = reinterpret_cast<uint8_t*>(mBlock) + sizeof(RecorderBlockHeader);
+			mPayloadBits = static_cast<uint64_t>(RECORDER_BLOCK_SIZE - sizeof(RecorderBlockHeader)) * 8;
+
+			// Recycling the oldest block, readers see sequence 0 and skip it until it is ready
+			mBlock->sequence.store(0, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			mBlock->sampleCount.store(0, std::memory_order_relaxed);
+			mBlock->firstTimeMs = 0;
+			mBlock->lastTimeMs.store(0, std::memory_order_relaxed);
+			std::memset(mPayload, 0, RECORDER_BLOCK_SIZE - sizeof(RecorderBlockHeader));
+			mBlock->sequence.store(sequence, std::memory_order_release);
+
+			mBitPosition = 0;
+			mSampleCount = 0;
+			return 0;
+		}
+
+		void MetricsRecorder::WriteBits(uint64_t value, unsigned int bits)
+		{
+			// The payload was zeroed when the block started, so bits are only ever OR-ed in
+			while (bits > 0)
+			{
+				const unsigned int offset = static_cast<unsigned int>(mBitPosition & 7);
+				const unsigned int take = std::min(8u - offset, bits);
+				const uint8_t chunk = static_cast<uint8_t>((value >> (bits - take)) & ((1u << take) - 1u));
+				mPayload[mBitPosition >> 3] |= static_cast<uint8_t>(chunk << (8u - offset - take));
+				bits -= take;
+				mBitPosition += take;
+			}
+		}
+
+		MetricsRecordReader::MetricsRecordReader()
+		{
+			mMapping = nullptr;
+			mMappingSize = 0;
+			mHeader = nullptr;
+		}
+
+		MetricsRecordReader::~MetricsRecordReader()
+		{
+			Close();
+		}
+
+		int MetricsRecordReader::Open(const std::string& path)
+		{
+			Close();
+
+#ifndef _WIN32
+			int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				return -1;
+			}
+
+			struct stat info {};
+			if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < RECORDER_HEADER_SIZE)
+			{
+				close(fd);
+				return -1;
+			}
+
+			const size_t size = static_cast<size_t>(info.st_size);
+			void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (mapping == MAP_FAILED)
+			{
+				return -1;
+			}
+
+			const RecorderFileHeader* header = static_cast<const RecorderFileHeader*>(mapping);
+			if (header->magic.load(std::memory_order_acquire) != RECORDER_MAGIC || header->version != RECORDER_LAYOUT_VERSION ||
+				header->headerSize != RECORDER_HEADER_SIZE || header->blockSize != RECORDER_BLOCK_SIZE ||
+				header->seriesCount == 0 || header->seriesCount > RECORDER_MAX_SERIES ||
+				RECORDER_HEADER_SIZE + static_cast<size_t>(header->blockCount) * RECORDER_BLOCK_SIZE > size)
+			{
+				munmap(mapping, size);
+				return -1;
+			}
+
+			mMapping = static_cast<const uint8_t*>(mapping);
+			mMappingSize = size;
+			mHeader = header;
+			return 0;
+#else
+			(void)path;
+			return -1;
+#endif
+		}
+
+		void MetricsRecordReader::Close()
+		{
+#ifndef _WIN32
+			if (mMapping != nullptr)
+			{
+				munmap(const_cast<uint8_t*>(mMapping), mMappingSize);
+			}
+#endif
+
+			mMapping = nullptr;
+			mMappingSize = 0;
+			mHeader = nullptr;
+		}
+
+		size_t MetricsRecordReader::GetSeriesCount() const
+		{
+			return mHeader != nullptr ? mHeader->seriesCount : 0;
+		}
+
+		const RecorderSeries* MetricsRecordReader::GetSeries(size_t index) const
+		{
+			return index < GetSeriesCount() ? &mHeader->series[index] : nullptr;
+		}
+
+		int MetricsRecordReader::FindSeries(const std::string& name) const
+		{
+			for (size_t i = 0; i < GetSeriesCount(); i++)
+			{
+				if (name == mHeader->series[i].name)
+				{
+					return static_cast<int>(i);
+				}
+			}
+
+			return -1;
+		}
+
+		int MetricsRecordReader::Scan(uint64_t startMs, uint64_t endMs, const Visitor& visitor) const
+		{
+			if (mHeader == nullptr)
+			{
+				return -1;
+			}
+
+			// Only block headers are touched to pick the blocks overlapping the range
+			std::vector<std::pair<uint64_t, const RecorderBlockHeader*>> blocks;
+			for (uint32_t i = 0; i < mHeader->blockCount; i++)
+			{
+				const RecorderBlockHeader* block = reinterpret_cast<const RecorderBlockHeader*>(
+					mMapping + RECORDER_HEADER_SIZE + static_cast<size_t>(i) * RECORDER_BLOCK_SIZE);
+
+				const uint64_t sequence = block->sequence.load(std::memory_order_acquire);
+				if (sequence == 0 || block->sampleCount.load(std::memory_order_acquire) == 0 ||
+					block->firstTimeMs > endMs || block->lastTimeMs.load(std::memory_order_relaxed) < startMs)
+				{
+					continue;
+				}
+
+				blocks.emplace_back(sequence, block);
+			}
+
+			std::sort(blocks.begin(), blocks.end(),
+				[](const auto& a, const auto& b) { return a.first < b.first; });
+
+			const size_t seriesCount = mHeader->seriesCount;
+			std::vector<double> decoded;
+			for (const auto& entry : blocks)
+			{
+				const size_t samples = DecodeBlock(entry.second, decoded);
+				for (size_t sample = 0; sample < samples; sample++)
+				{
+					const double* row = decoded.data() + sample * (seriesCount + 1);
+					const uint64_t timeMs = static_cast<uint64_t>(row[0]);
+					if (timeMs >= startMs && timeMs <= endMs)
+					{
+						visitor(timeMs, row + 1, seriesCount);
+					}
+				}
+			}
+
+			return 0;
+		}
+
+		int MetricsRecordReader::Downsample(size_t series, uint64_t startMs, uint64_t endMs, uint64_t stepMs,
+			std::vector<RecordedPoint>& points) const
+		{
+			points.clear();
+			if (series >= GetSeriesCount() || stepMs == 0)
+			{
+				return -1;
+			}
+
+			// Samples arrive in time order, so a bucket is finished as soon as the next one starts
+			int result = Scan(startMs, endMs, [&points, series, startMs, stepMs](uint64_t timeMs, const double* values, size_t)
+			{
+				const uint64_t bucket = startMs + (timeMs - startMs) / stepMs * stepMs;
+				const double value = values[series];
+
+				if (points.empty() || points.back().timeMs != bucket)
+				{
+					points.emplace_back();
+					points.back().timeMs = bucket;
+					points.back().minimum = value;
+					points.back().maximum = value;
+				}
+
+				RecordedPoint& point = points.back();
+				point.minimum = std::min(point.minimum, value);
+				point.maximum = std::max(point.maximum, value);
+				point.mean += value;
+				point.count++;
+			});
+
+			// The sums become means once every bucket is complete
+			for (RecordedPoint& point : points)
+			{
+				point.mean /= point.count;
+			}
+
+			return result;
+		}
+
+		size_t MetricsRecordReader::DecodeBlock(const RecorderBlockHeader* block, std::vector<double>& decoded) const
+		{
+			const size_t seriesCount = mHeader->seriesCount;
+			const uint64_t sequence = block->sequence.load(std::memory_order_acquire);
+			const uint32_t sampleCount = block->sampleCount.load(std::memory_order_acquire);
+
+			decoded.resize(static_cast<size_t>(sampleCount) * (seriesCount + 1));
+
+			BitReader reader(reinterpret_cast<const uint8_t*>(block) + sizeof(RecorderBlockHeader),
+				static_cast<uint64_t>(RECORDER_BLOCK_SIZE - sizeof(RecorderBlockHeader)) * 8);
+
+			uint64_t timeMs = 0;
+			int64_t delta = 0;
+			uint64_t values[RECORDER_MAX_SERIES] = {};
+			uint8_t leading[RECORDER_MAX_SERIES] = {};
+			uint8_t trailing[RECORDER_MAX_SERIES] = {};
+
+			auto signExtend = [](uint64_t value, unsigned int bits) -> int64_t
+			{
+				const uint64_t sign = 1ull << (bits - 1);
+				return static_cast<int64_t>((value ^ sign) - sign);
+			};
+
+			size_t decodedSamples = 0;
+			for (uint32_t sample = 0; sample < sampleCount; sample++)
+			{
+				uint64_t bits = 0;
+				if (sample == 0)
+				{
+					if (!reader.Read(64, timeMs))
+					{
+						break;
+					}
+				}
+				else
+				{
+					// Count the leading ones of the bucket prefix, at most four
+					unsigned int ones = 0;
+					while (ones < 4 && reader.Read(1, bits) && bits == 1)
+					{
+						ones++;
+					}
+
+					static constexpr unsigned int widths[] = { 0, 7, 9, 12, 64 };
+					int64_t deltaOfDelta = 0;
+					if (ones > 0)
+					{
+						if (!reader.Read(widths[ones], bits))
+						{
+							break;
+						}
+						deltaOfDelta = ones == 4 ? static_cast<int64_t>(bits) : signExtend(bits, widths[ones]);
+					}
+
+					delta += deltaOfDelta;
+					timeMs += static_cast<uint64_t>(delta);
+				}
+
+				double* row = decoded.data() + static_cast<size_t>(sample) * (seriesCount + 1);
+				row[0] = static_cast<double>(timeMs);
+
+				bool valid = true;
+				for (size_t i = 0; i < seriesCount && valid; i++)
+				{
+					if (sample == 0)
+					{
+						valid = reader.Read(64, values[i]);
+					}
+					else if (reader.Read(1, bits) && bits == 1)
+					{
+						uint64_t control = 0;
+						valid = reader.Read(1, control);
+						if (valid && control == 1)
+						{
+							uint64_t leadingBits = 0;
+							uint64_t lengthBits = 0;
+							valid = reader.Read(5, leadingBits) && reader.Read(6, lengthBits);
+							leading[i] = static_cast<uint8_t>(leadingBits);
+							trailing[i] = static_cast<uint8_t>(64 - leadingBits - (lengthBits + 1));
+						}
+
+						uint64_t meaningful = 0;
+						valid = valid && reader.Read(64u - leading[i] - trailing[i], meaningful);
+						values[i] ^= meaningful << trailing[i];
+					}
+
+					row[1 + i] = std::bit_cast<double>(values[i]) / mHeader->series[i].scale;
+				}
+
+				if (!valid)
+				{
+					break;
+				}
+				decodedSamples++;
+			}
+
+			// The writer recycled the block while it was being decoded
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (block->sequence.load(std::memory_order_relaxed) != sequence)
+			{
+				return 0;
+			}
+
+			return decodedSamples;
+		}
+	}
+}
@@ -0,0 +1,171 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		metrics_recorder.h
+//!
+//! @brief		Fixed-size, memory-mapped ring file of sampled metrics. Samples
+//!				are Gorilla compressed (delta-of-delta timestamps, XOR values)
+//!				into independent blocks, so a reader can skip straight to the
+//!				blocks covering a time range and decode only those.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Block fields read by concurrent readers
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <functional>					// Scan visitor
+#include <string>						// Paths and names
+#include <vector>						// Series lists, downsampled output
+#include "system_snapshot.h"			// Recording snapshots
+//
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_METRICS_RECORDER		// Define the metrics recorder classes.
+#define     CPP_METRICS_RECORDER
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Identifies a ring file written by this library
+		constexpr uint64_t RECORDER_MAGIC = 0x4F53535550545331ull;		// "OSSUPTS1"
+
+		/// @brief Bumped whenever the file or block layout changes
+		constexpr uint32_t RECORDER_LAYOUT_VERSION = 1;
+
+		/// @brief Limits of the file header
+		constexpr size_t RECORDER_MAX_SERIES = 32;
+		constexpr size_t RECORDER_SERIES_NAME_LENGTH = 48;
+
+		/// @brief Block size, every block decodes on its own
+		constexpr uint32_t RECORDER_BLOCK_SIZE = 4096;
+
+		/// @brief One recorded column. Values are stored as round(value * scale) so
+		///			that quantised figures compress to a few bits per sample.
+		struct RecorderSeries
+		{
+			char		name[RECORDER_SERIES_NAME_LENGTH] = {};
+			double		scale = 1.0;
+		};
+
+		/// @brief File header, one page at the start of the file.
+		struct RecorderFileHeader
+		{
+			std::atomic<uint64_t>	magic;				// Written last when a file is created
+			uint32_t				version;
+			uint32_t				headerSize;
+			uint32_t				blockSize;
+			uint32_t				blockCount;
+			uint32_t				seriesCount;
+			uint32_t				reserved;
+			std::atomic<uint64_t>	nextSequence;		// Sequence of the next block to start
+			RecorderSeries			series[RECORDER_MAX_SERIES];
+		};
+
+		/// @brief Start of every block, followed by the compressed bit stream.
+		struct RecorderBlockHeader
+		{
+			std::atomic<uint64_t>	sequence;			// 0 while empty or being recycled
+			std::atomic<uint32_t>	sampleCount;		// Published after the bits are written
+			uint32_t				reserved;
+			uint64_t				firstTimeMs;
+			std::atomic<uint64_t>	lastTimeMs;
+		};
+
+		/// @brief Aggregate of one series over one downsampling bucket.
+		struct RecordedPoint
+		{
+			uint64_t	timeMs = 0;						// Start of the bucket
+			double		minimum = 0.0;
+			double		maximum = 0.0;
+			double		mean = 0.0;
+			uint32_t	count = 0;
+		};
+
+		/// @brief Writer side. Appending costs no syscalls, the page cache writes the file back.
+		class MetricsRecorder
+		{
+		public:
+			MetricsRecorder();
+			~MetricsRecorder();
+			MetricsRecorder(const MetricsRecorder&) = delete;
+			MetricsRecorder& operator=(const MetricsRecorder&) = delete;
+			int			Open(const std::string& path, const std::vector<RecorderSeries>& series, uint64_t fileSizeBytes);
+			int			OpenForSnapshots(const std::string& path, uint64_t fileSizeBytes);
+			void		Close();
+			bool		IsOpen() const;
+			int			Append(uint64_t timeMs, const double* values, size_t count);
+			int			Record(const SystemSnapshot& snapshot, uint64_t timeMs = 0);
+			int			Flush();
+			uint64_t	GetBitsWritten() const;
+			uint64_t	GetSamplesWritten() const;
+			static void	GetSnapshotSeries(std::vector<RecorderSeries>& series);
+		protected:
+		private:
+			int			StartBlock();
+			void		WriteBits(uint64_t value, unsigned int bits);
+
+			int						mFd;
+			uint8_t*				mMapping;
+			size_t					mMappingSize;
+			RecorderFileHeader*		mHeader;
+			RecorderBlockHeader*	mBlock;				// Block being filled
+			uint8_t*				mPayload;
+			uint64_t				mBitPosition;
+			uint64_t				mPayloadBits;
+			uint32_t				mSampleCount;
+			uint64_t				mPreviousTimeMs;
+			int64_t					mPreviousDelta;
+			uint64_t				mPreviousValues[RECORDER_MAX_SERIES];
+			uint8_t					mPreviousLeading[RECORDER_MAX_SERIES];
+			uint8_t					mPreviousTrailing[RECORDER_MAX_SERIES];
+			uint64_t				mBitsWritten;
+			uint64_t				mSamplesWritten;
+		};
+
+		/// @brief Reader side, decodes directly from a read-only mapping.
+		class MetricsRecordReader
+		{
+		public:
+			using Visitor = std::function<void(uint64_t timeMs, const double* values, size_t count)>;
+
+			MetricsRecordReader();
+			~MetricsRecordReader();
+			MetricsRecordReader(const MetricsRecordReader&) = delete;
+			MetricsRecordReader& operator=(const MetricsRecordReader&) = delete;
+			int			Open(const std::string& path);
+			void		Close();
+			size_t		GetSeriesCount() const;
+			const RecorderSeries* GetSeries(size_t index) const;
+			int			FindSeries(const std::string& name) const;
+			int			Scan(uint64_t startMs, uint64_t endMs, const Visitor& visitor) const;
+			int			Downsample(size_t series, uint64_t startMs, uint64_t endMs, uint64_t stepMs,
+							std::vector<RecordedPoint>& points) const;
+		protected:
+		private:
+			size_t		DecodeBlock(const RecorderBlockHeader* block, std::vector<double>& decoded) const;
+
+			const uint8_t*				mMapping;
+			size_t						mMappingSize;
+			const RecorderFileHeader*	mHeader;
+		};
+	}
+}
+#endif
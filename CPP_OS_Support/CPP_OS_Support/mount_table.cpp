@@ -0,0 +1,424 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		mount_table.cpp
+//!
+//! @brief		Implementation of the mount table class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"mount_table.h"				// Mount Table Class
+#include	"instrumentation.h"			// statvfs probe
+#include	<cerrno>					// errno values
+#include	<climits>					// PATH_MAX
+#include	<condition_variable>		// Waiting on network mount queries
+#include	<cstdlib>					// realpath
+#include	<memory>					// Shared state with detached queries
+#include	<mutex>						// Shared state with detached queries
+#include	<thread>					// Network mount queries
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Filesystems whose statvfs can block on a remote server
+		static bool IsNetworkFsType(std::string_view fsType)
+		{
+			static constexpr std::string_view networkTypes[] =
+			{
+				"nfs", "nfs4", "cifs", "smb3", "smbfs", "ceph", "glusterfs", "9p", "afs", "lustre", "gpfs", "davfs",
+			};
+
+			for (std::string_view type : networkTypes)
+			{
+				if (fsType == type)
+				{
+					return true;
+				}
+			}
+
+			// FUSE daemons (sshfs, s3fs, ...) can hang just the same
+			return fsType.compare(0, 5, "fuse.") == 0;
+		}
+
+		/// @brief Kernel interface filesystems that have no meaningful capacity
+		static bool IsPseudoFsType(std::string_view fsType)
+		{
+			static constexpr std::string_view pseudoTypes[] =
+			{
+				"proc", "sysfs", "cgroup", "cgroup2", "devpts", "mqueue", "debugfs", "tracefs", "securityfs",
+				"pstore", "bpf", "configfs", "fusectl", "hugetlbfs", "autofs", "binfmt_misc", "rpc_pipefs",
+				"nsfs", "efivarfs", "selinuxfs",
+			};
+
+			for (std::string_view type : pseudoTypes)
+			{
+				if (fsType == type)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		/// @brief mountinfo escapes space, tab, newline and backslash as \ooo octal
+		static void DecodeMountField(std::string_view field, std::string& decoded)
+		{
+			decoded.clear();
+			decoded.reserve(field.size());
+
+			for (size_t i = 0; i < field.size(); i++)
+			{
+				if (field[i] == '\\' && i + 3 < field.size() &&
+					field[i + 1] >= '0' && field[i + 1] <= '7' &&
+					field[i + 2] >= '0' && field[i + 2] <= '7' &&
+					field[i + 3] >= '0' && field[i + 3] <= '7')
+				{
+					decoded.push_back(static_cast<char>((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 + (field[i + 3] - '0')));
+					i += 3;
+				}
+				else
+				{
+					decoded.push_back(field[i]);
+				}
+			}
+		}
+
+		struct MountTable::PendingQuery
+		{
+			std::mutex				mutex;
+			std::condition_variable	condition;
+			bool					finished = false;
+			DiskUsage				usage;
+		};
+
+		MountTable::MountTable() : mMountinfo("/proc/self/mountinfo", 64 * 1024)
+		{
+			mGeneration = 0;
+			mLoaded = false;
+		}
+
+		MountTable::~MountTable()
+		{
+
+		}
+
+		int MountTable::Refresh()
+		{
+#ifdef __linux__
+			// mountinfo is a seq_file handing out about a page per read, ProcfsFile reads
+			// on to the end. A table that stops mid-line is not the whole file and would
+			// attribute paths under the missing mounts to their parents, keep the last one.
+			std::string_view mountinfo = mMountinfo.Read();
+			if (mountinfo.empty() || mountinfo.back() != '\n')
+			{
+				return -1;
+			}
+
+			return Parse(mountinfo);
+#else
+			return -1;
+#endif
+		}
+
+		bool MountTable::CheckForChanges()
+		{
+			if (!mLoaded)
+			{
+				return Refresh() == 0;
+			}
+
+#ifdef __linux__
+			// mountinfo raises POLLPRI once per change of the mount namespace and the
+			// poll itself re-arms it, so this is a single non-blocking syscall.
+			struct pollfd descriptor {};
+			descriptor.fd = mMountinfo.GetDescriptor();
+			descriptor.events = POLLPRI;
+
+			if (descriptor.fd >= 0 && poll(&descriptor, 1, 0) > 0 && (descriptor.revents & (POLLPRI | POLLERR)) != 0)
+			{
+				return Refresh() == 0;
+			}
+#endif
+
+			return false;
+		}
+
+		void MountTable::EnsureCurrent()
+		{
+			CheckForChanges();
+		}
+
+		uint64_t MountTable::GetGeneration()
+		{
+			EnsureCurrent();
+			return mGeneration;
+		}
+
+		const std::vector<MountEntry>& MountTable::GetMounts()
+		{
+			EnsureCurrent();
+			return mMounts;
+		}
+
+		const MountEntry* MountTable::FindMount(const std::string& mountPoint)
+		{
+			EnsureCurrent();
+
+			auto found = mIndex.find(mountPoint);
+			return found != mIndex.end() ? &mMounts[found->second] : nullptr;
+		}
+
+		const MountEntry* MountTable::FindMountForPath(const std::string& path)
+		{
+			EnsureCurrent();
+
+			std::string resolved = path;
+#ifdef __linux__
+			char buffer[PATH_MAX];
+			if (realpath(path.c_str(), buffer) != nullptr)
+			{
+				resolved = buffer;
+			}
+#endif
+
+			// Walk up the path one component at a time until a mount point matches
+			while (true)
+			{
+				auto found = mIndex.find(resolved);
+				if (found != mIndex.end())
+				{
+					return &mMounts[found->second];
+				}
+
+				size_t slash = resolved.find_last_of('/');
+				if (slash == std::string::npos || resolved == "/")
+				{
+					return nullptr;
+				}
+
+				resolved.resize(slash == 0 ? 1 : slash);
+			}
+		}
+
+		int MountTable::QueryUsage(const std::string& path, DiskUsage& usage)
+		{
+			usage.valid = false;
+			usage.error = 0;
+
+#ifdef __linux__
+			struct statvfs info {};
+			ProbeTimer timer(Probe::STATVFS);
+			const int rc = statvfs(path.c_str(), &info);
+			timer.Finish(rc == 0);
+			if (rc != 0)
+			{
+				usage.error = errno;
+				return -1;
+			}
+
+			const uint64_t fragment = static_cast<uint64_t>(info.f_frsize);
+			usage.totalBytes = fragment * info.f_blocks;
+			usage.freeBytes = fragment * info.f_bavail;
+			usage.usedBytes = fragment * (info.f_blocks - info.f_bfree);
+			usage.totalInodes = info.f_files;
+			usage.freeInodes = info.f_favail;
+			usage.usedInodes = info.f_files - info.f_ffree;
+			usage.valid = true;
+			return 0;
+#else
+			(void)path;
+			usage.error = ENOSYS;
+			return -1;
+#endif
+		}
+
+		int MountTable::QueryAllUsage(std::vector<DiskUsage>& usage, bool includePseudo, std::chrono::milliseconds networkTimeout)
+		{
+			EnsureCurrent();
+			usage.clear();
+
+			if (!mLoaded)
+			{
+				return -1;
+			}
+
+			std::vector<std::pair<size_t, std::shared_ptr<PendingQuery>>> pending;
+
+			for (size_t i = 0; i < mMounts.size(); i++)
+			{
+				const MountEntry& mount = mMounts[i];
+
+				// Only the top of a stack of mounts on the same point is visible
+				if (mIndex.find(mount.mountPoint)->second != i || (mount.isPseudo && !includePseudo))
+				{
+					continue;
+				}
+
+				usage.emplace_back();
+				usage.back().mountPoint = mount.mountPoint;
+				usage.back().fsType = mount.fsType;
+
+				if (mount.isNetwork)
+				{
+					// A dead server can block statvfs indefinitely, so network mounts are queried
+					// in parallel on detached threads and abandoned after the timeout. A query
+					// still hung from an earlier call is waited on again instead of starting
+					// another thread, so a dead server holds one thread however often this runs.
+					std::shared_ptr<PendingQuery>& query = mNetworkQueries[mount.mountPoint];
+					if (!query)
+					{
+						query = std::make_shared<PendingQuery>();
+						std::string mountPoint = mount.mountPoint;
+						std::thread([query = query, mountPoint]
+						{
+							DiskUsage result;
+							QueryUsage(mountPoint, result);
+
+							std::lock_guard<std::mutex> lock(query->mutex);
+							query->usage = result;
+							query->finished = true;
+							query->condition.notify_all();
+						}).detach();
+					}
+
+					pending.emplace_back(usage.size() - 1, query);
+				}
+				else
+				{
+					QueryUsage(mount.mountPoint, usage.back());
+				}
+			}
+
+			const auto deadline = std::chrono::steady_clock::now() + networkTimeout;
+			for (auto& entry : pending)
+			{
+				DiskUsage& result = usage[entry.first];
+				PendingQuery& query = *entry.second;
+
+				std::unique_lock<std::mutex> lock(query.mutex);
+				if (query.condition.wait_until(lock, deadline, [&query] { return query.finished; }))
+				{
+					result.totalBytes = query.usage.totalBytes;
+					result.freeBytes = query.usage.freeBytes;
+					result.usedBytes = query.usage.usedBytes;
+					result.totalInodes = query.usage.totalInodes;
+					result.freeInodes = query.usage.freeInodes;
+					result.usedInodes = query.usage.usedInodes;
+					result.error = query.usage.error;
+					result.valid = query.usage.valid;
+
+					// Done, the next call starts a fresh query
+					lock.unlock();
+					mNetworkQueries.erase(result.mountPoint);
+				}
+				else
+				{
+					result.error = ETIMEDOUT;
+					result.valid = false;
+				}
+			}
+
+			// Forget queries on mounts that have gone away, their threads keep their own reference
+			for (auto query = mNetworkQueries.begin(); query != mNetworkQueries.end();)
+			{
+				query = mIndex.count(query->first) == 0 ? mNetworkQueries.erase(query) : std::next(query);
+			}
+
+			return 0;
+		}
+
+		int MountTable::Parse(std::string_view mountinfo)
+		{
+			size_t count = 0;
+
+			while (!mountinfo.empty())
+			{
+				std::string_view line = Procfs::NextLine(mountinfo);
+				if (line.empty())
+				{
+					continue;
+				}
+
+				// id parent major:minor root mount-point options [optional...] - fstype source super-options
+				uint64_t mountId = 0;
+				uint64_t parentId = 0;
+				uint64_t major = 0;
+				uint64_t minor = 0;
+
+				std::string_view idToken = Procfs::NextToken(line);
+				std::string_view parentToken = Procfs::NextToken(line);
+				std::string_view deviceToken = Procfs::NextToken(line);
+				std::string_view rootToken = Procfs::NextToken(line);
+				std::string_view pointToken = Procfs::NextToken(line);
+				std::string_view optionsToken = Procfs::NextToken(line);
+
+				size_t colon = deviceToken.find(':');
+				if (!Procfs::ToUnsigned(idToken, mountId) || !Procfs::ToUnsigned(parentToken, parentId) ||
+					colon == std::string_view::npos ||
+					!Procfs::ToUnsigned(deviceToken.substr(0, colon), major) ||
+					!Procfs::ToUnsigned(deviceToken.substr(colon + 1), minor))
+				{
+					continue;
+				}
+
+				std::string_view token = Procfs::NextToken(line);
+				while (!token.empty() && token != "-")
+				{
+					token = Procfs::NextToken(line);
+				}
+
+				std::string_view fsTypeToken = Procfs::NextToken(line);
+				std::string_view sourceToken = Procfs::NextToken(line);
+				std::string_view superToken = Procfs::NextToken(line);
+
+				// Entries are reused between refreshes so their strings keep their capacity
+				if (count >= mMounts.size())
+				{
+					mMounts.emplace_back();
+				}
+
+				MountEntry& entry = mMounts[count++];
+				entry.mountId = static_cast<uint32_t>(mountId);
+				entry.parentId = static_cast<uint32_t>(parentId);
+				entry.major = static_cast<uint32_t>(major);
+				entry.minor = static_cast<uint32_t>(minor);
+				DecodeMountField(rootToken, entry.root);
+				DecodeMountField(pointToken, entry.mountPoint);
+				entry.options.assign(optionsToken.data(), optionsToken.size());
+				entry.fsType.assign(fsTypeToken.data(), fsTypeToken.size());
+				DecodeMountField(sourceToken, entry.source);
+				entry.superOptions.assign(superToken.data(), superToken.size());
+				entry.isNetwork = IsNetworkFsType(entry.fsType);
+				entry.isPseudo = IsPseudoFsType(entry.fsType);
+			}
+
+			if (count == 0)
+			{
+				return -1;
+			}
+
+			mMounts.resize(count);
+
+			// Later entries are mounted over earlier ones on the same point
+			mIndex.clear();
+			for (size_t i = 0; i < mMounts.size(); i++)
+			{
+				mIndex[mMounts[i].mountPoint] = i;
+			}
+
+			mGeneration++;
+			mLoaded = true;
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		mount_table.h
+//!
+//! @brief		Indexed copy of /proc/self/mountinfo that is only re-parsed
+//!				when the kernel reports a mount change, plus batched capacity
+//!				and inode queries across every mounted filesystem.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <chrono>						// Network mount timeout
+#include <cstdint>						// Fixed width types
+#include <memory>						// Network mount queries in flight
+#include <string>						// Paths
+#include <string_view>					// Parsing
+#include <unordered_map>				// Mount point index
+#include <vector>						// Mount list
+#include "procfs_reader.h"				// Persistent mountinfo handle
+//
+#ifdef __linux__
+#include <poll.h>
+#include <sys/statvfs.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_MOUNT_TABLE				// Define the mount table class.
+#define     CPP_MOUNT_TABLE
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief One line of /proc/self/mountinfo, escapes decoded.
+		struct MountEntry
+		{
+			uint32_t	mountId = 0;
+			uint32_t	parentId = 0;
+			uint32_t	major = 0;
+			uint32_t	minor = 0;
+			std::string	root;
+			std::string	mountPoint;
+			std::string	options;
+			std::string	fsType;
+			std::string	source;
+			std::string	superOptions;
+			bool		isNetwork = false;		// statvfs may block on the network
+			bool		isPseudo = false;		// No meaningful capacity (proc, sysfs, cgroup...)
+		};
+
+		/// @brief Capacity and inode figures for one filesystem.
+		struct DiskUsage
+		{
+			std::string	mountPoint;
+			std::string	fsType;
+			uint64_t	totalBytes = 0;
+			uint64_t	freeBytes = 0;			// Free to unprivileged users (f_bavail)
+			uint64_t	usedBytes = 0;
+			uint64_t	totalInodes = 0;
+			uint64_t	freeInodes = 0;
+			uint64_t	usedInodes = 0;
+			int			error = 0;				// errno of the failed query, ETIMEDOUT for a hung mount
+			bool		valid = false;
+		};
+
+		class MountTable
+		{
+		public:
+			MountTable();
+			~MountTable();
+			MountTable(const MountTable&) = delete;
+			MountTable& operator=(const MountTable&) = delete;
+			int			Refresh();
+			bool		CheckForChanges();
+			uint64_t	GetGeneration();
+			const std::vector<MountEntry>& GetMounts();
+			const MountEntry* FindMount(const std::string& mountPoint);
+			const MountEntry* FindMountForPath(const std::string& path);
+			static int	QueryUsage(const std::string& path, DiskUsage& usage);
+			int			QueryAllUsage(std::vector<DiskUsage>& usage, bool includePseudo = false,
+							std::chrono::milliseconds networkTimeout = std::chrono::milliseconds(2000));
+		protected:
+		private:
+			/// @brief statvfs of a network mount running on its own thread
+			struct PendingQuery;
+
+			int			Parse(std::string_view mountinfo);
+			void		EnsureCurrent();
+
+			ProcfsFile									mMountinfo;
+			std::vector<MountEntry>						mMounts;
+			std::unordered_map<std::string, size_t>		mIndex;
+			std::unordered_map<std::string, std::shared_ptr<PendingQuery>> mNetworkQueries;	// At most one per mount point
+			uint64_t									mGeneration;
+			bool										mLoaded;
+		};
+	}
+}
+#endif
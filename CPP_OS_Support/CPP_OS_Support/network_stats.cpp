@@ -0,0 +1,267 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		network_stats.cpp
+//!
+//! @brief		Implementation of the network stats class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"network_stats.h"			// Network Stats Class
+#include	<algorithm>					// std::remove_if
+#include	<chrono>					// Sample timestamps
+#include	<cstring>					// memcpy, strncmp
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		NetworkStats::NetworkStats() : mNetDevFile("/proc/net/dev", 16 * 1024)
+		{
+			mSampleNumber = 0;
+			mLastTimestampNs = 0;
+		}
+
+		NetworkStats::~NetworkStats()
+		{
+
+		}
+
+		void NetworkStats::SetFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude)
+		{
+			mInclude = include;
+			mExclude = exclude;
+
+			// The filter result is cached per slot, re-evaluate the existing ones. An excluded
+			// slot's counters went stale, so one that comes back starts a new baseline.
+			for (InterfaceStats& stats : mInterfaces)
+			{
+				const bool included = Matches(stats.name);
+				if (included != stats.included)
+				{
+					stats.lastSeen = 0;
+					stats.hasRates = false;
+				}
+				stats.included = included;
+			}
+		}
+
+		int NetworkStats::Sample()
+		{
+			int result = -1;
+
+#ifdef __linux__
+			// Linux implementation, the file runs past a page with a few dozen interfaces
+			// and ProcfsFile reads on to the end, so every veth of a busy netns is seen
+			std::string_view netDev = mNetDevFile.Read();
+			if (!netDev.empty())
+			{
+				const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+				result = Update(netDev, now);
+			}
+
+#endif
+
+			return result;
+		}
+
+		int NetworkStats::Update(std::string_view netDev, uint64_t timestampNs)
+		{
+			mSampleNumber++;
+			const double seconds = mLastTimestampNs != 0 && timestampNs > mLastTimestampNs ?
+				static_cast<double>(timestampNs - mLastTimestampNs) / 1e9 : 0.0;
+			size_t position = 0;
+
+			while (!netDev.empty())
+			{
+				std::string_view line = Procfs::NextLine(netDev);
+
+				// The two header lines have no colon after the name
+				const size_t colon = line.find(':');
+				if (colon == std::string_view::npos)
+				{
+					continue;
+				}
+
+				std::string_view name = line.substr(0, colon);
+				while (!name.empty() && name.front() == ' ')
+				{
+					name.remove_prefix(1);
+				}
+				if (name.empty() || name.size() >= INTERFACE_NAME_LENGTH)
+				{
+					continue;
+				}
+
+				InterfaceStats* stats = Slot(name, position++);
+				if (!stats->included)
+				{
+					stats->lastSeen = mSampleNumber;
+					continue;
+				}
+
+				// rx: bytes packets errs drop fifo frame compressed multicast, then the same for tx
+				uint64_t fields[16] = {};
+				const char* cursor = line.data() + colon + 1;
+				const char* end = line.data() + line.size();
+				for (uint64_t& field : fields)
+				{
+					cursor = Procfs::ParseUnsigned(cursor, end, field);
+				}
+
+				InterfaceCounters current;
+				current.rxBytes = fields[0];
+				current.rxPackets = fields[1];
+				current.rxErrors = fields[2];
+				current.rxDrops = fields[3];
+				current.txBytes = fields[8];
+				current.txPackets = fields[9];
+				current.txErrors = fields[10];
+				current.txDrops = fields[11];
+
+				const bool continuous = stats->lastSeen == mSampleNumber - 1 && seconds > 0.0;
+				if (continuous)
+				{
+					// A counter that went backwards was reset (driver reload, 32-bit wrap)
+					auto rate = [seconds](uint64_t before, uint64_t after) -> double
+					{
+						return after >= before ? static_cast<double>(after - before) / seconds : 0.0;
+					};
+
+					const InterfaceCounters& previous = stats->counters;
+					stats->rxBytesPerSecond = rate(previous.rxBytes, current.rxBytes);
+					stats->rxPacketsPerSecond = rate(previous.rxPackets, current.rxPackets);
+					stats->rxErrorsPerSecond = rate(previous.rxErrors, current.rxErrors);
+					stats->rxDropsPerSecond = rate(previous.rxDrops, current.rxDrops);
+					stats->txBytesPerSecond = rate(previous.txBytes, current.txBytes);
+					stats->txPacketsPerSecond = rate(previous.txPackets, current.txPackets);
+					stats->txErrorsPerSecond = rate(previous.txErrors, current.txErrors);
+					stats->txDropsPerSecond = rate(previous.txDrops, current.txDrops);
+				}
+
+				stats->hasRates = continuous;
+				stats->counters = current;
+				stats->lastSeen = mSampleNumber;
+			}
+
+			// Drop interfaces that went away, this only moves slots and never allocates
+			const uint64_t sampleNumber = mSampleNumber;
+			mInterfaces.erase(std::remove_if(mInterfaces.begin(), mInterfaces.end(),
+				[sampleNumber](const InterfaceStats& stats) { return stats.lastSeen != sampleNumber; }), mInterfaces.end());
+
+			mLastTimestampNs = timestampNs;
+			return 0;
+		}
+
+		InterfaceStats* NetworkStats::Slot(std::string_view name, size_t position)
+		{
+			// /proc/net/dev keeps a stable order, so the slot at the same position is
+			// almost always the right one and the lookup is a single compare.
+			auto sameName = [name](const InterfaceStats& stats)
+			{
+				return std::strncmp(stats.name, name.data(), name.size()) == 0 && stats.name[name.size()] == '\0';
+			};
+
+			if (position < mInterfaces.size() && sameName(mInterfaces[position]))
+			{
+				return &mInterfaces[position];
+			}
+
+			for (InterfaceStats& stats : mInterfaces)
+			{
+				if (sameName(stats))
+				{
+					return &stats;
+				}
+			}
+
+			// New interface, the only path that can allocate
+			mInterfaces.emplace_back();
+			InterfaceStats& stats = mInterfaces.back();
+			std::memcpy(stats.name, name.data(), name.size());
+			stats.name[name.size()] = '\0';
+			stats.included = Matches(name);
+			stats.lastSeen = 0;
+			return &stats;
+		}
+
+		bool NetworkStats::Matches(std::string_view name) const
+		{
+#ifndef _WIN32
+			char buffer[INTERFACE_NAME_LENGTH] = {};
+			std::memcpy(buffer, name.data(), std::min(name.size(), INTERFACE_NAME_LENGTH - 1));
+
+			bool included = mInclude.empty();
+			for (const std::string& pattern : mInclude)
+			{
+				if (fnmatch(pattern.c_str(), buffer, 0) == 0)
+				{
+					included = true;
+					break;
+				}
+			}
+
+			for (const std::string& pattern : mExclude)
+			{
+				if (fnmatch(pattern.c_str(), buffer, 0) == 0)
+				{
+					included = false;
+					break;
+				}
+			}
+
+			return included;
+#else
+			(void)name;
+			return true;
+#endif
+		}
+
+		size_t NetworkStats::GetInterfaceCount() const
+		{
+			return mInterfaces.size();
+		}
+
+		const InterfaceStats* NetworkStats::GetInterface(size_t index) const
+		{
+			return index < mInterfaces.size() ? &mInterfaces[index] : nullptr;
+		}
+
+		const InterfaceStats* NetworkStats::FindInterface(std::string_view name) const
+		{
+			for (const InterfaceStats& stats : mInterfaces)
+			{
+				if (stats.included && name == stats.name)
+				{
+					return &stats;
+				}
+			}
+
+			return nullptr;
+		}
+
+		int NetworkStats::GetInterfaces(std::vector<InterfaceStats>& interfaces) const
+		{
+			// Reuses the caller's capacity, excluded interfaces are skipped
+			interfaces.clear();
+			for (const InterfaceStats& stats : mInterfaces)
+			{
+				if (stats.included)
+				{
+					interfaces.push_back(stats);
+				}
+			}
+
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		network_stats.h
+//!
+//! @brief		Per-interface throughput and error rates computed from the
+//!				deltas between /proc/net/dev samples. Interface slots are
+//!				reused between samples, so steady-state sampling does not
+//!				allocate however many interfaces the host has.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string>						// Filter patterns
+#include <string_view>					// Parsing
+#include <vector>						// Interface slots
+#include "procfs_reader.h"				// Persistent /proc/net/dev handle
+//
+#ifndef _WIN32
+#include <fnmatch.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_NETWORK_STATS			// Define the network stats class.
+#define     CPP_NETWORK_STATS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Interface names are at most IFNAMSIZ (16) including the terminator
+		constexpr size_t INTERFACE_NAME_LENGTH = 16;
+
+		/// @brief Cumulative counters from one /proc/net/dev line.
+		struct InterfaceCounters
+		{
+			uint64_t	rxBytes = 0;
+			uint64_t	rxPackets = 0;
+			uint64_t	rxErrors = 0;
+			uint64_t	rxDrops = 0;
+			uint64_t	txBytes = 0;
+			uint64_t	txPackets = 0;
+			uint64_t	txErrors = 0;
+			uint64_t	txDrops = 0;
+		};
+
+		/// @brief Counters and per-second rates of one interface over the last interval.
+		struct InterfaceStats
+		{
+			char				name[INTERFACE_NAME_LENGTH] = {};
+			InterfaceCounters	counters;
+			double				rxBytesPerSecond = 0.0;
+			double				rxPacketsPerSecond = 0.0;
+			double				rxErrorsPerSecond = 0.0;
+			double				rxDropsPerSecond = 0.0;
+			double				txBytesPerSecond = 0.0;
+			double				txPacketsPerSecond = 0.0;
+			double				txErrorsPerSecond = 0.0;
+			double				txDropsPerSecond = 0.0;
+			bool				hasRates = false;		// False until the interface was seen twice
+			bool				included = true;		// Result of the include/exclude filter
+			uint64_t			lastSeen = 0;			// Sample number the interface was last listed in
+		};
+
+		class NetworkStats
+		{
+		public:
+			NetworkStats();
+			~NetworkStats();
+			void		SetFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude);
+			int			Sample();
+			int			Update(std::string_view netDev, uint64_t timestampNs);
+			size_t		GetInterfaceCount() const;
+			const InterfaceStats* GetInterface(size_t index) const;
+			const InterfaceStats* FindInterface(std::string_view name) const;
+			int			GetInterfaces(std::vector<InterfaceStats>& interfaces) const;
+		protected:
+		private:
+			bool		Matches(std::string_view name) const;
+			InterfaceStats* Slot(std::string_view name, size_t position);
+
+			ProcfsFile					mNetDevFile;
+			std::vector<InterfaceStats>	mInterfaces;
+			std::vector<std::string>	mInclude;			// Globs, empty includes everything
+			std::vector<std::string>	mExclude;			// Globs
+			uint64_t					mSampleNumber;
+			uint64_t					mLastTimestampNs;
+		};
+	}
+}
+#endif
@@ -14,6 +14,8 @@
 //          name                        reason included
 //          --------------------        ---------------------------------------
 #include	"os_support.h"				// OS Support Class
+#include	<algorithm>					// std::min
+#include	<cerrno>					// errno of failing calls
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -21,9 +23,53 @@ namespace Essentials
 {
 	namespace Utilities
 	{
-		OS_Support::OS_Support()
+		// A failed RAM query is a /proc/meminfo read on Linux and a system call elsewhere
+#ifdef __linux__
+		static constexpr SupportError RAM_QUERY_ERROR = SupportError::READ_FAILED;
+#else
+		static constexpr SupportError RAM_QUERY_ERROR = SupportError::SYSTEM_CALL_FAILED;
+#endif
+
+		/// @brief Records the failure of a procfs backed collector, which has nothing to
+		///			read on other platforms. Callers clear errno before the collector runs,
+		///			so it is only set when a read failed; a file that read fine and did
+		///			not parse is a PARSE_FAILED without an errno.
+		static void SetCollectorError(const char* source)
+		{
+#ifdef __linux__
+			const int error = errno;
+			LastError::Set(error != 0 ? SupportError::READ_FAILED : SupportError::PARSE_FAILED, source, error);
+#else
+			LastError::Set(SupportError::NOT_SUPPORTED, source);
+#endif
+		}
+
+		/// @brief Records a failed QueryRam, a meminfo read and parse on Linux and a
+		///			single OS call elsewhere
+		static void SetRamQueryError(const char* source)
+		{
+#ifdef __linux__
+			SetCollectorError(source);
+#else
+			LastError::Set(RAM_QUERY_ERROR, source, errno);
+#endif
+		}
+
+		OS_Support::OS_Support() :
+			mStatFile("/proc/stat"),
+			mMeminfoFile("/proc/meminfo"),
+			mNetDevFile("/proc/net/dev")
 		{
-			mLastError = SupportError::NONE;
+			mSnapshotMounts = { "/" };
+			mCaptureTimestampNs = 0;
+			mHasCaptureCpuTimes = false;
+			mContainerAware = false;
+			mBatchedReads = false;
+			mThermalFailed = false;
+
+			mCaptureBatch.Add(mMeminfoFile);
+			mCaptureBatch.Add(mStatFile);
+			mCaptureBatch.Add(mNetDevFile);
 		}
 
 		OS_Support::~OS_Support()
@@ -33,49 +79,144 @@ namespace Essentials
 
 		double OS_Support::GetCpuUsagePercent()
 		{
-			double cpuUsage = 0.0;
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				return shared->GetCpuUsagePercent();
+			}
 
-#ifdef _WIN32
-			// Windows implementation
-			PDH_HQUERY query;
-			PDH_HCOUNTER counter;
-			PdhOpenQuery(NULL, NULL, &query);
-			PdhAddCounter(query, "\\Processor(_Total)\\% Processor Time", NULL, &counter);
-			PdhCollectQueryData(query);
-			Sleep(1000);  // Sleep for 1 second to get the updated value
-			PdhCollectQueryData(query);
-			PDH_FMT_COUNTERVALUE value;
-			PdhGetFormattedCounterValue(counter, PDH_FMT_DOUBLE, NULL, &value);
-			cpuUsage = value.doubleValue;
+			// Container mode reports the share of the cgroup's CPU allowance used since the previous call
+			if (mContainerAware && mCgroupStats.ReadCpu(mCgroupSample) == 0)
+			{
+				return mCgroupSample.cpuUsagePercent;
+			}
 
-#elif __linux__
-			// Linux implementation
-			std::ifstream file("/proc/stat");
-			std::string line;
-			std::getline(file, line);
-			file.close();
-			unsigned long user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
-			sscanf(line.c_str(), "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-				&user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal, &guest, &guest_nice);
-			unsigned long total_idle = idle + iowait;
-			unsigned long total_non_idle = user + nice + system + irq + softirq + steal;
-			unsigned long total = total_idle + total_non_idle;
-			cpuUsage = (total - total_idle) * 100.0 / total;
+			// Answered from the latest background sample, the first call starts the
+			// sampler and returns the since-boot average until an interval completes.
+			if (!mCpuSampler.IsRunning())
+			{
+				StartCpuSampling();
+			}
 
-#elif __APPLE__
-			// macOS implementation
-			int cpuUsagePercent = 0;
-			size_t size = sizeof(cpuUsagePercent);
-			sysctlbyname("kern.cp_times", &cpuUsagePercent, &size, NULL, 0);
-			cpuUsage = static_cast<double>(cpuUsagePercent) / 10.0;
+			return mCpuSampler.GetUsagePercent();
+		}
 
-#endif
+		CpuSample OS_Support::GetCpuSample()
+		{
+			if (!mCpuSampler.IsRunning())
+			{
+				StartCpuSampling();
+			}
+
+			return mCpuSampler.GetLatestSample();
+		}
+
+		int OS_Support::StartCpuSampling(uint32_t periodMs)
+		{
+			return mCpuSampler.Start(std::chrono::milliseconds(periodMs));
+		}
+
+		void OS_Support::StopCpuSampling()
+		{
+			mCpuSampler.Stop();
+		}
+
+		int OS_Support::GetPerCoreCpuUsage(std::vector<CoreCpuUsage>& cores)
+		{
+			// Each call covers the interval since the previous one, the first
+			// call reports the since-boot average of every core.
+			errno = 0;
+			if (mCoreStats.Sample() != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return mCoreStats.GetCoreUsage(cores);
+		}
+
+		const CpuTopology& OS_Support::GetCpuTopology()
+		{
+			// Shared by every instance, sysfs is walked once per process
+			const CpuTopology& topology = CpuTopology::Get();
+			if (!topology.IsDiscovered())
+			{
+				LastError::Set(SupportError::NOT_SUPPORTED, __func__);
+			}
+
+			return topology;
+		}
+
+		int OS_Support::GetNumaNodeMemory(std::vector<NumaNodeMemory>& nodes)
+		{
+			errno = 0;
+			if (!mNumaMemory.IsOpen() && mNumaMemory.Open(CpuTopology::Get()) != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			errno = 0;
+			if (mNumaMemory.Sample(nodes) != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		int OS_Support::GetCpuFrequencies(std::vector<CpuFrequency>& cpus)
+		{
+			if (SampleThermal(__func__) != 0)
+			{
+				return -1;
+			}
+
+			return mThermalStats.GetCpuFrequencies(cpus);
+		}
+
+		int OS_Support::GetThermalZones(std::vector<ThermalZone>& zones)
+		{
+			if (SampleThermal(__func__) != 0)
+			{
+				return -1;
+			}
+
+			return mThermalStats.GetThermalZones(zones);
+		}
+
+		int OS_Support::GetThrottleCounters(ThrottleCounters& counters)
+		{
+			// Events are counted between samples, poll regularly to catch short throttling
+			if (SampleThermal(__func__) != 0)
+			{
+				return -1;
+			}
 
-			return cpuUsage;
+			counters = mThermalStats.GetThrottleCounters();
+			return 0;
+		}
+
+		ThermalStats& OS_Support::GetThermalStats()
+		{
+			return mThermalStats;
 		}
 
 		double OS_Support::GetTotalRamInGigabytes()
 		{
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				return shared->GetTotalRamInGigabytes();
+			}
+
+			uint64_t containerTotal = 0;
+			uint64_t containerFree = 0;
+			uint64_t containerUsed = 0;
+			if (QueryContainerRam(containerTotal, containerFree, containerUsed))
+			{
+				return static_cast<double>(containerTotal) / (1024.0 * 1024.0 * 1024.0);
+			}
+
 			double totalRAM = 0.0;
 
 #ifdef _WIN32
@@ -87,22 +228,15 @@ namespace Essentials
 			}
 
 #elif __linux__
-			std::ifstream meminfoFile("/proc/meminfo");
-
-			if (meminfoFile.is_open())
+			uint64_t totalMemory = 0;
+			errno = 0;
+			if (Procfs::FindValue(mMeminfoFile.Read(), "MemTotal", totalMemory))
 			{
-				std::string line;
-				while (std::getline(meminfoFile, line))
-				{
-					if (line.find("MemTotal:") != std::string::npos)
-					{
-						double totalMemory;
-						std::sscanf(line.c_str(), "MemTotal: %lf", &totalMemory);
-						totalRAM = totalMemory * 1024.0;  // Convert from kilobytes to bytes
-						break;
-					}
-				}
-				meminfoFile.close();
+				totalRAM = static_cast<double>(totalMemory) * 1024.0;  // Convert from kilobytes to bytes
+			}
+			else
+			{
+				SetCollectorError(__func__);
 			}
 
 #elif __APPLE__
@@ -120,69 +254,57 @@ namespace Essentials
 
 		uint64_t OS_Support::GetTotalRamInBytes()
 		{
-			uint64_t totalRAM = 0;
-
-#ifdef _WIN32
-			// Windows implementation
-			MEMORYSTATUSEX memoryStatus{};
-			memoryStatus.dwLength = sizeof(memoryStatus);
-			if (GlobalMemoryStatusEx(&memoryStatus))
+			if (const SystemSnapshot* shared = ReadShared())
 			{
-				totalRAM = static_cast<uint64_t>(memoryStatus.ullTotalPhys);
+				return shared->GetTotalRamInBytes();
 			}
-#elif __linux__
-			// Linux implementation
-			struct sysinfo info;
-			if (sysinfo(&info) != -1)
+
+			uint64_t totalRAM = 0;
+			uint64_t freeRAM = 0;
+			uint64_t usedRAM = 0;
+			errno = 0;
+			if (!QueryContainerRam(totalRAM, freeRAM, usedRAM) && QueryRam(totalRAM, freeRAM) != 0)
 			{
-				totalRAM = static_cast<uint64_t>(info.totalram * info.mem_unit);
+				SetRamQueryError(__func__);
 			}
-#elif __APPLE__
-			// macOS implementation
-			int mib[2];
-			mib[0] = CTL_HW;
-			mib[1] = HW_MEMSIZE;
-			uint64_t physicalMemory;
-			uint64_t length = sizeof(physicalMemory);
-			sysctl(mib, 2, &physicalMemory, &length, nullptr, 0);
-			totalRAM = physicalMemory;
-#endif
 
 			return totalRAM;
 		}
 
 		uint64_t OS_Support::GetFreeRamInBytes()
 		{
-			uint64_t freeRAM = 0;
-
-#ifdef _WIN32
-			// Windows implementation
-			MEMORYSTATUSEX memoryStatus{};
-			memoryStatus.dwLength = sizeof(memoryStatus);
-			if (GlobalMemoryStatusEx(&memoryStatus))
+			if (const SystemSnapshot* shared = ReadShared())
 			{
-				freeRAM = static_cast<uint64_t>(memoryStatus.ullAvailPhys);
+				return shared->GetFreeRamInBytes();
 			}
-#elif __linux__
-			// Linux implementation
-			struct sysinfo info;
-			if (sysinfo(&info) != -1)
+
+			uint64_t totalRAM = 0;
+			uint64_t freeRAM = 0;
+			uint64_t usedRAM = 0;
+			errno = 0;
+			if (!QueryContainerRam(totalRAM, freeRAM, usedRAM) && QueryRam(totalRAM, freeRAM) != 0)
 			{
-				freeRAM = static_cast<uint64_t>(info.freeram * info.mem_unit);
+				SetRamQueryError(__func__);
 			}
-#elif __APPLE__
-			// macOS implementation
-			int64_t physicalMemory;
-			size_t length = sizeof(physicalMemory);
-			sysctlbyname("hw.memsize", &physicalMemory, &length, nullptr, 0);
-			freeRAM = static_cast<size_t>(physicalMemory);
-#endif
 
 			return freeRAM;
 		}
 
 		uint64_t OS_Support::GetUsedRamInBytes()
 		{
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				return shared->GetUsedRamInBytes();
+			}
+
+			uint64_t containerTotal = 0;
+			uint64_t containerFree = 0;
+			uint64_t containerUsed = 0;
+			if (QueryContainerRam(containerTotal, containerFree, containerUsed))
+			{
+				return containerUsed;
+			}
+
 			uint64_t ramUsage = 0;
 
 #ifdef _WIN32
@@ -193,28 +315,16 @@ namespace Essentials
 				ramUsage = pmc.WorkingSetSize;
 			}
 #elif __linux__
-			std::ifstream meminfoFile("/proc/meminfo");
-			std::string line;
-
-			while (std::getline(meminfoFile, line))
+			// MemTotal - MemAvailable, page cache the kernel can drop is not in use
+			MemorySample memory;
+			errno = 0;
+			if (MemoryStats::ParseMeminfo(mMeminfoFile.Read(), memory) == 0)
 			{
-				// Search for the "MemAvailable" or "Active" line
-				if (line.compare(0, 12, "MemAvailable") == 0 || line.compare(0, 6, "Active") == 0)
-				{
-					std::istringstream iss(line);
-					std::string fieldName;
-					size_t fieldValue;
-
-					// Extract the field name and value
-					iss >> fieldName >> fieldValue;
-
-					if (fieldName == "MemAvailable:" || fieldName == "Active:")
-					{
-						// Convert from kilobytes to bytes
-						ramUsage = fieldValue * 1024;
-						break;
-					}
-		}
+				ramUsage = memory.usedBytes;
+			}
+			else
+			{
+				SetCollectorError(__func__);
 			}
 #elif __APPLE__
 			// macOS implementation
@@ -231,44 +341,62 @@ namespace Essentials
 
 		double OS_Support::GetRamUsagePercent()
 		{
-			uint64_t totalRAM = GetTotalRamInBytes();
-			uint64_t freeRAM = GetFreeRamInBytes();
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				return shared->GetRamUsagePercent();
+			}
+
+			// One query for both figures so they describe the same instant
+			uint64_t totalRAM = 0;
+			uint64_t freeRAM = 0;
+			uint64_t containerUsed = 0;
+			if (QueryContainerRam(totalRAM, freeRAM, containerUsed))
+			{
+				return totalRAM > 0 ? static_cast<double>(containerUsed) / totalRAM * 100.0 : 0.0;
+			}
+
+			errno = 0;
+			if (QueryRam(totalRAM, freeRAM) != 0 || totalRAM == 0)
+			{
+				SetRamQueryError(__func__);
+				return 0.0;
+			}
+
 			uint64_t usedRAM = totalRAM - freeRAM;
 			double percent = static_cast<double>(usedRAM) / totalRAM;
 
 			return percent * 100.0;
 		}
 
-		uint64_t OS_Support::GetTotalDiskSpaceInBytes()
+		int OS_Support::GetMemoryStats(MemorySample& sample)
 		{
-			uint64_t totalSpace = 0;
-
-#ifdef WIN32
-			// Windows implementation
-			ULARGE_INTEGER freeBytesAvailable, totalBytes, totalFreeBytes;
-			if (GetDiskFreeSpaceEx(NULL, &freeBytesAvailable, &totalBytes, &totalFreeBytes))
+			// Rates cover the interval since the previous call, the first call
+			// only establishes the baseline and reports hasRates false.
+			errno = 0;
+			if (mMemoryStats.Sample() != 0)
 			{
-				totalSpace = static_cast<uint64_t>(totalBytes.QuadPart);
+				SetCollectorError(__func__);
+				return -1;
 			}
 
-#elif __linux__
-			// Linux implementation
-			struct statvfs diskInfo {};
-			if (statvfs("/", &diskInfo) == 0)
+			sample = mMemoryStats.GetLatest();
+			return 0;
+		}
+
+		uint64_t OS_Support::GetTotalDiskSpaceInBytes()
+		{
+			if (const SystemSnapshot* shared = ReadShared(true))
 			{
-				totalSpace = static_cast<uint64_t>(diskInfo.f_frsize) * diskInfo.f_blocks;
+				return shared->GetTotalDiskSpaceInBytes("/");
 			}
 
-#elif __APPLE__
-			// macOS implementation
-			struct statfs diskInfo {};
-			if (statfs("/", &diskInfo) == 0)
+			uint64_t totalSpace = 0;
+			uint64_t freeSpace = 0;
+			if (QueryDisk("/", totalSpace, freeSpace) != 0)
 			{
-				totalSpace = static_cast<uint64_t>(diskInfo.f_bsize) * diskInfo.f_blocks;
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
 			}
 
-#endif
-
 			return totalSpace;
 		}
 
@@ -281,34 +409,18 @@ namespace Essentials
 
 		uint64_t OS_Support::GetFreeDiskSpaceInBytes()
 		{
-			uint64_t freeSpace = 0;
-
-#ifdef _WIN32
-			// Windows implementation
-			ULARGE_INTEGER freeBytesAvailable, totalBytes, totalFreeBytes;
-			if (GetDiskFreeSpaceEx(NULL, &freeBytesAvailable, &totalBytes, &totalFreeBytes))
-			{
-				freeSpace = static_cast<uint64_t>(totalFreeBytes.QuadPart);
-			}
-
-#elif __linux__
-			// Linux implementation
-			struct statvfs diskInfo {};
-			if (statvfs("/", &diskInfo) == 0)
+			if (const SystemSnapshot* shared = ReadShared(true))
 			{
-				freeSpace = static_cast<uint64_t>(diskInfo.f_frsize) * diskInfo.f_bavail;
+				return shared->GetFreeDiskSpaceInBytes("/");
 			}
 
-#elif __APPLE__
-			// macOS implementation
-			struct statfs diskInfo {};
-			if (statfs("/", &diskInfo) == 0)
+			uint64_t totalSpace = 0;
+			uint64_t freeSpace = 0;
+			if (QueryDisk("/", totalSpace, freeSpace) != 0)
 			{
-				freeSpace = static_cast<uint64_t>(diskInfo.f_bsize) * diskInfo.f_bavail;
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
 			}
 
-#endif
-
 			return freeSpace;
 		}
 
@@ -321,8 +433,20 @@ namespace Essentials
 
 		double OS_Support::GetFreeDiskSpacePercent()
 		{
-			double totalDiskSpace = (double)GetTotalDiskSpaceInBytes();
-			double freeDiskSpace = (double)GetFreeDiskSpaceInBytes();
+			if (const SystemSnapshot* shared = ReadShared(true))
+			{
+				return shared->GetFreeDiskSpacePercent("/");
+			}
+
+			uint64_t totalSpace = 0;
+			uint64_t freeSpace = 0;
+			if (QueryDisk("/", totalSpace, freeSpace) != 0)
+			{
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
+			}
+
+			double totalDiskSpace = (double)totalSpace;
+			double freeDiskSpace = (double)freeSpace;
 			double freeSpacePercentage = 0;
 
 			if (totalDiskSpace != 0 && freeDiskSpace != 0)
@@ -335,8 +459,20 @@ namespace Essentials
 
 		double OS_Support::GetUsedDiskSpacePercent()
 		{
-			double totalDiskSpace = (double)GetTotalDiskSpaceInBytes();
-			double freeDiskSpace = (double)GetFreeDiskSpaceInBytes();
+			if (const SystemSnapshot* shared = ReadShared(true))
+			{
+				return shared->GetUsedDiskSpacePercent("/");
+			}
+
+			uint64_t totalSpace = 0;
+			uint64_t freeSpace = 0;
+			if (QueryDisk("/", totalSpace, freeSpace) != 0)
+			{
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
+			}
+
+			double totalDiskSpace = (double)totalSpace;
+			double freeDiskSpace = (double)freeSpace;
 			double usedDiskSpace = totalDiskSpace - freeDiskSpace;
 			double usedSpacePercentage = 0;
 
@@ -348,8 +484,103 @@ namespace Essentials
 			return usedSpacePercentage;
 		}
 
+		int OS_Support::GetDiskUsage(const std::string& path, DiskUsage& usage)
+		{
+			usage = DiskUsage();
+
+#ifdef __linux__
+			// Linux implementation
+			if (const MountEntry* mount = mMountTable.FindMountForPath(path))
+			{
+				usage.mountPoint = mount->mountPoint;
+				usage.fsType = mount->fsType;
+			}
+
+			if (MountTable::QueryUsage(path, usage) != 0)
+			{
+				LastError::Set(usage.error == ENOENT ? SupportError::NOT_FOUND : SupportError::SYSTEM_CALL_FAILED, __func__, usage.error);
+				return -1;
+			}
+
+			return 0;
+#else
+			// Other platforms only report capacity
+			usage.mountPoint = path;
+			if (QueryDisk(path.c_str(), usage.totalBytes, usage.freeBytes) != 0)
+			{
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
+				return -1;
+			}
+			usage.usedBytes = usage.totalBytes - usage.freeBytes;
+			usage.valid = true;
+			return 0;
+#endif
+		}
+
+		int OS_Support::GetAllDiskUsage(std::vector<DiskUsage>& usage, bool includePseudo)
+		{
+			errno = 0;
+			if (mMountTable.QueryAllUsage(usage, includePseudo) != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		MountTable& OS_Support::GetMountTable()
+		{
+			return mMountTable;
+		}
+
+		int OS_Support::GetDiskIoStats(std::vector<BlockDeviceStats>& devices)
+		{
+			// Rates cover the interval since the previous call, the first call
+			// only establishes the baseline and reports hasRates false.
+			errno = 0;
+			if (mDiskIoStats.Sample() != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return mDiskIoStats.GetDevices(devices);
+		}
+
+		int OS_Support::GetDiskIoStats(const std::string& path, BlockDeviceStats& device)
+		{
+			errno = 0;
+			if (mDiskIoStats.Sample() != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			// The device backing the filesystem that holds path
+			const BlockDeviceStats* stats = mDiskIoStats.FindDeviceForPath(mMountTable, path);
+			if (stats == nullptr)
+			{
+				LastError::Set(SupportError::NOT_FOUND, __func__);
+				return -1;
+			}
+
+			device = *stats;
+			return 0;
+		}
+
+		void OS_Support::SetDiskIoFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude)
+		{
+			mDiskIoStats.SetFilter(include, exclude);
+		}
+
 		int OS_Support::GetNumberOfEthernetDevices()
 		{
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				return shared->GetNumberOfEthernetDevices();
+			}
+
 			int result = -1;
 
 #ifdef _WIN32
@@ -393,21 +624,15 @@ namespace Essentials
 
 #elif __linux__
 			// Linux implementation
-			std::ifstream netDevFile("/proc/net/dev");
-			if (netDevFile)
+			errno = 0;
+			std::string_view netDev = mNetDevFile.Read();
+			if (!netDev.empty())
 			{
-				std::string line;
-				int count = 0;
-
-				// Count the number of lines that start with "eth" or "en" and exclude loopback interfaces
-				while (std::getline(netDevFile, line))
-				{
-					if ((line.find("eth") == 0 || line.find("en") == 0) && line.find("lo:") != 0)
-						count++;
-				}
-
-				netDevFile.close();
-				result = count;
+				result = CountEthernetDevices(netDev);
+			}
+			else
+			{
+				SetCollectorError(__func__);
 			}
 
 #elif __APPLE__
@@ -445,63 +670,174 @@ namespace Essentials
 			return result;
 	}
 
+		int OS_Support::GetNetworkInterfaceStats(std::vector<InterfaceStats>& interfaces)
+		{
+			// Rates cover the interval since the previous call, the first call
+			// only establishes the baseline and reports hasRates false.
+			errno = 0;
+			if (mNetworkStats.Sample() != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return mNetworkStats.GetInterfaces(interfaces);
+		}
+
+		void OS_Support::SetNetworkInterfaceFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude)
+		{
+			mNetworkStats.SetFilter(include, exclude);
+		}
+
+		LinkMonitor& OS_Support::GetLinkMonitor()
+		{
+			// The netlink socket is only opened by callers that want link events
+			if (mLinkMonitor.GetDescriptor() < 0 && mLinkMonitor.Open() != 0)
+			{
+				LastError::Set(SupportError::NOT_SUPPORTED, __func__, errno);
+			}
+
+			return mLinkMonitor;
+		}
+
+		int OS_Support::ScanProcesses(std::vector<ProcessInfo>& processes)
+		{
+			// CPU percentages cover the interval since the previous scan
+			errno = 0;
+			if (mProcessScanner.Scan() != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			processes = mProcessScanner.GetProcesses();
+			return 0;
+		}
+
+		int OS_Support::GetTopProcesses(ProcessSortKey key, size_t count, std::vector<ProcessInfo>& top)
+		{
+			// Answers from the last scan, scanning first when there has not been one
+			errno = 0;
+			if (mProcessScanner.GetProcesses().empty() && mProcessScanner.Scan() != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return mProcessScanner.GetTopProcesses(key, count, top);
+		}
+
+		ProcessScanner& OS_Support::GetProcessScanner()
+		{
+			return mProcessScanner;
+		}
+
+		int OS_Support::SetContainerAware(bool enable)
+		{
+			if (!enable)
+			{
+				mContainerAware = false;
+				mCgroupStats.Close();
+				mPressureMonitor.SetCgroupDirectory(std::string());
+				return 0;
+			}
+
+			errno = 0;
+			if (!mCgroupStats.IsOpen() && mCgroupStats.Open(mMountTable) != 0)
+			{
+				LastError::Set(SupportError::NOT_SUPPORTED, __func__, errno);
+				return -1;
+			}
+
+			// Baseline so the first CPU query already covers an interval
+			mCgroupStats.ReadCpu(mCgroupSample);
+			mPressureMonitor.SetCgroupDirectory(mCgroupStats.GetDirectory());
+			mContainerAware = true;
+			return 0;
+		}
+
+		bool OS_Support::IsContainerAware() const
+		{
+			return mContainerAware;
+		}
+
+		int OS_Support::GetCgroupSample(CgroupSample& sample)
+		{
+			errno = 0;
+			if (!mCgroupStats.IsOpen() && mCgroupStats.Open(mMountTable) != 0)
+			{
+				LastError::Set(SupportError::NOT_SUPPORTED, __func__, errno);
+				return -1;
+			}
+
+			errno = 0;
+			if (mCgroupStats.Sample(sample) != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		int OS_Support::GetPressure(PressureResource resource, PressureStats& stats)
+		{
+			// Stall time counts reclaim and swap-in, unlike freeram, so it shows memory trouble early
+			errno = 0;
+			if (mPressureMonitor.Read(resource, stats) != 0)
+			{
+				SetCollectorError(__func__);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		PressureMonitor& OS_Support::GetPressureMonitor()
+		{
+			return mPressureMonitor;
+		}
+
 		int OS_Support::MountStorageDevice(const std::string& device, const std::string& location)
 		{
 			int result = -1;
 
 #ifdef _WIN32
 			// Windows implementation
-			std::cout << "Mounting storage devices is not applicable on Windows." << std::endl;
+			LastError::Set(SupportError::NOT_SUPPORTED, __func__);
 			result = 0;
 
 #elif __linux__
 			// Linux implementation
-			std::string checkCommand = "mount | grep -qs '" + device + "\\|" + location + "'";
-			int checkResult = std::system(checkCommand.c_str());
+			MountRequest request;
+			request.device = device;
+			request.location = location;
 
-			if (checkResult == 0)
-			{
-				std::cout << "Drive is already mounted." << std::endl;
-				result = 0;
-			}
-			else
-			{
-				std::string mountCommand = "mount " + device + " " + location;
-				int mountResult = std::system(mountCommand.c_str());
-				if (mountResult == 0)
-				{
-					std::cout << "Drive mounted successfully." << std::endl;
-					result = 1;
-				}
-				else
-				{
-					std::cout << "Failed to mount drive." << std::endl;
-					result = -1;
-				}
-			}
+			MountResult mountResult;
+			result = MountStorageDevice(request, mountResult);
 
 #elif __APPLE__
 			// macOS implementation
-			std::string checkCommand = = "diskutil info " + device + " | grep -q 'Mount Point: " + location + "'";
+			std::string checkCommand = "diskutil info " + device + " | grep -q 'Mount Point: " + location + "'";
 			int checkResult = std::system(checkCommand.c_str());
 
 			if (checkResult == 0)
 			{
-				std::cout << "Drive is already mounted." << std::endl;
 				result = 0;
 			}
 			else
 			{
 				std::string mountCommand = "diskutil mount " + device + " " + location;
+				ProbeTimer timer(Probe::MOUNT);
 				int mountResult = std::system(mountCommand.c_str());
+				timer.Finish(mountResult == 0);
 				if (mountResult == 0)
 				{
-					std::cout << "Drive mounted successfully." << std::endl;
 					result = 1;
 				}
 				else
 				{
-					std::cout << "Failed to mount drive." << std::endl;
+					LastError::Set(SupportError::MOUNT_FAILED, __func__);
 					result = -1;
 				}
 			}
@@ -511,40 +847,58 @@ namespace Essentials
 			return result;
 		}
 
+		int OS_Support::MountStorageDevice(const MountRequest& request, MountResult& result)
+		{
+			result = MountResult();
+			result.location = request.location;
+
+			if (StorageMounter::IsMounted(mMountTable, request.device, request.location))
+			{
+				result.status = 0;
+				return 0;
+			}
+
+			if (StorageMounter::Mount(request, result) != 0)
+			{
+				LastError::Set(SupportError::MOUNT_FAILED, __func__, result.errorNumber);
+				return -1;
+			}
+
+			return 1;
+		}
+
 		int OS_Support::UnmountStorageDevice(const std::string& location)
 		{
 			int result = -1;
 
 #ifdef _WIN32
 			// Windows implementation
-			std::cout << "Unmounting storage devices is not applicable on Windows." << std::endl;
+			LastError::Set(SupportError::NOT_SUPPORTED, __func__);
 			result = 0;
 
 #elif __linux__
 			// Linux implementation
-			std::string checkCommand = "grep -qs " + location + " /proc/mounts";
-			int checkResult = std::system(checkCommand.c_str());
-
-			if (checkResult == 0)
+			if (!StorageMounter::IsMounted(mMountTable, std::string(), location))
 			{
-				std::string unmountCommand = "umount " + location;
-				int unmountResult = std::system(unmountCommand.c_str());
-				if (unmountResult == 0)
+				result = 0;
+			}
+			else
+			{
+				MountRequest request;
+				request.action = MountRequest::Action::UNMOUNT;
+				request.location = location;
+
+				MountResult unmountResult;
+				if (StorageMounter::Unmount(request, unmountResult) == 0)
 				{
-					std::cout << "Drive unmounted successfully." << std::endl;
 					result = 1;
 				}
 				else
 				{
-					std::cout << "Failed to unmount folder." << std::endl;
+					LastError::Set(SupportError::UNMOUNT_FAILED, __func__, unmountResult.errorNumber);
 					result = -1;
 				}
 			}
-			else
-			{
-				std::cout << "Location is not mounted." << std::endl;
-				result = 0;
-			}
 
 #elif __APPLE__
 			// macOS implementation
@@ -554,21 +908,21 @@ namespace Essentials
 			if (checkResult == 0)
 			{
 				std::string unmountCommand = "diskutil unmount " + location;
+				ProbeTimer timer(Probe::UNMOUNT);
 				int unmountResult = std::system(unmountCommand.c_str());
+				timer.Finish(unmountResult == 0);
 				if (unmountResult == 0)
 				{
-					std::cout << "Drive unmounted successfully." << std::endl;
 					result = 1;
 				}
 				else
 				{
-					std::cout << "Failed to unmount folder." << std::endl;
+					LastError::Set(SupportError::UNMOUNT_FAILED, __func__);
 					result = -1;
 				}
 			}
 			else
 			{
-				std::cout << "Location is not mounted." << std::endl;
 				result = 0;
 			}
 
@@ -577,21 +931,44 @@ namespace Essentials
 			return result;
 		}
 
+		int OS_Support::RunMountBatch(const std::vector<MountRequest>& requests, std::vector<MountResult>& results, unsigned int concurrency)
+		{
+			if (StorageMounter::RunBatch(mMountTable, requests, results, concurrency) != 0)
+			{
+				LastError::Set(SupportError::MOUNT_FAILED, __func__);
+				return -1;
+			}
+
+			return 0;
+		}
+
 		uint64_t OS_Support::GetSystemUpTimeInSeconds()
 		{
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				return shared->GetSystemUpTimeInSeconds();
+			}
+
 			uint64_t uptime = 0;
 
-#ifdef WIN32
+#ifdef _WIN32
 			// Windows implementation
 			ULONGLONG msCount = GetTickCount64();
 			uptime = msCount / 1000;
 #elif __linux__ || __APPLE__
 			// Linux and macOS implementation
 			struct sysinfo info {};
-			if (sysinfo(&info) == 0)
+			ProbeTimer timer(Probe::SYSINFO);
+			const int rc = sysinfo(&info);
+			timer.Finish(rc == 0);
+			if (rc == 0)
 			{
 				uptime = info.uptime;
 			}
+			else
+			{
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
+			}
 #endif
 
 			return uptime;
@@ -615,9 +992,438 @@ namespace Essentials
 			return -1;
 		}
 
-		std::string OS_Support::GetLastError()
+		int OS_Support::SetSnapshotMounts(const std::vector<std::string>& mounts)
+		{
+			if (mounts.size() > SNAPSHOT_MAX_MOUNTS)
+			{
+				LastError::Set(SupportError::INVALID_ARGUMENT, __func__);
+				return -1;
+			}
+
+			for (const std::string& mount : mounts)
+			{
+				if (mount.size() >= SNAPSHOT_MOUNT_PATH_LENGTH)
+				{
+					LastError::Set(SupportError::INVALID_ARGUMENT, __func__);
+					return -1;
+				}
+			}
+
+			mSnapshotMounts = mounts;
+			return 0;
+		}
+
+		int OS_Support::Capture(SystemSnapshot& snapshot)
+		{
+			// Client mode, the collector process already did the kernel work
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				snapshot = *shared;
+				return 0;
+			}
+
+			int result = 0;
+			snapshot = SystemSnapshot();
+			snapshot.timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+
+#ifdef __linux__
+			// Linux implementation, one sysinfo and one read of each proc file
+			struct sysinfo info {};
+			ProbeTimer timer(Probe::SYSINFO);
+			const int rc = sysinfo(&info);
+			timer.Finish(rc == 0);
+			if (rc == 0)
+			{
+				snapshot.upTimeSeconds = static_cast<uint64_t>(info.uptime);
+			}
+			else
+			{
+				LastError::Set(SupportError::SYSTEM_CALL_FAILED, __func__, errno);
+				result = -1;
+			}
+
+			// Batched, the three reads go to the kernel as one io_uring submission
+			errno = 0;
+			if (mBatchedReads)
+			{
+				mCaptureBatch.ReadAll();
+			}
+			else
+			{
+				mMeminfoFile.Read();
+				mStatFile.Read();
+				mNetDevFile.Read();
+			}
+
+			// Free is what can be allocated without swapping, page cache included
+			MemorySample memory;
+			if (MemoryStats::ParseMeminfo(mMeminfoFile.GetContents(), memory) == 0)
+			{
+				snapshot.totalRamBytes = memory.totalBytes;
+				snapshot.freeRamBytes = memory.availableBytes;
+				snapshot.usedRamBytes = memory.usedBytes;
+				snapshot.totalRamGigabytes = static_cast<double>(memory.totalBytes) / (1024.0 * 1024.0 * 1024.0);
+			}
+			else
+			{
+				SetCollectorError(__func__);
+				result = -1;
+			}
+
+			if (CpuSampler::ParseCpuTimes(mStatFile.GetContents(), snapshot.cpuTimes) != 0)
+			{
+				SetCollectorError(__func__);
+				result = -1;
+			}
+
+			std::string_view netDev = mNetDevFile.GetContents();
+			snapshot.ethernetDeviceCount = netDev.empty() ? -1 : CountEthernetDevices(netDev);
+
+#else
+			// Other platforms answer each figure with a single OS call already
+			QueryRam(snapshot.totalRamBytes, snapshot.freeRamBytes);
+			snapshot.upTimeSeconds = GetSystemUpTimeInSeconds();
+			snapshot.totalRamGigabytes = GetTotalRamInGigabytes();
+			snapshot.usedRamBytes = GetUsedRamInBytes();
+			snapshot.ethernetDeviceCount = GetNumberOfEthernetDevices();
+			if (CpuSampler::ReadCpuTimes(mStatFile, snapshot.cpuTimes) != 0)
+			{
+				LastError::Set(SupportError::NOT_SUPPORTED, __func__);
+				result = -1;
+			}
+
+#endif
+
+			// One statvfs per configured mount
+			for (const std::string& mount : mSnapshotMounts)
+			{
+				DiskSnapshot& disk = snapshot.disks[snapshot.diskCount++];
+				std::memcpy(disk.path, mount.c_str(), mount.size() + 1);
+				disk.valid = QueryDisk(mount.c_str(), disk.totalBytes, disk.freeBytes) == 0;
+			}
+
+			// Interval utilisation against the previous capture, since boot on the first
+			CpuSampler::ComputeSample(mHasCaptureCpuTimes ? mCaptureCpuTimes : CpuTimes(), snapshot.cpuTimes, snapshot.cpu);
+			snapshot.cpu.timestampNs = snapshot.timestampNs;
+			snapshot.cpu.intervalNs = mHasCaptureCpuTimes ? snapshot.timestampNs - mCaptureTimestampNs : 0;
+			mCaptureCpuTimes = snapshot.cpuTimes;
+			mCaptureTimestampNs = snapshot.timestampNs;
+			mHasCaptureCpuTimes = true;
+
+			// Container mode swaps in the cgroup's view, the raw host CPU times are kept
+			uint64_t containerTotal = 0;
+			uint64_t containerFree = 0;
+			uint64_t containerUsed = 0;
+			if (QueryContainerRam(containerTotal, containerFree, containerUsed))
+			{
+				snapshot.totalRamBytes = containerTotal;
+				snapshot.freeRamBytes = containerFree;
+				snapshot.usedRamBytes = containerUsed;
+				snapshot.totalRamGigabytes = static_cast<double>(containerTotal) / (1024.0 * 1024.0 * 1024.0);
+			}
+
+			if (mContainerAware && mCgroupStats.ReadCpu(mCgroupSample) == 0 && mCgroupSample.cpuIntervalNs > 0)
+			{
+				snapshot.cpu = CpuSample();
+				snapshot.cpu.usage = mCgroupSample.cpuUsagePercent;
+				snapshot.cpu.user = mCgroupSample.cpuUserPercent;
+				snapshot.cpu.system = mCgroupSample.cpuSystemPercent;
+				snapshot.cpu.idle = mCgroupSample.cpuUsagePercent < 100.0 ? 100.0 - mCgroupSample.cpuUsagePercent : 0.0;
+				snapshot.cpu.timestampNs = snapshot.timestampNs;
+				snapshot.cpu.intervalNs = mCgroupSample.cpuIntervalNs;
+			}
+
+			return result;
+		}
+
+		// The async calls run on one OS_Support at a time, like the blocking ones. Work
+		// that can block in the kernel (statvfs of a network mount, mount probing a
+		// device, the diskutil shell-outs) goes to the helper pool, the awaiting
+		// coroutine resumes on the executor once it is done. The tasks are lazy, so inputs
+		// are taken by value into the coroutine frame; the snapshot and MountResult are
+		// outputs and have to outlive the task.
+
+		Task<int> OS_Support::CaptureAsync(Executor& executor, SystemSnapshot& snapshot)
+		{
+			co_return co_await Offload(executor, [this, &snapshot] { return Capture(snapshot); });
+		}
+
+		Task<double> OS_Support::GetCpuUsageAsync(Executor& executor, std::chrono::milliseconds interval)
+		{
+			if (const SystemSnapshot* shared = ReadShared())
+			{
+				co_return shared->GetCpuUsagePercent();
+			}
+
+			// Two reads around a timer on the executor, no thread waits out the interval
+			if (mContainerAware && mCgroupStats.ReadCpu(mCgroupSample) == 0)
+			{
+				co_await SleepFor(executor, interval);
+				co_return mCgroupStats.ReadCpu(mCgroupSample) == 0 ? mCgroupSample.cpuUsagePercent : 0.0;
+			}
+
+			CpuTimes start;
+			errno = 0;
+			if (CpuSampler::ReadCpuTimes(mStatFile, start) != 0)
+			{
+				SetCollectorError(__func__);
+				co_return 0.0;
+			}
+
+			co_await SleepFor(executor, interval);
+
+			CpuTimes end;
+			errno = 0;
+			if (CpuSampler::ReadCpuTimes(mStatFile, end) != 0)
+			{
+				SetCollectorError(__func__);
+				co_return 0.0;
+			}
+
+			CpuSample sample;
+			CpuSampler::ComputeSample(start, end, sample);
+			co_return sample.usage;
+		}
+
+		Task<int> OS_Support::MountAsync(Executor& executor, std::string device, std::string location)
+		{
+			co_return co_await Offload(executor, [this, &device, &location] { return MountStorageDevice(device, location); });
+		}
+
+		Task<int> OS_Support::MountAsync(Executor& executor, MountRequest request, MountResult& result)
+		{
+			co_return co_await Offload(executor, [this, &request, &result] { return MountStorageDevice(request, result); });
+		}
+
+		Task<int> OS_Support::UnmountAsync(Executor& executor, std::string location)
+		{
+			co_return co_await Offload(executor, [this, &location] { return UnmountStorageDevice(location); });
+		}
+
+		void OS_Support::SetBatchedReads(bool enable)
+		{
+			mBatchedReads = enable;
+			mCaptureBatch.SetRingEnabled(enable);
+		}
+
+		bool OS_Support::IsUsingBatchedReads() const
+		{
+			return mBatchedReads && mCaptureBatch.IsUsingRing();
+		}
+
+		int OS_Support::AttachSharedMetrics(const std::string& name)
+		{
+			errno = 0;
+			if (mSharedReader.Attach(name) != 0)
+			{
+				LastError::Set(SupportError::NOT_FOUND, __func__, errno);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		void OS_Support::DetachSharedMetrics()
+		{
+			mSharedReader.Detach();
+		}
+
+		bool OS_Support::IsUsingSharedMetrics() const
+		{
+			return mSharedReader.IsAttached();
+		}
+
+		const SystemSnapshot* OS_Support::ReadShared(bool needsRootDisk)
+		{
+			// Absent, dead or stale segments fall back to direct collection. A collector
+			// publishes host figures, so container mode always reads its own cgroup. A
+			// stale segment may belong to a collector that has restarted under a new one.
+			if (mContainerAware || !mSharedReader.IsAttached() ||
+				(!mSharedReader.ReadFresh(mSharedSnapshot) && !(mSharedReader.Reconnect() && mSharedReader.ReadFresh(mSharedSnapshot))))
+			{
+				return nullptr;
+			}
+
+			if (needsRootDisk && mSharedSnapshot.FindDisk("/") == nullptr)
+			{
+				return nullptr;
+			}
+
+			return &mSharedSnapshot;
+		}
+
+		int OS_Support::SampleThermal(const char* source)
+		{
+			// Without cpufreq and thermal sysfs the open fails every time, so it is only tried once
+			if (!mThermalStats.IsOpen() && (mThermalFailed || mThermalStats.Open(CpuTopology::Get()) != 0))
+			{
+				mThermalFailed = true;
+				LastError::Set(SupportError::NOT_SUPPORTED, source);
+				return -1;
+			}
+
+			return mThermalStats.Sample();
+		}
+
+		int OS_Support::QueryRam(uint64_t& totalRAM, uint64_t& freeRAM)
+		{
+			int result = -1;
+
+#ifdef _WIN32
+			// Windows implementation
+			MEMORYSTATUSEX memoryStatus{};
+			memoryStatus.dwLength = sizeof(memoryStatus);
+			if (GlobalMemoryStatusEx(&memoryStatus))
+			{
+				totalRAM = static_cast<uint64_t>(memoryStatus.ullTotalPhys);
+				freeRAM = static_cast<uint64_t>(memoryStatus.ullAvailPhys);
+				result = 0;
+			}
+#elif __linux__
+			// Linux implementation, free is MemAvailable like ullAvailPhys on Windows.
+			// sysinfo's freeram leaves out the page cache the kernel drops on demand.
+			MemorySample memory;
+			if (MemoryStats::ParseMeminfo(mMeminfoFile.Read(), memory) == 0)
+			{
+				totalRAM = memory.totalBytes;
+				freeRAM = memory.availableBytes;
+				result = 0;
+			}
+#elif __APPLE__
+			// macOS implementation
+			int mib[2];
+			mib[0] = CTL_HW;
+			mib[1] = HW_MEMSIZE;
+			uint64_t physicalMemory;
+			size_t length = sizeof(physicalMemory);
+			if (sysctl(mib, 2, &physicalMemory, &length, nullptr, 0) == 0)
+			{
+				totalRAM = physicalMemory;
+				freeRAM = physicalMemory;
+				result = 0;
+			}
+#endif
+
+			return result;
+		}
+
+		bool OS_Support::QueryContainerRam(uint64_t& totalRAM, uint64_t& freeRAM, uint64_t& usedRAM)
+		{
+			if (!mContainerAware || mCgroupStats.ReadMemory(mCgroupSample) != 0)
+			{
+				return false;
+			}
+
+			uint64_t hostTotal = 0;
+			uint64_t hostFree = 0;
+			QueryRam(hostTotal, hostFree);
+
+			// Without a limit the cgroup may grow into whatever the host has left
+			usedRAM = mCgroupSample.memoryWorkingSetBytes;
+			totalRAM = mCgroupSample.hasMemoryLimit ? std::min(mCgroupSample.memoryLimitBytes, hostTotal) : hostTotal;
+			freeRAM = totalRAM > usedRAM ? totalRAM - usedRAM : 0;
+			if (!mCgroupSample.hasMemoryLimit)
+			{
+				freeRAM = std::min(freeRAM, hostFree);
+			}
+			return true;
+		}
+
+		int OS_Support::QueryDisk(const char* path, uint64_t& totalSpace, uint64_t& freeSpace)
+		{
+			int result = -1;
+
+#ifdef _WIN32
+			// Windows implementation, "/" means the root of the current drive
+			ULARGE_INTEGER freeBytesAvailable, totalBytes, totalFreeBytes;
+			LPCSTR directory = (path == nullptr || std::strcmp(path, "/") == 0) ? NULL : path;
+			ProbeTimer timer(Probe::STATVFS);
+			const BOOL queried = GetDiskFreeSpaceExA(directory, &freeBytesAvailable, &totalBytes, &totalFreeBytes);
+			timer.Finish(queried != FALSE);
+			if (queried)
+			{
+				totalSpace = static_cast<uint64_t>(totalBytes.QuadPart);
+				freeSpace = static_cast<uint64_t>(totalFreeBytes.QuadPart);
+				result = 0;
+			}
+
+#elif __linux__
+			// Linux implementation
+			struct statvfs diskInfo {};
+			ProbeTimer timer(Probe::STATVFS);
+			const int rc = statvfs(path, &diskInfo);
+			timer.Finish(rc == 0);
+			if (rc == 0)
+			{
+				totalSpace = static_cast<uint64_t>(diskInfo.f_frsize) * diskInfo.f_blocks;
+				freeSpace = static_cast<uint64_t>(diskInfo.f_frsize) * diskInfo.f_bavail;
+				result = 0;
+			}
+
+#elif __APPLE__
+			// macOS implementation
+			struct statfs diskInfo {};
+			ProbeTimer timer(Probe::STATVFS);
+			const int rc = statfs(path, &diskInfo);
+			timer.Finish(rc == 0);
+			if (rc == 0)
+			{
+				totalSpace = static_cast<uint64_t>(diskInfo.f_bsize) * diskInfo.f_blocks;
+				freeSpace = static_cast<uint64_t>(diskInfo.f_bsize) * diskInfo.f_bavail;
+				result = 0;
+			}
+
+#endif
+
+			return result;
+		}
+
+#ifdef __linux__
+		int OS_Support::CountEthernetDevices(std::string_view netDev)
+		{
+			int count = 0;
+
+			// Count the interface names that start with "eth" or "en", names are right aligned
+			while (!netDev.empty())
+			{
+				std::string_view line = Procfs::NextLine(netDev);
+				if (line.find(':') == std::string_view::npos)
+				{
+					continue;
+				}
+
+				std::string_view name = Procfs::NextToken(line);
+				if (name.compare(0, 3, "eth") == 0 || name.compare(0, 2, "en") == 0)
+				{
+					count++;
+				}
+			}
+
+			return count;
+		}
+#endif
+
+		int OS_Support::GetProbeStats(Probe probe, ProbeStats& stats)
+		{
+			// Process wide, every instance and thread records into the same shards
+			return Instrumentation::Collect(probe, stats);
+		}
+
+		std::string_view OS_Support::GetLastError() const
+		{
+			return LastError::Get().Message();
+		}
+
+		const ErrorInfo& OS_Support::GetLastErrorInfo() const
+		{
+			// The calling thread's, see LastError
+			return LastError::Get();
+		}
+
+		std::error_code OS_Support::GetLastErrorCode() const
 		{
-			return SupportErrorMap[mLastError];
+			return LastError::Get().Code();
 		}
 
 	}
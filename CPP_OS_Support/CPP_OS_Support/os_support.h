@@ -17,15 +17,35 @@
 #include <string>						// Strings
 #include <iostream>						// IO
 #include <sstream>						// String stream
-#include <map>							// Error map
+#include <vector>						// Per-core results, snapshot mounts
+#include <string_view>					// Proc file views
+#include <cstring>						// memcpy
+#include "support_error.h"				// Error codes and per-thread last error
+#include "cpu_sampler.h"				// Background CPU utilisation sampling
+#include "cpu_core_stats.h"				// Per-core CPU utilisation
+#include "cpu_topology.h"				// Cores, caches and NUMA nodes
+#include "thermal_stats.h"				// Frequency, temperature and throttling
+#include "system_snapshot.h"			// One-pass capture of every metric
+#include "procfs_reader.h"				// Persistent proc file handles
+#include "procfs_batch.h"				// io_uring capture reads
+#include "event_loop.h"					// Coroutine executors and tasks
+#include "shared_metrics.h"				// Client mode over a collector's segment
+#include "mount_table.h"				// Multi-mount disk space
+#include "disk_io_stats.h"				// Per-device I/O rates
+#include "memory_stats.h"				// Memory breakdown and paging rates
+#include "storage_mount.h"				// Native mount/umount
+#include "network_stats.h"				// Per-interface throughput
+#include "link_monitor.h"				// Netlink interface table and events
+#include "process_scanner.h"			// Per-process resource table
+#include "cgroup_stats.h"				// Container limits and usage
+#include "pressure_monitor.h"			// PSI averages and triggers
+#include "instrumentation.h"			// Collection path latency probes
 //
 #ifdef _WIN32
 #include <Windows.h>
 #include <psapi.h>
 #include <iphlpapi.h>
 #pragma comment(lib, "iphlpapi.lib")
-#include <Pdh.h>
-#pragma comment(lib, "Pdh.lib")
 #elif __linux__
 #include <sys/sysinfo.h>
 #include <sys/statvfs.h>
@@ -63,45 +83,112 @@ namespace Essentials
 			std::to_string(OS_SUPPORT_VERSION_PATCH) + " - b" +
 			std::to_string(OS_SUPPORT_VERSION_BUILD) + ".\n";
 
-		/// @brief OS Support enum for error codes
-		enum class SupportError : uint8_t
-		{
-			NONE,
-		};
-
-		/// @brief Error enum to readable string conversion map
-		static std::map<SupportError, std::string> SupportErrorMap
-		{
-			{SupportError::NONE,
-				std::string("Error Code " + std::to_string((uint8_t)SupportError::NONE) + ": No error.")},
-		};
-
 		class OS_Support
 		{
 		public:
 			OS_Support();
 			~OS_Support();
 			double		GetCpuUsagePercent();
+			CpuSample	GetCpuSample();
+			int			StartCpuSampling(uint32_t periodMs = 1000);
+			void		StopCpuSampling();
+			int			GetPerCoreCpuUsage(std::vector<CoreCpuUsage>& cores);
+			const CpuTopology& GetCpuTopology();
+			int			GetNumaNodeMemory(std::vector<NumaNodeMemory>& nodes);
+			int			GetCpuFrequencies(std::vector<CpuFrequency>& cpus);
+			int			GetThermalZones(std::vector<ThermalZone>& zones);
+			int			GetThrottleCounters(ThrottleCounters& counters);
+			ThermalStats& GetThermalStats();
 			double		GetTotalRamInGigabytes();
 			uint64_t	GetTotalRamInBytes();
 			uint64_t	GetFreeRamInBytes();
 			uint64_t	GetUsedRamInBytes();
 			double		GetRamUsagePercent();
+			int			GetMemoryStats(MemorySample& sample);
 			uint64_t	GetTotalDiskSpaceInBytes();
 			double		GetTotalDiskSpaceInGigabytes();
 			uint64_t	GetFreeDiskSpaceInBytes();
 			double		GetFreeDiskSpaceInGigabytes();
 			double		GetFreeDiskSpacePercent();
 			double		GetUsedDiskSpacePercent();
+			int			GetDiskUsage(const std::string& path, DiskUsage& usage);
+			int			GetAllDiskUsage(std::vector<DiskUsage>& usage, bool includePseudo = false);
+			MountTable&	GetMountTable();
+			int			GetDiskIoStats(std::vector<BlockDeviceStats>& devices);
+			int			GetDiskIoStats(const std::string& path, BlockDeviceStats& device);
+			void		SetDiskIoFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude);
 			int			GetNumberOfEthernetDevices();
+			int			GetNetworkInterfaceStats(std::vector<InterfaceStats>& interfaces);
+			void		SetNetworkInterfaceFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude);
+			LinkMonitor& GetLinkMonitor();
+			int			ScanProcesses(std::vector<ProcessInfo>& processes);
+			int			GetTopProcesses(ProcessSortKey key, size_t count, std::vector<ProcessInfo>& top);
+			ProcessScanner& GetProcessScanner();
+			int			SetContainerAware(bool enable);
+			bool		IsContainerAware() const;
+			int			GetCgroupSample(CgroupSample& sample);
+			int			GetPressure(PressureResource resource, PressureStats& stats);
+			PressureMonitor& GetPressureMonitor();
 			int			MountStorageDevice(const std::string& device, const std::string& location);
+			int			MountStorageDevice(const MountRequest& request, MountResult& result);
 			int			UnmountStorageDevice(const std::string& location);
+			int			RunMountBatch(const std::vector<MountRequest>& requests, std::vector<MountResult>& results,
+							unsigned int concurrency = 0);
 			uint64_t	GetSystemUpTimeInSeconds();
 			int			GetSystemUpTimeHMS(int& hours, int& mins, int& secs);
-			std::string GetLastError();
+			int			SetSnapshotMounts(const std::vector<std::string>& mounts);
+			int			Capture(SystemSnapshot& snapshot);
+			Task<int>	CaptureAsync(Executor& executor, SystemSnapshot& snapshot);
+			Task<double> GetCpuUsageAsync(Executor& executor, std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+			Task<int>	MountAsync(Executor& executor, std::string device, std::string location);
+			Task<int>	MountAsync(Executor& executor, MountRequest request, MountResult& result);
+			Task<int>	UnmountAsync(Executor& executor, std::string location);
+			void		SetBatchedReads(bool enable);
+			bool		IsUsingBatchedReads() const;
+			int			AttachSharedMetrics(const std::string& name = SHARED_METRICS_DEFAULT_NAME);
+			void		DetachSharedMetrics();
+			bool		IsUsingSharedMetrics() const;
+			static int	GetProbeStats(Probe probe, ProbeStats& stats);
+			std::string_view GetLastError() const;
+			const ErrorInfo& GetLastErrorInfo() const;
+			std::error_code GetLastErrorCode() const;
 		protected:
 		private:
-			SupportError	mLastError;
+			const SystemSnapshot* ReadShared(bool needsRootDisk = false);
+			int			QueryRam(uint64_t& totalRAM, uint64_t& freeRAM);
+			int			SampleThermal(const char* source);
+			bool		QueryContainerRam(uint64_t& totalRAM, uint64_t& freeRAM, uint64_t& usedRAM);
+			static int	QueryDisk(const char* path, uint64_t& totalSpace, uint64_t& freeSpace);
+#ifdef __linux__
+			static int	CountEthernetDevices(std::string_view netDev);
+#endif
+
+			CpuSampler		mCpuSampler;
+			CpuCoreStats	mCoreStats;
+			NumaMemoryStats	mNumaMemory;
+			ThermalStats	mThermalStats;
+			bool			mThermalFailed;		// Set once the thermal sysfs files could not be opened
+			NetworkStats	mNetworkStats;
+			LinkMonitor		mLinkMonitor;
+			ProcessScanner	mProcessScanner;
+			CgroupStats		mCgroupStats;
+			CgroupSample	mCgroupSample;
+			bool			mContainerAware;
+			PressureMonitor	mPressureMonitor;
+			std::vector<std::string> mSnapshotMounts;
+			CpuTimes		mCaptureCpuTimes;
+			uint64_t		mCaptureTimestampNs;
+			bool			mHasCaptureCpuTimes;
+			ProcfsFile		mStatFile;
+			ProcfsFile		mMeminfoFile;
+			ProcfsFile		mNetDevFile;
+			ProcfsBatch		mCaptureBatch;
+			bool			mBatchedReads;
+			SharedMetricsReader mSharedReader;
+			MountTable		mMountTable;
+			DiskIoStats		mDiskIoStats;
+			MemoryStats		mMemoryStats;
+			SystemSnapshot	mSharedSnapshot;
 		};
 	}
 }
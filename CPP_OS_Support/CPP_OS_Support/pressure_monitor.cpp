@@ -0,0 +1,399 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		pressure_monitor.cpp
+//!
+//! @brief		Implementation of the pressure monitor class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"pressure_monitor.h"		// Pressure Monitor Class
+#include	<cerrno>					// errno values
+#include	<chrono>					// Event timestamps
+#include	<cstdio>					// snprintf
+#include	<cstring>					// strlen
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief File names shared by /proc/pressure and cgroup directories
+		static const char* const PRESSURE_FILE_NAMES[] = { "cpu", "memory", "io" };
+
+		/// @brief epoll user data of the eventfd that stops the event thread
+		static constexpr uint64_t PRESSURE_WAKE_ID = ~0ull;
+
+		PressureMonitor::PressureMonitor()
+		{
+			mEpollFd = -1;
+			mWakeFd = -1;
+			mNextTriggerId = 1;
+			mStopRequested = false;
+			mRunning = false;
+		}
+
+		PressureMonitor::~PressureMonitor()
+		{
+			Stop();
+
+			std::lock_guard<std::mutex> lock(mMutex);
+#ifdef __linux__
+			for (auto& entry : mTriggers)
+			{
+				close(entry.second.fd);
+			}
+
+			if (mWakeFd >= 0)
+			{
+				close(mWakeFd);
+			}
+
+			if (mEpollFd >= 0)
+			{
+				close(mEpollFd);
+			}
+#endif
+			mTriggers.clear();
+		}
+
+		int PressureMonitor::SetCgroupDirectory(const std::string& directory)
+		{
+			// Existing triggers stay on the files they were registered against
+			mDirectory = directory;
+			for (ProcfsFile& file : mFiles)
+			{
+				file.Close();
+			}
+
+			return 0;
+		}
+
+		int PressureMonitor::Read(PressureResource resource, PressureStats& stats)
+		{
+			const size_t index = static_cast<size_t>(resource);
+			if (index >= static_cast<size_t>(PressureResource::RESOURCE_COUNT))
+			{
+				return -1;
+			}
+
+			ProcfsFile& file = mFiles[index];
+			if (!file.IsOpen() && file.Open(GetPath(resource).c_str(), 256) != 0)
+			{
+				return -1;
+			}
+
+			// "some avg10=0.12 avg60=0.05 avg300=0.01 total=123456", then the same for "full"
+			std::string_view text = file.Read();
+			if (text.empty())
+			{
+				return -1;
+			}
+
+			stats = PressureStats();
+			while (!text.empty())
+			{
+				std::string_view line = Procfs::NextLine(text);
+				std::string_view kind = Procfs::NextToken(line);
+				if (kind == "some")
+				{
+					ParseLine(line, stats.some);
+				}
+				else if (kind == "full")
+				{
+					ParseLine(line, stats.full);
+					stats.hasFull = true;
+				}
+			}
+
+			return 0;
+		}
+
+		int PressureMonitor::AddTrigger(PressureResource resource, bool full, uint32_t stallUs, uint32_t windowUs, Callback callback)
+		{
+#ifdef __linux__
+			if (static_cast<size_t>(resource) >= static_cast<size_t>(PressureResource::RESOURCE_COUNT) || EnsureEpoll() != 0)
+			{
+				return -1;
+			}
+
+			// Each trigger needs its own descriptor, the kernel ties it to the open file
+			int fd = open(GetPath(resource).c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+			if (fd < 0)
+			{
+				return -1;
+			}
+
+			// The window must be 500ms..10s and, for unprivileged callers, a multiple of 2s
+			char request[64];
+			std::snprintf(request, sizeof(request), "%s %u %u", full ? "full" : "some", stallUs, windowUs);
+			if (write(fd, request, std::strlen(request) + 1) < 0)
+			{
+				const int savedErrno = errno;
+				close(fd);
+				errno = savedErrno;
+				return -1;
+			}
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			const int triggerId = mNextTriggerId++;
+
+			struct epoll_event event {};
+			event.events = EPOLLPRI;
+			event.data.u64 = static_cast<uint64_t>(triggerId);
+			if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+			{
+				close(fd);
+				return -1;
+			}
+
+			Trigger& trigger = mTriggers[triggerId];
+			trigger.fd = fd;
+			trigger.resource = resource;
+			trigger.full = full;
+			trigger.callback = std::move(callback);
+
+			return triggerId;
+#else
+			(void)resource;
+			(void)full;
+			(void)stallUs;
+			(void)windowUs;
+			(void)callback;
+			return -1;
+#endif
+		}
+
+		int PressureMonitor::RemoveTrigger(int triggerId)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto found = mTriggers.find(triggerId);
+			if (found == mTriggers.end())
+			{
+				return -1;
+			}
+
+#ifdef __linux__
+			// Closing the descriptor is what unregisters the trigger in the kernel
+			epoll_ctl(mEpollFd, EPOLL_CTL_DEL, found->second.fd, nullptr);
+			close(found->second.fd);
+#endif
+			mTriggers.erase(found);
+			return 0;
+		}
+
+		int PressureMonitor::ProcessEvents(int timeoutMs)
+		{
+#ifdef __linux__
+			if (EnsureEpoll() != 0)
+			{
+				return -1;
+			}
+
+			struct epoll_event events[16];
+			int count = epoll_wait(mEpollFd, events, 16, timeoutMs);
+			if (count < 0)
+			{
+				return errno == EINTR ? 0 : -1;
+			}
+
+			const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+
+			int delivered = 0;
+			for (int i = 0; i < count; i++)
+			{
+				if (events[i].data.u64 == PRESSURE_WAKE_ID)
+				{
+					uint64_t value = 0;
+					if (read(mWakeFd, &value, sizeof(value)) < 0)
+					{
+						// Already drained by an earlier wake up
+					}
+					continue;
+				}
+
+				PressureEvent event;
+				event.triggerId = static_cast<int>(events[i].data.u64);
+				event.timestampNs = now;
+				Callback callback;
+
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					auto found = mTriggers.find(event.triggerId);
+					if (found == mTriggers.end())
+					{
+						continue;
+					}
+
+					event.resource = found->second.resource;
+					event.full = found->second.full;
+					callback = found->second.callback;
+
+					// POLLERR means the file is gone, typically because its cgroup was removed
+					if ((events[i].events & EPOLLERR) != 0)
+					{
+						event.lost = true;
+						epoll_ctl(mEpollFd, EPOLL_CTL_DEL, found->second.fd, nullptr);
+						close(found->second.fd);
+						mTriggers.erase(found);
+					}
+				}
+
+				if (callback)
+				{
+					callback(event);
+				}
+				delivered++;
+			}
+
+			return delivered;
+#else
+			(void)timeoutMs;
+			return -1;
+#endif
+		}
+
+		int PressureMonitor::Start()
+		{
+			if (mRunning)
+			{
+				return 0;
+			}
+
+			if (EnsureEpoll() != 0)
+			{
+				return -1;
+			}
+
+			mStopRequested = false;
+			mRunning = true;
+			mThread = std::thread(&PressureMonitor::Run, this);
+			return 0;
+		}
+
+		void PressureMonitor::Stop()
+		{
+			if (mThread.joinable())
+			{
+				mStopRequested = true;
+#ifdef __linux__
+				uint64_t one = 1;
+				if (write(mWakeFd, &one, sizeof(one)) < 0)
+				{
+					// The eventfd cannot overflow with a single pending wake up
+				}
+#endif
+				mThread.join();
+			}
+
+			mRunning = false;
+		}
+
+		bool PressureMonitor::IsRunning() const
+		{
+			return mRunning;
+		}
+
+		std::string PressureMonitor::GetPath(PressureResource resource) const
+		{
+			const char* name = PRESSURE_FILE_NAMES[static_cast<size_t>(resource)];
+			if (mDirectory.empty())
+			{
+				return std::string("/proc/pressure/") + name;
+			}
+
+			return mDirectory + "/" + name + ".pressure";
+		}
+
+		int PressureMonitor::EnsureEpoll()
+		{
+#ifdef __linux__
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mEpollFd >= 0)
+			{
+				return 0;
+			}
+
+			mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+			mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			if (mEpollFd < 0 || mWakeFd < 0)
+			{
+				return -1;
+			}
+
+			struct epoll_event event {};
+			event.events = EPOLLIN;
+			event.data.u64 = PRESSURE_WAKE_ID;
+			return epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event);
+#else
+			return -1;
+#endif
+		}
+
+		void PressureMonitor::ParseLine(std::string_view line, PressureLine& pressure)
+		{
+			while (!line.empty())
+			{
+				std::string_view token = Procfs::NextToken(line);
+				const size_t equals = token.find('=');
+				if (equals == std::string_view::npos)
+				{
+					continue;
+				}
+
+				std::string_view key = token.substr(0, equals);
+				std::string_view value = token.substr(equals + 1);
+
+				if (key == "total")
+				{
+					Procfs::ToUnsigned(value, pressure.totalUsec);
+					continue;
+				}
+
+				// Averages are printed with two decimals, parsed without locale or allocation
+				uint64_t whole = 0;
+				uint64_t fraction = 0;
+				const size_t dot = value.find('.');
+				Procfs::ToUnsigned(value.substr(0, dot), whole);
+				if (dot != std::string_view::npos)
+				{
+					Procfs::ToUnsigned(value.substr(dot + 1, 2), fraction);
+				}
+
+				const double parsed = static_cast<double>(whole) + static_cast<double>(fraction) / 100.0;
+				if (key == "avg10")
+				{
+					pressure.avg10 = parsed;
+				}
+				else if (key == "avg60")
+				{
+					pressure.avg60 = parsed;
+				}
+				else if (key == "avg300")
+				{
+					pressure.avg300 = parsed;
+				}
+			}
+		}
+
+		void PressureMonitor::Run()
+		{
+			// Blocks in the kernel until a threshold is crossed, costing nothing while healthy
+			while (!mStopRequested)
+			{
+				if (ProcessEvents(-1) < 0)
+				{
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		pressure_monitor.h
+//!
+//! @brief		Pressure Stall Information for CPU, memory and IO, system
+//!				wide or for one cgroup. Besides reading the averages, kernel
+//!				PSI triggers can be registered so callers are only woken
+//!				when a stall threshold is crossed.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Running flag
+#include <cstdint>						// Fixed width types
+#include <functional>					// Trigger callbacks
+#include <map>							// Trigger table
+#include <mutex>						// Trigger table guard
+#include <string>						// cgroup directory
+#include <thread>						// Event thread
+#include "procfs_reader.h"				// Persistent pressure file handles
+//
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_PRESSURE_MONITOR		// Define the pressure monitor class.
+#define     CPP_PRESSURE_MONITOR
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Resources the kernel tracks stalls for.
+		enum class PressureResource : uint8_t
+		{
+			CPU,
+			MEMORY,
+			IO,
+			RESOURCE_COUNT,
+		};
+
+		/// @brief One "some" or "full" line of a pressure file.
+		struct PressureLine
+		{
+			double		avg10 = 0.0;			// Percent of wall time stalled, 10s average
+			double		avg60 = 0.0;
+			double		avg300 = 0.0;
+			uint64_t	totalUsec = 0;			// Cumulative stall time
+		};
+
+		/// @brief Contents of one pressure file.
+		struct PressureStats
+		{
+			PressureLine	some;				// At least one task stalled
+			PressureLine	full;				// Every non-idle task stalled at once
+			bool			hasFull = false;	// System-wide CPU only reports "full" on newer kernels
+		};
+
+		/// @brief Delivered when a trigger's threshold was crossed.
+		struct PressureEvent
+		{
+			int					triggerId = -1;
+			PressureResource	resource = PressureResource::MEMORY;
+			bool				full = false;
+			bool				lost = false;	// The file went away, e.g. its cgroup was removed
+			uint64_t			timestampNs = 0;
+		};
+
+		class PressureMonitor
+		{
+		public:
+			using Callback = std::function<void(const PressureEvent& event)>;
+
+			PressureMonitor();
+			~PressureMonitor();
+			PressureMonitor(const PressureMonitor&) = delete;
+			PressureMonitor& operator=(const PressureMonitor&) = delete;
+			int			SetCgroupDirectory(const std::string& directory);
+			int			Read(PressureResource resource, PressureStats& stats);
+			int			AddTrigger(PressureResource resource, bool full, uint32_t stallUs, uint32_t windowUs, Callback callback);
+			int			RemoveTrigger(int triggerId);
+			int			ProcessEvents(int timeoutMs);
+			int			Start();
+			void		Stop();
+			bool		IsRunning() const;
+		protected:
+		private:
+			/// @brief A registered trigger and the descriptor the kernel signals on
+			struct Trigger
+			{
+				int					fd = -1;
+				PressureResource	resource = PressureResource::MEMORY;
+				bool				full = false;
+				Callback			callback;
+			};
+
+			std::string	GetPath(PressureResource resource) const;
+			int			EnsureEpoll();
+			static void	ParseLine(std::string_view line, PressureLine& pressure);
+			void		Run();
+
+			std::string					mDirectory;				// Empty for the system-wide /proc/pressure
+			ProcfsFile					mFiles[static_cast<size_t>(PressureResource::RESOURCE_COUNT)];
+			int							mEpollFd;
+			int							mWakeFd;
+			int							mNextTriggerId;
+			std::mutex					mMutex;
+			std::map<int, Trigger>		mTriggers;
+			std::thread					mThread;
+			std::atomic<bool>			mStopRequested;
+			std::atomic<bool>			mRunning;
+		};
+	}
+}
+#endif
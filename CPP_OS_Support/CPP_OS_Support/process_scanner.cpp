@@ -0,0 +1,529 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		process_scanner.cpp
+//!
+//! @brief		Implementation of the process scanner class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"process_scanner.h"			// Process Scanner Class
+#include	<algorithm>					// std::nth_element, std::sort
+#include	<chrono>					// Scan interval
+#include	<cstdio>					// snprintf
+#include	<cstring>					// memcpy
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Pids handed to a worker at a time, small enough to balance slow processes
+		static constexpr size_t SCAN_CHUNK_SIZE = 128;
+
+#ifdef __linux__
+		/// @brief Layout of the records returned by getdents64
+		struct LinuxDirent64
+		{
+			uint64_t		d_ino;
+			int64_t			d_off;
+			unsigned short	d_reclen;
+			unsigned char	d_type;
+			char			d_name[1];
+		};
+#endif
+
+		void ProcessScanner::TickMap::Reset(size_t expected)
+		{
+			// Keep the load factor under one half so probes stay short
+			size_t capacity = 64;
+			while (capacity < expected * 2)
+			{
+				capacity <<= 1;
+			}
+
+			if (mSlots.size() < capacity)
+			{
+				mSlots.resize(capacity);
+			}
+			mMask = mSlots.size() - 1;
+
+			for (Slot& slot : mSlots)
+			{
+				slot.pid = 0;
+			}
+		}
+
+		void ProcessScanner::TickMap::Insert(int32_t pid, uint64_t startTime, uint64_t ticks)
+		{
+			size_t index = (static_cast<uint32_t>(pid) * 2654435761u) & mMask;
+			while (mSlots[index].pid != 0 && mSlots[index].pid != pid)
+			{
+				index = (index + 1) & mMask;
+			}
+
+			mSlots[index].pid = pid;
+			mSlots[index].startTime = startTime;
+			mSlots[index].ticks = ticks;
+		}
+
+		bool ProcessScanner::TickMap::Find(int32_t pid, uint64_t startTime, uint64_t& ticks) const
+		{
+			if (mSlots.empty())
+			{
+				return false;
+			}
+
+			size_t index = (static_cast<uint32_t>(pid) * 2654435761u) & mMask;
+			while (mSlots[index].pid != 0)
+			{
+				if (mSlots[index].pid == pid)
+				{
+					// A different start time is a new process that reused the pid
+					if (mSlots[index].startTime != startTime)
+					{
+						return false;
+					}
+
+					ticks = mSlots[index].ticks;
+					return true;
+				}
+				index = (index + 1) & mMask;
+			}
+
+			return false;
+		}
+
+		ProcessScanner::ProcessScanner()
+		{
+			mProcFd = -1;
+			mLastScanNs = 0;
+			mTicksPerSecond = 100.0;
+			mElapsedSeconds = 0.0;
+			mReadPss = false;
+			mCountOpenFds = true;
+			mWorkerCount = 0;
+			mWorkGeneration = 0;
+			mWorkersBusy = 0;
+			mStopWorkers = false;
+			mNextChunk = 0;
+
+#ifdef __linux__
+			long ticks = sysconf(_SC_CLK_TCK);
+			if (ticks > 0)
+			{
+				mTicksPerSecond = static_cast<double>(ticks);
+			}
+#endif
+		}
+
+		ProcessScanner::~ProcessScanner()
+		{
+			StopWorkers();
+
+#ifdef __linux__
+			if (mProcFd >= 0)
+			{
+				close(mProcFd);
+			}
+#endif
+		}
+
+		void ProcessScanner::SetWorkerCount(unsigned int workers)
+		{
+			StopWorkers();
+			mWorkerCount = workers;
+		}
+
+		void ProcessScanner::SetReadPss(bool enable)
+		{
+			mReadPss = enable;
+		}
+
+		void ProcessScanner::SetCountOpenFds(bool enable)
+		{
+			mCountOpenFds = enable;
+		}
+
+		int ProcessScanner::Scan()
+		{
+#ifdef __linux__
+			if (ListPids() != 0)
+			{
+				return -1;
+			}
+
+			const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+			mElapsedSeconds = mLastScanNs != 0 ? static_cast<double>(now - mLastScanNs) / 1e9 : 0.0;
+			mLastScanNs = now;
+
+			// Slots are reused between scans, only a growing pid count allocates
+			mScanned.resize(mPids.size());
+			mScannedValid.assign(mPids.size(), 0);
+
+			if (mWorkers.empty() && mWorkerStates.empty())
+			{
+				StartWorkers();
+			}
+
+			// Wake the pool and take part in the scan from this thread as well
+			{
+				std::lock_guard<std::mutex> lock(mWorkMutex);
+				mNextChunk = 0;
+				mWorkersBusy = mWorkers.size();
+				mWorkGeneration++;
+			}
+			mWorkCondition.notify_all();
+
+			ScanRange(mWorkerStates[0]);
+
+			{
+				std::unique_lock<std::mutex> lock(mWorkMutex);
+				mDoneCondition.wait(lock, [this] { return mWorkersBusy == 0; });
+			}
+
+			// Compact the table and remember the ticks for the next interval
+			mProcesses.clear();
+			mCurrent.Reset(mPids.size());
+			for (size_t i = 0; i < mScanned.size(); i++)
+			{
+				if (mScannedValid[i])
+				{
+					const ProcessInfo& info = mScanned[i];
+					mCurrent.Insert(info.pid, info.startTime, info.cpuTicks);
+					mProcesses.push_back(info);
+				}
+			}
+			std::swap(mPrevious, mCurrent);
+
+			return 0;
+#else
+			return -1;
+#endif
+		}
+
+		const std::vector<ProcessInfo>& ProcessScanner::GetProcesses() const
+		{
+			return mProcesses;
+		}
+
+		int ProcessScanner::GetTopProcesses(ProcessSortKey key, size_t count, std::vector<ProcessInfo>& top)
+		{
+			top.clear();
+			count = std::min(count, mProcesses.size());
+			if (count == 0)
+			{
+				return 0;
+			}
+
+			mOrder.resize(mProcesses.size());
+			for (size_t i = 0; i < mOrder.size(); i++)
+			{
+				mOrder[i] = static_cast<uint32_t>(i);
+			}
+
+			auto greater = [this, key](uint32_t a, uint32_t b)
+			{
+				const ProcessInfo& left = mProcesses[a];
+				const ProcessInfo& right = mProcesses[b];
+				return key == ProcessSortKey::CPU ? left.cpuPercent > right.cpuPercent : left.rssBytes > right.rssBytes;
+			};
+
+			// Linear selection of the top N, then only those N are ordered
+			std::nth_element(mOrder.begin(), mOrder.begin() + static_cast<std::ptrdiff_t>(count - 1), mOrder.end(), greater);
+			std::sort(mOrder.begin(), mOrder.begin() + static_cast<std::ptrdiff_t>(count), greater);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				top.push_back(mProcesses[mOrder[i]]);
+			}
+
+			return 0;
+		}
+
+		int ProcessScanner::ListPids()
+		{
+#ifdef __linux__
+			if (mProcFd < 0)
+			{
+				mProcFd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+				if (mProcFd < 0)
+				{
+					return -1;
+				}
+				mDirectoryBuffer.resize(64 * 1024);
+			}
+
+			// Rewinding the same descriptor re-reads the live pid list
+			if (lseek(mProcFd, 0, SEEK_SET) != 0)
+			{
+				return -1;
+			}
+
+			mPids.clear();
+			while (true)
+			{
+				long length = syscall(SYS_getdents64, mProcFd, mDirectoryBuffer.data(), mDirectoryBuffer.size());
+				if (length < 0)
+				{
+					return -1;
+				}
+				if (length == 0)
+				{
+					break;
+				}
+
+				for (long offset = 0; offset < length;)
+				{
+					const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(mDirectoryBuffer.data() + offset);
+					offset += entry->d_reclen;
+
+					int32_t pid = 0;
+					const char* name = entry->d_name;
+					if (*name < '1' || *name > '9')
+					{
+						continue;
+					}
+
+					for (; *name >= '0' && *name <= '9'; name++)
+					{
+						pid = pid * 10 + (*name - '0');
+					}
+
+					if (*name == '\0')
+					{
+						mPids.push_back(pid);
+					}
+				}
+			}
+
+			return 0;
+#else
+			return -1;
+#endif
+		}
+
+		void ProcessScanner::ScanRange(WorkerState& state)
+		{
+			while (true)
+			{
+				const size_t begin = mNextChunk.fetch_add(SCAN_CHUNK_SIZE);
+				if (begin >= mPids.size())
+				{
+					return;
+				}
+
+				const size_t end = std::min(begin + SCAN_CHUNK_SIZE, mPids.size());
+				for (size_t i = begin; i < end; i++)
+				{
+					// A process that exits mid scan simply leaves its slot invalid
+					mScannedValid[i] = ReadProcess(state, mPids[i], mScanned[i]) ? 1 : 0;
+				}
+			}
+		}
+
+		bool ProcessScanner::ReadProcess(WorkerState& state, int32_t pid, ProcessInfo& info)
+		{
+#ifdef __linux__
+			char path[48];
+			std::snprintf(path, sizeof(path), "%d/stat", pid);
+			if (state.file.OpenAt(mProcFd, path, 1024) != 0)
+			{
+				return false;
+			}
+
+			std::string_view stat = state.file.Read();
+			state.file.Close();
+
+			// "pid (comm) state ppid ..." where comm may itself contain spaces and parentheses
+			const size_t open = stat.find('(');
+			const size_t close = stat.rfind(')');
+			if (open == std::string_view::npos || close == std::string_view::npos || close < open)
+			{
+				return false;
+			}
+
+			info = ProcessInfo();
+			info.pid = pid;
+
+			const size_t nameLength = std::min(close - open - 1, PROCESS_NAME_LENGTH - 1);
+			std::memcpy(info.name, stat.data() + open + 1, nameLength);
+			info.name[nameLength] = '\0';
+
+			// Fields are numbered as in proc(5), the state is field 3
+			std::string_view rest = stat.substr(close + 1);
+			uint64_t fields[25] = {};
+			for (size_t field = 3; field < 25 && !rest.empty(); field++)
+			{
+				std::string_view token = Procfs::NextToken(rest);
+				if (field == 3)
+				{
+					info.state = token.empty() ? '?' : token[0];
+				}
+				else if (token.empty() || token[0] == '-')
+				{
+					// Signed fields such as tty_nr, priority and nice are not used
+					continue;
+				}
+				else
+				{
+					Procfs::ToUnsigned(token, fields[field]);
+				}
+			}
+
+			static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+			info.parentPid = static_cast<int32_t>(fields[4]);
+			info.cpuTicks = fields[14] + fields[15];
+			info.threads = static_cast<uint32_t>(fields[20]);
+			info.startTime = fields[22];
+			info.rssBytes = fields[24] * pageSize;
+
+			uint64_t previousTicks = 0;
+			if (mElapsedSeconds > 0.0 && mPrevious.Find(pid, info.startTime, previousTicks) && info.cpuTicks >= previousTicks)
+			{
+				info.cpuPercent = static_cast<double>(info.cpuTicks - previousTicks) / mTicksPerSecond / mElapsedSeconds * 100.0;
+				info.hasCpuRate = true;
+			}
+
+			if (mReadPss)
+			{
+				// smaps_rollup walks every mapping in the kernel, which is why it is opt in
+				std::snprintf(path, sizeof(path), "%d/smaps_rollup", pid);
+				if (state.file.OpenAt(mProcFd, path, 2048) == 0)
+				{
+					uint64_t pss = 0;
+					if (Procfs::FindValue(state.file.Read(), "Pss", pss))
+					{
+						info.pssBytes = pss * 1024;
+					}
+					state.file.Close();
+				}
+			}
+
+			if (mCountOpenFds)
+			{
+				info.openFds = CountOpenFds(state, pid);
+			}
+
+			return true;
+#else
+			(void)state;
+			(void)pid;
+			(void)info;
+			return false;
+#endif
+		}
+
+		int32_t ProcessScanner::CountOpenFds(WorkerState& state, int32_t pid)
+		{
+#ifdef __linux__
+			char path[32];
+			std::snprintf(path, sizeof(path), "%d/fd", pid);
+			int directory = openat(mProcFd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (directory < 0)
+			{
+				return -1;
+			}
+
+			int32_t count = 0;
+			while (true)
+			{
+				long length = syscall(SYS_getdents64, directory, state.directoryBuffer.data(), state.directoryBuffer.size());
+				if (length <= 0)
+				{
+					break;
+				}
+
+				for (long offset = 0; offset < length;)
+				{
+					const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(state.directoryBuffer.data() + offset);
+					offset += entry->d_reclen;
+					if (entry->d_name[0] != '.')
+					{
+						count++;
+					}
+				}
+			}
+
+			close(directory);
+			return count;
+#else
+			(void)state;
+			(void)pid;
+			return -1;
+#endif
+		}
+
+		void ProcessScanner::StartWorkers()
+		{
+			// A handful of threads is enough, each pid costs a few syscalls on a shared kernel lock
+			unsigned int workers = mWorkerCount;
+			if (workers == 0)
+			{
+				workers = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+			}
+
+			mWorkerStates.resize(workers);
+			for (WorkerState& state : mWorkerStates)
+			{
+				state.directoryBuffer.resize(16 * 1024);
+			}
+
+			mStopWorkers = false;
+			for (unsigned int i = 1; i < workers; i++)
+			{
+				// Handing over the generation here means no scan can be missed before the thread waits
+				mWorkers.emplace_back(&ProcessScanner::WorkerLoop, this, static_cast<size_t>(i), mWorkGeneration);
+			}
+		}
+
+		void ProcessScanner::StopWorkers()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mWorkMutex);
+				mStopWorkers = true;
+			}
+			mWorkCondition.notify_all();
+
+			for (std::thread& worker : mWorkers)
+			{
+				worker.join();
+			}
+
+			mWorkers.clear();
+			mWorkerStates.clear();
+		}
+
+		void ProcessScanner::WorkerLoop(size_t index, uint64_t seenGeneration)
+		{
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mWorkMutex);
+					mWorkCondition.wait(lock, [this, seenGeneration] { return mStopWorkers || mWorkGeneration != seenGeneration; });
+					if (mStopWorkers)
+					{
+						return;
+					}
+					seenGeneration = mWorkGeneration;
+				}
+
+				ScanRange(mWorkerStates[index]);
+
+				{
+					std::lock_guard<std::mutex> lock(mWorkMutex);
+					mWorkersBusy--;
+				}
+				mDoneCondition.notify_one();
+			}
+		}
+	}
+}
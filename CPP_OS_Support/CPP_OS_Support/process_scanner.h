@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		process_scanner.h
+//!
+//! @brief		Per-process resource table built from /proc/[pid]. The walk
+//!				goes through one reused /proc directory descriptor and openat,
+//!				the pid list is split across a small worker pool, and CPU
+//!				ticks from the previous scan live in a flat hash map.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Work distribution
+#include <condition_variable>			// Worker wake up
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <mutex>						// Worker wake up
+#include <thread>						// Worker pool
+#include <vector>						// Process table
+#include "procfs_reader.h"				// Per-pid file reads
+//
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_PROCESS_SCANNER			// Define the process scanner class.
+#define     CPP_PROCESS_SCANNER
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief /proc/[pid]/comm is at most 15 characters plus the terminator
+		constexpr size_t PROCESS_NAME_LENGTH = 16;
+
+		/// @brief One row of the process table.
+		struct ProcessInfo
+		{
+			int32_t		pid = 0;
+			int32_t		parentPid = 0;
+			char		name[PROCESS_NAME_LENGTH] = {};
+			char		state = '?';				// R, S, D, Z, T...
+			uint32_t	threads = 0;
+			int32_t		openFds = -1;				// -1 when /proc/[pid]/fd is not readable
+			uint64_t	rssBytes = 0;
+			uint64_t	pssBytes = 0;				// Only filled in when PSS is enabled
+			uint64_t	cpuTicks = 0;				// utime + stime
+			uint64_t	startTime = 0;				// Ticks after boot, tells a reused pid apart
+			double		cpuPercent = 0.0;			// Of one core over the last interval, like top
+			bool		hasCpuRate = false;			// False for processes new in this scan
+		};
+
+		/// @brief Orderings answerable by GetTopProcesses.
+		enum class ProcessSortKey : uint8_t
+		{
+			CPU,
+			RSS,
+		};
+
+		class ProcessScanner
+		{
+		public:
+			ProcessScanner();
+			~ProcessScanner();
+			ProcessScanner(const ProcessScanner&) = delete;
+			ProcessScanner& operator=(const ProcessScanner&) = delete;
+			void		SetWorkerCount(unsigned int workers);
+			void		SetReadPss(bool enable);
+			void		SetCountOpenFds(bool enable);
+			int			Scan();
+			const std::vector<ProcessInfo>& GetProcesses() const;
+			int			GetTopProcesses(ProcessSortKey key, size_t count, std::vector<ProcessInfo>& top);
+		protected:
+		private:
+			/// @brief Open addressing map from pid to the ticks it had in the last scan.
+			class TickMap
+			{
+			public:
+				void		Reset(size_t expected);
+				void		Insert(int32_t pid, uint64_t startTime, uint64_t ticks);
+				bool		Find(int32_t pid, uint64_t startTime, uint64_t& ticks) const;
+			private:
+				struct Slot
+				{
+					int32_t		pid;				// 0 marks an empty slot
+					uint64_t	startTime;
+					uint64_t	ticks;
+				};
+
+				std::vector<Slot>	mSlots;
+				size_t				mMask = 0;
+			};
+
+			/// @brief Buffers owned by one worker so reads never contend.
+			struct WorkerState
+			{
+				ProcfsFile			file;
+				std::vector<char>	directoryBuffer;
+			};
+
+			int			ListPids();
+			void		ScanRange(WorkerState& state);
+			bool		ReadProcess(WorkerState& state, int32_t pid, ProcessInfo& info);
+			int32_t		CountOpenFds(WorkerState& state, int32_t pid);
+			void		StartWorkers();
+			void		StopWorkers();
+			void		WorkerLoop(size_t index, uint64_t seenGeneration);
+
+			int							mProcFd;
+			std::vector<char>			mDirectoryBuffer;
+			std::vector<int32_t>		mPids;
+			std::vector<ProcessInfo>	mScanned;			// One slot per listed pid, filled by the workers
+			std::vector<uint8_t>		mScannedValid;
+			std::vector<ProcessInfo>	mProcesses;
+			std::vector<uint32_t>		mOrder;				// Scratch for top-N selection
+			TickMap						mPrevious;
+			TickMap						mCurrent;
+			uint64_t					mLastScanNs;
+			double						mTicksPerSecond;
+			double						mElapsedSeconds;
+			bool						mReadPss;
+			bool						mCountOpenFds;
+
+			unsigned int				mWorkerCount;
+			std::vector<std::thread>	mWorkers;
+			std::vector<WorkerState>	mWorkerStates;		// Index 0 belongs to the scanning thread
+			std::mutex					mWorkMutex;
+			std::condition_variable		mWorkCondition;
+			std::condition_variable		mDoneCondition;
+			uint64_t					mWorkGeneration;
+			size_t						mWorkersBusy;
+			bool						mStopWorkers;
+			std::atomic<size_t>			mNextChunk;
+		};
+	}
+}
+#endif
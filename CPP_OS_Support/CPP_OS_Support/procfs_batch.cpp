@@ -0,0 +1,448 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		procfs_batch.cpp
+//!
+//! @brief		Implementation of the procfs batch class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"procfs_batch.h"			// Procfs Batch Class
+#include	<atomic>					// Ring head/tail ordering
+#include	<cerrno>					// errno values
+#include	<cstring>					// memset
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+#if OS_SUPPORT_HAS_IO_URING
+		static int IoUringSetup(unsigned int entries, struct io_uring_params* params)
+		{
+			return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+		}
+
+		static int IoUringEnter(int ringFd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+		{
+			return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+		}
+
+		static int IoUringRegister(int ringFd, unsigned int opcode, const void* arg, unsigned int count)
+		{
+			return static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+		}
+
+		/// @brief The kernel reads and writes the ring indices from the other side
+		static inline unsigned int LoadAcquire(unsigned int* value)
+		{
+			return std::atomic_ref<unsigned int>(*value).load(std::memory_order_acquire);
+		}
+
+		static inline void StoreRelease(unsigned int* value, unsigned int newValue)
+		{
+			std::atomic_ref<unsigned int>(*value).store(newValue, std::memory_order_release);
+		}
+#endif
+
+		ProcfsBatch::ProcfsBatch()
+		{
+			mRingEnabled = true;
+			mRingFailed = false;
+			mRingFd = -1;
+			mEntries = 0;
+#if OS_SUPPORT_HAS_IO_URING
+			mFixedFiles = false;
+			mFixedBuffers = false;
+			mSqRing = nullptr;
+			mSqRingSize = 0;
+			mCqRing = nullptr;
+			mCqRingSize = 0;
+			mSqes = nullptr;
+			mSqesSize = 0;
+			mSqHead = nullptr;
+			mSqTail = nullptr;
+			mSqMask = nullptr;
+			mSqArray = nullptr;
+			mCqHead = nullptr;
+			mCqTail = nullptr;
+			mCqMask = nullptr;
+			mCqes = nullptr;
+#endif
+		}
+
+		ProcfsBatch::~ProcfsBatch()
+		{
+			CloseRing();
+		}
+
+		int ProcfsBatch::Add(ProcfsFile& file)
+		{
+			for (ProcfsFile* existing : mFiles)
+			{
+				if (existing == &file)
+				{
+					return 0;
+				}
+			}
+
+			mFiles.push_back(&file);
+			return 1;
+		}
+
+		void ProcfsBatch::Clear()
+		{
+			mFiles.clear();
+			CloseRing();
+		}
+
+		int ProcfsBatch::ReadAll()
+		{
+			// Lazily constructed files open on their first read, as with ProcfsFile::Read
+			for (ProcfsFile* file : mFiles)
+			{
+				file->mLength = 0;
+				if (file->mFd < 0 && !file->mPath.empty())
+				{
+					file->Open(file->mPath.c_str(), file->mBuffer.size());
+				}
+			}
+
+			mCompleted.assign(mFiles.size(), 0);
+			if (mRingEnabled && !mRingFailed && !mFiles.empty())
+			{
+				ReadWithRing();
+			}
+
+			// Anything the ring did not finish, read on from where it stopped, or the
+			// whole batch without a ring
+			int result = 0;
+			for (size_t i = 0; i < mFiles.size(); i++)
+			{
+				if (mCompleted[i] != 1 && mFiles[i]->ReadRemaining().empty())
+				{
+					result = -1;
+				}
+			}
+
+			return result;
+		}
+
+		void ProcfsBatch::SetRingEnabled(bool enable)
+		{
+			mRingEnabled = enable;
+		}
+
+		bool ProcfsBatch::IsUsingRing() const
+		{
+			return mRingEnabled && mRingFd >= 0;
+		}
+
+		size_t ProcfsBatch::GetFileCount() const
+		{
+			return mFiles.size();
+		}
+
+		int ProcfsBatch::ReadWithRing()
+		{
+#if OS_SUPPORT_HAS_IO_URING
+			if (mFiles.size() > mEntries)
+			{
+				// Sized for the whole batch so one submission carries every read
+				unsigned int entries = 8;
+				while (entries < mFiles.size())
+				{
+					entries *= 2;
+				}
+
+				CloseRing();
+				if (SetupRing(entries) != 0)
+				{
+					mRingFailed = true;
+					return -1;
+				}
+			}
+
+			UpdateRegistrations();
+
+			// Multi-record seq_files hand out about a page per read, so a short completion
+			// is not the end of the file. Each round reads on where the last one stopped
+			// and a file is complete once its read returns 0. Files that fill their buffer
+			// drop out and are finished with pread, which grows the buffer.
+			const unsigned int mask = *mSqMask;
+			bool submitted = false;
+			while (true)
+			{
+				unsigned int tail = *mSqTail;
+				unsigned int queued = 0;
+
+				for (size_t i = 0; i < mFiles.size(); i++)
+				{
+					ProcfsFile& file = *mFiles[i];
+					if (file.mFd < 0 || mCompleted[i] != 0 || file.mLength == file.mBuffer.size())
+					{
+						continue;
+					}
+
+					const unsigned int index = tail & mask;
+					struct io_uring_sqe& sqe = mSqes[index];
+					std::memset(&sqe, 0, sizeof(sqe));
+					sqe.opcode = mFixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+					sqe.fd = mFixedFiles ? static_cast<int>(i) : file.mFd;
+					sqe.flags = mFixedFiles ? IOSQE_FIXED_FILE : 0;
+					sqe.addr = reinterpret_cast<uint64_t>(file.mBuffer.data() + file.mLength);
+					sqe.len = static_cast<uint32_t>(file.mBuffer.size() - file.mLength);
+					sqe.off = file.mLength;
+					sqe.buf_index = mFixedBuffers ? static_cast<uint16_t>(i) : 0;
+					sqe.user_data = i;
+
+					mSqArray[index] = index;
+					tail++;
+					queued++;
+				}
+
+				if (queued == 0)
+				{
+					return submitted ? 0 : -1;
+				}
+
+				submitted = true;
+				StoreRelease(mSqTail, tail);
+
+				// One enter submits every read of the round and waits for all of them
+				unsigned int reaped = 0;
+				unsigned int toSubmit = queued;
+				while (reaped < queued)
+				{
+					int rc = IoUringEnter(mRingFd, toSubmit, queued - reaped, IORING_ENTER_GETEVENTS);
+					if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+					{
+						// The kernel refused the ring outright, stay on pread from now on
+						if (errno == ENOSYS || errno == EPERM || errno == EOPNOTSUPP)
+						{
+							mRingFailed = true;
+						}
+						CloseRing();
+
+						// Partly read files are read again from the start with pread
+						for (size_t i = 0; i < mFiles.size(); i++)
+						{
+							if (mCompleted[i] == 0)
+							{
+								mFiles[i]->mLength = 0;
+							}
+						}
+						return -1;
+					}
+
+					// Whatever the kernel has not consumed yet goes in with the next enter
+					toSubmit = tail - LoadAcquire(mSqHead);
+
+					unsigned int head = *mCqHead;
+					const unsigned int cqTail = LoadAcquire(mCqTail);
+					while (head != cqTail)
+					{
+						const struct io_uring_cqe& cqe = mCqes[head & *mCqMask];
+						const size_t i = static_cast<size_t>(cqe.user_data);
+						ProcfsFile& file = *mFiles[i];
+
+						if (cqe.res > 0)
+						{
+							file.mLength += static_cast<size_t>(cqe.res);
+						}
+						else if (cqe.res == 0)
+						{
+							mCompleted[i] = 1;
+						}
+						else
+						{
+							// Failed read, pread starts the file over and reports the error
+							file.mLength = 0;
+							mCompleted[i] = 2;
+						}
+
+						head++;
+						reaped++;
+					}
+					StoreRelease(mCqHead, head);
+				}
+			}
+#else
+			return -1;
+#endif
+		}
+
+		int ProcfsBatch::SetupRing(unsigned int entries)
+		{
+#if OS_SUPPORT_HAS_IO_URING
+			struct io_uring_params params {};
+			params.flags = IORING_SETUP_CLAMP;
+
+			int ringFd = IoUringSetup(entries, &params);
+			if (ringFd < 0)
+			{
+				return -1;
+			}
+
+			mRingFd = ringFd;
+			mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+			mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+			mSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+			// Kernels since 5.4 map both rings with one mmap
+			const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (singleMap)
+			{
+				mSqRingSize = mCqRingSize = mSqRingSize > mCqRingSize ? mSqRingSize : mCqRingSize;
+			}
+
+			mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+			if (mSqRing == MAP_FAILED)
+			{
+				mSqRing = nullptr;
+				CloseRing();
+				return -1;
+			}
+
+			if (singleMap)
+			{
+				mCqRing = mSqRing;
+			}
+			else
+			{
+				mCqRing = mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+				if (mCqRing == MAP_FAILED)
+				{
+					mCqRing = nullptr;
+					CloseRing();
+					return -1;
+				}
+			}
+
+			void* sqes = mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+			if (sqes == MAP_FAILED)
+			{
+				CloseRing();
+				return -1;
+			}
+			mSqes = static_cast<struct io_uring_sqe*>(sqes);
+
+			char* sq = static_cast<char*>(mSqRing);
+			char* cq = static_cast<char*>(mCqRing);
+			mSqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+			mSqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+			mSqMask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+			mSqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+			mCqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+			mCqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+			mCqMask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+			mCqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+			mEntries = params.sq_entries;
+			return 0;
+#else
+			(void)entries;
+			return -1;
+#endif
+		}
+
+		void ProcfsBatch::CloseRing()
+		{
+#if OS_SUPPORT_HAS_IO_URING
+			if (mSqes != nullptr)
+			{
+				munmap(mSqes, mSqesSize);
+			}
+			if (mCqRing != nullptr && mCqRing != mSqRing)
+			{
+				munmap(mCqRing, mCqRingSize);
+			}
+			if (mSqRing != nullptr)
+			{
+				munmap(mSqRing, mSqRingSize);
+			}
+			if (mRingFd >= 0)
+			{
+				// Closing the ring drops the file and buffer registrations with it
+				close(mRingFd);
+			}
+
+			mSqes = nullptr;
+			mSqRing = nullptr;
+			mCqRing = nullptr;
+			mFixedFiles = false;
+			mFixedBuffers = false;
+			mRegisteredFds.clear();
+			mRegisteredBuffers.clear();
+#endif
+			mRingFd = -1;
+			mEntries = 0;
+		}
+
+		void ProcfsBatch::UpdateRegistrations()
+		{
+#if OS_SUPPORT_HAS_IO_URING
+			// Descriptors change when a file reopens, buffers when a file outgrows its
+			// buffer. Both are compared every batch and registered again only on change.
+			bool fdsChanged = mRegisteredFds.size() != mFiles.size();
+			bool buffersChanged = mRegisteredBuffers.size() != mFiles.size();
+
+			for (size_t i = 0; i < mFiles.size(); i++)
+			{
+				const ProcfsFile& file = *mFiles[i];
+				if (!fdsChanged && mRegisteredFds[i] != file.mFd)
+				{
+					fdsChanged = true;
+				}
+				if (!buffersChanged && (mRegisteredBuffers[i].iov_base != file.mBuffer.data() ||
+					mRegisteredBuffers[i].iov_len != file.mBuffer.size()))
+				{
+					buffersChanged = true;
+				}
+			}
+
+			if (fdsChanged)
+			{
+				if (mFixedFiles)
+				{
+					IoUringRegister(mRingFd, IORING_UNREGISTER_FILES, nullptr, 0);
+				}
+
+				// Unopened files keep their slot as -1, the kernel treats that as sparse
+				mRegisteredFds.resize(mFiles.size());
+				for (size_t i = 0; i < mFiles.size(); i++)
+				{
+					mRegisteredFds[i] = mFiles[i]->mFd;
+				}
+				mFixedFiles = IoUringRegister(mRingFd, IORING_REGISTER_FILES, mRegisteredFds.data(),
+					static_cast<unsigned int>(mRegisteredFds.size())) == 0;
+			}
+
+			if (buffersChanged)
+			{
+				if (mFixedBuffers)
+				{
+					IoUringRegister(mRingFd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+				}
+
+				// Pinning can fail against RLIMIT_MEMLOCK on older kernels, plain reads still work
+				mRegisteredBuffers.resize(mFiles.size());
+				for (size_t i = 0; i < mFiles.size(); i++)
+				{
+					mRegisteredBuffers[i].iov_base = mFiles[i]->mBuffer.data();
+					mRegisteredBuffers[i].iov_len = mFiles[i]->mBuffer.size();
+				}
+				mFixedBuffers = IoUringRegister(mRingFd, IORING_REGISTER_BUFFERS, mRegisteredBuffers.data(),
+					static_cast<unsigned int>(mRegisteredBuffers.size())) == 0;
+			}
+#endif
+		}
+	}
+}
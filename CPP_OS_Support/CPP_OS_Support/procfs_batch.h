@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		procfs_batch.h
+//!
+//! @brief		Reads a fixed set of procfs/sysfs files as one io_uring batch.
+//!				Descriptors and read buffers are registered with the ring, so
+//!				a whole sample is one io_uring_enter per page of its largest
+//!				file instead of preads for every page of every file. Falls
+//!				back to ProcfsFile::Read when io_uring is not available (old
+//!				kernel, seccomp, io_uring_disabled sysctl).
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <vector>						// File and registration tables
+#include "procfs_reader.h"				// Files and their buffers
+//
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define		OS_SUPPORT_HAS_IO_URING 1
+#else
+#define		OS_SUPPORT_HAS_IO_URING 0
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_PROCFS_BATCH			// Define the procfs batch class.
+#define     CPP_PROCFS_BATCH
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		class ProcfsBatch
+		{
+		public:
+			ProcfsBatch();
+			~ProcfsBatch();
+			ProcfsBatch(const ProcfsBatch&) = delete;
+			ProcfsBatch& operator=(const ProcfsBatch&) = delete;
+			int			Add(ProcfsFile& file);
+			void		Clear();
+			int			ReadAll();
+			void		SetRingEnabled(bool enable);
+			bool		IsUsingRing() const;
+			size_t		GetFileCount() const;
+		protected:
+		private:
+			int			ReadWithRing();
+			int			SetupRing(unsigned int entries);
+			void		CloseRing();
+			void		UpdateRegistrations();
+
+			std::vector<ProcfsFile*>	mFiles;				// Not owned, must outlive the batch
+			std::vector<uint8_t>		mCompleted;			// 1 once the ring read a file to its end, 2 when its read failed
+			bool						mRingEnabled;
+			bool						mRingFailed;		// Set once io_uring proved unusable
+			int							mRingFd;
+			unsigned int				mEntries;
+#if OS_SUPPORT_HAS_IO_URING
+			bool						mFixedFiles;		// Descriptors registered
+			bool						mFixedBuffers;		// Buffers registered
+			std::vector<int>			mRegisteredFds;
+			std::vector<struct iovec>	mRegisteredBuffers;
+			void*						mSqRing;
+			size_t						mSqRingSize;
+			void*						mCqRing;
+			size_t						mCqRingSize;
+			struct io_uring_sqe*		mSqes;
+			size_t						mSqesSize;
+			unsigned int*				mSqHead;
+			unsigned int*				mSqTail;
+			unsigned int*				mSqMask;
+			unsigned int*				mSqArray;
+			unsigned int*				mCqHead;
+			unsigned int*				mCqTail;
+			unsigned int*				mCqMask;
+			struct io_uring_cqe*		mCqes;
+#endif
+		};
+	}
+}
+#endif
@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		procfs_reader.cpp
+//!
+//! @brief		Implementation of the procfs reader class and parsers
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"procfs_reader.h"			// Procfs Reader Class
+#include	"instrumentation.h"			// Read latency probe
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		ProcfsFile::ProcfsFile()
+		{
+			mFd = -1;
+			mLength = 0;
+		}
+
+		ProcfsFile::ProcfsFile(const char* path, size_t initialCapacity)
+		{
+			mFd = -1;
+			mLength = 0;
+			mPath = path;
+			mBuffer.resize(initialCapacity > 0 ? initialCapacity : 1);
+		}
+
+		ProcfsFile::~ProcfsFile()
+		{
+			Close();
+		}
+
+		ProcfsFile::ProcfsFile(ProcfsFile&& other) noexcept
+		{
+			mFd = other.mFd;
+			mPath = std::move(other.mPath);
+			mBuffer = std::move(other.mBuffer);
+			mLength = other.mLength;
+			other.mFd = -1;
+			other.mLength = 0;
+		}
+
+		ProcfsFile& ProcfsFile::operator=(ProcfsFile&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Close();
+				mFd = other.mFd;
+				mPath = std::move(other.mPath);
+				mBuffer = std::move(other.mBuffer);
+				mLength = other.mLength;
+				other.mFd = -1;
+				other.mLength = 0;
+			}
+
+			return *this;
+		}
+
+		int ProcfsFile::Open(const char* path, size_t initialCapacity)
+		{
+#ifndef _WIN32
+			return OpenAt(AT_FDCWD, path, initialCapacity);
+#else
+			(void)path;
+			(void)initialCapacity;
+			return -1;
+#endif
+		}
+
+		int ProcfsFile::OpenAt(int directoryFd, const char* path, size_t initialCapacity)
+		{
+			Close();
+
+#ifndef _WIN32
+			mFd = ::openat(directoryFd, path, O_RDONLY | O_CLOEXEC);
+			if (mFd < 0)
+			{
+				return -1;
+			}
+
+			mPath = path;
+			if (mBuffer.size() < initialCapacity)
+			{
+				mBuffer.resize(initialCapacity > 0 ? initialCapacity : 1);
+			}
+
+			return 0;
+#else
+			(void)directoryFd;
+			(void)path;
+			(void)initialCapacity;
+			return -1;
+#endif
+		}
+
+		void ProcfsFile::Close()
+		{
+#ifndef _WIN32
+			if (mFd >= 0)
+			{
+				::close(mFd);
+			}
+#endif
+			mFd = -1;
+			mLength = 0;
+		}
+
+		bool ProcfsFile::IsOpen() const
+		{
+			return mFd >= 0;
+		}
+
+		std::string_view ProcfsFile::Read()
+		{
+			mLength = 0;
+
+#ifndef _WIN32
+			// Opened lazily when constructed with a path
+			if (mFd < 0 && (mPath.empty() || Open(mPath.c_str(), mBuffer.size()) != 0))
+			{
+				return std::string_view();
+			}
+#endif
+
+			return ReadRemaining();
+		}
+
+		std::string_view ProcfsFile::ReadRemaining()
+		{
+#ifndef _WIN32
+			if (mFd < 0)
+			{
+				mLength = 0;
+				return std::string_view();
+			}
+
+			ProbeTimer timer(Probe::PROCFS_READ);
+			while (true)
+			{
+				// A multi-record seq_file hands out about a page per read whatever the
+				// buffer size, so a short read is not the end of the file. Keep reading
+				// where the last read stopped until the kernel returns 0. Reading on from
+				// the previous position lets seq_file continue its walk instead of
+				// restarting it for each page.
+				if (mLength == mBuffer.size())
+				{
+					mBuffer.resize(mBuffer.size() * 2);
+				}
+
+				ssize_t length = ::pread(mFd, mBuffer.data() + mLength, mBuffer.size() - mLength, static_cast<off_t>(mLength));
+				if (length < 0)
+				{
+					mLength = 0;
+					timer.Finish(false);
+					return std::string_view();
+				}
+
+				if (length == 0)
+				{
+					break;
+				}
+
+				mLength += static_cast<size_t>(length);
+			}
+			timer.Finish(true);
+#endif
+
+			return std::string_view(mBuffer.data(), mLength);
+		}
+
+		std::string_view ProcfsFile::ReadPrefix()
+		{
+			mLength = 0;
+
+#ifndef _WIN32
+			if (mFd < 0 && (mPath.empty() || Open(mPath.c_str(), mBuffer.size()) != 0))
+			{
+				return std::string_view();
+			}
+
+			// Only as much as the buffer holds, for callers that parse the leading lines
+			ProbeTimer timer(Probe::PROCFS_READ);
+			ssize_t length = ::pread(mFd, mBuffer.data(), mBuffer.size(), 0);
+			timer.Finish(length >= 0);
+			if (length < 0)
+			{
+				return std::string_view();
+			}
+			mLength = static_cast<size_t>(length);
+#endif
+
+			return std::string_view(mBuffer.data(), mLength);
+		}
+
+		std::string_view ProcfsFile::GetContents() const
+		{
+			return std::string_view(mBuffer.data(), mLength);
+		}
+
+		int ProcfsFile::GetDescriptor() const
+		{
+			return mFd;
+		}
+
+		const std::string& ProcfsFile::GetPath() const
+		{
+			return mPath;
+		}
+
+		namespace Procfs
+		{
+			const char* SkipSpaces(const char* cursor, const char* end)
+			{
+				while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+				{
+					cursor++;
+				}
+
+				return cursor;
+			}
+
+			const char* ParseUnsigned(const char* cursor, const char* end, uint64_t& value)
+			{
+				cursor = SkipSpaces(cursor, end);
+
+				value = 0;
+				while (cursor < end && *cursor >= '0' && *cursor <= '9')
+				{
+					value = value * 10 + static_cast<uint64_t>(*cursor - '0');
+					cursor++;
+				}
+
+				return cursor;
+			}
+
+			std::string_view NextLine(std::string_view& text)
+			{
+				size_t lineEnd = text.find('\n');
+				std::string_view line = text.substr(0, lineEnd);
+				text.remove_prefix(lineEnd == std::string_view::npos ? text.size() : lineEnd + 1);
+
+				return line;
+			}
+
+			std::string_view NextToken(std::string_view& text)
+			{
+				size_t start = 0;
+				while (start < text.size() && (text[start] == ' ' || text[start] == '\t'))
+				{
+					start++;
+				}
+
+				size_t end = start;
+				while (end < text.size() && text[end] != ' ' && text[end] != '\t' && text[end] != '\n')
+				{
+					end++;
+				}
+
+				std::string_view token = text.substr(start, end - start);
+				text.remove_prefix(end);
+
+				return token;
+			}
+
+			bool ToUnsigned(std::string_view token, uint64_t& value)
+			{
+				if (token.empty())
+				{
+					return false;
+				}
+
+				const char* end = token.data() + token.size();
+				return ParseUnsigned(token.data(), end, value) == end;
+			}
+
+			bool FindValue(std::string_view text, std::string_view key, uint64_t& value)
+			{
+				// "Key:   1234 kB" lines as used by meminfo, status and memory.stat style files
+				// ("key 1234") are both accepted.
+				while (!text.empty())
+				{
+					std::string_view line = NextLine(text);
+					if (line.size() > key.size() && line.compare(0, key.size(), key) == 0 &&
+						(line[key.size()] == ':' || line[key.size()] == ' '))
+					{
+						const char* end = line.data() + line.size();
+						const char* cursor = line.data() + key.size() + (line[key.size()] == ':' ? 1 : 0);
+						ParseUnsigned(cursor, end, value);
+						return true;
+					}
+				}
+
+				return false;
+			}
+		}
+	}
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		procfs_reader.h
+//!
+//! @brief		Persistent procfs/sysfs file reader. The descriptor stays
+//!				open and every read is a run of preads from offset 0 to the
+//!				end of the file into a buffer that is reused, so steady-state
+//!				sampling does not allocate.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string>						// Path storage
+#include <string_view>					// Views into the read buffer
+#include <vector>						// Read buffer
+//
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_PROCFS_READER			// Define the procfs reader class.
+#define     CPP_PROCFS_READER
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		class ProcfsBatch;
+
+		class ProcfsFile
+		{
+		public:
+			ProcfsFile();
+			explicit ProcfsFile(const char* path, size_t initialCapacity = 4096);
+			~ProcfsFile();
+			ProcfsFile(const ProcfsFile&) = delete;
+			ProcfsFile& operator=(const ProcfsFile&) = delete;
+			ProcfsFile(ProcfsFile&& other) noexcept;
+			ProcfsFile& operator=(ProcfsFile&& other) noexcept;
+			int			Open(const char* path, size_t initialCapacity = 4096);
+			int			OpenAt(int directoryFd, const char* path, size_t initialCapacity = 4096);
+			void		Close();
+			bool		IsOpen() const;
+			std::string_view Read();
+			std::string_view ReadPrefix();
+			std::string_view GetContents() const;
+			int			GetDescriptor() const;
+			const std::string& GetPath() const;
+		protected:
+		private:
+			friend class ProcfsBatch;		// Fills the buffer from io_uring completions
+
+			std::string_view ReadRemaining();	// Reads on from mLength to the end of the file
+
+			int					mFd;
+			std::string			mPath;
+			std::vector<char>	mBuffer;
+			size_t				mLength;
+		};
+
+		/// @brief In-place parsers for procfs text. None of them allocate.
+		namespace Procfs
+		{
+			const char*			SkipSpaces(const char* cursor, const char* end);
+			const char*			ParseUnsigned(const char* cursor, const char* end, uint64_t& value);
+			std::string_view	NextLine(std::string_view& text);
+			std::string_view	NextToken(std::string_view& text);
+			bool				ToUnsigned(std::string_view token, uint64_t& value);
+			bool				FindValue(std::string_view text, std::string_view key, uint64_t& value);
+		}
+	}
+}
+#endif
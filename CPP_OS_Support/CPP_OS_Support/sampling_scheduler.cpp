@@ -0,0 +1,490 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		sampling_scheduler.cpp
+//!
+//! @brief		Implementation of the sampling scheduler class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"sampling_scheduler.h"		// Sampling Scheduler Class
+#include	<algorithm>					// std::min
+#include	<cstring>					// strncpy
+#include	<random>					// Start phase jitter
+//
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		static uint64_t SteadyNowNs()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		SamplingScheduler::SamplingScheduler()
+		{
+			mIntervals[static_cast<size_t>(SampledMetric::CPU)] = std::chrono::milliseconds(100);
+			mIntervals[static_cast<size_t>(SampledMetric::MEMORY)] = std::chrono::milliseconds(1000);
+			mIntervals[static_cast<size_t>(SampledMetric::DISK)] = std::chrono::milliseconds(30000);
+			mIntervals[static_cast<size_t>(SampledMetric::PROCESSES)] = std::chrono::milliseconds(5000);
+			mResolution = std::chrono::milliseconds(10);
+			mMaxJitter = std::chrono::milliseconds(1000);
+			mDiskPaths = { "/" };
+			mCursor = 0;
+			mCpuTimestampNs = 0;
+			mHasCpuTimes = false;
+			mTimerFd = -1;
+			mStopFd = -1;
+			mRunning = false;
+			mPassCount = 0;
+			mCollectionCount = 0;
+		}
+
+		SamplingScheduler::~SamplingScheduler()
+		{
+			Stop();
+		}
+
+		int SamplingScheduler::SetInterval(SampledMetric metric, std::chrono::milliseconds interval)
+		{
+			// A zero interval disables the metric
+			if (mRunning || metric >= SampledMetric::METRIC_COUNT || interval.count() < 0)
+			{
+				return -1;
+			}
+
+			mIntervals[static_cast<size_t>(metric)] = interval;
+			return 0;
+		}
+
+		int SamplingScheduler::SetDisks(const std::vector<std::string>& paths)
+		{
+			if (mRunning || paths.size() > SNAPSHOT_MAX_MOUNTS)
+			{
+				return -1;
+			}
+
+			for (const std::string& path : paths)
+			{
+				if (path.empty() || path.size() >= SNAPSHOT_MOUNT_PATH_LENGTH)
+				{
+					return -1;
+				}
+			}
+
+			mDiskPaths = paths;
+			return 0;
+		}
+
+		int SamplingScheduler::SetTickResolution(std::chrono::milliseconds resolution)
+		{
+			if (mRunning || resolution.count() <= 0)
+			{
+				return -1;
+			}
+
+			mResolution = resolution;
+			return 0;
+		}
+
+		int SamplingScheduler::SetMaxJitter(std::chrono::milliseconds jitter)
+		{
+			if (mRunning || jitter.count() < 0)
+			{
+				return -1;
+			}
+
+			mMaxJitter = jitter;
+			return 0;
+		}
+
+		std::shared_ptr<SampleQueue> SamplingScheduler::Subscribe(size_t capacity)
+		{
+			auto queue = std::make_shared<SampleQueue>(capacity);
+
+			std::lock_guard<std::mutex> lock(mSubscriberMutex);
+			mSubscribers.push_back(queue);
+			return queue;
+		}
+
+		void SamplingScheduler::Unsubscribe(const std::shared_ptr<SampleQueue>& queue)
+		{
+			std::lock_guard<std::mutex> lock(mSubscriberMutex);
+			mSubscribers.erase(std::remove(mSubscribers.begin(), mSubscribers.end(), queue), mSubscribers.end());
+		}
+
+		int SamplingScheduler::Start()
+		{
+			if (mRunning)
+			{
+				return 0;
+			}
+
+#ifdef __linux__
+			bool anyEnabled = false;
+			for (size_t i = 0; i < METRIC_COUNT; i++)
+			{
+				// Rounded to whole ticks, never faster than one tick
+				const int64_t ticks = mIntervals[i].count() == 0 ? 0 :
+					std::max<int64_t>(1, (mIntervals[i].count() + mResolution.count() / 2) / mResolution.count());
+				mEntries[i].intervalTicks = static_cast<uint64_t>(ticks);
+				mEntries[i].deadlineTick = 0;
+				anyEnabled = anyEnabled || ticks > 0;
+			}
+
+			if (!anyEnabled)
+			{
+				return -1;
+			}
+
+			mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+			mStopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			if (mTimerFd < 0 || mStopFd < 0)
+			{
+				Stop();
+				return -1;
+			}
+
+			// Every deadline is a multiple of its interval from the epoch, so a slower metric
+			// always lands on a tick a faster one is due on and they share a pass. The epoch
+			// itself starts a random distance out, hosts started together do not sample in step.
+			std::chrono::nanoseconds phase(0);
+			if (mMaxJitter.count() > 0)
+			{
+				std::random_device device;
+				std::uniform_int_distribution<int64_t> distribution(0, std::chrono::nanoseconds(mMaxJitter).count());
+				phase = std::chrono::nanoseconds(distribution(device));
+			}
+			mEpoch = std::chrono::steady_clock::now() + phase;
+
+			for (std::vector<uint8_t>& slot : mWheel)
+			{
+				slot.clear();
+			}
+			mCursor = 0;
+			for (size_t i = 0; i < METRIC_COUNT; i++)
+			{
+				if (mEntries[i].intervalTicks > 0)
+				{
+					Insert(i);
+				}
+			}
+
+			mHasCpuTimes = false;
+			mStatFile.Open("/proc/stat", 256);
+			mPassCount = 0;
+			mCollectionCount = 0;
+			mRunning = true;
+			mThread = std::thread(&SamplingScheduler::Run, this);
+
+			return 0;
+#else
+			return -1;
+#endif
+		}
+
+		void SamplingScheduler::Stop()
+		{
+#ifdef __linux__
+			if (mStopFd >= 0)
+			{
+				// Stays readable once written, the thread sees it at its next poll
+				uint64_t one = 1;
+				ssize_t written = write(mStopFd, &one, sizeof(one));
+				(void)written;
+			}
+
+			if (mThread.joinable())
+			{
+				mThread.join();
+			}
+
+			for (int* fd : { &mTimerFd, &mStopFd })
+			{
+				if (*fd >= 0)
+				{
+					close(*fd);
+					*fd = -1;
+				}
+			}
+#endif
+			mStatFile.Close();
+			mRunning = false;
+		}
+
+		bool SamplingScheduler::IsRunning() const
+		{
+			return mRunning;
+		}
+
+		uint64_t SamplingScheduler::GetPassCount() const
+		{
+			return mPassCount.load(std::memory_order_relaxed);
+		}
+
+		uint64_t SamplingScheduler::GetCollectionCount() const
+		{
+			return mCollectionCount.load(std::memory_order_relaxed);
+		}
+
+		void SamplingScheduler::Run()
+		{
+#ifdef __linux__
+			SampleBatch batch;
+			uint64_t sequence = 0;
+
+			while (true)
+			{
+				const uint64_t nextTick = FindNextTick();
+				if (ArmTimer(nextTick) != 0)
+				{
+					break;
+				}
+
+				struct pollfd fds[2] = { { mTimerFd, POLLIN, 0 }, { mStopFd, POLLIN, 0 } };
+				if (poll(fds, 2, -1) < 0)
+				{
+					continue;
+				}
+
+				if (fds[1].revents != 0)
+				{
+					break;
+				}
+
+				uint64_t expirations = 0;
+				if (read(mTimerFd, &expirations, sizeof(expirations)) < 0)
+				{
+					continue;
+				}
+
+				const uint64_t nowTick = GetCurrentTick();
+				if (nowTick < nextTick)
+				{
+					continue;
+				}
+
+				const uint32_t due = Advance(nowTick);
+				if (due == 0)
+				{
+					continue;
+				}
+
+				batch = SampleBatch();
+				batch.sequence = sequence++;
+				Collect(due, batch);
+				Publish(batch);
+				mPassCount.fetch_add(1, std::memory_order_relaxed);
+			}
+#endif
+		}
+
+		void SamplingScheduler::Insert(size_t metric)
+		{
+			mWheel[mEntries[metric].deadlineTick % WHEEL_SLOTS].push_back(static_cast<uint8_t>(metric));
+		}
+
+		uint32_t SamplingScheduler::Advance(uint64_t nowTick)
+		{
+			// Every slot between the cursor and now, a late wakeup catches up on all of them
+			uint32_t due = 0;
+			const uint64_t steps = std::min<uint64_t>(nowTick - mCursor + 1, WHEEL_SLOTS);
+			for (uint64_t step = 0; step < steps; step++)
+			{
+				std::vector<uint8_t>& slot = mWheel[(mCursor + step) % WHEEL_SLOTS];
+				for (size_t i = slot.size(); i-- > 0;)
+				{
+					if (mEntries[slot[i]].deadlineTick <= nowTick)
+					{
+						due |= 1u << slot[i];
+						slot[i] = slot.back();
+						slot.pop_back();
+					}
+				}
+			}
+			mCursor = nowTick + 1;
+
+			for (size_t metric = 0; metric < METRIC_COUNT; metric++)
+			{
+				if ((due & (1u << metric)) == 0)
+				{
+					continue;
+				}
+
+				// Missed deadlines are skipped rather than collected back to back
+				ScheduleEntry& entry = mEntries[metric];
+				entry.deadlineTick += entry.intervalTicks;
+				if (entry.deadlineTick <= nowTick)
+				{
+					entry.deadlineTick += ((nowTick - entry.deadlineTick) / entry.intervalTicks + 1) * entry.intervalTicks;
+				}
+				Insert(metric);
+			}
+
+			return due;
+		}
+
+		uint64_t SamplingScheduler::FindNextTick() const
+		{
+			for (uint64_t step = 0; step < WHEEL_SLOTS; step++)
+			{
+				const uint64_t tick = mCursor + step;
+				for (uint8_t metric : mWheel[tick % WHEEL_SLOTS])
+				{
+					if (mEntries[metric].deadlineTick == tick)
+					{
+						return tick;
+					}
+				}
+			}
+
+			// Nothing due this revolution, wake at its end and look again
+			return mCursor + WHEEL_SLOTS;
+		}
+
+		uint64_t SamplingScheduler::GetCurrentTick() const
+		{
+			const auto now = std::chrono::steady_clock::now();
+			if (now < mEpoch)
+			{
+				return 0;
+			}
+			return static_cast<uint64_t>((now - mEpoch) / mResolution);
+		}
+
+		int SamplingScheduler::ArmTimer(uint64_t tick)
+		{
+#ifdef __linux__
+			const auto deadline = mEpoch + tick * mResolution;
+			const auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+
+			struct itimerspec spec {};
+			spec.it_value.tv_sec = static_cast<time_t>(sinceEpoch / 1000000000);
+			spec.it_value.tv_nsec = static_cast<long>(sinceEpoch % 1000000000);
+			if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+			{
+				spec.it_value.tv_nsec = 1;
+			}
+
+			return timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0 ? 0 : -1;
+#else
+			(void)tick;
+			return -1;
+#endif
+		}
+
+		void SamplingScheduler::Collect(uint32_t due, SampleBatch& batch)
+		{
+			batch.timestampNs = SteadyNowNs();
+
+			auto collected = [&batch, this](SampledMetric metric, bool ok)
+			{
+				const uint32_t bit = 1u << static_cast<uint32_t>(metric);
+				batch.metrics |= bit;
+				batch.failedMetrics |= ok ? 0 : bit;
+				mCollectionCount.fetch_add(1, std::memory_order_relaxed);
+			};
+
+			if (due & (1u << static_cast<uint32_t>(SampledMetric::CPU)))
+			{
+				// The aggregate line leads /proc/stat, the rest of the file is never copied
+				CpuTimes times;
+				const bool ok = CpuSampler::ParseCpuTimes(mStatFile.ReadPrefix(), times) == 0;
+				if (ok)
+				{
+					ComputeSample(times, batch);
+				}
+				collected(SampledMetric::CPU, ok);
+			}
+
+			if (due & (1u << static_cast<uint32_t>(SampledMetric::MEMORY)))
+			{
+				const bool ok = mMemory.Collect(mMemorySnapshot) == 0;
+				if (ok)
+				{
+					batch.totalRamBytes = mMemorySnapshot.Get<Mem::Total>();
+					batch.freeRamBytes = mMemorySnapshot.Get<Mem::Free>();
+					batch.availableRamBytes = mMemorySnapshot.Get<Mem::Available>();
+					batch.usedRamBytes = mMemorySnapshot.Get<Mem::Used>();
+				}
+				collected(SampledMetric::MEMORY, ok);
+			}
+
+			if (due & (1u << static_cast<uint32_t>(SampledMetric::DISK)))
+			{
+				bool ok = true;
+				for (const std::string& path : mDiskPaths)
+				{
+					DiskSnapshot& disk = batch.disks[batch.diskCount++];
+					std::strncpy(disk.path, path.c_str(), SNAPSHOT_MOUNT_PATH_LENGTH - 1);
+					if (MountTable::QueryUsage(path, mDiskUsage) == 0)
+					{
+						disk.totalBytes = mDiskUsage.totalBytes;
+						disk.freeBytes = mDiskUsage.freeBytes;
+						disk.valid = true;
+					}
+					else
+					{
+						ok = false;
+					}
+				}
+				collected(SampledMetric::DISK, ok);
+			}
+
+			if (due & (1u << static_cast<uint32_t>(SampledMetric::PROCESSES)))
+			{
+				const bool ok = mProcessScanner.Scan() == 0;
+				if (ok)
+				{
+					batch.processCount = static_cast<uint32_t>(mProcessScanner.GetProcesses().size());
+					mProcessScanner.GetTopProcesses(ProcessSortKey::CPU, SAMPLE_TOP_PROCESSES, mTopProcesses);
+					for (const ProcessInfo& process : mTopProcesses)
+					{
+						ProcessSummary& summary = batch.topProcesses[batch.topProcessCount++];
+						summary.pid = process.pid;
+						std::memcpy(summary.name, process.name, PROCESS_NAME_LENGTH);
+						summary.cpuPercent = process.cpuPercent;
+						summary.rssBytes = process.rssBytes;
+					}
+				}
+				collected(SampledMetric::PROCESSES, ok);
+			}
+		}
+
+		void SamplingScheduler::ComputeSample(const CpuTimes& times, SampleBatch& batch)
+		{
+			// The first collection reports the since-boot average, like CpuSampler's seed
+			CpuSampler::ComputeSample(mHasCpuTimes ? mCpuTimes : CpuTimes(), times, batch.cpu);
+			batch.cpu.timestampNs = batch.timestampNs;
+			batch.cpu.intervalNs = mHasCpuTimes ? batch.timestampNs - mCpuTimestampNs : 0;
+			mCpuTimes = times;
+			mCpuTimestampNs = batch.timestampNs;
+			mHasCpuTimes = true;
+		}
+
+		void SamplingScheduler::Publish(const SampleBatch& batch)
+		{
+			std::lock_guard<std::mutex> lock(mSubscriberMutex);
+			for (const std::shared_ptr<SampleQueue>& queue : mSubscribers)
+			{
+				queue->Push(batch);
+			}
+		}
+	}
+}
@@ -0,0 +1,169 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		sampling_scheduler.h
+//!
+//! @brief		One thread sampling several metrics at their own intervals.
+//!				Deadlines live on a hashed timer wheel and the thread sleeps
+//!				on a timerfd armed for the next occupied tick. Metrics due on
+//!				the same tick are collected in one pass and handed to every
+//!				subscriber as a single SampleBatch.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <array>						// Wheel slots and schedule entries
+#include <atomic>						// Running flag and counters
+#include <chrono>						// Intervals and tick resolution
+#include <cstdint>						// Fixed width types
+#include <memory>						// Shared subscriber queues
+#include <mutex>						// Subscriber list
+#include <string>						// Disk paths
+#include <thread>						// Scheduler thread
+#include <vector>						// Slot contents, subscribers
+#include "bounded_queue.h"				// Subscriber queues
+#include "cpu_sampler.h"				// CPU interval math
+#include "mount_table.h"				// Disk usage queries
+#include "process_scanner.h"			// Process table
+#include "procfs_reader.h"				// Persistent /proc/stat handle
+#include "selective_snapshot.h"			// Single read of /proc/meminfo
+#include "system_snapshot.h"			// DiskSnapshot
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SAMPLING_SCHEDULER		// Define the sampling scheduler class.
+#define     CPP_SAMPLING_SCHEDULER
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Metrics the scheduler can sample, each on its own interval
+		enum class SampledMetric : uint8_t
+		{
+			CPU,
+			MEMORY,
+			DISK,
+			PROCESSES,
+			METRIC_COUNT,
+		};
+
+		/// @brief Busiest processes carried by a batch
+		constexpr size_t SAMPLE_TOP_PROCESSES = 8;
+
+		/// @brief One row of the busiest processes.
+		struct ProcessSummary
+		{
+			int32_t		pid = 0;
+			char		name[PROCESS_NAME_LENGTH] = {};
+			double		cpuPercent = 0.0;
+			uint64_t	rssBytes = 0;
+		};
+
+		/// @brief Result of one collection pass. Only the metrics flagged in the mask
+		///			were collected, the fields of the others are left zeroed.
+		struct SampleBatch
+		{
+			uint64_t		sequence = 0;				// Pass number, gaps show dropped batches
+			uint64_t		timestampNs = 0;			// Steady clock time of the pass
+			uint32_t		metrics = 0;				// Bit per SampledMetric collected
+			uint32_t		failedMetrics = 0;			// Bit per SampledMetric whose read failed
+			CpuSample		cpu;						// Since the previous CPU collection
+			uint64_t		totalRamBytes = 0;
+			uint64_t		freeRamBytes = 0;
+			uint64_t		availableRamBytes = 0;
+			uint64_t		usedRamBytes = 0;			// MemTotal - MemAvailable
+			uint32_t		diskCount = 0;
+			DiskSnapshot	disks[SNAPSHOT_MAX_MOUNTS];
+			uint32_t		processCount = 0;
+			uint32_t		topProcessCount = 0;
+			ProcessSummary	topProcesses[SAMPLE_TOP_PROCESSES];
+
+			bool Has(SampledMetric metric) const
+			{
+				return (metrics & (1u << static_cast<uint32_t>(metric))) != 0;
+			}
+		};
+
+		using SampleQueue = BoundedQueue<SampleBatch>;
+
+		class SamplingScheduler
+		{
+		public:
+			SamplingScheduler();
+			~SamplingScheduler();
+			SamplingScheduler(const SamplingScheduler&) = delete;
+			SamplingScheduler& operator=(const SamplingScheduler&) = delete;
+			int			SetInterval(SampledMetric metric, std::chrono::milliseconds interval);
+			int			SetDisks(const std::vector<std::string>& paths);
+			int			SetTickResolution(std::chrono::milliseconds resolution);
+			int			SetMaxJitter(std::chrono::milliseconds jitter);
+			std::shared_ptr<SampleQueue> Subscribe(size_t capacity = 64);
+			void		Unsubscribe(const std::shared_ptr<SampleQueue>& queue);
+			int			Start();
+			void		Stop();
+			bool		IsRunning() const;
+			uint64_t	GetPassCount() const;
+			uint64_t	GetCollectionCount() const;
+		protected:
+		private:
+			/// @brief Slots on the wheel, one revolution is this many ticks
+			static constexpr size_t WHEEL_SLOTS = 512;
+			static constexpr size_t METRIC_COUNT = static_cast<size_t>(SampledMetric::METRIC_COUNT);
+
+			struct ScheduleEntry
+			{
+				uint64_t	intervalTicks = 0;			// 0 when the metric is disabled
+				uint64_t	deadlineTick = 0;
+			};
+
+			void		Run();
+			void		Insert(size_t metric);
+			uint32_t	Advance(uint64_t nowTick);
+			uint64_t	FindNextTick() const;
+			uint64_t	GetCurrentTick() const;
+			int			ArmTimer(uint64_t tick);
+			void		Collect(uint32_t due, SampleBatch& batch);
+			void		ComputeSample(const CpuTimes& times, SampleBatch& batch);
+			void		Publish(const SampleBatch& batch);
+
+			std::chrono::milliseconds	mIntervals[METRIC_COUNT];
+			std::chrono::milliseconds	mResolution;
+			std::chrono::milliseconds	mMaxJitter;
+			std::vector<std::string>	mDiskPaths;
+
+			// Only touched by the scheduler thread once started
+			std::array<ScheduleEntry, METRIC_COUNT>	mEntries;
+			std::array<std::vector<uint8_t>, WHEEL_SLOTS> mWheel;
+			uint64_t					mCursor;				// First tick the wheel has not examined yet
+			std::chrono::steady_clock::time_point mEpoch;		// Tick 0, shifted by the jitter
+			ProcfsFile					mStatFile;
+			CpuTimes					mCpuTimes;
+			uint64_t					mCpuTimestampNs;
+			bool						mHasCpuTimes;
+			Snapshot<Mem::Total, Mem::Free, Mem::Available, Mem::Used>::Collector mMemory;
+			Snapshot<Mem::Total, Mem::Free, Mem::Available, Mem::Used> mMemorySnapshot;
+			DiskUsage					mDiskUsage;
+			ProcessScanner				mProcessScanner;
+			std::vector<ProcessInfo>	mTopProcesses;
+
+			std::mutex					mSubscriberMutex;
+			std::vector<std::shared_ptr<SampleQueue>> mSubscribers;
+			std::thread					mThread;
+			int							mTimerFd;
+			int							mStopFd;
+			std::atomic<bool>			mRunning;
+			std::atomic<uint64_t>		mPassCount;
+			std::atomic<uint64_t>		mCollectionCount;
+		};
+	}
+}
+#endif
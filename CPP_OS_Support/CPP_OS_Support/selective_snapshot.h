@@ -0,0 +1,541 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		selective_snapshot.h
+//!
+//! @brief		Compile-time selected snapshot. The metric list decides which
+//!				kernel sources are read, e.g.
+//!
+//!				Snapshot<Mem::Available, Disk::Free<"/data">, Cpu::Total> snapshot;
+//!				Snapshot<...>::Collector collector;
+//!				collector.Collect(snapshot);
+//!				uint64_t available = snapshot.Get<Mem::Available>();
+//!
+//!				reads /proc/meminfo, the first line of /proc/stat and one
+//!				statvfs of /data and nothing else. The values are stored back
+//!				to back with no slot for metrics that were not asked for.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <array>						// Unique disk paths
+#include <chrono>						// Snapshot timestamp
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string_view>					// Paths and proc file views
+#include <tuple>						// Packed values
+#include <type_traits>					// Metric traits
+#include "procfs_reader.h"				// Persistent proc file handles
+#include "cpu_sampler.h"				// CpuTimes parsing and interval math
+#include "instrumentation.h"			// sysinfo and statvfs probes
+//
+#ifdef __linux__
+#include <sys/statvfs.h>
+#include <sys/sysinfo.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SELECTIVE_SNAPSHOT		// Define the selective snapshot templates.
+#define     CPP_SELECTIVE_SNAPSHOT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Kernel sources a metric is answered from
+		enum SnapshotSource : uint32_t
+		{
+			SOURCE_NONE		= 0,
+			SOURCE_MEMINFO	= 1u << 0,		// /proc/meminfo
+			SOURCE_STAT		= 1u << 1,		// First line of /proc/stat
+			SOURCE_SYSINFO	= 1u << 2,		// sysinfo(2)
+			SOURCE_STATVFS	= 1u << 3,		// statvfs(3) of each distinct disk path
+		};
+
+		/// @brief String literal usable as a template argument, Disk::Free<"/data">
+		template <size_t N>
+		struct FixedString
+		{
+			char value[N] = {};
+
+			constexpr FixedString(const char (&text)[N])
+			{
+				for (size_t i = 0; i < N; i++)
+				{
+					value[i] = text[i];
+				}
+			}
+
+			constexpr std::string_view View() const
+			{
+				return std::string_view(value, N - 1);
+			}
+		};
+
+		/// @brief Capacity of one disk path, filled by a single statvfs
+		struct DiskReading
+		{
+			uint64_t	totalBytes = 0;
+			uint64_t	freeBytes = 0;
+			bool		valid = false;
+		};
+
+		/// @brief What the collector read this pass. Only the parts of the requested
+		///			sources are filled in, metrics only look at their own source.
+		struct SnapshotSources
+		{
+			std::string_view	meminfo;
+			CpuSample			cpu;
+			uint64_t			upTimeSeconds = 0;
+			uint64_t			processCount = 0;
+			double				loadAverage[3] = {};
+		};
+
+		/// @brief meminfo values are in KiB
+		inline uint64_t MeminfoBytes(std::string_view meminfo, std::string_view key)
+		{
+			uint64_t value = 0;
+			return Procfs::FindValue(meminfo, key, value) ? value * 1024 : 0;
+		}
+
+		namespace Mem
+		{
+			struct Total
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read) { return MeminfoBytes(read.meminfo, "MemTotal"); }
+			};
+
+			struct Free
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read) { return MeminfoBytes(read.meminfo, "MemFree"); }
+			};
+
+			struct Available
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read) { return MeminfoBytes(read.meminfo, "MemAvailable"); }
+			};
+
+			/// @brief MemTotal - MemAvailable, what applications cannot get back
+			struct Used
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read)
+				{
+					const uint64_t total = MeminfoBytes(read.meminfo, "MemTotal");
+					const uint64_t available = MeminfoBytes(read.meminfo, "MemAvailable");
+					return total > available ? total - available : 0;
+				}
+			};
+
+			struct Cached
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read) { return MeminfoBytes(read.meminfo, "Cached"); }
+			};
+
+			struct SwapTotal
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read) { return MeminfoBytes(read.meminfo, "SwapTotal"); }
+			};
+
+			struct SwapFree
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_MEMINFO;
+				static ValueType Extract(const SnapshotSources& read) { return MeminfoBytes(read.meminfo, "SwapFree"); }
+			};
+		}
+
+		/// @brief Percentages over the interval since the collector's previous pass,
+		///			since boot on the first one.
+		namespace Cpu
+		{
+			struct Total
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_STAT;
+				static ValueType Extract(const SnapshotSources& read) { return read.cpu.usage; }
+			};
+
+			struct User
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_STAT;
+				static ValueType Extract(const SnapshotSources& read) { return read.cpu.user; }
+			};
+
+			struct System
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_STAT;
+				static ValueType Extract(const SnapshotSources& read) { return read.cpu.system; }
+			};
+
+			struct IoWait
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_STAT;
+				static ValueType Extract(const SnapshotSources& read) { return read.cpu.iowait; }
+			};
+
+			struct Steal
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_STAT;
+				static ValueType Extract(const SnapshotSources& read) { return read.cpu.steal; }
+			};
+		}
+
+		namespace Sys
+		{
+			struct UpTime
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_SYSINFO;
+				static ValueType Extract(const SnapshotSources& read) { return read.upTimeSeconds; }
+			};
+
+			struct Processes
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_SYSINFO;
+				static ValueType Extract(const SnapshotSources& read) { return read.processCount; }
+			};
+
+			struct Load1
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_SYSINFO;
+				static ValueType Extract(const SnapshotSources& read) { return read.loadAverage[0]; }
+			};
+
+			struct Load5
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_SYSINFO;
+				static ValueType Extract(const SnapshotSources& read) { return read.loadAverage[1]; }
+			};
+
+			struct Load15
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_SYSINFO;
+				static ValueType Extract(const SnapshotSources& read) { return read.loadAverage[2]; }
+			};
+		}
+
+		/// @brief Every metric on the same path shares one statvfs
+		namespace Disk
+		{
+			template <FixedString Path>
+			struct Total
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_STATVFS;
+				static constexpr std::string_view path = Path.View();
+				static ValueType Extract(const DiskReading& disk) { return disk.totalBytes; }
+			};
+
+			template <FixedString Path>
+			struct Free
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_STATVFS;
+				static constexpr std::string_view path = Path.View();
+				static ValueType Extract(const DiskReading& disk) { return disk.freeBytes; }
+			};
+
+			template <FixedString Path>
+			struct Used
+			{
+				using ValueType = uint64_t;
+				static constexpr uint32_t sources = SOURCE_STATVFS;
+				static constexpr std::string_view path = Path.View();
+				static ValueType Extract(const DiskReading& disk) { return disk.totalBytes - disk.freeBytes; }
+			};
+
+			template <FixedString Path>
+			struct FreePercent
+			{
+				using ValueType = double;
+				static constexpr uint32_t sources = SOURCE_STATVFS;
+				static constexpr std::string_view path = Path.View();
+				static ValueType Extract(const DiskReading& disk)
+				{
+					return disk.totalBytes > 0 ? static_cast<double>(disk.freeBytes) * 100.0 / static_cast<double>(disk.totalBytes) : 0.0;
+				}
+			};
+		}
+
+		template <typename... Metrics>
+		class SnapshotCollector;
+
+		template <typename Metric>
+		inline constexpr bool IS_DISK_METRIC = (Metric::sources & SOURCE_STATVFS) != 0;
+
+		template <typename Metric>
+		constexpr std::string_view DiskPathOf()
+		{
+			if constexpr (IS_DISK_METRIC<Metric>)
+			{
+				return Metric::path;
+			}
+			else
+			{
+				return std::string_view();
+			}
+		}
+
+		/// @brief Distinct disk paths of a metric list in first-use order, each
+		///			disk metric reads the slot of its path.
+		template <typename... Metrics>
+		struct SnapshotDiskPaths
+		{
+			struct Table
+			{
+				std::array<std::string_view, sizeof...(Metrics)>	paths{};
+				size_t												count = 0;
+			};
+
+			static constexpr Table MakeTable()
+			{
+				constexpr std::string_view all[] = { DiskPathOf<Metrics>()... };
+				Table table;
+				for (std::string_view path : all)
+				{
+					bool seen = path.empty();
+					for (size_t i = 0; i < table.count && !seen; i++)
+					{
+						seen = table.paths[i] == path;
+					}
+					if (!seen)
+					{
+						table.paths[table.count++] = path;
+					}
+				}
+				return table;
+			}
+
+			static constexpr Table	TABLE = MakeTable();
+			static constexpr size_t	COUNT = TABLE.count;
+
+			template <typename Metric>
+			static constexpr size_t SlotOf()
+			{
+				for (size_t i = 0; i < COUNT; i++)
+				{
+					if (TABLE.paths[i] == Metric::path)
+					{
+						return i;
+					}
+				}
+				return 0;
+			}
+		};
+
+		/// @brief Stands in for state of a source the snapshot does not use. Each
+		///			member gets its own tag, empty members of one type cannot overlap.
+		template <int Tag>
+		struct UnusedSource
+		{
+		};
+
+		/// @brief Index of a type in a pack, a compile error when absent or repeated
+		template <typename Wanted, typename... Types>
+		constexpr size_t IndexOfMetric()
+		{
+			constexpr bool matches[] = { std::is_same_v<Wanted, Types>... };
+			size_t index = sizeof...(Types);
+			size_t count = 0;
+			for (size_t i = 0; i < sizeof...(Types); i++)
+			{
+				if (matches[i])
+				{
+					index = i;
+					count++;
+				}
+			}
+			return count == 1 ? index : sizeof...(Types);
+		}
+
+		/// @brief The requested metrics' values, back to back in declaration order.
+		template <typename... Metrics>
+		struct Snapshot
+		{
+			static_assert(sizeof...(Metrics) > 0, "a snapshot needs at least one metric");
+
+			using Collector = SnapshotCollector<Metrics...>;
+
+			/// @brief Union of the sources the metrics need
+			static constexpr uint32_t SOURCES = (Metrics::sources | ...);
+
+			uint64_t timestampNs = 0;
+			std::tuple<typename Metrics::ValueType...> values;
+
+			static_assert(sizeof(values) == (sizeof(typename Metrics::ValueType) + ...), "snapshot values must pack without padding");
+
+			template <typename Metric>
+			typename Metric::ValueType Get() const
+			{
+				constexpr size_t index = IndexOfMetric<Metric, Metrics...>();
+				static_assert(index < sizeof...(Metrics), "metric is not part of this snapshot, or listed twice");
+				return std::get<index>(values);
+			}
+		};
+
+		/// @brief Reads exactly the sources the snapshot's metrics need. Handles are
+		///			kept open between passes, files for unused sources are never opened.
+		template <typename... Metrics>
+		class SnapshotCollector
+		{
+		public:
+			using SnapshotType = Snapshot<Metrics...>;
+
+			SnapshotCollector()
+			{
+				// Opened lazily on the first pass, like every other ProcfsFile
+				if constexpr (NEEDS_MEMINFO)
+				{
+					mMeminfoFile = ProcfsFile("/proc/meminfo", 4096);
+				}
+				if constexpr (NEEDS_STAT)
+				{
+					mStatFile = ProcfsFile("/proc/stat", 256);
+					mHasCpuTimes = false;
+				}
+			}
+
+			int Collect(SnapshotType& snapshot)
+			{
+				int result = 0;
+				SnapshotSources read;
+				std::array<DiskReading, DiskPaths::COUNT> disks{};
+
+				snapshot.timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+
+#ifdef __linux__
+				if constexpr (NEEDS_MEMINFO)
+				{
+					read.meminfo = mMeminfoFile.Read();
+					result = read.meminfo.empty() ? -1 : result;
+				}
+
+				if constexpr (NEEDS_STAT)
+				{
+					// The aggregate line leads the file, the per-cpu and interrupt lines are never copied
+					CpuTimes times;
+					if (CpuSampler::ParseCpuTimes(mStatFile.ReadPrefix(), times) == 0)
+					{
+						CpuSampler::ComputeSample(mHasCpuTimes ? mCpuTimes : CpuTimes(), times, read.cpu);
+						mCpuTimes = times;
+						mHasCpuTimes = true;
+					}
+					else
+					{
+						result = -1;
+					}
+				}
+
+				if constexpr ((SnapshotType::SOURCES & SOURCE_SYSINFO) != 0)
+				{
+					struct sysinfo info {};
+					ProbeTimer timer(Probe::SYSINFO);
+					const int rc = sysinfo(&info);
+					timer.Finish(rc == 0);
+					if (rc == 0)
+					{
+						read.upTimeSeconds = static_cast<uint64_t>(info.uptime);
+						read.processCount = info.procs;
+						for (int i = 0; i < 3; i++)
+						{
+							read.loadAverage[i] = static_cast<double>(info.loads[i]) / static_cast<double>(1u << SI_LOAD_SHIFT);
+						}
+					}
+					else
+					{
+						result = -1;
+					}
+				}
+
+				for (size_t i = 0; i < DiskPaths::COUNT; i++)
+				{
+					// Paths come from string literals, so they are terminated
+					struct statvfs info {};
+					ProbeTimer timer(Probe::STATVFS);
+					const int rc = statvfs(DiskPaths::TABLE.paths[i].data(), &info);
+					timer.Finish(rc == 0);
+					if (rc == 0)
+					{
+						disks[i].totalBytes = static_cast<uint64_t>(info.f_frsize) * info.f_blocks;
+						disks[i].freeBytes = static_cast<uint64_t>(info.f_frsize) * info.f_bavail;
+						disks[i].valid = true;
+					}
+					else
+					{
+						result = -1;
+					}
+				}
+#else
+				result = -1;
+#endif
+
+				Extract(snapshot, read, disks, std::index_sequence_for<Metrics...>());
+				return result;
+			}
+		protected:
+		private:
+			using DiskPaths = SnapshotDiskPaths<Metrics...>;
+
+			static constexpr bool NEEDS_MEMINFO = (SnapshotType::SOURCES & SOURCE_MEMINFO) != 0;
+			static constexpr bool NEEDS_STAT = (SnapshotType::SOURCES & SOURCE_STAT) != 0;
+
+			template <size_t... Indices>
+			static void Extract(SnapshotType& snapshot, const SnapshotSources& read,
+				const std::array<DiskReading, DiskPaths::COUNT>& disks, std::index_sequence<Indices...>)
+			{
+				(ExtractOne<Metrics, Indices>(snapshot, read, disks), ...);
+			}
+
+			template <typename Metric, size_t Index>
+			static void ExtractOne(SnapshotType& snapshot, const SnapshotSources& read,
+				const std::array<DiskReading, DiskPaths::COUNT>& disks)
+			{
+				if constexpr (IS_DISK_METRIC<Metric>)
+				{
+					std::get<Index>(snapshot.values) = Metric::Extract(disks[DiskPaths::template SlotOf<Metric>()]);
+				}
+				else
+				{
+					std::get<Index>(snapshot.values) = Metric::Extract(read);
+				}
+			}
+
+			// Sources the snapshot does not use take no space
+			[[no_unique_address]] std::conditional_t<NEEDS_MEMINFO, ProcfsFile, UnusedSource<0>>	mMeminfoFile;
+			[[no_unique_address]] std::conditional_t<NEEDS_STAT, ProcfsFile, UnusedSource<1>>		mStatFile;
+			[[no_unique_address]] std::conditional_t<NEEDS_STAT, CpuTimes, UnusedSource<2>>		mCpuTimes;
+			[[no_unique_address]] std::conditional_t<NEEDS_STAT, bool, UnusedSource<3>>			mHasCpuTimes;
+		};
+	}
+}
+#endif
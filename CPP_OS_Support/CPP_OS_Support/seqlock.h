@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		seqlock.h
+//!
+//! @brief		Single writer / many reader sequence lock used to publish
+//!				small trivially copyable samples without a mutex.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Sequence counter and payload words
+#include <cstdint>						// Fixed width types
+#include <cstring>						// memcpy
+#include <type_traits>					// is_trivially_copyable
+//
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SEQLOCK					// Define the seqlock class.
+#define     CPP_SEQLOCK
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Hint to the CPU that we are spinning on a shared cache line
+		inline void SpinPause()
+		{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+			_mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			asm volatile("yield");
+#endif
+		}
+
+		/// @brief Sequence lock publishing a value of type T. Exactly one thread may call Store,
+		///			any number of threads may call Load concurrently. Readers never block the writer
+		///			and never take a lock; they retry only if a store raced with the copy.
+		///			The payload is kept as relaxed atomic words so the racing copy is well defined.
+		template <typename T>
+		class SeqLock
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+		public:
+			static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+			SeqLock()
+			{
+				mSequence.store(0, std::memory_order_relaxed);
+				for (size_t i = 0; i < WORD_COUNT; i++)
+				{
+					mWords[i].store(0, std::memory_order_relaxed);
+				}
+			}
+
+			SeqLock(const SeqLock&) = delete;
+			SeqLock& operator=(const SeqLock&) = delete;
+
+			/// @brief Publish a new value. Must only be called from the single writer thread.
+			/// @param value - value to publish
+			void Store(const T& value)
+			{
+				uint64_t words[WORD_COUNT] = {};
+				std::memcpy(words, &value, sizeof(T));
+
+				const uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+				mSequence.store(sequence + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+
+				for (size_t i = 0; i < WORD_COUNT; i++)
+				{
+					mWords[i].store(words[i], std::memory_order_relaxed);
+				}
+
+				mSequence.store(sequence + 2, std::memory_order_release);
+			}
+
+			/// @brief Make a single attempt to copy out a consistent value.
+			/// @param value - [out] copy of the published value on success
+			/// @return true if the copy is consistent, false if a store was in progress
+			bool TryLoad(T& value) const
+			{
+				uint64_t words[WORD_COUNT];
+
+				const uint64_t before = mSequence.load(std::memory_order_acquire);
+				if (before & 1)
+				{
+					return false;
+				}
+
+				for (size_t i = 0; i < WORD_COUNT; i++)
+				{
+					words[i] = mWords[i].load(std::memory_order_relaxed);
+				}
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (mSequence.load(std::memory_order_relaxed) != before)
+				{
+					return false;
+				}
+
+				std::memcpy(&value, words, sizeof(T));
+				return true;
+			}
+
+			/// @brief Copy out a consistent value, retrying while a store is in progress.
+			/// @return the latest published value
+			T Load() const
+			{
+				T value;
+				while (!TryLoad(value))
+				{
+					SpinPause();
+				}
+				return value;
+			}
+
+			/// @brief Number of completed stores.
+			uint64_t GetVersion() const
+			{
+				return mSequence.load(std::memory_order_acquire) / 2;
+			}
+
+		protected:
+		private:
+			alignas(64) std::atomic<uint64_t>	mSequence;
+			std::atomic<uint64_t>				mWords[WORD_COUNT];
+		};
+	}
+}
+#endif
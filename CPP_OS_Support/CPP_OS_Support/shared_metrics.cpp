@@ -0,0 +1,336 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		shared_metrics.cpp
+//!
+//! @brief		Implementation of the shared metrics publisher and reader
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"shared_metrics.h"			// Shared Metrics Classes
+#include	<new>						// Placement new
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Reads retried while a store is in progress. A store copies one snapshot and
+		///			takes microseconds, a sequence that stays odd longer belongs to a
+		///			collector that died mid-store.
+		static constexpr int SHARED_METRICS_READ_ATTEMPTS = 4096;
+
+		/// @brief Least time between two looks for a recreated segment, each costs an
+		///			shm_open and an fstat while the client collects directly.
+		static constexpr uint64_t SHARED_METRICS_RECONNECT_INTERVAL_NS = 1000000000ull;
+
+		/// @brief Same clock as SystemSnapshot::timestampNs. CLOCK_MONOTONIC is system
+		///			wide, so the age is meaningful across processes, and it is served by the vDSO.
+		static uint64_t MonotonicNowNs()
+		{
+#ifndef _WIN32
+			struct timespec now {};
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+#else
+			return 0;
+#endif
+		}
+
+		SharedMetricsPublisher::SharedMetricsPublisher()
+		{
+			mFd = -1;
+			mSegment = nullptr;
+		}
+
+		SharedMetricsPublisher::~SharedMetricsPublisher()
+		{
+			Close();
+		}
+
+		int SharedMetricsPublisher::Open(const std::string& name, uint64_t periodNs)
+		{
+			Close();
+
+#ifndef _WIN32
+			int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+			if (fd < 0)
+			{
+				return -1;
+			}
+
+			// One writer per segment, the seqlock is single-writer
+			if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+			{
+				close(fd);
+				return -1;
+			}
+
+			if (ftruncate(fd, sizeof(SharedMetricsSegment)) != 0)
+			{
+				close(fd);
+				return -1;
+			}
+
+			void* mapping = mmap(nullptr, sizeof(SharedMetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mapping == MAP_FAILED)
+			{
+				close(fd);
+				return -1;
+			}
+
+			// Invalidate first so readers of a previous generation stop trusting it,
+			// then lay out the header and publish the magic last.
+			SharedMetricsSegment* segment = static_cast<SharedMetricsSegment*>(mapping);
+			segment->magic.store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			segment = new (mapping) SharedMetricsSegment();
+			segment->version = SHARED_METRICS_LAYOUT_VERSION;
+			segment->segmentSize = static_cast<uint32_t>(sizeof(SharedMetricsSegment));
+			segment->snapshotSize = static_cast<uint32_t>(sizeof(SystemSnapshot));
+			segment->reserved = 0;
+			segment->periodNs.store(periodNs, std::memory_order_relaxed);
+			segment->writerPid.store(static_cast<uint64_t>(getpid()), std::memory_order_relaxed);
+			segment->magic.store(SHARED_METRICS_MAGIC, std::memory_order_release);
+
+			mName = name;
+			mFd = fd;
+			mSegment = segment;
+			return 0;
+#else
+			(void)name;
+			(void)periodNs;
+			return -1;
+#endif
+		}
+
+		void SharedMetricsPublisher::Close()
+		{
+#ifndef _WIN32
+			if (mSegment != nullptr)
+			{
+				// Mark the segment dead so clients fall back to direct collection
+				mSegment->magic.store(0, std::memory_order_release);
+				munmap(mSegment, sizeof(SharedMetricsSegment));
+				shm_unlink(mName.c_str());
+			}
+
+			if (mFd >= 0)
+			{
+				close(mFd);
+			}
+#endif
+			mSegment = nullptr;
+			mFd = -1;
+		}
+
+		bool SharedMetricsPublisher::IsOpen() const
+		{
+			return mSegment != nullptr;
+		}
+
+		void SharedMetricsPublisher::Publish(const SystemSnapshot& snapshot)
+		{
+			if (mSegment != nullptr)
+			{
+				mSegment->snapshot.Store(snapshot);
+			}
+		}
+
+		SharedMetricsReader::SharedMetricsReader()
+		{
+			mSegment = nullptr;
+			mDevice = 0;
+			mInode = 0;
+			mLastReconnectNs = 0;
+		}
+
+		SharedMetricsReader::~SharedMetricsReader()
+		{
+			Detach();
+		}
+
+		int SharedMetricsReader::Attach(const std::string& name)
+		{
+			Detach();
+
+#ifndef _WIN32
+			int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+			if (fd < 0)
+			{
+				return -1;
+			}
+
+			struct stat info {};
+			const SharedMetricsSegment* segment = fstat(fd, &info) == 0 ? MapSegment(fd, static_cast<uint64_t>(info.st_size)) : nullptr;
+			close(fd);
+			if (segment == nullptr)
+			{
+				return -1;
+			}
+
+			mSegment = segment;
+			mName = name;
+			mDevice = static_cast<uint64_t>(info.st_dev);
+			mInode = static_cast<uint64_t>(info.st_ino);
+			mLastReconnectNs = MonotonicNowNs();
+			return 0;
+#else
+			(void)name;
+			return -1;
+#endif
+		}
+
+		bool SharedMetricsReader::Reconnect()
+		{
+#ifndef _WIN32
+			if (mName.empty())
+			{
+				return false;
+			}
+
+			const uint64_t now = MonotonicNowNs();
+			if (now - mLastReconnectNs < SHARED_METRICS_RECONNECT_INTERVAL_NS)
+			{
+				return false;
+			}
+			mLastReconnectNs = now;
+
+			// The collector unlinks its segment on exit and creates a new one on start, a
+			// name that still leads to the mapped inode means nothing has been replaced
+			int fd = shm_open(mName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			struct stat info {};
+			if (fstat(fd, &info) != 0 || (static_cast<uint64_t>(info.st_dev) == mDevice && static_cast<uint64_t>(info.st_ino) == mInode))
+			{
+				close(fd);
+				return false;
+			}
+
+			// Not yet valid while the new collector is still laying it out, retried later
+			const SharedMetricsSegment* segment = MapSegment(fd, static_cast<uint64_t>(info.st_size));
+			close(fd);
+			if (segment == nullptr)
+			{
+				return false;
+			}
+
+			if (mSegment != nullptr)
+			{
+				munmap(const_cast<SharedMetricsSegment*>(mSegment), sizeof(SharedMetricsSegment));
+			}
+
+			mSegment = segment;
+			mDevice = static_cast<uint64_t>(info.st_dev);
+			mInode = static_cast<uint64_t>(info.st_ino);
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		const SharedMetricsSegment* SharedMetricsReader::MapSegment(int fd, uint64_t size)
+		{
+#ifndef _WIN32
+			if (size < sizeof(SharedMetricsSegment))
+			{
+				return nullptr;
+			}
+
+			void* mapping = mmap(nullptr, sizeof(SharedMetricsSegment), PROT_READ, MAP_SHARED, fd, 0);
+			if (mapping == MAP_FAILED)
+			{
+				return nullptr;
+			}
+
+			const SharedMetricsSegment* segment = static_cast<const SharedMetricsSegment*>(mapping);
+			if (segment->magic.load(std::memory_order_acquire) != SHARED_METRICS_MAGIC ||
+				segment->version != SHARED_METRICS_LAYOUT_VERSION ||
+				segment->segmentSize != sizeof(SharedMetricsSegment) ||
+				segment->snapshotSize != sizeof(SystemSnapshot))
+			{
+				munmap(mapping, sizeof(SharedMetricsSegment));
+				return nullptr;
+			}
+
+			return segment;
+#else
+			(void)fd;
+			(void)size;
+			return nullptr;
+#endif
+		}
+
+		void SharedMetricsReader::Detach()
+		{
+#ifndef _WIN32
+			if (mSegment != nullptr)
+			{
+				munmap(const_cast<SharedMetricsSegment*>(mSegment), sizeof(SharedMetricsSegment));
+			}
+#endif
+			mSegment = nullptr;
+			mName.clear();
+			mDevice = 0;
+			mInode = 0;
+		}
+
+		bool SharedMetricsReader::IsAttached() const
+		{
+			return mSegment != nullptr;
+		}
+
+		bool SharedMetricsReader::Read(SystemSnapshot& snapshot) const
+		{
+			if (mSegment == nullptr || mSegment->magic.load(std::memory_order_acquire) != SHARED_METRICS_MAGIC ||
+				mSegment->snapshot.GetVersion() == 0)
+			{
+				return false;
+			}
+
+			// Bounded, Load would spin forever on a segment left mid-store
+			for (int attempt = 0; attempt < SHARED_METRICS_READ_ATTEMPTS; attempt++)
+			{
+				if (mSegment->snapshot.TryLoad(snapshot))
+				{
+					return true;
+				}
+				SpinPause();
+			}
+
+			return false;
+		}
+
+		bool SharedMetricsReader::ReadFresh(SystemSnapshot& snapshot) const
+		{
+			if (!Read(snapshot))
+			{
+				return false;
+			}
+
+			// A collector that died leaves its last snapshot behind, treat anything older
+			// than a few periods (and at least a second) as absent.
+			const uint64_t period = mSegment->periodNs.load(std::memory_order_relaxed);
+			const uint64_t maxAge = period * 3 > 1000000000ull ? period * 3 : 1000000000ull;
+			const uint64_t now = MonotonicNowNs();
+
+			return now >= snapshot.timestampNs && now - snapshot.timestampNs <= maxAge;
+		}
+
+		uint64_t SharedMetricsReader::GetVersion() const
+		{
+			return mSegment != nullptr ? mSegment->snapshot.GetVersion() : 0;
+		}
+	}
+}
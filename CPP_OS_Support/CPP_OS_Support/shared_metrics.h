@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		shared_metrics.h
+//!
+//! @brief		Fixed-layout POSIX shared-memory segment carrying the latest
+//!				SystemSnapshot, so one collector process can serve many
+//!				reader processes that never touch /proc themselves.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <atomic>						// Header fields shared across processes
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string>						// Segment name
+#include "seqlock.h"					// Sequence counter guarding the payload
+#include "system_snapshot.h"			// Payload
+//
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SHARED_METRICS			// Define the shared metrics classes.
+#define     CPP_SHARED_METRICS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Default segment name, shared by the collector and client modes
+		constexpr const char* SHARED_METRICS_DEFAULT_NAME = "/os_support_metrics";
+
+		/// @brief Identifies a segment written by this library
+		constexpr uint64_t SHARED_METRICS_MAGIC = 0x4F53535550504D31ull;	// "OSSUPPM1"
+
+		/// @brief Bumped whenever SharedMetricsSegment or SystemSnapshot change layout
+		constexpr uint32_t SHARED_METRICS_LAYOUT_VERSION = 1;
+
+		/// @brief The segment as laid out in memory. Readers validate magic, version and
+		///			sizes before trusting the payload.
+		struct SharedMetricsSegment
+		{
+			std::atomic<uint64_t>	magic;				// Written last by the collector
+			uint32_t				version;
+			uint32_t				segmentSize;
+			uint32_t				snapshotSize;
+			uint32_t				reserved;
+			std::atomic<uint64_t>	periodNs;			// Collection period, used for staleness
+			std::atomic<uint64_t>	writerPid;
+			SeqLock<SystemSnapshot>	snapshot;
+		};
+
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared metrics need address-free 64-bit atomics");
+
+		/// @brief Collector side. Creates the segment and is its only writer; a second
+		///			publisher on the same name is refused via an exclusive flock.
+		class SharedMetricsPublisher
+		{
+		public:
+			SharedMetricsPublisher();
+			~SharedMetricsPublisher();
+			SharedMetricsPublisher(const SharedMetricsPublisher&) = delete;
+			SharedMetricsPublisher& operator=(const SharedMetricsPublisher&) = delete;
+			int			Open(const std::string& name = SHARED_METRICS_DEFAULT_NAME, uint64_t periodNs = 1000000000ull);
+			void		Close();
+			bool		IsOpen() const;
+			void		Publish(const SystemSnapshot& snapshot);
+		protected:
+		private:
+			std::string				mName;
+			int						mFd;
+			SharedMetricsSegment*	mSegment;
+		};
+
+		/// @brief Client side. After Attach, Read is a plain memory copy with no syscalls.
+		///			A restarted collector recreates the segment under the same name, Reconnect
+		///			maps the new one in place of the old.
+		class SharedMetricsReader
+		{
+		public:
+			SharedMetricsReader();
+			~SharedMetricsReader();
+			SharedMetricsReader(const SharedMetricsReader&) = delete;
+			SharedMetricsReader& operator=(const SharedMetricsReader&) = delete;
+			int			Attach(const std::string& name = SHARED_METRICS_DEFAULT_NAME);
+			void		Detach();
+			bool		IsAttached() const;
+			bool		Read(SystemSnapshot& snapshot) const;
+			bool		ReadFresh(SystemSnapshot& snapshot) const;
+			bool		Reconnect();
+			uint64_t	GetVersion() const;
+		protected:
+		private:
+			static const SharedMetricsSegment* MapSegment(int fd, uint64_t size);
+
+			const SharedMetricsSegment*	mSegment;
+			std::string					mName;
+			uint64_t					mDevice;			// Identity of the mapped segment, a
+			uint64_t					mInode;				// recreated one has a new inode
+			uint64_t					mLastReconnectNs;
+		};
+	}
+}
+#endif
@@ -0,0 +1,428 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		storage_mount.cpp
+//!
+//! @brief		Implementation of the storage mounter class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"storage_mount.h"			// Storage Mounter Class
+#include	"instrumentation.h"			// mount/umount probes
+#include	<algorithm>					// std::min, std::find
+#include	<atomic>					// Batch work index
+#include	<cerrno>					// errno values
+#include	<climits>					// PATH_MAX
+#include	<cstdio>					// snprintf
+#include	<cstdlib>					// realpath
+#include	<cstring>					// strncpy
+#include	<thread>					// Batch workers
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		bool StorageMounter::IsMounted(MountTable& table, const std::string& device, const std::string& location)
+		{
+			std::string resolved = location;
+#ifdef __linux__
+			char buffer[PATH_MAX];
+			if (realpath(location.c_str(), buffer) != nullptr)
+			{
+				resolved = buffer;
+			}
+#endif
+
+			if (table.FindMount(resolved) != nullptr)
+			{
+				return true;
+			}
+
+			// A block device or image can only be mounted once without bind mounts
+			if (!device.empty() && device[0] == '/')
+			{
+#ifdef __linux__
+				// mountinfo names an image by the loop device it was attached to and a disk
+				// by whatever path mount was given, so both are matched by identity
+				struct stat info {};
+				const bool found = stat(device.c_str(), &info) == 0;
+#endif
+				for (const MountEntry& mount : table.GetMounts())
+				{
+					if (mount.source == device)
+					{
+						return true;
+					}
+
+#ifdef __linux__
+					if (found && S_ISBLK(info.st_mode) && mount.major == major(info.st_rdev) && mount.minor == minor(info.st_rdev))
+					{
+						return true;
+					}
+
+					if (found && S_ISREG(info.st_mode) && IsLoopBackedBy(mount, info))
+					{
+						return true;
+					}
+#endif
+				}
+			}
+
+			return false;
+		}
+
+#ifdef __linux__
+		bool StorageMounter::IsLoopBackedBy(const MountEntry& mount, const struct stat& image)
+		{
+			if (mount.source.compare(0, 9, "/dev/loop") != 0)
+			{
+				return false;
+			}
+
+			// The loop driver publishes the path of the attached file, compared by inode
+			// so a symlink or another path to the same image still matches
+			char path[64];
+			std::snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/loop/backing_file", mount.major, mount.minor);
+
+			ProcfsFile file(path, PATH_MAX);
+			std::string_view backing = file.Read();
+			while (!backing.empty() && backing.back() == '\n')
+			{
+				backing.remove_suffix(1);
+			}
+
+			struct stat info {};
+			return !backing.empty() && stat(std::string(backing).c_str(), &info) == 0 &&
+				info.st_dev == image.st_dev && info.st_ino == image.st_ino;
+		}
+#endif
+
+		int StorageMounter::Mount(const MountRequest& request, MountResult& result)
+		{
+			result = MountResult();
+			result.location = request.location;
+
+#ifdef __linux__
+			std::string source = request.device;
+			int loopFd = -1;
+
+			// Image files go through a loop device that detaches itself on unmount
+			struct stat info {};
+			if (stat(request.device.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+			{
+				if (AttachLoopDevice(request.device, (request.flags & MS_RDONLY) != 0, result.loopDevice, loopFd) != 0)
+				{
+					result.errorNumber = errno;
+					return -1;
+				}
+				source = result.loopDevice;
+			}
+
+			int rc = -1;
+			if (!request.fsType.empty())
+			{
+				rc = MountWithType(source, request, request.fsType, result);
+			}
+			else
+			{
+				std::vector<std::string> blockTypes;
+				std::vector<std::string> nodevTypes;
+				ListFilesystems(blockTypes, nodevTypes);
+
+				if (std::find(nodevTypes.begin(), nodevTypes.end(), request.device) != nodevTypes.end())
+				{
+					// "tmpfs", "ramfs" and friends name their own type
+					rc = MountWithType(source, request, request.device, result);
+				}
+				else if (source.empty() || source[0] != '/')
+				{
+					result.errorNumber = EINVAL;
+				}
+				else
+				{
+					// Same probing order as mount(8) without libblkid, stop on anything
+					// other than "not this filesystem".
+					for (const std::string& type : blockTypes)
+					{
+						rc = MountWithType(source, request, type, result);
+						if (rc == 0 || (result.errorNumber != EINVAL && result.errorNumber != ENODEV))
+						{
+							break;
+						}
+					}
+				}
+			}
+
+			if (loopFd >= 0)
+			{
+				// With autoclear the loop device now lives exactly as long as the mount
+				close(loopFd);
+			}
+
+			if (rc != 0 && !result.loopDevice.empty())
+			{
+				result.loopDevice.clear();
+			}
+
+			return rc;
+#else
+			result.errorNumber = ENOSYS;
+			return -1;
+#endif
+		}
+
+		int StorageMounter::Unmount(const MountRequest& request, MountResult& result)
+		{
+			result = MountResult();
+			result.location = request.location;
+
+#ifdef __linux__
+			ProbeTimer timer(Probe::UNMOUNT);
+			const int rc = umount2(request.location.c_str(), static_cast<int>(request.flags));
+			timer.Finish(rc == 0);
+			if (rc != 0)
+			{
+				result.errorNumber = errno;
+				return -1;
+			}
+
+			result.status = 1;
+			return 0;
+#else
+			result.errorNumber = ENOSYS;
+			return -1;
+#endif
+		}
+
+		int StorageMounter::RunBatch(MountTable& table, const std::vector<MountRequest>& requests,
+			std::vector<MountResult>& results, unsigned int concurrency)
+		{
+			results.assign(requests.size(), MountResult());
+
+			// State checks use the cached table on this thread, workers only make syscalls
+			std::vector<size_t> work;
+			for (size_t i = 0; i < requests.size(); i++)
+			{
+				const MountRequest& request = requests[i];
+				results[i].location = request.location;
+
+				const bool mounted = IsMounted(table, request.action == MountRequest::Action::MOUNT ? request.device : std::string(),
+					request.location);
+
+				if (request.action == MountRequest::Action::MOUNT ? mounted : !mounted)
+				{
+					results[i].status = 0;
+				}
+				else
+				{
+					work.push_back(i);
+				}
+			}
+
+			if (concurrency == 0)
+			{
+				concurrency = std::max(1u, std::thread::hardware_concurrency());
+			}
+			const size_t workerCount = std::min<size_t>(concurrency, work.size());
+
+			std::atomic<size_t> next{ 0 };
+			auto worker = [&]
+			{
+				for (size_t index = next++; index < work.size(); index = next++)
+				{
+					const size_t i = work[index];
+					if (requests[i].action == MountRequest::Action::MOUNT)
+					{
+						Mount(requests[i], results[i]);
+					}
+					else
+					{
+						Unmount(requests[i], results[i]);
+					}
+				}
+			};
+
+			std::vector<std::thread> workers;
+			for (size_t i = 1; i < workerCount; i++)
+			{
+				workers.emplace_back(worker);
+			}
+			worker();
+
+			for (std::thread& thread : workers)
+			{
+				thread.join();
+			}
+
+			for (const MountResult& result : results)
+			{
+				if (result.status < 0)
+				{
+					return -1;
+				}
+			}
+
+			return 0;
+		}
+
+		int StorageMounter::MountWithType(const std::string& source, const MountRequest& request,
+			const std::string& fsType, MountResult& result)
+		{
+#ifdef __linux__
+			// Type probing failures are counted as errors too, they cost the same syscall
+			ProbeTimer timer(Probe::MOUNT);
+			const int rc = mount(source.c_str(), request.location.c_str(), fsType.c_str(), request.flags,
+				request.data.empty() ? nullptr : request.data.c_str());
+			timer.Finish(rc == 0);
+			if (rc != 0)
+			{
+				result.errorNumber = errno;
+				result.status = -1;
+				return -1;
+			}
+
+			result.fsType = fsType;
+			result.errorNumber = 0;
+			result.status = 1;
+			return 0;
+#else
+			(void)source;
+			(void)request;
+			(void)fsType;
+			result.errorNumber = ENOSYS;
+			return -1;
+#endif
+		}
+
+		int StorageMounter::AttachLoopDevice(const std::string& image, bool readOnly, std::string& loopDevice, int& loopFd)
+		{
+#ifdef __linux__
+			const int openMode = (readOnly ? O_RDONLY : O_RDWR) | O_CLOEXEC;
+
+			int control = open("/dev/loop-control", O_RDWR | O_CLOEXEC);
+			if (control < 0)
+			{
+				return -1;
+			}
+
+			int imageFd = open(image.c_str(), openMode);
+			if (imageFd < 0)
+			{
+				close(control);
+				return -1;
+			}
+
+			int rc = -1;
+
+			// Another process can take the free device between the two calls, so retry
+			for (int attempt = 0; attempt < 8 && rc != 0; attempt++)
+			{
+				int number = ioctl(control, LOOP_CTL_GET_FREE);
+				if (number < 0)
+				{
+					break;
+				}
+
+				std::string path = "/dev/loop" + std::to_string(number);
+				int fd = open(path.c_str(), openMode);
+				if (fd < 0)
+				{
+					continue;
+				}
+
+				struct loop_info64 loopInfo {};
+				loopInfo.lo_flags = LO_FLAGS_AUTOCLEAR | (readOnly ? LO_FLAGS_READ_ONLY : 0);
+				std::strncpy(reinterpret_cast<char*>(loopInfo.lo_file_name), image.c_str(), LO_NAME_SIZE - 1);
+
+#ifdef LOOP_CONFIGURE
+				struct loop_config config {};
+				config.fd = static_cast<uint32_t>(imageFd);
+				config.info = loopInfo;
+				if (ioctl(fd, LOOP_CONFIGURE, &config) == 0)
+				{
+					rc = 0;
+				}
+				else if (errno != EINVAL && errno != ENOTTY)
+				{
+					close(fd);
+					continue;
+				}
+#endif
+				// Kernels before 5.8 need the two step setup
+				if (rc != 0 && ioctl(fd, LOOP_SET_FD, imageFd) == 0)
+				{
+					if (ioctl(fd, LOOP_SET_STATUS64, &loopInfo) == 0)
+					{
+						rc = 0;
+					}
+					else
+					{
+						ioctl(fd, LOOP_CLR_FD, 0);
+					}
+				}
+
+				if (rc == 0)
+				{
+					loopDevice = path;
+					loopFd = fd;
+				}
+				else
+				{
+					close(fd);
+				}
+			}
+
+			const int savedErrno = errno;
+			close(imageFd);
+			close(control);
+			errno = savedErrno;
+
+			return rc;
+#else
+			(void)image;
+			(void)readOnly;
+			(void)loopDevice;
+			(void)loopFd;
+			return -1;
+#endif
+		}
+
+		int StorageMounter::ListFilesystems(std::vector<std::string>& blockTypes, std::vector<std::string>& nodevTypes)
+		{
+			ProcfsFile filesystems("/proc/filesystems");
+			std::string_view text = filesystems.Read();
+			if (text.empty())
+			{
+				return -1;
+			}
+
+			// "nodev\ttmpfs" or "\text4"
+			while (!text.empty())
+			{
+				std::string_view line = Procfs::NextLine(text);
+				std::string_view first = Procfs::NextToken(line);
+				std::string_view second = Procfs::NextToken(line);
+
+				if (first == "nodev")
+				{
+					nodevTypes.emplace_back(second);
+				}
+				else if (!first.empty() && first != "fuseblk")
+				{
+					// fuseblk needs a userspace helper to mount
+					blockTypes.emplace_back(first);
+				}
+			}
+
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		storage_mount.h
+//!
+//! @brief		Direct mount(2)/umount2(2) support, including filesystem type
+//!				detection and loop device setup for image files, with a
+//!				batch API that runs many targets concurrently.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Fixed width types
+#include <string>						// Paths and options
+#include <vector>						// Batches
+#include "mount_table.h"				// Current mount state
+#include "procfs_reader.h"				// /proc/filesystems
+//
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/loop.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_STORAGE_MOUNT			// Define the storage mount class.
+#define     CPP_STORAGE_MOUNT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief One mount or unmount to perform.
+		struct MountRequest
+		{
+			enum class Action : uint8_t
+			{
+				MOUNT,
+				UNMOUNT,
+			};
+
+			Action			action = Action::MOUNT;
+			std::string		device;					// Block device, image file, or the fs name for nodev filesystems
+			std::string		location;
+			std::string		fsType;					// Empty to detect
+			unsigned long	flags = 0;				// MS_* for mount, MNT_* / UMOUNT_* for unmount
+			std::string		data;					// Filesystem specific options, e.g. "size=64m"
+		};
+
+		/// @brief Outcome of one request. status follows MountStorageDevice: 1 done,
+		///			0 nothing to do (already mounted / not mounted), -1 failed.
+		struct MountResult
+		{
+			std::string		location;
+			std::string		fsType;					// Type actually mounted
+			std::string		loopDevice;				// Set when an image file was attached to a loop device
+			int				status = -1;
+			int				errorNumber = 0;		// errno of the failing call
+		};
+
+		class StorageMounter
+		{
+		public:
+			static bool	IsMounted(MountTable& table, const std::string& device, const std::string& location);
+			static int	Mount(const MountRequest& request, MountResult& result);
+			static int	Unmount(const MountRequest& request, MountResult& result);
+			static int	RunBatch(MountTable& table, const std::vector<MountRequest>& requests,
+							std::vector<MountResult>& results, unsigned int concurrency = 0);
+		protected:
+		private:
+			static int	MountWithType(const std::string& source, const MountRequest& request,
+							const std::string& fsType, MountResult& result);
+			static int	AttachLoopDevice(const std::string& image, bool readOnly, std::string& loopDevice, int& loopFd);
+#ifdef __linux__
+			static bool	IsLoopBackedBy(const MountEntry& mount, const struct stat& image);
+#endif
+			static int	ListFilesystems(std::vector<std::string>& blockTypes, std::vector<std::string>& nodevTypes);
+		};
+	}
+}
+#endif
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		support_error.cpp
+//!
+//! @brief		Implementation of the support error category and last error
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"support_error.h"			// Support Error Types
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Category for SupportError values, one instance per process
+		class SupportErrorCategoryImpl : public std::error_category
+		{
+		public:
+			const char* name() const noexcept override
+			{
+				return "os_support";
+			}
+
+			std::string message(int value) const override
+			{
+				return std::string(ToString(static_cast<SupportError>(value)));
+			}
+
+			// Lets callers compare against the portable std::errc conditions
+			std::error_condition default_error_condition(int value) const noexcept override
+			{
+				switch (static_cast<SupportError>(value))
+				{
+				case SupportError::NOT_SUPPORTED: return std::make_error_condition(std::errc::not_supported);
+				case SupportError::NOT_FOUND: return std::make_error_condition(std::errc::no_such_file_or_directory);
+				case SupportError::INVALID_ARGUMENT: return std::make_error_condition(std::errc::invalid_argument);
+				default: return std::error_condition(value, *this);
+				}
+			}
+		};
+
+		// Constant initialised, nothing runs at static-init time and every thread starts clear
+		static thread_local ErrorInfo tLastError;
+
+		std::error_code ErrorInfo::Code() const
+		{
+			return make_error_code(code);
+		}
+
+		std::error_code ErrorInfo::SystemCode() const
+		{
+			return std::error_code(errorNumber, std::generic_category());
+		}
+
+		const std::error_category& SupportErrorCategory()
+		{
+			static const SupportErrorCategoryImpl category;
+			return category;
+		}
+
+		std::error_code make_error_code(SupportError error)
+		{
+			return std::error_code(static_cast<int>(error), SupportErrorCategory());
+		}
+
+		namespace LastError
+		{
+			const ErrorInfo& Get()
+			{
+				return tLastError;
+			}
+
+			void Set(SupportError code, const char* source, int errorNumber)
+			{
+				tLastError.code = code;
+				tLastError.errorNumber = errorNumber;
+				tLastError.source = source != nullptr ? source : "";
+			}
+
+			void Clear()
+			{
+				tLastError = ErrorInfo();
+			}
+		}
+	}
+}
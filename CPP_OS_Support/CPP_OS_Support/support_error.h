@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		support_error.h
+//!
+//! @brief		Error codes, their std::error_code category and the per-thread
+//!				last error. Messages are constexpr string views and recording
+//!				an error stores three words in thread-local storage, so
+//!				neither reporting nor checking an error allocates or locks.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstdint>						// Fixed width types
+#include <string>						// error_category::message
+#include <string_view>					// Message table
+#include <system_error>					// std::error_code integration
+#include <utility>						// std::forward
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SUPPORT_ERROR			// Define the support error types.
+#define     CPP_SUPPORT_ERROR
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief OS Support enum for error codes
+		enum class SupportError : uint8_t
+		{
+			NONE,
+			NOT_SUPPORTED,
+			MOUNT_FAILED,
+			UNMOUNT_FAILED,
+			READ_FAILED,					// A proc or sysfs file could not be read
+			PARSE_FAILED,					// A proc or sysfs file had an unexpected format
+			SYSTEM_CALL_FAILED,				// sysinfo, statvfs and the like
+			NOT_FOUND,						// No such path, device, mount or process
+			INVALID_ARGUMENT,
+			ERROR_COUNT,
+		};
+
+		/// @brief Readable message per code, indexed by the enum value
+		constexpr std::string_view SUPPORT_ERROR_MESSAGES[] =
+		{
+			"Error Code 0: No error.",
+			"Error Code 1: Not supported on this platform.",
+			"Error Code 2: Failed to mount drive.",
+			"Error Code 3: Failed to unmount drive.",
+			"Error Code 4: Failed to read a system file.",
+			"Error Code 5: Unexpected system file format.",
+			"Error Code 6: System call failed.",
+			"Error Code 7: Not found.",
+			"Error Code 8: Invalid argument.",
+		};
+
+		static_assert(sizeof(SUPPORT_ERROR_MESSAGES) / sizeof(SUPPORT_ERROR_MESSAGES[0]) ==
+			static_cast<size_t>(SupportError::ERROR_COUNT), "Every SupportError needs a message");
+
+		/// @brief Message of a code, unknown values map to an empty view
+		constexpr std::string_view ToString(SupportError error)
+		{
+			return error < SupportError::ERROR_COUNT ? SUPPORT_ERROR_MESSAGES[static_cast<size_t>(error)] : std::string_view();
+		}
+
+		/// @brief What went wrong, the errno of the failing call (0 when there was none)
+		///			and the method that reported it. source points at a string literal.
+		struct ErrorInfo
+		{
+			SupportError	code = SupportError::NONE;
+			int				errorNumber = 0;
+			const char*		source = "";
+
+			bool				Ok() const { return code == SupportError::NONE; }
+			std::string_view	Message() const { return ToString(code); }
+			std::error_code		Code() const;
+			std::error_code		SystemCode() const;
+		};
+
+		/// @brief A value with the error state of the call that produced it
+		template <typename T>
+		struct Result
+		{
+			T			value{};
+			ErrorInfo	error;
+
+			bool		Ok() const { return error.Ok(); }
+			explicit operator bool() const { return error.Ok(); }
+		};
+
+		const std::error_category& SupportErrorCategory();
+		std::error_code make_error_code(SupportError error);
+
+		/// @brief Last error of the calling thread, like errno. Each thread only sees
+		///			the errors of the calls it made itself, whatever instance they went through.
+		namespace LastError
+		{
+			const ErrorInfo& Get();
+			void		Set(SupportError code, const char* source, int errorNumber = 0);
+			void		Clear();
+		}
+
+		/// @brief Runs call with the thread's error cleared and returns what it returned
+		///			together with the error it reported, e.g. Checked([&] { return os.GetFreeRamInBytes(); })
+		template <typename Call>
+		auto Checked(Call&& call) -> Result<decltype(call())>
+		{
+			LastError::Clear();
+			Result<decltype(call())> result;
+			result.value = std::forward<Call>(call)();
+			result.error = LastError::Get();
+			return result;
+		}
+	}
+}
+
+namespace std
+{
+	template <>
+	struct is_error_code_enum<Essentials::Utilities::SupportError> : true_type {};
+}
+#endif
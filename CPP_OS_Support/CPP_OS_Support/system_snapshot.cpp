@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		system_snapshot.cpp
+//!
+//! @brief		Implementation of the system snapshot accessors
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"system_snapshot.h"			// System Snapshot
+#include	<cstring>					// strncmp
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		double SystemSnapshot::GetCpuUsagePercent() const
+		{
+			return cpu.usage;
+		}
+
+		double SystemSnapshot::GetTotalRamInGigabytes() const
+		{
+			return totalRamGigabytes;
+		}
+
+		uint64_t SystemSnapshot::GetTotalRamInBytes() const
+		{
+			return totalRamBytes;
+		}
+
+		uint64_t SystemSnapshot::GetFreeRamInBytes() const
+		{
+			return freeRamBytes;
+		}
+
+		uint64_t SystemSnapshot::GetUsedRamInBytes() const
+		{
+			return usedRamBytes;
+		}
+
+		double SystemSnapshot::GetRamUsagePercent() const
+		{
+			if (totalRamBytes == 0)
+			{
+				return 0.0;
+			}
+
+			uint64_t usedRAM = totalRamBytes - freeRamBytes;
+			double percent = static_cast<double>(usedRAM) / totalRamBytes;
+
+			return percent * 100.0;
+		}
+
+		const DiskSnapshot* SystemSnapshot::FindDisk(const char* path) const
+		{
+			// No path selects the first configured mount, "/" by default
+			if (path == nullptr)
+			{
+				return diskCount > 0 && disks[0].valid ? &disks[0] : nullptr;
+			}
+
+			for (uint32_t i = 0; i < diskCount && i < SNAPSHOT_MAX_MOUNTS; i++)
+			{
+				if (disks[i].valid && std::strncmp(disks[i].path, path, SNAPSHOT_MOUNT_PATH_LENGTH) == 0)
+				{
+					return &disks[i];
+				}
+			}
+
+			return nullptr;
+		}
+
+		uint64_t SystemSnapshot::GetTotalDiskSpaceInBytes(const char* path) const
+		{
+			const DiskSnapshot* disk = FindDisk(path);
+			return disk != nullptr ? disk->totalBytes : 0;
+		}
+
+		double SystemSnapshot::GetTotalDiskSpaceInGigabytes(const char* path) const
+		{
+			double bytes = (double)GetTotalDiskSpaceInBytes(path);
+
+			return bytes / (1024 * 1024 * 1024);
+		}
+
+		uint64_t SystemSnapshot::GetFreeDiskSpaceInBytes(const char* path) const
+		{
+			const DiskSnapshot* disk = FindDisk(path);
+			return disk != nullptr ? disk->freeBytes : 0;
+		}
+
+		double SystemSnapshot::GetFreeDiskSpaceInGigabytes(const char* path) const
+		{
+			double bytes = (double)GetFreeDiskSpaceInBytes(path);
+
+			return bytes / (1024 * 1024 * 1024);
+		}
+
+		double SystemSnapshot::GetFreeDiskSpacePercent(const char* path) const
+		{
+			const DiskSnapshot* disk = FindDisk(path);
+			double freeSpacePercentage = 0;
+
+			if (disk != nullptr && disk->totalBytes != 0 && disk->freeBytes != 0)
+			{
+				freeSpacePercentage = ((double)disk->freeBytes / (double)disk->totalBytes) * 100.0;
+			}
+
+			return freeSpacePercentage;
+		}
+
+		double SystemSnapshot::GetUsedDiskSpacePercent(const char* path) const
+		{
+			const DiskSnapshot* disk = FindDisk(path);
+			double usedSpacePercentage = 0;
+
+			if (disk != nullptr && disk->totalBytes != 0 && disk->freeBytes != 0)
+			{
+				double usedDiskSpace = (double)disk->totalBytes - (double)disk->freeBytes;
+				usedSpacePercentage = (usedDiskSpace / (double)disk->totalBytes) * 100.0;
+			}
+
+			return usedSpacePercentage;
+		}
+
+		int SystemSnapshot::GetNumberOfEthernetDevices() const
+		{
+			return ethernetDeviceCount;
+		}
+
+		uint64_t SystemSnapshot::GetSystemUpTimeInSeconds() const
+		{
+			return upTimeSeconds;
+		}
+
+		int SystemSnapshot::GetSystemUpTimeHMS(int& hours, int& mins, int& secs) const
+		{
+			if (upTimeSeconds > 0)
+			{
+				mins = (int)upTimeSeconds / 60;
+				hours = mins / 60;
+				mins = mins % 60;
+				secs = (int)upTimeSeconds % 60;
+
+				return 0;
+			}
+
+			// default return is fail.
+			return -1;
+		}
+	}
+}
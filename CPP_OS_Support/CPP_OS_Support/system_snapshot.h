@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		system_snapshot.h
+//!
+//! @brief		Point in time copy of every metric OS_Support reports, filled
+//!				by OS_Support::Capture in a single pass over the kernel
+//!				sources and answerable with no further kernel calls.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include "cpu_sampler.h"				// CpuTimes and CpuSample
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_SYSTEM_SNAPSHOT			// Define the system snapshot struct.
+#define     CPP_SYSTEM_SNAPSHOT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Maximum number of mounts a snapshot carries
+		constexpr size_t SNAPSHOT_MAX_MOUNTS = 8;
+
+		/// @brief Maximum mount path length, including the terminator
+		constexpr size_t SNAPSHOT_MOUNT_PATH_LENGTH = 64;
+
+		/// @brief Capacity of one mounted filesystem.
+		struct DiskSnapshot
+		{
+			char		path[SNAPSHOT_MOUNT_PATH_LENGTH] = {};
+			uint64_t	totalBytes = 0;
+			uint64_t	freeBytes = 0;
+			bool		valid = false;
+		};
+
+		/// @brief Every metric OS_Support reports, captured together. The layout is fixed
+		///			and trivially copyable so a snapshot can be published or shared as is.
+		struct SystemSnapshot
+		{
+			uint64_t		timestampNs = 0;			// Steady clock time of the capture
+			uint64_t		upTimeSeconds = 0;
+			uint64_t		totalRamBytes = 0;
+			uint64_t		freeRamBytes = 0;			// Allocatable without swapping, MemAvailable on Linux
+			uint64_t		usedRamBytes = 0;
+			double			totalRamGigabytes = 0.0;
+			CpuTimes		cpuTimes;					// Cumulative counters at capture time
+			CpuSample		cpu;						// Utilisation since the previous capture
+			int32_t			ethernetDeviceCount = -1;
+			uint32_t		diskCount = 0;
+			DiskSnapshot	disks[SNAPSHOT_MAX_MOUNTS];
+
+			double			GetCpuUsagePercent() const;
+			double			GetTotalRamInGigabytes() const;
+			uint64_t		GetTotalRamInBytes() const;
+			uint64_t		GetFreeRamInBytes() const;
+			uint64_t		GetUsedRamInBytes() const;
+			double			GetRamUsagePercent() const;
+			const DiskSnapshot* FindDisk(const char* path) const;
+			uint64_t		GetTotalDiskSpaceInBytes(const char* path = nullptr) const;
+			double			GetTotalDiskSpaceInGigabytes(const char* path = nullptr) const;
+			uint64_t		GetFreeDiskSpaceInBytes(const char* path = nullptr) const;
+			double			GetFreeDiskSpaceInGigabytes(const char* path = nullptr) const;
+			double			GetFreeDiskSpacePercent(const char* path = nullptr) const;
+			double			GetUsedDiskSpacePercent(const char* path = nullptr) const;
+			int				GetNumberOfEthernetDevices() const;
+			uint64_t		GetSystemUpTimeInSeconds() const;
+			int				GetSystemUpTimeHMS(int& hours, int& mins, int& secs) const;
+		};
+	}
+}
+#endif
@@ -0,0 +1,511 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		thermal_stats.cpp
+//!
+//! @brief		Implementation of the thermal stats class
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include	"thermal_stats.h"			// Thermal Stats Class
+#include	<cstring>					// memcpy
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief The governor only changes by hand, it is re-read every this many samples
+		static constexpr uint64_t GOVERNOR_REFRESH_SAMPLES = 16;
+
+		/// @brief Zone and cooling device ids can have gaps after a driver unloads
+		static constexpr int THERMAL_MAX_ID_GAP = 8;
+
+		static bool ReadUnsigned(ProcfsFile& file, uint64_t& value)
+		{
+			std::string_view text = file.Read();
+			value = 0;
+			if (text.empty())
+			{
+				return false;
+			}
+
+			Procfs::ParseUnsigned(text.data(), text.data() + text.size(), value);
+			return true;
+		}
+
+		/// @brief Temperatures go below zero on outdoor hardware
+		static bool ReadSigned(ProcfsFile& file, int64_t& value)
+		{
+			std::string_view text = file.Read();
+			value = 0;
+			if (text.empty())
+			{
+				return false;
+			}
+
+			const bool negative = text.front() == '-';
+			uint64_t magnitude = 0;
+			Procfs::ParseUnsigned(text.data() + (negative ? 1 : 0), text.data() + text.size(), magnitude);
+			value = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+			return true;
+		}
+
+		/// @brief First line of text into a fixed name, truncated to fit
+		static void CopyName(std::string_view text, char (&name)[THERMAL_NAME_LENGTH])
+		{
+			text = Procfs::NextLine(text);
+			const size_t length = text.size() < THERMAL_NAME_LENGTH - 1 ? text.size() : THERMAL_NAME_LENGTH - 1;
+			text.copy(name, length);
+			name[length] = '\0';
+		}
+
+		/// @brief Opens path into file, reads it once and leaves it open
+		static bool OpenAndRead(ProcfsFile& file, const std::string& path, uint64_t& value)
+		{
+			return file.Open(path.c_str(), 32) == 0 && ReadUnsigned(file, value);
+		}
+
+		ThermalStats::ThermalStats()
+		{
+			mSampleNumber = 0;
+			mOpen = false;
+		}
+
+		ThermalStats::~ThermalStats()
+		{
+			Close();
+		}
+
+		int ThermalStats::Open(const CpuTopology& topology, const std::string& root)
+		{
+			Close();
+
+#ifdef __linux__
+			// Linux implementation, every handle is opened here and only pread afterwards
+			OpenFrequency(topology, root + "/devices/system/cpu");
+			OpenThermal(root + "/class/thermal");
+
+			// Virtual machines usually have none of these
+			if (mPolicies.empty() && mThrottles.empty() && mZones.empty() && mCooling.empty())
+			{
+				return -1;
+			}
+
+			mOpen = true;
+			return 0;
+#else
+			(void)topology;
+			(void)root;
+			return -1;
+#endif
+		}
+
+		void ThermalStats::Close()
+		{
+			mPolicies.clear();
+			mCpuPolicy.clear();
+			mThrottles.clear();
+			mCpuCoreThrottle.clear();
+			mCpuPackageThrottle.clear();
+			mZones.clear();
+			mCooling.clear();
+			mCounters = ThrottleCounters();
+			mSampleNumber = 0;
+			mOpen = false;
+		}
+
+		bool ThermalStats::IsOpen() const
+		{
+			return mOpen;
+		}
+
+		int ThermalStats::Sample()
+		{
+			if (!mOpen)
+			{
+				return -1;
+			}
+
+			mSampleNumber++;
+			SampleFrequency();
+			SampleThermal();
+			mCounters.samples++;
+			return 0;
+		}
+
+		int ThermalStats::GetCpuFrequencies(std::vector<CpuFrequency>& cpus) const
+		{
+			// One entry per CPU with cpufreq or a throttle counter, the caller's vector is reused
+			size_t count = 0;
+			for (size_t cpu = 0; cpu < mCpuPolicy.size(); cpu++)
+			{
+				count += mCpuPolicy[cpu] >= 0 || mCpuCoreThrottle[cpu] >= 0 ? 1 : 0;
+			}
+			cpus.resize(count);
+
+			size_t index = 0;
+			for (size_t cpu = 0; cpu < mCpuPolicy.size(); cpu++)
+			{
+				if (mCpuPolicy[cpu] < 0 && mCpuCoreThrottle[cpu] < 0)
+				{
+					continue;
+				}
+
+				CpuFrequency& entry = cpus[index++];
+				entry = CpuFrequency();
+				entry.cpu = static_cast<int>(cpu);
+				if (mCpuPolicy[cpu] >= 0)
+				{
+					const PolicySlot& policy = mPolicies[static_cast<size_t>(mCpuPolicy[cpu])];
+					entry.currentKhz = policy.currentKhz;
+					entry.minKhz = policy.minKhz;
+					entry.maxKhz = policy.maxKhz;
+					entry.hardwareMaxKhz = policy.hardwareMaxKhz;
+					std::memcpy(entry.governor, policy.governor, sizeof(entry.governor));
+					entry.capped = policy.capped;
+				}
+
+				if (mCpuCoreThrottle[cpu] >= 0)
+				{
+					entry.coreThrottleCount = mThrottles[static_cast<size_t>(mCpuCoreThrottle[cpu])].count;
+				}
+
+				if (mCpuPackageThrottle[cpu] >= 0)
+				{
+					entry.packageThrottleCount = mThrottles[static_cast<size_t>(mCpuPackageThrottle[cpu])].count;
+				}
+			}
+
+			return mOpen ? 0 : -1;
+		}
+
+		int ThermalStats::GetThermalZones(std::vector<ThermalZone>& zones) const
+		{
+			zones.resize(mZones.size());
+			for (size_t i = 0; i < mZones.size(); i++)
+			{
+				zones[i] = mZones[i].zone;
+			}
+
+			return mOpen ? 0 : -1;
+		}
+
+		int ThermalStats::GetCoolingDevices(std::vector<CoolingDevice>& devices) const
+		{
+			devices.resize(mCooling.size());
+			for (size_t i = 0; i < mCooling.size(); i++)
+			{
+				devices[i] = mCooling[i].device;
+			}
+
+			return mOpen ? 0 : -1;
+		}
+
+		const ThrottleCounters& ThermalStats::GetThrottleCounters() const
+		{
+			return mCounters;
+		}
+
+		int ThermalStats::ParseTripType(std::string_view text, TripType& type)
+		{
+			text = Procfs::NextLine(text);
+			if (text == "active")
+			{
+				type = TripType::ACTIVE;
+			}
+			else if (text == "passive")
+			{
+				type = TripType::PASSIVE;
+			}
+			else if (text == "hot")
+			{
+				type = TripType::HOT;
+			}
+			else if (text == "critical")
+			{
+				type = TripType::CRITICAL;
+			}
+			else
+			{
+				return -1;
+			}
+
+			return 0;
+		}
+
+		void ThermalStats::OpenFrequency(const CpuTopology& topology, const std::string& cpuRoot)
+		{
+			const size_t cpuCount = topology.GetCpus().size();
+			mCpuPolicy.assign(cpuCount, -1);
+			mCpuCoreThrottle.assign(cpuCount, -1);
+			mCpuPackageThrottle.assign(cpuCount, -1);
+
+			std::vector<int> coreThrottle(topology.GetCores().size(), -1);
+			std::vector<int> packageThrottle(topology.GetPackages().size(), -1);
+			ProcfsFile scratch;
+			uint64_t value = 0;
+
+			for (const LogicalCpu& cpu : topology.GetCpus())
+			{
+				if (!cpu.online)
+				{
+					continue;
+				}
+
+				const std::string directory = cpuRoot + "/cpu" + std::to_string(cpu.cpu) + "/";
+				const size_t index = static_cast<size_t>(cpu.cpu);
+
+				// cpuN/cpufreq links to the policy directory, the first CPU of a policy opens it
+				PolicySlot policy;
+				if (mCpuPolicy[index] < 0 && OpenAndRead(policy.currentFile, directory + "cpufreq/scaling_cur_freq", value))
+				{
+					policy.currentKhz = static_cast<uint32_t>(value);
+					if (OpenAndRead(policy.maxFile, directory + "cpufreq/scaling_max_freq", value))
+					{
+						policy.maxKhz = static_cast<uint32_t>(value);
+					}
+
+					if (OpenAndRead(scratch, directory + "cpufreq/scaling_min_freq", value))
+					{
+						policy.minKhz = static_cast<uint32_t>(value);
+					}
+
+					if (OpenAndRead(scratch, directory + "cpufreq/cpuinfo_max_freq", value))
+					{
+						policy.hardwareMaxKhz = static_cast<uint32_t>(value);
+					}
+
+					if (policy.governorFile.Open((directory + "cpufreq/scaling_governor").c_str(), THERMAL_NAME_LENGTH) == 0)
+					{
+						CopyName(policy.governorFile.Read(), policy.governor);
+					}
+					policy.capped = policy.hardwareMaxKhz > 0 && policy.maxKhz > 0 && policy.maxKhz < policy.hardwareMaxKhz;
+
+					CpuSet related;
+					if (scratch.Open((directory + "cpufreq/related_cpus").c_str(), 256) == 0)
+					{
+						related = CpuSet::FromList(scratch.Read());
+					}
+					related.Set(cpu.cpu);
+
+					for (int member = related.First(); member >= 0; member = related.Next(member))
+					{
+						if (static_cast<size_t>(member) < cpuCount && mCpuPolicy[static_cast<size_t>(member)] < 0)
+						{
+							mCpuPolicy[static_cast<size_t>(member)] = static_cast<int>(mPolicies.size());
+						}
+					}
+					mPolicies.push_back(std::move(policy));
+				}
+
+				// Intel only, one counter per core and one per package, the SMT siblings share them
+				if (cpu.core >= 0 && static_cast<size_t>(cpu.core) < coreThrottle.size())
+				{
+					int& slot = coreThrottle[static_cast<size_t>(cpu.core)];
+					ThrottleSlot throttle;
+					if (slot < 0 && OpenAndRead(throttle.file, directory + "thermal_throttle/core_throttle_count", value))
+					{
+						throttle.count = value;
+						slot = static_cast<int>(mThrottles.size());
+						mThrottles.push_back(std::move(throttle));
+					}
+					mCpuCoreThrottle[index] = slot;
+				}
+
+				for (size_t package = 0; package < topology.GetPackages().size(); package++)
+				{
+					if (topology.GetPackages()[package].id != cpu.package)
+					{
+						continue;
+					}
+
+					int& slot = packageThrottle[package];
+					ThrottleSlot throttle;
+					throttle.package = true;
+					if (slot < 0 && OpenAndRead(throttle.file, directory + "thermal_throttle/package_throttle_count", value))
+					{
+						throttle.count = value;
+						slot = static_cast<int>(mThrottles.size());
+						mThrottles.push_back(std::move(throttle));
+					}
+					mCpuPackageThrottle[index] = slot;
+				}
+			}
+		}
+
+		void ThermalStats::OpenThermal(const std::string& thermalRoot)
+		{
+			ProcfsFile scratch;
+
+			for (int id = 0, misses = 0; misses < THERMAL_MAX_ID_GAP; id++)
+			{
+				const std::string directory = thermalRoot + "/thermal_zone" + std::to_string(id) + "/";
+				ZoneSlot slot;
+				if (slot.temperatureFile.Open((directory + "temp").c_str(), 32) != 0)
+				{
+					misses++;
+					continue;
+				}
+				misses = 0;
+
+				ThermalZone& zone = slot.zone;
+				zone.id = id;
+				if (scratch.Open((directory + "type").c_str(), THERMAL_NAME_LENGTH) == 0)
+				{
+					CopyName(scratch.Read(), zone.type);
+				}
+
+				// Trip points are fixed by firmware or the driver, read once
+				for (size_t trip = 0; trip < THERMAL_MAX_TRIPS; trip++)
+				{
+					const std::string prefix = directory + "trip_point_" + std::to_string(trip) + "_";
+					TripPoint& point = zone.trips[zone.tripCount];
+					if (scratch.Open((prefix + "temp").c_str(), 32) != 0 || !ReadSigned(scratch, point.temperatureMilliC))
+					{
+						break;
+					}
+
+					if (scratch.Open((prefix + "type").c_str(), 32) != 0 || ParseTripType(scratch.Read(), point.type) != 0)
+					{
+						continue;
+					}
+					zone.tripCount++;
+				}
+
+				mZones.push_back(std::move(slot));
+			}
+
+			for (int id = 0, misses = 0; misses < THERMAL_MAX_ID_GAP; id++)
+			{
+				const std::string directory = thermalRoot + "/cooling_device" + std::to_string(id) + "/";
+				CoolingSlot slot;
+				uint64_t value = 0;
+				if (!OpenAndRead(slot.stateFile, directory + "cur_state", value))
+				{
+					misses++;
+					continue;
+				}
+				misses = 0;
+
+				CoolingDevice& device = slot.device;
+				device.id = id;
+				device.currentState = static_cast<uint32_t>(value);
+				if (scratch.Open((directory + "type").c_str(), THERMAL_NAME_LENGTH) == 0)
+				{
+					CopyName(scratch.Read(), device.type);
+				}
+
+				if (OpenAndRead(scratch, directory + "max_state", value))
+				{
+					device.maxState = static_cast<uint32_t>(value);
+				}
+
+				mCooling.push_back(std::move(slot));
+			}
+		}
+
+		void ThermalStats::SampleFrequency()
+		{
+			const bool refreshGovernor = mSampleNumber % GOVERNOR_REFRESH_SAMPLES == 0;
+			uint64_t value = 0;
+
+			for (PolicySlot& policy : mPolicies)
+			{
+				if (ReadUnsigned(policy.currentFile, value))
+				{
+					policy.currentKhz = static_cast<uint32_t>(value);
+				}
+
+				// The cpufreq cooling device and firmware limits lower the policy maximum
+				if (policy.maxFile.IsOpen() && ReadUnsigned(policy.maxFile, value))
+				{
+					policy.maxKhz = static_cast<uint32_t>(value);
+					const bool capped = policy.hardwareMaxKhz > 0 && policy.maxKhz < policy.hardwareMaxKhz;
+					mCounters.frequencyCapEvents += capped && !policy.capped ? 1 : 0;
+					policy.capped = capped;
+				}
+
+				if (refreshGovernor && policy.governorFile.IsOpen())
+				{
+					CopyName(policy.governorFile.Read(), policy.governor);
+				}
+			}
+
+			// Counters only grow, a smaller value means the CPU went through hotplug
+			for (ThrottleSlot& throttle : mThrottles)
+			{
+				if (!ReadUnsigned(throttle.file, value))
+				{
+					continue;
+				}
+
+				if (value > throttle.count)
+				{
+					(throttle.package ? mCounters.packageThrottleEvents : mCounters.coreThrottleEvents) += value - throttle.count;
+				}
+				throttle.count = value;
+			}
+		}
+
+		void ThermalStats::SampleThermal()
+		{
+			for (ZoneSlot& slot : mZones)
+			{
+				ThermalZone& zone = slot.zone;
+				const int64_t previous = zone.temperatureMilliC;
+				const bool hadPrevious = zone.valid;
+
+				int64_t temperature = 0;
+				zone.valid = ReadSigned(slot.temperatureFile, temperature);
+				if (!zone.valid)
+				{
+					continue;
+				}
+				zone.temperatureMilliC = temperature;
+
+				// Disabled trips read 0 or below, they never count
+				zone.tripsExceeded = 0;
+				for (size_t i = 0; i < zone.tripCount; i++)
+				{
+					const TripPoint& trip = zone.trips[i];
+					if (trip.temperatureMilliC <= 0 || temperature < trip.temperatureMilliC)
+					{
+						continue;
+					}
+
+					zone.tripsExceeded++;
+					if (hadPrevious && previous < trip.temperatureMilliC && trip.type != TripType::ACTIVE)
+					{
+						zone.tripCrossings++;
+						mCounters.tripCrossings++;
+					}
+				}
+			}
+
+			uint64_t value = 0;
+			for (CoolingSlot& slot : mCooling)
+			{
+				if (!ReadUnsigned(slot.stateFile, value))
+				{
+					continue;
+				}
+
+				CoolingDevice& device = slot.device;
+				if (device.currentState == 0 && value > 0)
+				{
+					device.activations++;
+					mCounters.coolingActivations++;
+				}
+				device.currentState = static_cast<uint32_t>(value);
+			}
+		}
+	}
+}
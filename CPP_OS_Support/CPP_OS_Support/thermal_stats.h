@@ -0,0 +1,176 @@
+///////////////////////////////////////////////////////////////////////////////
+//!
+//! @file		thermal_stats.h
+//!
+//! @brief		CPU frequency, thermal zone and cooling device sampling with
+//!				throttling counters. Every sysfs file is opened once and
+//!				re-read with pread, so a sample costs one read per cpufreq
+//!				policy file and per zone and no opens or allocations.
+//!
+//! @author		Chip Brommer
+//!
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Includes:
+//          name                        reason included
+//          --------------------        ---------------------------------------
+#include <cstddef>						// size_t
+#include <cstdint>						// Fixed width types
+#include <string>						// Sysfs root
+#include <string_view>					// Parsing
+#include <vector>						// Policy, zone and device slots
+#include "procfs_reader.h"				// Persistent sysfs handles
+#include "cpu_topology.h"				// Online CPUs, cores and packages
+//
+//	Defines:
+//          name                        reason defined
+//          --------------------        ---------------------------------------
+#ifndef     CPP_THERMAL_STATS			// Define the thermal stats class.
+#define     CPP_THERMAL_STATS
+//
+///////////////////////////////////////////////////////////////////////////////
+
+namespace Essentials
+{
+	namespace Utilities
+	{
+		/// @brief Governor, zone and cooling device names, THERMAL_NAME_LENGTH is 20 in the kernel
+		constexpr size_t THERMAL_NAME_LENGTH = 32;
+
+		/// @brief Trip points kept per zone, THERMAL_MAX_TRIPS is 12 in the kernel
+		constexpr size_t THERMAL_MAX_TRIPS = 12;
+
+		/// @brief Frequency of one CPU, shared with the other CPUs of its cpufreq policy
+		struct CpuFrequency
+		{
+			int			cpu = -1;
+			uint32_t	currentKhz = 0;				// scaling_cur_freq
+			uint32_t	minKhz = 0;					// scaling_min_freq at open
+			uint32_t	maxKhz = 0;					// scaling_max_freq, lowered by thermal capping
+			uint32_t	hardwareMaxKhz = 0;			// cpuinfo_max_freq
+			char		governor[THERMAL_NAME_LENGTH] = {};
+			bool		capped = false;				// maxKhz below hardwareMaxKhz
+			uint64_t	coreThrottleCount = 0;		// Intel thermal_throttle, 0 elsewhere
+			uint64_t	packageThrottleCount = 0;
+		};
+
+		/// @brief Trip point types as sysfs names them
+		enum class TripType : uint8_t
+		{
+			ACTIVE,							// Fans
+			PASSIVE,						// Frequency capping
+			HOT,
+			CRITICAL,						// Shutdown
+		};
+
+		struct TripPoint
+		{
+			int64_t		temperatureMilliC = 0;
+			TripType	type = TripType::ACTIVE;
+		};
+
+		/// @brief One thermal zone, temperatures in millidegrees Celsius
+		struct ThermalZone
+		{
+			int			id = -1;
+			char		type[THERMAL_NAME_LENGTH] = {};
+			int64_t		temperatureMilliC = 0;
+			TripPoint	trips[THERMAL_MAX_TRIPS];
+			size_t		tripCount = 0;
+			int			tripsExceeded = 0;			// Trip points at or below the temperature
+			uint64_t	tripCrossings = 0;			// Times a passive, hot or critical trip was crossed upwards
+			bool		valid = false;				// False when the last read failed
+		};
+
+		/// @brief One cooling device, a state above 0 means it is acting
+		struct CoolingDevice
+		{
+			int			id = -1;
+			char		type[THERMAL_NAME_LENGTH] = {};
+			uint32_t	currentState = 0;
+			uint32_t	maxState = 0;
+			uint64_t	activations = 0;			// Transitions from state 0 to active
+		};
+
+		/// @brief Throttling events seen since the stats were opened
+		struct ThrottleCounters
+		{
+			uint64_t	coreThrottleEvents = 0;		// Hardware PROCHOT events, summed over cores
+			uint64_t	packageThrottleEvents = 0;	// Summed over packages
+			uint64_t	frequencyCapEvents = 0;		// A policy's maximum dropped below the hardware maximum
+			uint64_t	tripCrossings = 0;			// Passive, hot or critical trips crossed upwards
+			uint64_t	coolingActivations = 0;		// Cooling devices leaving state 0
+			uint64_t	samples = 0;
+		};
+
+		class ThermalStats
+		{
+		public:
+			ThermalStats();
+			~ThermalStats();
+			int			Open(const CpuTopology& topology, const std::string& root = "/sys");
+			void		Close();
+			bool		IsOpen() const;
+			int			Sample();
+			int			GetCpuFrequencies(std::vector<CpuFrequency>& cpus) const;
+			int			GetThermalZones(std::vector<ThermalZone>& zones) const;
+			int			GetCoolingDevices(std::vector<CoolingDevice>& devices) const;
+			const ThrottleCounters& GetThrottleCounters() const;
+			static int	ParseTripType(std::string_view text, TripType& type);
+		protected:
+		private:
+			/// @brief One cpufreq policy, the CPUs it covers read one set of files
+			struct PolicySlot
+			{
+				ProcfsFile	currentFile;
+				ProcfsFile	maxFile;
+				ProcfsFile	governorFile;
+				uint32_t	currentKhz = 0;
+				uint32_t	minKhz = 0;
+				uint32_t	maxKhz = 0;
+				uint32_t	hardwareMaxKhz = 0;
+				char		governor[THERMAL_NAME_LENGTH] = {};
+				bool		capped = false;
+			};
+
+			/// @brief A hardware throttle counter, one per core or per package
+			struct ThrottleSlot
+			{
+				ProcfsFile	file;
+				uint64_t	count = 0;
+				bool		package = false;
+			};
+
+			struct ZoneSlot
+			{
+				ProcfsFile	temperatureFile;
+				ThermalZone	zone;
+			};
+
+			struct CoolingSlot
+			{
+				ProcfsFile	stateFile;
+				CoolingDevice device;
+			};
+
+			void		OpenFrequency(const CpuTopology& topology, const std::string& cpuRoot);
+			void		OpenThermal(const std::string& thermalRoot);
+			void		SampleFrequency();
+			void		SampleThermal();
+
+			std::vector<PolicySlot>		mPolicies;
+			std::vector<int>			mCpuPolicy;			// Policy index per CPU number, -1 without cpufreq
+			std::vector<ThrottleSlot>	mThrottles;
+			std::vector<int>			mCpuCoreThrottle;	// Throttle slot per CPU number, -1 without one
+			std::vector<int>			mCpuPackageThrottle;
+			std::vector<ZoneSlot>		mZones;
+			std::vector<CoolingSlot>	mCooling;
+			ThrottleCounters			mCounters;
+			uint64_t					mSampleNumber;
+			bool						mOpen;
+		};
+	}
+}
+#endif
@@ -0,0 +1,1324 @@
+﻿#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CPP_OS_Support/os_support.h"
+#include "CPP_OS_Support/metrics_collector.h"
+#include "CPP_OS_Support/metrics_recorder.h"
+#include "CPP_OS_Support/sampling_scheduler.h"
+#include "CPP_OS_Support/selective_snapshot.h"
+
+#ifdef __linux__
+#include <csignal>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace Essentials::Utilities;
+
+/// @brief Heap allocations made by the current thread, counted by the operator new overrides below
+static thread_local uint64_t tAllocations = 0;
+
+// The replacements below are malloc and free underneath. Once GCC inlines one of these
+// deletes it sees free() on a pointer that came from operator new and reports
+// -Wmismatched-new-delete, although every form is replaced and always pairs up.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static void* CountedAllocate(std::size_t size, std::size_t alignment) noexcept
+{
+	tAllocations++;
+	size = size == 0 ? 1 : size;
+	if (alignment <= alignof(std::max_align_t))
+	{
+		return std::malloc(size);
+	}
+
+	// aligned_alloc wants the size to be a multiple of the alignment
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* memory = CountedAllocate(size, 0))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (void* memory = CountedAllocate(size, static_cast<std::size_t>(alignment)))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/// @brief Build a /proc/stat image with the given number of cores, counters advanced by tick.
+static std::string MakeProcStat(int cores, uint64_t tick)
+{
+	std::string text = "cpu  0 0 0 0 0 0 0 0 0 0\n";
+	char line[256];
+	for (int core = 0; core < cores; core++)
+	{
+		const uint64_t base = 1000000 + static_cast<uint64_t>(core) * 977 + tick * 100;
+		std::snprintf(line, sizeof(line), "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu 0 0\n", core,
+			static_cast<unsigned long long>(base + tick * 31), static_cast<unsigned long long>(base / 7),
+			static_cast<unsigned long long>(base / 3 + tick * 11), static_cast<unsigned long long>(base * 4 + tick * 50),
+			static_cast<unsigned long long>(base / 50 + tick), static_cast<unsigned long long>(base / 90 + tick),
+			static_cast<unsigned long long>(base / 80 + tick * 2), static_cast<unsigned long long>(tick % 3));
+		text += line;
+	}
+	text += "intr 123456 0 0 0\nctxt 98765\n";
+	return text;
+}
+
+static void BenchmarkPerCoreScaling()
+{
+	std::cout << "Per-core CPU utilisation, cost per sample\n";
+	std::cout << "  cores     ns/sample     ns/core\n";
+
+	for (int cores : { 1, 8, 32, 64, 128, 256, 512 })
+	{
+		const std::string images[2] = { MakeProcStat(cores, 0), MakeProcStat(cores, 1) };
+		CpuCoreStats stats;
+		stats.Update(images[0]);
+
+		const int iterations = 200000 / cores + 100;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			stats.Update(images[(i + 1) & 1]);
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		const double perSample = elapsed / iterations;
+		std::printf("  %5d  %12.1f  %10.2f\n", cores, perSample, perSample / cores);
+	}
+
+	OS_Support os;
+	std::vector<CoreCpuUsage> usage;
+	const int iterations = 2000;
+	os.GetPerCoreCpuUsage(usage);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		os.GetPerCoreCpuUsage(usage);
+	}
+	auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	std::printf("  live /proc/stat (%zu cores): %.1f ns/sample\n\n", usage.size(), elapsed / iterations);
+}
+
+/// @brief Build a /proc/diskstats image of disks with three partitions each, counters advanced by tick.
+static std::string MakeDiskstats(int devices, uint64_t tick)
+{
+	std::string text;
+	char line[256];
+	for (int device = 0; device < devices; device++)
+	{
+		char name[32];
+		if (device % 4 == 0)
+		{
+			std::snprintf(name, sizeof(name), "nvme%dn1", device / 4);
+		}
+		else
+		{
+			std::snprintf(name, sizeof(name), "nvme%dn1p%d", device / 4, device % 4);
+		}
+
+		const unsigned long long base = 100000ULL + static_cast<unsigned long long>(device) * 131 + tick * 50;
+		std::snprintf(line, sizeof(line), "%4d %7d %s %llu 0 %llu %llu %llu 0 %llu %llu %llu %llu %llu 0 0 0 0 0 0\n",
+			259, device, name, base, base * 8, base / 10, base / 2, base * 8, base / 5,
+			static_cast<unsigned long long>(tick % 7), base / 3, base / 2);
+		text += line;
+	}
+	return text;
+}
+
+static void BenchmarkDiskstatsScaling()
+{
+	std::cout << "Disk I/O stats, cost per sample\n";
+	std::cout << "  devices    bytes     ns/sample   ns/device  tracked\n";
+
+	for (int devices : { 16, 133, 512, 2048 })
+	{
+		const std::string images[2] = { MakeDiskstats(devices, 0), MakeDiskstats(devices, 1) };
+		DiskIoStats stats;
+		stats.Update(images[0], 1);
+
+		const int iterations = 200000 / devices + 100;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			stats.Update(images[(i + 1) & 1], static_cast<uint64_t>(i + 2) * 1000000000ULL);
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		const double perSample = elapsed / iterations;
+		std::printf("  %7d  %7zu  %12.1f  %10.2f  %7zu%s\n", devices, images[0].size(), perSample, perSample / devices,
+			stats.GetDeviceCount(), stats.GetDeviceCount() == static_cast<size_t>(devices) ? "" : "  FAIL");
+	}
+
+	// A partition appearing near the top shifts every later line, the samples after it
+	// have to be back to a single compare per device
+	{
+		const int devices = 2048;
+		std::string images[2] = { MakeDiskstats(devices, 0), MakeDiskstats(devices, 1) };
+		DiskIoStats stats;
+		stats.Update(images[0], 1);
+
+		for (std::string& image : images)
+		{
+			image.insert(image.find('\n') + 1, " 259 99999 nvme0n1p9 1 0 8 1 1 0 8 1 0 1 2 0 0 0 0 0 0\n");
+		}
+		stats.Update(images[1], 2000000000ULL);
+
+		const int iterations = 200;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			stats.Update(images[i & 1], static_cast<uint64_t>(i + 3) * 1000000000ULL);
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		std::printf("  after hotplug (%d devices)  %12.1f ns/sample  %7zu tracked\n", devices + 1, elapsed / iterations,
+			stats.GetDeviceCount());
+	}
+
+	// The live file goes through ProcfsFile, every line has to come back past the first page
+	ProcfsFile file("/proc/diskstats");
+	const std::string_view contents = file.Read();
+	const size_t lines = static_cast<size_t>(std::count(contents.begin(), contents.end(), '\n'));
+	DiskIoStats live;
+	live.Sample();
+	std::printf("  live /proc/diskstats (%zu bytes, %zu lines): %zu devices tracked%s\n\n", contents.size(), lines,
+		live.GetDeviceCount(), live.GetDeviceCount() == lines ? "" : "  FAIL");
+}
+
+/// @brief Build a /proc/net/dev image of veth pairs, counters advanced by tick.
+static std::string MakeNetDev(int interfaces, uint64_t tick)
+{
+	std::string text =
+		"Inter-|   Receive                                                |  Transmit\n"
+		" face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n";
+	char line[256];
+	for (int interface = 0; interface < interfaces; interface++)
+	{
+		const unsigned long long base = 1000000ULL + static_cast<unsigned long long>(interface) * 977 + tick * 1500;
+		std::snprintf(line, sizeof(line), "veth%05d: %llu %llu 0 0 0 0 0 0 %llu %llu 0 0 0 0 0 0\n",
+			interface, base, base / 1500, base * 2, base / 750);
+		text += line;
+	}
+	return text;
+}
+
+static void BenchmarkNetDevScaling()
+{
+	std::cout << "Network stats, cost per sample\n";
+	std::cout << "  interfaces    bytes     ns/sample  ns/interface  tracked\n";
+
+	for (int interfaces : { 8, 81, 512, 2048 })
+	{
+		const std::string images[2] = { MakeNetDev(interfaces, 0), MakeNetDev(interfaces, 1) };
+		NetworkStats stats;
+		stats.Update(images[0], 1);
+
+		const int iterations = 200000 / interfaces + 100;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			stats.Update(images[(i + 1) & 1], static_cast<uint64_t>(i + 2) * 1000000000ULL);
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		const double perSample = elapsed / iterations;
+		std::printf("  %10d  %7zu  %12.1f  %12.2f  %7zu%s\n", interfaces, images[0].size(), perSample, perSample / interfaces,
+			stats.GetInterfaceCount(), stats.GetInterfaceCount() == static_cast<size_t>(interfaces) ? "" : "  FAIL");
+	}
+
+	// Every interface of the live file has to come back, not only the first page
+	ProcfsFile file("/proc/net/dev");
+	const std::string_view contents = file.Read();
+	const size_t interfaces = static_cast<size_t>(std::count(contents.begin(), contents.end(), ':'));
+	NetworkStats live;
+	live.Sample();
+	std::printf("  live /proc/net/dev (%zu bytes, %zu interfaces): %zu tracked%s\n\n", contents.size(), interfaces,
+		live.GetInterfaceCount(), live.GetInterfaceCount() == interfaces ? "" : "  FAIL");
+}
+
+/// @brief Payload whose words must always agree, a torn read shows up as a mismatch.
+struct StressPayload
+{
+	uint64_t words[32];
+};
+
+static void StressSeqLock()
+{
+	const int readers = std::max(4u, std::thread::hardware_concurrency());
+	const auto duration = std::chrono::milliseconds(500);
+
+	SeqLock<StressPayload> lock;
+	std::atomic<bool> stop{ false };
+	std::atomic<uint64_t> reads{ 0 };
+	std::atomic<uint64_t> torn{ 0 };
+	uint64_t writes = 0;
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < readers; i++)
+	{
+		threads.emplace_back([&]
+		{
+			uint64_t localReads = 0;
+			uint64_t localTorn = 0;
+			uint64_t lastSeen = 0;
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				StressPayload payload = lock.Load();
+				for (uint64_t word : payload.words)
+				{
+					if (word != payload.words[0])
+					{
+						localTorn++;
+						break;
+					}
+				}
+
+				// Values only ever move forward for a given reader
+				if (payload.words[0] < lastSeen)
+				{
+					localTorn++;
+				}
+				lastSeen = payload.words[0];
+				localReads++;
+			}
+			reads += localReads;
+			torn += localTorn;
+		});
+	}
+
+	auto end = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < end)
+	{
+		StressPayload payload;
+		writes++;
+		std::fill(std::begin(payload.words), std::end(payload.words), writes);
+		lock.Store(payload);
+	}
+
+	stop = true;
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	std::printf("SeqLock stress, %d readers + 1 writer for %lld ms\n", readers, static_cast<long long>(duration.count()));
+	std::printf("  writes %llu, reads %llu, torn reads %llu -> %s\n\n", static_cast<unsigned long long>(writes),
+		static_cast<unsigned long long>(reads.load()), static_cast<unsigned long long>(torn.load()), torn == 0 ? "PASS" : "FAIL");
+}
+
+static void BenchmarkCollectorReaders()
+{
+	std::cout << "MetricsCollector::GetSnapshot reader latency (collector period 1 ms)\n";
+	std::cout << "  threads      p50 ns      p99 ns    p99.9 ns\n";
+
+	MetricsCollector collector;
+	collector.Start(std::chrono::milliseconds(1));
+
+	for (int threadCount : { 1, 4, 16 })
+	{
+		const int samplesPerThread = 20000;
+		std::vector<std::vector<double>> latencies(threadCount);
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&, t]
+			{
+				std::vector<double>& local = latencies[t];
+				local.reserve(samplesPerThread);
+				volatile uint64_t sink = 0;
+				for (int i = 0; i < samplesPerThread; i++)
+				{
+					auto start = std::chrono::steady_clock::now();
+					SystemSnapshot snapshot = collector.GetSnapshot();
+					auto stop = std::chrono::steady_clock::now();
+					sink = sink + snapshot.totalRamBytes;
+					local.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+				}
+			});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		std::vector<double> all;
+		for (const std::vector<double>& local : latencies)
+		{
+			all.insert(all.end(), local.begin(), local.end());
+		}
+		std::sort(all.begin(), all.end());
+
+		auto percentile = [&all](double p) { return all[static_cast<size_t>(p * (all.size() - 1))]; };
+		std::printf("  %7d  %10.1f  %10.1f  %10.1f\n", threadCount, percentile(0.50), percentile(0.99), percentile(0.999));
+	}
+
+	collector.Stop();
+	std::cout << "\n";
+}
+
+static void BenchmarkRecorder()
+{
+	std::cout << "MetricsRecorder, one day of 1 s snapshots (random walk CPU/RAM, two disks)\n";
+
+	const char* path = "/tmp/os_support_recorder_benchmark.bin";
+	const int samples = 86400;
+
+	MetricsRecorder recorder;
+	if (recorder.OpenForSnapshots(path, 64ull * 1024 * 1024) != 0)
+	{
+		std::cout << "  recorder unavailable\n\n";
+		return;
+	}
+
+	std::mt19937 generator(42);
+	std::normal_distribution<double> noise(0.0, 1.0);
+
+	SystemSnapshot snapshot;
+	snapshot.diskCount = 2;
+	snapshot.disks[0].valid = true;
+	snapshot.disks[0].freeBytes = 200ull << 30;
+	snapshot.disks[1].valid = true;
+	snapshot.disks[1].freeBytes = 40ull << 30;
+
+	double cpu = 25.0;
+	double ram = 6.0 * (1ull << 30);
+	uint64_t timeMs = 1700000000000ull;
+	double writeNs = 0.0;
+
+	for (int i = 0; i < samples; i++)
+	{
+		cpu = std::clamp(cpu + noise(generator) * 2.0, 0.0, 100.0);
+		ram = std::clamp(ram + noise(generator) * 4.0e6, 1.0e9, 15.0e9);
+		snapshot.cpu.usage = cpu;
+		snapshot.cpu.user = cpu * 0.7;
+		snapshot.cpu.system = cpu * 0.25;
+		snapshot.cpu.iowait = std::max(0.0, noise(generator));
+		snapshot.usedRamBytes = static_cast<uint64_t>(ram);
+		snapshot.freeRamBytes = (16ull << 30) - snapshot.usedRamBytes;
+		if (i % 30 == 0)
+		{
+			snapshot.disks[0].freeBytes -= 4096 * static_cast<uint64_t>(generator() % 512);
+		}
+
+		// Sampler wake-ups jitter by a few milliseconds
+		timeMs += 1000 + (generator() % 5) - 2;
+
+		auto start = std::chrono::steady_clock::now();
+		recorder.Record(snapshot, timeMs);
+		writeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const double bytesPerSample = static_cast<double>(recorder.GetBitsWritten()) / 8.0 / static_cast<double>(recorder.GetSamplesWritten());
+	std::printf("  bytes/sample        %8.2f  (14 series, %.1f MiB per week)\n", bytesPerSample,
+		bytesPerSample * 7 * 86400 / (1024.0 * 1024.0));
+	std::printf("  write ns/sample     %8.1f\n", writeNs / samples);
+	recorder.Close();
+
+	MetricsRecordReader reader;
+	if (reader.Open(path) == 0)
+	{
+		size_t decoded = 0;
+		auto start = std::chrono::steady_clock::now();
+		reader.Scan(0, ~0ull, [&decoded](uint64_t, const double*, size_t) { decoded++; });
+		const double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<RecordedPoint> points;
+		start = std::chrono::steady_clock::now();
+		reader.Downsample(static_cast<size_t>(reader.FindSeries("cpu.usage")), timeMs - 3600000, timeMs, 60000, points);
+		const double downsampleUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		std::printf("  full scan ns/sample %8.1f  (%zu samples)\n", scanNs / static_cast<double>(decoded), decoded);
+		std::printf("  last hour to 1 min  %8.1f us (%zu points)\n", downsampleUs, points.size());
+	}
+
+	std::remove(path);
+	std::cout << "\n";
+}
+
+/// @brief One public OS_Support method under test. The call may do paired work
+///			(mount then unmount) as long as it leaves the instance as it found it.
+struct MethodBenchmark
+{
+	const char*								name;
+	int										iterations;
+	bool									concurrent;		// Safe to run on several instances at once
+	std::function<void(OS_Support&, int)>	call;			// Second argument is the caller's thread index
+};
+
+/// @brief Measured cost of one method at one concurrency level.
+struct MethodResult
+{
+	std::string	name;
+	int			threads = 1;
+	int			iterations = 0;
+	double		meanNs = 0.0;
+	double		p50Ns = 0.0;
+	double		p99Ns = 0.0;
+	double		syscallsPerCall = -1.0;		// -1 when the syscalls could not be counted
+	double		allocationsPerCall = 0.0;
+};
+
+/// @brief Scratch mount points, one per caller, only used when running as root
+static std::string MountScratch(int thread, int index)
+{
+	return "/tmp/os_support_benchmark_" + std::to_string(thread) + "_" + std::to_string(index);
+}
+
+static std::vector<MethodBenchmark> MakeMethodBenchmarks()
+{
+	std::vector<MethodBenchmark> methods;
+	const bool root = geteuid() == 0;
+
+	auto add = [&methods](const char* name, int iterations, bool concurrent, std::function<void(OS_Support&, int)> call)
+	{
+		methods.push_back({ name, iterations, concurrent, std::move(call) });
+	};
+
+	add("GetCpuUsagePercent", 2000, true, [](OS_Support& os, int) { os.GetCpuUsagePercent(); });
+	add("GetCpuSample", 2000, true, [](OS_Support& os, int) { os.GetCpuSample(); });
+	add("StartCpuSampling+StopCpuSampling", 50, true, [](OS_Support& os, int) { os.StartCpuSampling(1000); os.StopCpuSampling(); });
+	add("GetPerCoreCpuUsage", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<CoreCpuUsage> cores;
+		os.GetPerCoreCpuUsage(cores);
+	});
+	add("GetCpuTopology", 2000, true, [](OS_Support& os, int) { os.GetCpuTopology(); });
+	add("GetNumaNodeMemory", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<NumaNodeMemory> nodes;
+		os.GetNumaNodeMemory(nodes);
+	});
+	add("GetCpuFrequencies", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<CpuFrequency> cpus;
+		os.GetCpuFrequencies(cpus);
+	});
+	add("GetThermalZones", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<ThermalZone> zones;
+		os.GetThermalZones(zones);
+	});
+	add("GetThrottleCounters", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local ThrottleCounters counters;
+		os.GetThrottleCounters(counters);
+	});
+	add("GetThermalStats", 2000, true, [](OS_Support& os, int) { os.GetThermalStats(); });
+	add("GetTotalRamInGigabytes", 2000, true, [](OS_Support& os, int) { os.GetTotalRamInGigabytes(); });
+	add("GetTotalRamInBytes", 2000, true, [](OS_Support& os, int) { os.GetTotalRamInBytes(); });
+	add("GetFreeRamInBytes", 2000, true, [](OS_Support& os, int) { os.GetFreeRamInBytes(); });
+	add("GetUsedRamInBytes", 2000, true, [](OS_Support& os, int) { os.GetUsedRamInBytes(); });
+	add("GetRamUsagePercent", 2000, true, [](OS_Support& os, int) { os.GetRamUsagePercent(); });
+	add("GetMemoryStats", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local MemorySample sample;
+		os.GetMemoryStats(sample);
+	});
+	add("GetTotalDiskSpaceInBytes", 2000, true, [](OS_Support& os, int) { os.GetTotalDiskSpaceInBytes(); });
+	add("GetTotalDiskSpaceInGigabytes", 2000, true, [](OS_Support& os, int) { os.GetTotalDiskSpaceInGigabytes(); });
+	add("GetFreeDiskSpaceInBytes", 2000, true, [](OS_Support& os, int) { os.GetFreeDiskSpaceInBytes(); });
+	add("GetFreeDiskSpaceInGigabytes", 2000, true, [](OS_Support& os, int) { os.GetFreeDiskSpaceInGigabytes(); });
+	add("GetFreeDiskSpacePercent", 2000, true, [](OS_Support& os, int) { os.GetFreeDiskSpacePercent(); });
+	add("GetUsedDiskSpacePercent", 2000, true, [](OS_Support& os, int) { os.GetUsedDiskSpacePercent(); });
+	add("GetDiskUsage", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local DiskUsage usage;
+		os.GetDiskUsage("/", usage);
+	});
+	add("GetAllDiskUsage", 200, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<DiskUsage> usage;
+		os.GetAllDiskUsage(usage);
+	});
+	add("GetMountTable", 2000, true, [](OS_Support& os, int) { os.GetMountTable(); });
+	add("GetDiskIoStats", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<BlockDeviceStats> devices;
+		os.GetDiskIoStats(devices);
+	});
+	add("GetDiskIoStats(path)", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local BlockDeviceStats device;
+		os.GetDiskIoStats("/", device);
+	});
+	add("SetDiskIoFilter", 2000, true, [](OS_Support& os, int)
+	{
+		static const std::vector<std::string> include;
+		static const std::vector<std::string> exclude = { "loop*", "ram*" };
+		os.SetDiskIoFilter(include, exclude);
+	});
+	add("GetNumberOfEthernetDevices", 2000, true, [](OS_Support& os, int) { os.GetNumberOfEthernetDevices(); });
+	add("GetNetworkInterfaceStats", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<InterfaceStats> interfaces;
+		os.GetNetworkInterfaceStats(interfaces);
+	});
+	add("SetNetworkInterfaceFilter", 2000, true, [](OS_Support& os, int)
+	{
+		static const std::vector<std::string> include;
+		static const std::vector<std::string> exclude = { "veth*" };
+		os.SetNetworkInterfaceFilter(include, exclude);
+	});
+	add("GetLinkMonitor", 2000, true, [](OS_Support& os, int) { os.GetLinkMonitor(); });
+	add("ScanProcesses", 10, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<ProcessInfo> processes;
+		os.ScanProcesses(processes);
+	});
+	add("GetTopProcesses", 500, true, [](OS_Support& os, int)
+	{
+		static thread_local std::vector<ProcessInfo> top;
+		os.GetTopProcesses(ProcessSortKey::CPU, 10, top);
+	});
+	add("GetProcessScanner", 2000, true, [](OS_Support& os, int) { os.GetProcessScanner(); });
+	add("SetContainerAware", 200, true, [](OS_Support& os, int) { os.SetContainerAware(true); os.SetContainerAware(false); });
+	add("IsContainerAware", 2000, true, [](OS_Support& os, int) { os.IsContainerAware(); });
+	add("GetCgroupSample", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local CgroupSample sample;
+		os.GetCgroupSample(sample);
+	});
+	add("GetPressure", 2000, true, [](OS_Support& os, int)
+	{
+		static thread_local PressureStats stats;
+		os.GetPressure(PressureResource::MEMORY, stats);
+	});
+	add("GetPressureMonitor", 2000, true, [](OS_Support& os, int) { os.GetPressureMonitor(); });
+	add("GetSystemUpTimeInSeconds", 2000, true, [](OS_Support& os, int) { os.GetSystemUpTimeInSeconds(); });
+	add("GetSystemUpTimeHMS", 2000, true, [](OS_Support& os, int)
+	{
+		int hours = 0;
+		int mins = 0;
+		int secs = 0;
+		os.GetSystemUpTimeHMS(hours, mins, secs);
+	});
+	add("SetSnapshotMounts", 2000, true, [](OS_Support& os, int)
+	{
+		static const std::vector<std::string> mounts = { "/" };
+		os.SetSnapshotMounts(mounts);
+	});
+	add("Capture", 1000, true, [](OS_Support& os, int)
+	{
+		static thread_local SystemSnapshot snapshot;
+		os.Capture(snapshot);
+	});
+	add("Capture(batched reads)", 1000, true, [](OS_Support& os, int)
+	{
+		static thread_local SystemSnapshot snapshot;
+		os.SetBatchedReads(true);
+		os.Capture(snapshot);
+	});
+	add("CaptureAsync", 500, true, [](OS_Support& os, int)
+	{
+		static thread_local EventLoop loop;
+		static thread_local SystemSnapshot snapshot;
+		loop.RunUntilComplete(os.CaptureAsync(loop, snapshot));
+	});
+	add("AttachSharedMetrics+DetachSharedMetrics", 500, true, [](OS_Support& os, int)
+	{
+		os.AttachSharedMetrics("/os_support_benchmark_absent");
+		os.DetachSharedMetrics();
+	});
+	add("IsUsingSharedMetrics", 2000, true, [](OS_Support& os, int) { os.IsUsingSharedMetrics(); });
+	add("GetLastError", 2000, true, [](OS_Support& os, int) { os.GetLastError(); });
+	add("GetLastErrorInfo", 2000, true, [](OS_Support& os, int) { os.GetLastErrorInfo(); });
+	add("GetLastErrorCode", 2000, true, [](OS_Support& os, int) { os.GetLastErrorCode(); });
+
+	if (root)
+	{
+		add("MountStorageDevice+UnmountStorageDevice", 50, true, [](OS_Support& os, int thread)
+		{
+			const std::string location = MountScratch(thread, 0);
+			os.MountStorageDevice("tmpfs", location);
+			os.UnmountStorageDevice(location);
+		});
+		add("MountStorageDevice(request)", 50, true, [](OS_Support& os, int thread)
+		{
+			MountRequest request;
+			request.device = "tmpfs";
+			request.location = MountScratch(thread, 0);
+			request.data = "size=1m";
+			MountResult result;
+			os.MountStorageDevice(request, result);
+			os.UnmountStorageDevice(request.location);
+		});
+		add("MountAsync+UnmountAsync", 50, true, [](OS_Support& os, int thread)
+		{
+			static thread_local EventLoop loop;
+			MountRequest request;
+			request.device = "tmpfs";
+			request.location = MountScratch(thread, 0);
+			MountResult result;
+			loop.RunUntilComplete(os.MountAsync(loop, request, result));
+			loop.RunUntilComplete(os.UnmountAsync(loop, request.location));
+		});
+		add("RunMountBatch", 20, true, [](OS_Support& os, int thread)
+		{
+			std::vector<MountRequest> requests(4);
+			for (int i = 0; i < 4; i++)
+			{
+				requests[i].device = "tmpfs";
+				requests[i].location = MountScratch(thread, i);
+			}
+
+			std::vector<MountResult> results;
+			os.RunMountBatch(requests, results);
+			for (MountRequest& request : requests)
+			{
+				request.action = MountRequest::Action::UNMOUNT;
+			}
+			os.RunMountBatch(requests, results);
+		});
+	}
+
+	return methods;
+}
+
+/// @brief Syscalls per call on the calling thread, counted by tracing a forked child.
+static double CountSyscalls(const std::function<void(OS_Support&, int)>& call, int iterations)
+{
+#if defined(__linux__) && defined(PTRACE_GET_SYSCALL_INFO)
+	iterations = std::min(iterations, 50);
+
+	pid_t child = fork();
+	if (child < 0)
+	{
+		return -1.0;
+	}
+
+	if (child == 0)
+	{
+		// Warm up lazily opened handles and threads before tracing starts. getppid()
+		// brackets the measured calls, none of the methods under test make it.
+		OS_Support os;
+		for (int i = 0; i < 3; i++)
+		{
+			call(os, 0);
+		}
+
+		if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0)
+		{
+			_exit(1);
+		}
+		raise(SIGSTOP);
+
+		syscall(SYS_getppid);
+		for (int i = 0; i < iterations; i++)
+		{
+			call(os, 0);
+		}
+		syscall(SYS_getppid);
+		_exit(0);
+	}
+
+	int status = 0;
+	if (waitpid(child, &status, 0) != child || !WIFSTOPPED(status))
+	{
+		waitpid(child, &status, 0);
+		return -1.0;
+	}
+
+	ptrace(PTRACE_SETOPTIONS, child, nullptr, reinterpret_cast<void*>(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+	int64_t count = 0;
+	int markers = 0;
+	while (ptrace(PTRACE_SYSCALL, child, nullptr, nullptr) == 0 && waitpid(child, &status, 0) == child && !WIFEXITED(status))
+	{
+		if (!WIFSTOPPED(status) || WSTOPSIG(status) != (SIGTRAP | 0x80))
+		{
+			continue;
+		}
+
+		struct __ptrace_syscall_info info {};
+		if (ptrace(PTRACE_GET_SYSCALL_INFO, child, reinterpret_cast<void*>(sizeof(info)), &info) <= 0 ||
+			info.op != PTRACE_SYSCALL_INFO_ENTRY)
+		{
+			continue;
+		}
+
+		if (info.entry.nr == SYS_getppid)
+		{
+			markers++;
+		}
+		else if (markers == 1)
+		{
+			count++;
+		}
+	}
+
+	if (!WIFEXITED(status))
+	{
+		kill(child, SIGKILL);
+		waitpid(child, &status, 0);
+	}
+
+	return markers >= 2 ? static_cast<double>(count) / iterations : -1.0;
+#else
+	(void)call;
+	(void)iterations;
+	return -1.0;
+#endif
+}
+
+/// @brief Runs the method on one OS_Support per thread and merges the per-call latencies.
+static MethodResult RunMethod(const MethodBenchmark& method, int threadCount)
+{
+	MethodResult result;
+	result.name = method.name;
+	result.threads = threadCount;
+	result.iterations = method.iterations;
+
+	std::vector<std::vector<double>> latencies(threadCount);
+	std::vector<uint64_t> allocations(threadCount, 0);
+	std::atomic<int> ready{ 0 };
+
+	auto worker = [&](int thread)
+	{
+		OS_Support os;
+		for (int i = 0; i < 3; i++)
+		{
+			method.call(os, thread);
+		}
+
+		std::vector<double>& local = latencies[thread];
+		local.reserve(method.iterations);
+
+		// Start together so the callers really overlap
+		ready++;
+		while (ready.load() < threadCount)
+		{
+			std::this_thread::yield();
+		}
+
+		const uint64_t allocationsBefore = tAllocations;
+		for (int i = 0; i < method.iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			method.call(os, thread);
+			local.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+		}
+		allocations[thread] = tAllocations - allocationsBefore;
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker, t);
+	}
+	worker(0);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	std::vector<double> all;
+	uint64_t totalAllocations = 0;
+	for (int t = 0; t < threadCount; t++)
+	{
+		all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+		totalAllocations += allocations[t];
+	}
+	std::sort(all.begin(), all.end());
+
+	double sum = 0.0;
+	for (double latency : all)
+	{
+		sum += latency;
+	}
+
+	result.meanNs = sum / static_cast<double>(all.size());
+	result.p50Ns = all[static_cast<size_t>(0.50 * (all.size() - 1))];
+	result.p99Ns = all[static_cast<size_t>(0.99 * (all.size() - 1))];
+	result.allocationsPerCall = static_cast<double>(totalAllocations) / static_cast<double>(all.size());
+	return result;
+}
+
+static void PrepareMountScratch(int threadCount, bool create)
+{
+#ifdef __linux__
+	for (int thread = 0; thread < threadCount; thread++)
+	{
+		for (int index = 0; index < 4; index++)
+		{
+			const std::string path = MountScratch(thread, index);
+			if (create)
+			{
+				mkdir(path.c_str(), 0755);
+			}
+			else
+			{
+				rmdir(path.c_str());
+			}
+		}
+	}
+#else
+	(void)threadCount;
+	(void)create;
+#endif
+}
+
+/// @brief Quotes and escapes a string for the JSON output
+static std::string JsonString(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if (c == '\n')
+		{
+			quoted += "\\n";
+		}
+		else if (static_cast<unsigned char>(c) >= 0x20)
+		{
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+static void PrintMethodResults(const std::vector<MethodResult>& results, bool json)
+{
+	if (json)
+	{
+		std::printf("{\n  \"version\": %s,\n  \"results\": [\n", JsonString(OSSupportVersion).c_str());
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const MethodResult& result = results[i];
+			char syscalls[32];
+			if (result.syscallsPerCall < 0.0)
+			{
+				std::snprintf(syscalls, sizeof(syscalls), "null");
+			}
+			else
+			{
+				std::snprintf(syscalls, sizeof(syscalls), "%.2f", result.syscallsPerCall);
+			}
+
+			std::printf("    { \"method\": %s, \"threads\": %d, \"iterations\": %d, \"mean_ns\": %.1f, \"p50_ns\": %.1f, "
+				"\"p99_ns\": %.1f, \"syscalls_per_call\": %s, \"allocations_per_call\": %.2f }%s\n",
+				JsonString(result.name).c_str(), result.threads, result.iterations, result.meanNs, result.p50Ns, result.p99Ns,
+				syscalls, result.allocationsPerCall, i + 1 < results.size() ? "," : "");
+		}
+		std::printf("  ]\n}\n");
+		return;
+	}
+
+	std::cout << "OS_Support per-method cost\n";
+	std::printf("  %-42s %7s %11s %11s %11s %9s %9s\n", "method", "threads", "mean ns", "p50 ns", "p99 ns", "syscalls", "allocs");
+	for (const MethodResult& result : results)
+	{
+		char syscalls[32];
+		if (result.syscallsPerCall < 0.0)
+		{
+			std::snprintf(syscalls, sizeof(syscalls), "n/a");
+		}
+		else
+		{
+			std::snprintf(syscalls, sizeof(syscalls), "%.2f", result.syscallsPerCall);
+		}
+
+		std::printf("  %-42s %7d %11.1f %11.1f %11.1f %9s %9.2f\n", result.name.c_str(), result.threads,
+			result.meanNs, result.p50Ns, result.p99Ns, syscalls, result.allocationsPerCall);
+	}
+	std::cout << "\n";
+}
+
+static void BenchmarkMethods(int concurrentCallers, const std::string& filter, bool json)
+{
+	std::vector<MethodBenchmark> methods = MakeMethodBenchmarks();
+	std::vector<MethodResult> results;
+
+	PrepareMountScratch(concurrentCallers, true);
+
+	for (const MethodBenchmark& method : methods)
+	{
+		if (!filter.empty() && std::string(method.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		MethodResult single = RunMethod(method, 1);
+		single.syscallsPerCall = CountSyscalls(method.call, method.iterations);
+		results.push_back(single);
+
+		if (method.concurrent && concurrentCallers > 1)
+		{
+			// Syscalls per call do not change with the number of callers
+			MethodResult concurrent = RunMethod(method, concurrentCallers);
+			concurrent.syscallsPerCall = single.syscallsPerCall;
+			results.push_back(concurrent);
+		}
+	}
+
+	PrepareMountScratch(concurrentCallers, false);
+	PrintMethodResults(results, json);
+}
+
+/// @brief One full pass over a typical set of host procfs and sysfs files, as one
+///			io_uring batch and as one pread per file.
+static void BenchmarkBatchedReads()
+{
+	static const char* const paths[] =
+	{
+		"/proc/stat", "/proc/meminfo", "/proc/net/dev", "/proc/diskstats", "/proc/loadavg", "/proc/vmstat",
+		"/proc/self/stat", "/proc/self/statm", "/proc/self/status", "/proc/pressure/cpu", "/proc/pressure/memory",
+		"/proc/pressure/io", "/sys/class/net/lo/operstate", "/sys/class/net/lo/statistics/rx_bytes",
+		"/sys/class/net/lo/statistics/tx_bytes", "/sys/kernel/mm/transparent_hugepage/enabled",
+	};
+
+	// Built inside the call so a traced child makes its own ring rather than sharing the parent's
+	struct Reader
+	{
+		std::vector<ProcfsFile>	files;
+		ProcfsBatch				batch;
+	};
+
+	auto makeCall = [](bool ring)
+	{
+		auto reader = std::make_shared<std::unique_ptr<Reader>>();
+		return [reader, ring](OS_Support&, int)
+		{
+			if (!*reader)
+			{
+				*reader = std::make_unique<Reader>();
+				Reader& created = **reader;
+				created.files.reserve(std::size(paths));
+				for (const char* path : paths)
+				{
+					ProcfsFile file;
+					if (file.Open(path) == 0)
+					{
+						created.files.push_back(std::move(file));
+					}
+				}
+				for (ProcfsFile& file : created.files)
+				{
+					created.batch.Add(file);
+				}
+				created.batch.SetRingEnabled(ring);
+			}
+			(*reader)->batch.ReadAll();
+		};
+	};
+
+	std::cout << "Full procfs/sysfs pass, " << std::size(paths) << " files or fewer where absent\n";
+	std::cout << "  backend        ns/pass   syscalls/pass\n";
+
+	for (bool ring : { false, true })
+	{
+		const double syscalls = CountSyscalls(makeCall(ring), 50);
+
+		MethodBenchmark method{ ring ? "io_uring" : "pread", 2000, false, makeCall(ring) };
+		MethodResult result = RunMethod(method, 1);
+
+		char syscallText[32];
+		std::snprintf(syscallText, sizeof(syscallText), syscalls < 0.0 ? "n/a" : "%.2f", syscalls);
+		std::printf("  %-10s %11.1f %15s\n", method.name, result.meanNs, syscallText);
+	}
+
+	OS_Support os;
+	SystemSnapshot snapshot;
+	os.SetBatchedReads(true);
+	os.Capture(snapshot);
+	std::cout << "  Capture batched reads: " << (os.IsUsingBatchedReads() ? "io_uring" : "pread fallback") << "\n\n";
+}
+
+/// @brief Subscriber queue cost per batch, and how many collections the scheduler
+///			coalesces into each pass at its default intervals sped up tenfold
+static void BenchmarkSamplingScheduler()
+{
+	std::cout << "SamplingScheduler (" << sizeof(SampleBatch) << " byte batches)\n";
+
+	SampleQueue queue(64);
+	SampleBatch batch;
+	const int rounds = 200000;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; i++)
+	{
+		batch.sequence = static_cast<uint64_t>(i);
+		queue.Push(batch);
+		queue.TryPop(batch);
+	}
+	auto stop = std::chrono::steady_clock::now();
+	std::printf("  push+pop ns           %8.1f\n", std::chrono::duration<double, std::nano>(stop - start).count() / rounds);
+
+	// Full queue, every push first drops the oldest batch
+	for (size_t i = 0; i < queue.GetCapacity(); i++)
+	{
+		queue.Push(batch);
+	}
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; i++)
+	{
+		queue.Push(batch);
+	}
+	stop = std::chrono::steady_clock::now();
+	std::printf("  drop-oldest push ns   %8.1f\n", std::chrono::duration<double, std::nano>(stop - start).count() / rounds);
+
+	SamplingScheduler scheduler;
+	scheduler.SetInterval(SampledMetric::CPU, std::chrono::milliseconds(10));
+	scheduler.SetInterval(SampledMetric::MEMORY, std::chrono::milliseconds(100));
+	scheduler.SetInterval(SampledMetric::DISK, std::chrono::milliseconds(3000));
+	scheduler.SetInterval(SampledMetric::PROCESSES, std::chrono::milliseconds(500));
+	scheduler.SetTickResolution(std::chrono::milliseconds(1));
+	scheduler.SetMaxJitter(std::chrono::milliseconds(0));
+	std::shared_ptr<SampleQueue> subscriber = scheduler.Subscribe(16);
+
+	if (scheduler.Start() == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(3005));
+		scheduler.Stop();
+		std::printf("  3 s run               %llu passes, %llu collections, %llu batches dropped by an idle subscriber\n",
+			static_cast<unsigned long long>(scheduler.GetPassCount()), static_cast<unsigned long long>(scheduler.GetCollectionCount()),
+			static_cast<unsigned long long>(subscriber->GetDroppedCount()));
+	}
+	std::cout << "\n";
+}
+
+/// @brief Compile-time selected snapshots against the full Capture they replace
+static void BenchmarkSelectiveSnapshot()
+{
+	using MemoryAndCpu = Snapshot<Mem::Available, Cpu::Total>;
+	using MemoryDiskAndCpu = Snapshot<Mem::Available, Disk::Free<"/">, Cpu::Total>;
+
+	const MethodBenchmark methods[] =
+	{
+		{ "Capture", 2000, false, [](OS_Support& os, int)
+		{
+			static thread_local SystemSnapshot snapshot;
+			os.Capture(snapshot);
+		} },
+		{ "Mem::Available, Cpu::Total", 2000, false, [](OS_Support&, int)
+		{
+			static thread_local MemoryAndCpu snapshot;
+			static thread_local MemoryAndCpu::Collector collector;
+			collector.Collect(snapshot);
+		} },
+		{ "+ Disk::Free<\"/\">", 2000, false, [](OS_Support&, int)
+		{
+			static thread_local MemoryDiskAndCpu snapshot;
+			static thread_local MemoryDiskAndCpu::Collector collector;
+			collector.Collect(snapshot);
+		} },
+	};
+
+	std::cout << "Selective snapshot vs Capture\n";
+	std::cout << "  snapshot                        bytes     ns/pass   syscalls/pass\n";
+
+	const size_t sizes[] = { sizeof(SystemSnapshot), sizeof(MemoryAndCpu), sizeof(MemoryDiskAndCpu) };
+	for (size_t i = 0; i < std::size(methods); i++)
+	{
+		const double syscalls = CountSyscalls(methods[i].call, 50);
+		MethodResult result = RunMethod(methods[i], 1);
+
+		char syscallText[32];
+		std::snprintf(syscallText, sizeof(syscallText), syscalls < 0.0 ? "n/a" : "%.2f", syscalls);
+		std::printf("  %-28s %8zu %11.1f %15s\n", methods[i].name, sizes[i], result.meanNs, syscallText);
+	}
+	std::cout << "\n";
+}
+
+/// @brief What the probes recorded over the whole run, only with OS_SUPPORT_ENABLE_INSTRUMENTATION
+static void PrintProbeStats()
+{
+	if (!INSTRUMENTATION_ENABLED)
+	{
+		return;
+	}
+
+	std::cout << "Collection path probes, all threads\n";
+	std::printf("  %-12s %10s %8s %11s %11s %11s %11s\n", "probe", "calls", "errors", "mean ns", "p50 ns", "p99 ns", "max ns");
+	for (int i = 0; i < static_cast<int>(Probe::PROBE_COUNT); i++)
+	{
+		ProbeStats stats;
+		if (OS_Support::GetProbeStats(static_cast<Probe>(i), stats) != 0)
+		{
+			continue;
+		}
+
+		std::printf("  %-12s %10llu %8llu %11.1f %11llu %11llu %11llu\n", GetProbeName(static_cast<Probe>(i)),
+			static_cast<unsigned long long>(stats.calls), static_cast<unsigned long long>(stats.errors), stats.GetMeanNs(),
+			static_cast<unsigned long long>(stats.GetPercentileNs(50.0)), static_cast<unsigned long long>(stats.GetPercentileNs(99.0)),
+			static_cast<unsigned long long>(stats.maxNs));
+	}
+	std::cout << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+	// --json prints only the per-method results, for diffing between releases
+	bool json = false;
+	int concurrentCallers = static_cast<int>(std::max(4u, std::thread::hardware_concurrency()));
+	std::string filter;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			concurrentCallers = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--json] [--threads N] [--filter name]\n";
+			return 1;
+		}
+	}
+
+	if (json)
+	{
+		BenchmarkMethods(concurrentCallers, filter, true);
+		return 0;
+	}
+
+	std::cout << OSSupportVersion << "\n";
+
+	BenchmarkMethods(concurrentCallers, filter, false);
+	BenchmarkPerCoreScaling();
+	BenchmarkDiskstatsScaling();
+	BenchmarkNetDevScaling();
+	StressSeqLock();
+	BenchmarkCollectorReaders();
+	BenchmarkRecorder();
+	BenchmarkBatchedReads();
+	BenchmarkSelectiveSnapshot();
+	BenchmarkSamplingScheduler();
+	PrintProbeStats();
+
+	return 0;
+}
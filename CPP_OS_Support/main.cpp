@@ -1,14 +1,50 @@
 ﻿#include <iostream>
+#include <thread>
+#include <string>
 #include "CPP_OS_Support/os_support.h"
+#include "CPP_OS_Support/metrics_collector.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+	// Collector mode publishes snapshots for every other process on the host
+	if (argc > 1 && std::string(argv[1]) == "--collector")
+	{
+		Essentials::Utilities::MetricsCollector collector;
+		if (collector.EnableSharedMemory() != 0 || collector.Start(std::chrono::milliseconds(1000)) != 0)
+		{
+			std::cout << "Failed to start the shared metrics collector.\n";
+			return 1;
+		}
+
+		std::cout << "Publishing to " << Essentials::Utilities::SHARED_METRICS_DEFAULT_NAME << ", Ctrl+C to stop.\n";
+		while (true)
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(60));
+		}
+	}
+
 	Essentials::Utilities::OS_Support os;
 
-	std::cout << "Time Up:      " << os.GetSystemUpTimeInSeconds()		<< " secs\n";
+	// Read from a running collector when there is one, otherwise collect directly
+	if (os.AttachSharedMetrics() == 0)
+	{
+		std::cout << "Using shared metrics from a running collector.\n\n";
+	}
+
+	// Prime the CPU counters so the capture below reports a real interval
+	Essentials::Utilities::SystemSnapshot snapshot;
+	std::vector<Essentials::Utilities::InterfaceStats> interfaces;
+	os.Capture(snapshot);
+	os.GetNetworkInterfaceStats(interfaces);
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+	// Everything below is answered from a single capture
+	os.Capture(snapshot);
+
+	std::cout << "Time Up:      " << snapshot.GetSystemUpTimeInSeconds()	<< " secs\n";
 
 	int secs, mins, hrs;
-	int rtn = os.GetSystemUpTimeHMS(hrs, mins, secs);
+	int rtn = snapshot.GetSystemUpTimeHMS(hrs, mins, secs);
 
 	if (rtn > -1)
 	{
@@ -17,26 +53,52 @@ int main()
 
 	std::cout << "\n\n";
 
-	std::cout << "Total Ram:    " << os.GetTotalRamInGigabytes()		<< " Gb\n";
-	std::cout << "Total Ram:    " << os.GetTotalRamInBytes()			<< " Bytes\n";
-	std::cout << "Used Ram:     " << os.GetUsedRamInBytes()				<< " Bytes\n";
-	std::cout << "Free Ram:     " << os.GetFreeRamInBytes()				<< " Bytes\n";
-	std::cout << "Percent Used: " << os.GetRamUsagePercent()			<< " %\n";
+	std::cout << "Total Ram:    " << snapshot.GetTotalRamInGigabytes()		<< " Gb\n";
+	std::cout << "Total Ram:    " << snapshot.GetTotalRamInBytes()			<< " Bytes\n";
+	std::cout << "Used Ram:     " << snapshot.GetUsedRamInBytes()			<< " Bytes\n";
+	std::cout << "Free Ram:     " << snapshot.GetFreeRamInBytes()			<< " Bytes\n";
+	std::cout << "Percent Used: " << snapshot.GetRamUsagePercent()			<< " %\n";
 
 	std::cout << "\n\n";
 
-	std::cout << "CPU Usage:    " << os.GetCpuUsagePercent()			<< " %\n";
+	std::cout << "CPU Usage:    " << snapshot.GetCpuUsagePercent()			<< " %\n";
 
 	std::cout << "\n\n";
 
-	std::cout << "Total Space:  " << os.GetTotalDiskSpaceInGigabytes()	<< " Gb\n";
-	std::cout << "Free Space:   " << os.GetFreeDiskSpaceInGigabytes()	<< " Gb\n";
-	std::cout << "Percent Free: " << os.GetFreeDiskSpacePercent()		<< " %\n";
-	std::cout << "Percent Used: " << os.GetUsedDiskSpacePercent()		<< " %\n";
+	std::cout << "Total Space:  " << snapshot.GetTotalDiskSpaceInGigabytes()	<< " Gb\n";
+	std::cout << "Free Space:   " << snapshot.GetFreeDiskSpaceInGigabytes()	<< " Gb\n";
+	std::cout << "Percent Free: " << snapshot.GetFreeDiskSpacePercent()		<< " %\n";
+	std::cout << "Percent Used: " << snapshot.GetUsedDiskSpacePercent()		<< " %\n";
 
 	std::cout << "\n\n";
 
-	std::cout << "Number Eth Devices: " << os.GetNumberOfEthernetDevices() << "\n";
+	std::vector<Essentials::Utilities::DiskUsage> disks;
+	if (os.GetAllDiskUsage(disks) == 0)
+	{
+		for (const Essentials::Utilities::DiskUsage& disk : disks)
+		{
+			if (disk.valid && disk.totalBytes > 0)
+			{
+				std::cout << disk.mountPoint << " (" << disk.fsType << "): "
+					<< disk.freeBytes / (1024 * 1024) << " / " << disk.totalBytes / (1024 * 1024) << " MiB free, "
+					<< disk.freeInodes << " / " << disk.totalInodes << " inodes free\n";
+			}
+		}
+
+		std::cout << "\n\n";
+	}
+
+	std::cout << "Number Eth Devices: " << snapshot.GetNumberOfEthernetDevices() << "\n";
+
+	if (os.GetNetworkInterfaceStats(interfaces) == 0)
+	{
+		for (const Essentials::Utilities::InterfaceStats& stats : interfaces)
+		{
+			std::cout << stats.name << ": rx " << stats.rxBytesPerSecond << " B/s, tx " << stats.txBytesPerSecond
+				<< " B/s, errors " << stats.rxErrorsPerSecond + stats.txErrorsPerSecond
+				<< "/s, drops " << stats.rxDropsPerSecond + stats.txDropsPerSecond << "/s\n";
+		}
+	}
 
 	return 0;
 }